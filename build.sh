@@ -1 +1,10 @@
 gcc -Wall -o hues.o -g -c hues.c
+gcc -Wall -o hues_ring.o -g -c hues_ring.c
+gcc -Wall -o hues_file.o -g -c hues_file.c
+gcc -Wall -o hues_socket.o -g -c hues_socket.c
+gcc -Wall -o hues_lz4.o -g -c hues_lz4.c
+gcc -Wall -o hues_index.o -g -c hues_index.c
+gcc -Wall -o hues_bloom.o -g -c hues_bloom.c
+gcc -Wall -o hues_columnar.o -g -c hues_columnar.c
+gcc -Wall -o hues_hook.o -g -c hues_hook.c
+gcc -Wall -fPIC -shared -o libhues_preload.so -g hues_preload.c hues.c hues_ring.c hues_file.c hues_socket.c hues_lz4.c hues_index.c hues_bloom.c hues_columnar.c hues_hook.c -pthread -lrt -ldl
@@ -5,6 +5,11 @@
 
 #include "hues.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/syscall.h>
+
 /**
  * @fn static void hues_log_message_v(hues_message* message, va_list list)
  * @brief Logs a formatted message.
@@ -39,15 +44,92 @@ static size_t hues_format_pv_core(char* buffer, size_t buffer_size, char prefix,
  */
 static size_t hues_format_cv_core(char* buffer, size_t buffer_size, char prefix, hues_format** formats, const char* to_format, va_list list);
 
+/**
+ * @fn static void hues_emit(const hues_record* record, hues_level_format* theme_level)
+ * @brief Writes a formatted record to the console and to every sink accepting its level.
+ * @param record The record to write.
+ * @param theme_level The colors of the record level.
+ */
+static void hues_emit(const hues_record* record, hues_level_format* theme_level);
+
+/**
+ * @fn static void hues_log_record_v(hues_message* message, uint64_t timestamp, va_list list)
+ * @brief Formats and emits a message logged at the given time, regardless of the minimum level.
+ * @param message The message to log.
+ * @param timestamp The time of the message, in nanoseconds since the epoch.
+ * @param list A list of arguments to use in the to_format string.
+ */
+static void hues_log_record_v(hues_message* message, uint64_t timestamp, va_list list);
+
+/**
+ * @fn static void hues_backtrace_capture(hues_message* message, uint64_t timestamp, va_list list)
+ * @brief Stores a message below the minimum level in the backtrace of the calling thread, without formatting it.
+ * @param message The message to store.
+ * @param timestamp The time of the message, in nanoseconds since the epoch.
+ * @param list A list of arguments to use in the to_format string.
+ */
+static void hues_backtrace_capture(hues_message* message, uint64_t timestamp, va_list list);
+
+/**
+ * @fn static int hues_request_append(const hues_record* record)
+ * @brief Buffers a record in the request the calling thread is attached to, if any.
+ * @param record The record to buffer.
+ * @return 1 if the record was buffered, 0 if it has to be emitted.
+ */
+static int hues_request_append(const hues_record* record);
+
 static hues_configuration hues_glob_configuration = { 
     .minimum_level = HUES_LEVEL_DEBUG,
     .header_format = "#t/#d #v\t",
     .prefix = '#',
     .theme = NULL,
     .levels_count = HUES_LEVEL_UNKNOWN + 1,
-    .formats = NULL
+    .formats = NULL,
+    .sinks = NULL,
+    .backtrace_depth = 0,
+    .backtrace_trigger_level = HUES_LEVEL_SEVERE,
+    .signal_fd = STDERR_FILENO,
+    .console = 1
 };
 
+/**
+ * @var hues_thread_timestamp
+ * @brief Time of the record being formatted by the calling thread, in nanoseconds since the epoch, 0 outside of a record.
+ */
+static __thread uint64_t hues_thread_timestamp = 0;
+
+/**
+ * @var hues_thread_sequence
+ * @brief Sequence number of the record being formatted by the calling thread.
+ */
+static __thread uint64_t hues_thread_sequence = 0;
+
+/**
+ * @var hues_sequence_counter
+ * @brief Start of the next batch of sequence numbers.
+ */
+static uint64_t hues_sequence_counter = 0;
+
+/**
+ * @var hues_thread_sequence_next
+ * @brief Next number of the batch of sequence numbers of the calling thread.
+ */
+static __thread uint64_t hues_thread_sequence_next = 0;
+
+/**
+ * @var hues_thread_sequence_end
+ * @brief End of the batch of sequence numbers of the calling thread, equal to the next number once the batch is used up.
+ */
+static __thread uint64_t hues_thread_sequence_end = 0;
+
+uint64_t hues_sequence_next() {
+    if (hues_thread_sequence_next == hues_thread_sequence_end) {
+        hues_thread_sequence_next = __atomic_fetch_add(&hues_sequence_counter, HUES_SEQUENCE_BATCH, __ATOMIC_RELAXED);
+        hues_thread_sequence_end = hues_thread_sequence_next + HUES_SEQUENCE_BATCH;
+    }
+    return hues_thread_sequence_next++;
+}
+
 char* hues_configuration_get_level_format() {
     return hues_glob_configuration.header_format;
 }
@@ -76,10 +158,41 @@ hues_theme* hues_configuration_get_theme() {
     return hues_glob_configuration.theme;
 }
 
+/**
+ * @fn static void hues_level_format_prepare(hues_level_format* format)
+ * @brief Computes the escape sequences selecting the colors of a level, once, so that logging only copies them.
+ * @param format The level format.
+ */
+static void hues_level_format_prepare(hues_level_format* format) {
+    int length = snprintf(format->escape_sequence, sizeof(format->escape_sequence), ESC_SEQ_BG ESC_SEQ_FG,
+        format->background_color.r, format->background_color.g, format->background_color.b,
+        format->foreground_color.r, format->foreground_color.g, format->foreground_color.b);
+    format->escape_sequence_length = length > 0 ? (size_t) length : 0;
+}
+
 void hues_configuration_set_theme(hues_theme* theme) {
+    for (size_t i = 0; theme != NULL && i < hues_glob_configuration.levels_count; i++) {
+        hues_level_format_prepare(&theme->format[i]);
+    }
     hues_glob_configuration.theme = theme;
 }
 
+int hues_configuration_get_console() {
+    return hues_glob_configuration.console;
+}
+
+void hues_configuration_set_console(int enabled) {
+    hues_glob_configuration.console = enabled;
+}
+
+int hues_configuration_get_signal_fd() {
+    return hues_glob_configuration.signal_fd;
+}
+
+void hues_configuration_set_signal_fd(int fd) {
+    hues_glob_configuration.signal_fd = fd;
+}
+
 hues_format** hues_configuration_get_formats() {
     return hues_glob_configuration.formats;
 }
@@ -104,6 +217,48 @@ void hues_configuration_add_format(hues_format* format) {
     }
 }
 
+size_t hues_configuration_get_backtrace_depth() {
+    return hues_glob_configuration.backtrace_depth;
+}
+
+hues_level_enum hues_configuration_get_backtrace_trigger_level() {
+    return hues_glob_configuration.backtrace_trigger_level;
+}
+
+void hues_configuration_set_backtrace(size_t depth, hues_level_enum trigger_level) {
+    hues_glob_configuration.backtrace_depth = depth;
+    hues_glob_configuration.backtrace_trigger_level = trigger_level;
+}
+
+hues_sink** hues_configuration_get_sinks() {
+    return hues_glob_configuration.sinks;
+}
+
+void hues_configuration_add_sink(hues_sink* sink) {
+    size_t sinks_count = 0;
+    if (hues_glob_configuration.sinks != NULL) {
+        for (size_t i = 0; hues_glob_configuration.sinks[i] != NULL; i++) {
+            sinks_count++;
+        }
+    }
+    hues_glob_configuration.sinks = realloc(hues_glob_configuration.sinks, sizeof(hues_sink*) * (sinks_count + 2));
+    hues_glob_configuration.sinks[sinks_count] = sink;
+    hues_glob_configuration.sinks[sinks_count + 1] = NULL;
+}
+
+void hues_configuration_remove_sink(hues_sink* sink) {
+    if (hues_glob_configuration.sinks == NULL) {
+        return;
+    }
+    size_t j = 0;
+    for (size_t i = 0; hues_glob_configuration.sinks[i] != NULL; i++) {
+        if (hues_glob_configuration.sinks[i] != sink) {
+            hues_glob_configuration.sinks[j++] = hues_glob_configuration.sinks[i];
+        }
+    }
+    hues_glob_configuration.sinks[j] = NULL;
+}
+
 const hues_color hues_hex_to_color(uint32_t hex) {
     hues_color clr;
     clr.r = (hex >> 16) & 0xFF;
@@ -112,18 +267,27 @@ const hues_color hues_hex_to_color(uint32_t hex) {
     return clr;
 }
 
+const char* hues_level_name(hues_level_enum level) {
+    static const char* names[] = { "TRACE", "DEBUG", "INFO", "WARN", "SEVERE", "CRITICAL" };
+    if (level < HUES_LEVEL_TRACE || level >= HUES_LEVEL_UNKNOWN) {
+        return "???";
+    }
+    return names[level];
+}
+
 void hues_color_to_hex(char* hex, hues_color* clr) {
     sprintf(hex, "#%02x%02x%02x", clr->r, clr->g, clr->b);
 }
 
 void hues_theme_from_hex(uint32_t* bg_hex, uint32_t* fg_hex) {
-    hues_glob_configuration.theme = malloc(sizeof(hues_theme));
-    hues_glob_configuration.theme->format = malloc(sizeof(hues_level_format) * hues_glob_configuration.levels_count);
+    hues_theme* theme = malloc(sizeof(hues_theme));
+    theme->format = malloc(sizeof(hues_level_format) * hues_glob_configuration.levels_count);
     for (size_t i = 0; i < HUES_LEVEL_UNKNOWN + 1; i++) {
-        hues_glob_configuration.theme->format[i].level = i;
-        hues_glob_configuration.theme->format[i].background_color = hues_hex_to_color(bg_hex[i]);
-        hues_glob_configuration.theme->format[i].foreground_color = hues_hex_to_color(fg_hex[i]);
+        theme->format[i].level = i;
+        theme->format[i].background_color = hues_hex_to_color(bg_hex[i]);
+        theme->format[i].foreground_color = hues_hex_to_color(fg_hex[i]);
     }
+    hues_configuration_set_theme(theme);
 }
 
 /**
@@ -335,20 +499,80 @@ static size_t hues_format_pv_core(char* buffer, size_t buffer_size, char prefix,
     return buffptr - buffer;
 }
 
+/**
+ * @var hues_cached_pid
+ * @brief Identifier of the process, 0 until first needed. Reset in the child after a fork.
+ */
+static pid_t hues_cached_pid = 0;
+
+/**
+ * @var hues_fork_generation
+ * @brief Number of forks the process descends from, invalidating the per-thread caches of the parent.
+ */
+static unsigned hues_fork_generation = 0;
+
+/**
+ * @struct hues_thread_cache
+ * @brief Represents the values cached by a thread for its records.
+ */
+typedef struct {
+    unsigned generation;  /**< Fork generation the thread identifier was cached in. */
+    pid_t thread_id;  /**< Kernel identifier of the thread, 0 until first needed. */
+    time_t second;  /**< Second the date and time are cached for. */
+    char date[16];  /**< Formatted date. */
+    size_t date_length;  /**< Length of the formatted date. */
+    char time[16];  /**< Formatted time. */
+    size_t time_length;  /**< Length of the formatted time. */
+} hues_thread_cache;
+
+static __thread hues_thread_cache hues_thread_cached = { .second = -1 };
+
 static size_t hues_function_format_pid(char* buffer, size_t buffer_size, char specifier, va_list list) {
-    return snprintf(buffer, buffer_size, "%d", getpid());
+    if (hues_cached_pid == 0) {
+        hues_cached_pid = getpid();
+    }
+    return snprintf(buffer, buffer_size, "%d", hues_cached_pid);
+}
+
+static size_t hues_function_format_thread_id(char* buffer, size_t buffer_size, char specifier, va_list list) {
+    hues_thread_cache* cache = &hues_thread_cached;
+    if (cache->thread_id == 0 || cache->generation != hues_fork_generation) {
+        cache->thread_id = (pid_t) syscall(SYS_gettid);
+        cache->generation = hues_fork_generation;
+    }
+    return snprintf(buffer, buffer_size, "%d", cache->thread_id);
+}
+
+/**
+ * @fn static hues_thread_cache* hues_thread_cache_time()
+ * @brief Retrieves the date and time of the record being formatted, formatting them only once per second.
+ * @return The cache of the calling thread.
+ */
+static hues_thread_cache* hues_thread_cache_time() {
+    hues_thread_cache* cache = &hues_thread_cached;
+    time_t now = hues_thread_timestamp != 0 ? (time_t) (hues_thread_timestamp / 1000000000u) : time(NULL);
+    if (now != cache->second) {
+        struct tm time_info;
+        localtime_r(&now, &time_info);
+        cache->date_length = strftime(cache->date, sizeof(cache->date), "%d/%m/%Y", &time_info);
+        cache->time_length = strftime(cache->time, sizeof(cache->time), "%H:%M:%S", &time_info);
+        cache->second = now;
+    }
+    return cache;
 }
 
 static size_t hues_function_format_date(char* buffer, size_t buffer_size, char specifier, va_list list) {
-    time_t now = time(NULL);
-    struct tm* time_info = localtime(&now);
-    return strftime(buffer, buffer_size, "%d/%m/%Y", time_info);
+    hues_thread_cache* cache = hues_thread_cache_time();
+    return snprintf(buffer, buffer_size, "%s", cache->date);
 }
 
 static size_t hues_function_format_time(char* buffer, size_t buffer_size, char specifier, va_list list) {
-    time_t now = time(NULL);
-    struct tm* time_info = localtime(&now);
-    return strftime(buffer, buffer_size, "%H:%M:%S", time_info);
+    hues_thread_cache* cache = hues_thread_cache_time();
+    return snprintf(buffer, buffer_size, "%s", cache->time);
+}
+
+static size_t hues_function_format_sequence(char* buffer, size_t buffer_size, char specifier, va_list list) {
+    return snprintf(buffer, buffer_size, "%llu", (unsigned long long) hues_thread_sequence);
 }
 
 static size_t hues_function_format_level(char* buffer, size_t buffer_size, char specifier, va_list list) {
@@ -396,10 +620,31 @@ void hues_log(hues_message* message, ...) {
  */
 static void hues_log_message_v(hues_message* message, va_list list) {
     if (message->level.level < hues_glob_configuration.minimum_level) {
+        if (hues_glob_configuration.backtrace_depth > 0) {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            hues_backtrace_capture(message, (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec, list);
+        }
         return;
     }
+    if (hues_glob_configuration.backtrace_depth > 0 && message->level.level >= hues_glob_configuration.backtrace_trigger_level) {
+        hues_backtrace_dump();
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    hues_log_record_v(message, (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec, list);
+}
+
+/**
+ * @fn static void hues_log_record_v(hues_message* message, uint64_t timestamp, va_list list)
+ * @brief Formats and emits a message logged at the given time, regardless of the minimum level.
+ * @param message The message to log.
+ * @param timestamp The time of the message, in nanoseconds since the epoch.
+ * @param list A list of arguments to use in the to_format string.
+ */
+static void hues_log_record_v(hues_message* message, uint64_t timestamp, va_list list) {
     char buffer[BUFFER_SIZE];
-    hues_level_format* theme_level;
+    hues_level_format* theme_level = NULL;
     for (size_t i = 0; i < hues_glob_configuration.levels_count; i++) {
         if (hues_glob_configuration.theme->format[i].level == message->level.level) {
             theme_level = &hues_glob_configuration.theme->format[i];
@@ -410,28 +655,1076 @@ static void hues_log_message_v(hues_message* message, va_list list) {
         fprintf(stderr, "No color configuration found for level %d\n", message->level.level);
         return;
     }
-    size_t written = snprintf(buffer, sizeof(buffer), ESC_SEQ_BG, theme_level->background_color.r, theme_level->background_color.g, theme_level->background_color.b);
-    written += snprintf(buffer + written, sizeof(buffer), ESC_SEQ_FG, theme_level->foreground_color.r, theme_level->foreground_color.g, theme_level->foreground_color.b);
-    written += hues_format_pv_core(buffer + written, sizeof(buffer), hues_glob_configuration.prefix, hues_glob_configuration.formats, hues_glob_configuration.header_format, list);
-    written += hues_format_pv_core(buffer + written, sizeof(buffer) - written, hues_glob_configuration.prefix, hues_glob_configuration.formats, message->contents, list);
-    ssize_t index = 0;
-    if (buffer[written - 1] == '\n') {
-        index = -1;
+    uint64_t sequence = hues_sequence_next();
+    hues_thread_timestamp = timestamp;
+    hues_thread_sequence = sequence;
+    size_t header_length = hues_format_pv_core(buffer, sizeof(buffer), hues_glob_configuration.prefix, hues_glob_configuration.formats, hues_glob_configuration.header_format, list);
+    size_t written = header_length + hues_format_pv_core(buffer + header_length, sizeof(buffer) - header_length, hues_glob_configuration.prefix, hues_glob_configuration.formats, message->contents, list);
+    hues_thread_timestamp = 0;
+    hues_thread_sequence = 0;
+    hues_record record = {
+        .level = message->level.level,
+        .timestamp = timestamp,
+        .sequence = sequence,
+        .location = message->location,
+        .text = buffer,
+        .length = written,
+        .header_length = header_length,
+        .arguments = message->arguments,
+        .arguments_length = message->arguments != NULL ? message->arguments_length : 0
+    };
+    if (hues_request_append(&record)) {
+        return;
+    }
+    hues_emit(&record, theme_level);
+}
+
+/**
+ * @def HUES_BACKTRACE_ARGUMENTS_COUNT
+ * @brief Maximum number of arguments kept for a message in the backtrace.
+ */
+#define HUES_BACKTRACE_ARGUMENTS_COUNT 8
+
+/**
+ * @def HUES_BACKTRACE_STORAGE_SIZE
+ * @brief Size of the storage for the strings of a message in the backtrace.
+ */
+#define HUES_BACKTRACE_STORAGE_SIZE 512
+
+/**
+ * @struct hues_backtrace_entry
+ * @brief Represents a message kept in a backtrace.
+ * A message is kept unformatted, with its arguments as raw words and its strings copied in the storage.
+ * Messages whose arguments cannot be kept that way (floating point values, structures) are formatted right away in the storage.
+ */
+typedef struct {
+    hues_message message;  /**< The message, its contents must outlive the backtrace. */
+    uint64_t timestamp;  /**< Time of the message, in nanoseconds since the epoch. */
+    hues_level level;  /**< Level argument of the message. */
+    hues_code_location location;  /**< Code location argument of the message. */
+    uintptr_t arguments[HUES_BACKTRACE_ARGUMENTS_COUNT];  /**< Raw arguments of the message. */
+    int formatted;  /**< Whether the storage holds the formatted message rather than copied strings. */
+    size_t formatted_length;  /**< Length of the formatted message. */
+    size_t header_length;  /**< Length of the header part of the formatted message. */
+    char storage[HUES_BACKTRACE_STORAGE_SIZE];  /**< Copied strings or formatted message. */
+} hues_backtrace_entry;
+
+/**
+ * @struct hues_backtrace
+ * @brief Represents the ring of recent messages below the minimum level of a thread.
+ */
+typedef struct {
+    size_t depth;  /**< Number of entries. */
+    size_t count;  /**< Number of entries in use. */
+    size_t next;  /**< Index of the next entry to write. */
+    hues_backtrace_entry* entries;  /**< Entries of the ring. */
+} hues_backtrace;
+
+static __thread hues_backtrace* hues_thread_backtrace = NULL;
+static pthread_key_t hues_backtrace_key;
+static pthread_once_t hues_backtrace_key_once = PTHREAD_ONCE_INIT;
+
+static void hues_backtrace_free(void* backtrace) {
+    free(((hues_backtrace*) backtrace)->entries);
+    free(backtrace);
+}
+
+static void hues_backtrace_key_create() {
+    pthread_key_create(&hues_backtrace_key, hues_backtrace_free);
+}
+
+/**
+ * @fn static hues_backtrace* hues_backtrace_get()
+ * @brief Retrieves the backtrace of the calling thread, (re)allocating it to the configured depth.
+ * @return The backtrace of the calling thread.
+ */
+static hues_backtrace* hues_backtrace_get() {
+    hues_backtrace* backtrace = hues_thread_backtrace;
+    size_t depth = hues_glob_configuration.backtrace_depth;
+    if (backtrace != NULL && backtrace->depth == depth) {
+        return backtrace;
+    }
+    if (backtrace == NULL) {
+        pthread_once(&hues_backtrace_key_once, hues_backtrace_key_create);
+        backtrace = calloc(1, sizeof(hues_backtrace));
+        pthread_setspecific(hues_backtrace_key, backtrace);
+        hues_thread_backtrace = backtrace;
+    }
+    free(backtrace->entries);
+    backtrace->entries = malloc(depth * sizeof(hues_backtrace_entry));
+    backtrace->depth = depth;
+    backtrace->count = 0;
+    backtrace->next = 0;
+    return backtrace;
+}
+
+/**
+ * @fn static hues_format* hues_format_find(hues_format** formats, const char* specifier, size_t* spec_len)
+ * @brief Finds the format matching the specifier following a prefix character, as the formatting functions do.
+ * @param formats A pointer to the array of log message formats.
+ * @param specifier The characters following the prefix character.
+ * @param spec_len The length of the matched specifier.
+ * @return The matching format, or NULL if there is none.
+ */
+static hues_format* hues_format_find(hues_format** formats, const char* specifier, size_t* spec_len) {
+    for (size_t length = 3; length > 0; length--) {
+        for (size_t i = 0; formats[i] != NULL; i++) {
+            if (strncmp(specifier, formats[i]->specifier, length) == 0) {
+                *spec_len = length;
+                return formats[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @fn static int hues_backtrace_capture_arguments(hues_backtrace_entry* entry, va_list list)
+ * @brief Keeps the raw arguments of a message in a backtrace entry.
+ * @param entry The entry holding the message.
+ * @param list A list of arguments to use in the to_format string.
+ * @return 1 if the arguments were kept, 0 if the message has to be formatted right away.
+ */
+static int hues_backtrace_capture_arguments(hues_backtrace_entry* entry, va_list list) {
+    const char* cursor = entry->message.contents;
+    size_t count = 0;
+    size_t used = 0;
+    entry->level = va_arg(list, hues_level);
+    entry->location = va_arg(list, hues_code_location);
+    while (*cursor != '\0') {
+        if (*cursor == hues_glob_configuration.prefix) {
+            size_t spec_len = 0;
+            hues_format* format = hues_format_find(hues_glob_configuration.formats, cursor + 1, &spec_len);
+            if (format != NULL && format->format_function != hues_function_format_date && format->format_function != hues_function_format_time
+                && format->format_function != hues_function_format_pid && format->format_function != hues_function_format_thread_id
+                && format->format_function != hues_function_format_sequence) {
+                return 0;  // The format may take arguments of any type
+            }
+            cursor += spec_len + 1;
+        } else if (*cursor == '%') {
+            cursor++;
+            while (*cursor != '\0' && strchr("-+ #0123456789.", *cursor) != NULL) {
+                cursor++;
+            }
+            const char* modifier = cursor;
+            while (*cursor != '\0' && strchr("hlLqjzt", *cursor) != NULL) {
+                cursor++;
+            }
+            size_t modifier_length = cursor - modifier;
+            if (count == HUES_BACKTRACE_ARGUMENTS_COUNT) {
+                return 0;
+            }
+            switch (*cursor) {
+                case '%':
+                    entry->arguments[count++] = 0;  // Consumed by the formatting functions too
+                    break;
+                case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c': {
+                    // Read the argument as the type its length modifier gives it, then widen it
+                    int is_signed = *cursor == 'd' || *cursor == 'i' || *cursor == 'c';
+                    if (modifier_length == 0 || (modifier[0] == 'h' && *cursor != 'c' && (modifier_length == 1 || modifier[1] == 'h'))) {
+                        entry->arguments[count++] = is_signed ? (uintptr_t) va_arg(list, int) : (uintptr_t) va_arg(list, unsigned int);
+                    } else if (*cursor == 'c' || modifier_length > 2 || (modifier_length == 2 && strncmp(modifier, "ll", 2) != 0)) {
+                        return 0;  // Wide characters or unknown modifiers
+                    } else if (modifier_length == 1 && modifier[0] == 'l') {
+                        entry->arguments[count++] = is_signed ? (uintptr_t) va_arg(list, long) : (uintptr_t) va_arg(list, unsigned long);
+                    } else if ((modifier_length == 2 || modifier[0] == 'q') && sizeof(long long) <= sizeof(uintptr_t)) {
+                        entry->arguments[count++] = is_signed ? (uintptr_t) va_arg(list, long long) : (uintptr_t) va_arg(list, unsigned long long);
+                    } else if (modifier[0] == 'z') {
+                        entry->arguments[count++] = is_signed ? (uintptr_t) va_arg(list, ssize_t) : (uintptr_t) va_arg(list, size_t);
+                    } else if (modifier[0] == 'j' && sizeof(intmax_t) <= sizeof(uintptr_t)) {
+                        entry->arguments[count++] = is_signed ? (uintptr_t) va_arg(list, intmax_t) : (uintptr_t) va_arg(list, uintmax_t);
+                    } else if (modifier[0] == 't') {
+                        entry->arguments[count++] = (uintptr_t) va_arg(list, ptrdiff_t);
+                    } else {
+                        return 0;  // L, or a type wider than the arguments kept
+                    }
+                    break;
+                }
+                case 'p':
+                    if (modifier_length != 0) {
+                        return 0;
+                    }
+                    entry->arguments[count++] = (uintptr_t) va_arg(list, void*);
+                    break;
+                case 's': {
+                    if (modifier_length != 0) {
+                        return 0;  // Wide string
+                    }
+                    const char* string = va_arg(list, const char*);
+                    if (string == NULL) {
+                        entry->arguments[count++] = 0;
+                        break;
+                    }
+                    size_t length = strlen(string);
+                    if (used + length + 1 > sizeof(entry->storage)) {
+                        return 0;
+                    }
+                    memcpy(entry->storage + used, string, length + 1);
+                    entry->arguments[count++] = (uintptr_t) (entry->storage + used);
+                    used += length + 1;
+                    break;
+                }
+                default:
+                    return 0;
+            }
+            if (*cursor != '\0') {
+                cursor++;
+            }
+        } else {
+            cursor++;
+        }
+    }
+    while (count < HUES_BACKTRACE_ARGUMENTS_COUNT) {
+        entry->arguments[count++] = 0;
+    }
+    return 1;
+}
+
+static void hues_backtrace_capture(hues_message* message, uint64_t timestamp, va_list list) {
+    hues_backtrace* backtrace = hues_backtrace_get();
+    hues_backtrace_entry* entry = &backtrace->entries[backtrace->next];
+    backtrace->next = (backtrace->next + 1) % backtrace->depth;
+    if (backtrace->count < backtrace->depth) {
+        backtrace->count++;
+    }
+    entry->message = *message;
+    entry->message.arguments = NULL;  // Pointing to the stack of the caller
+    entry->message.arguments_length = 0;
+    entry->timestamp = timestamp;
+    entry->formatted = 0;
+    va_list arguments;
+    va_copy(arguments, list);
+    int captured = hues_backtrace_capture_arguments(entry, arguments);
+    va_end(arguments);
+    if (!captured) {
+        hues_thread_timestamp = timestamp;
+        va_copy(arguments, list);
+        size_t header_length = hues_format_pv_core(entry->storage, sizeof(entry->storage), hues_glob_configuration.prefix, hues_glob_configuration.formats, hues_glob_configuration.header_format, arguments);
+        entry->header_length = header_length;
+        if (header_length < sizeof(entry->storage) - 1) {
+            header_length += hues_format_pv_core(entry->storage + header_length, sizeof(entry->storage) - header_length, hues_glob_configuration.prefix, hues_glob_configuration.formats, message->contents, arguments);
+        }
+        va_end(arguments);
+        hues_thread_timestamp = 0;
+        entry->formatted = 1;
+        entry->formatted_length = header_length < sizeof(entry->storage) ? header_length : sizeof(entry->storage) - 1;
+    }
+}
+
+/**
+ * @fn static void hues_backtrace_replay(hues_message* message, uint64_t timestamp, ...)
+ * @brief Formats and emits a message kept in a backtrace, its arguments being laid out as when it was logged.
+ * @param message The message to log.
+ * @param timestamp The time of the message, in nanoseconds since the epoch.
+ */
+static void hues_backtrace_replay(hues_message* message, uint64_t timestamp, ...) {
+    va_list list;
+    va_start(list, timestamp);
+    hues_log_record_v(message, timestamp, list);
+    va_end(list);
+}
+
+void hues_backtrace_dump() {
+    hues_backtrace* backtrace = hues_thread_backtrace;
+    if (backtrace == NULL || backtrace->count == 0) {
+        return;
+    }
+    size_t first = (backtrace->next + backtrace->depth - backtrace->count) % backtrace->depth;
+    size_t count = backtrace->count;
+    backtrace->count = 0;
+    for (size_t i = 0; i < count; i++) {
+        hues_backtrace_entry* entry = &backtrace->entries[(first + i) % backtrace->depth];
+        if (!entry->formatted) {
+            uintptr_t* arguments = entry->arguments;
+            hues_backtrace_replay(&entry->message, entry->timestamp, entry->level, entry->location,
+                arguments[0], arguments[1], arguments[2], arguments[3], arguments[4], arguments[5], arguments[6], arguments[7]);
+            continue;
+        }
+        hues_level_format* theme_level = &hues_glob_configuration.theme->format[entry->message.level.level];
+        hues_record record = {
+            .level = entry->message.level.level,
+            .timestamp = entry->timestamp,
+            .sequence = hues_sequence_next(),  // #S in the text of the entry is 0, the number being taken when emitted
+            .location = entry->message.location,
+            .text = entry->storage,
+            .length = entry->formatted_length,
+            .header_length = entry->header_length < entry->formatted_length ? entry->header_length : entry->formatted_length
+        };
+        hues_emit(&record, theme_level);
+    }
+}
+
+/**
+ * @struct hues_writer
+ * @brief Represents the background writer delivering records to the sinks, and its queue.
+ */
+typedef struct {
+    char* data;  /**< Queued records. */
+    size_t capacity;  /**< Size of the queue in bytes. */
+    uint64_t read_position;  /**< Monotonic position of the next record to deliver. */
+    uint64_t write_position;  /**< Monotonic position of the next record to queue. */
+    uint64_t flush_requests;  /**< Number of flushes requested. */
+    uint64_t flushes;  /**< Number of flushes requested and done. */
+    int running;  /**< Whether the writer is started. Written under the mutex, read without it only as a hint. */
+    int stopping;  /**< Whether the writer has to stop once the queue is empty. Records are then delivered by their thread. */
+    int busy;  /**< Whether the writer is using the sinks. */
+    int forking;  /**< Whether a fork is waiting for the queue to drain, holding back new records. */
+    pthread_t thread;  /**< Writer thread. */
+    pthread_mutex_t mutex;  /**< Protects the queue positions and the flags. */
+    pthread_cond_t not_empty;  /**< Signaled when records are queued or the writer is requested to flush or stop. */
+    pthread_cond_t not_full;  /**< Signaled when records are delivered or sinks are flushed. */
+} hues_writer;
+
+static hues_writer hues_glob_writer = {
+    .data = NULL,
+    .running = 0,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+    .not_full = PTHREAD_COND_INITIALIZER
+};
+
+static pthread_once_t hues_fork_handlers_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @fn static void hues_fork_handlers_register()
+ * @brief Registers the fork handlers of the library, once.
+ */
+static void hues_fork_handlers_register();
+
+/**
+ * @fn static void hues_writer_enqueue(const hues_record* record)
+ * @brief Copies a record in the queue of the writer, waiting for room if the queue is full.
+ * Once the writer is stopping, nothing is queued anymore: the record is delivered to the sinks by the calling thread.
+ * @param record The record to queue.
+ */
+static void hues_writer_enqueue(const hues_record* record);
+
+/**
+ * @fn static void hues_dispatch(const hues_record* record)
+ * @brief Writes a record to every sink accepting its level.
+ * @param record The record to write.
+ */
+static void hues_dispatch(const hues_record* record);
+
+/**
+ * @struct hues_queued_record
+ * @brief Header of a record buffered in a request or queued for the writer, followed by its text and its captured values.
+ */
+typedef struct {
+    hues_level_enum level;  /**< Log level. */
+    uint64_t timestamp;  /**< Time of the record, in nanoseconds since the epoch. */
+    uint64_t sequence;  /**< Sequence number of the record. */
+    hues_code_location location;  /**< Code location of the log message. */
+    size_t length;  /**< Length of the text. */
+    size_t header_length;  /**< Length of the header part of the text. */
+    size_t arguments_length;  /**< Length of the captured values. */
+} hues_queued_record;
+
+/**
+ * @def HUES_QUEUED_RECORD_SIZE(length)
+ * @brief Size taken by a queued record with the given length of text and captured values, padded to 8 bytes.
+ */
+#define HUES_QUEUED_RECORD_SIZE(length) ((sizeof(hues_queued_record) + (length) + 7) & ~(size_t) 7)
+
+/**
+ * @struct hues_request_buffer
+ * @brief Represents the buffer of the records of an ongoing request, taken from the pool.
+ */
+typedef struct hues_request_buffer {
+    uint64_t request_id;  /**< Correlation id of the request, 0 when the buffer is free. */
+    uint64_t start;  /**< Monotonic time of the beginning of the request, in nanoseconds. */
+    hues_level_enum maximum_level;  /**< Highest level of the records of the request. */
+    int spilled;  /**< Whether the buffer overflowed and the records now go straight through. */
+    size_t used;  /**< Number of bytes used in the data. */
+    char* data;  /**< Buffered entries. */
+    pthread_mutex_t mutex;  /**< Serializes the threads attached to the request. */
+    struct hues_request_buffer* next_free;  /**< Next buffer of the free list. */
+} hues_request_buffer;
+
+/**
+ * @struct hues_tail_sampler
+ * @brief Represents the pool of request buffers and the sampling decision parameters.
+ */
+typedef struct {
+    hues_request_buffer* buffers;  /**< All the buffers of the pool. */
+    size_t buffers_count;  /**< Number of buffers in the pool. */
+    size_t buffer_size;  /**< Size of the data of each buffer. */
+    hues_level_enum keep_level;  /**< Requests with a record at or above this level are kept. */
+    uint64_t latency_threshold;  /**< Requests lasting at least this long, in nanoseconds, are kept. */
+    hues_request_buffer* free_list;  /**< Buffers available for new requests. */
+    pthread_mutex_t mutex;  /**< Protects the free list and the request ids. */
+} hues_tail_sampler;
+
+static hues_tail_sampler hues_glob_tail_sampler = { .buffers = NULL, .mutex = PTHREAD_MUTEX_INITIALIZER };
+static __thread hues_request_buffer* hues_thread_request = NULL;
+static __thread uint64_t hues_thread_request_id = 0;
+
+static uint64_t hues_monotonic_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+int hues_tail_sampling_configure(size_t buffers_count, size_t buffer_size, hues_level_enum keep_level, uint64_t latency_threshold) {
+    hues_tail_sampler* sampler = &hues_glob_tail_sampler;
+    buffer_size = (buffer_size + 7) & ~(size_t) 7;
+    pthread_mutex_lock(&sampler->mutex);
+    if (sampler->buffers != NULL && (buffers_count != sampler->buffers_count || buffer_size != sampler->buffer_size)) {
+        // Threads may still point to the buffers of the pool: it lives as long as the process
+        pthread_mutex_unlock(&sampler->mutex);
+        return -1;
+    }
+    sampler->keep_level = keep_level;
+    sampler->latency_threshold = latency_threshold;
+    if (sampler->buffers == NULL && buffers_count > 0) {
+        sampler->buffers_count = buffers_count;
+        sampler->buffer_size = buffer_size;
+        char* data = malloc(buffers_count * sampler->buffer_size);
+        sampler->buffers = calloc(buffers_count, sizeof(hues_request_buffer));
+        for (size_t i = buffers_count; i-- > 0;) {
+            hues_request_buffer* buffer = &sampler->buffers[i];
+            buffer->data = data + i * sampler->buffer_size;
+            pthread_mutex_init(&buffer->mutex, NULL);
+            buffer->next_free = sampler->free_list;
+            sampler->free_list = buffer;
+        }
+    }
+    pthread_mutex_unlock(&sampler->mutex);
+    return 0;
+}
+
+int hues_request_begin(uint64_t request_id) {
+    hues_tail_sampler* sampler = &hues_glob_tail_sampler;
+    pthread_mutex_lock(&sampler->mutex);
+    hues_request_buffer* buffer = sampler->free_list;
+    if (buffer == NULL || request_id == 0) {
+        pthread_mutex_unlock(&sampler->mutex);
+        return -1;
+    }
+    sampler->free_list = buffer->next_free;
+    pthread_mutex_unlock(&sampler->mutex);
+    pthread_mutex_lock(&buffer->mutex);
+    buffer->start = hues_monotonic_now();
+    buffer->maximum_level = HUES_LEVEL_TRACE;
+    buffer->spilled = 0;
+    buffer->used = 0;
+    __atomic_store_n(&buffer->request_id, request_id, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&buffer->mutex);
+    hues_thread_request = buffer;
+    hues_thread_request_id = request_id;
+    return 0;
+}
+
+/**
+ * @fn static hues_request_buffer* hues_request_find(uint64_t request_id)
+ * @brief Finds the buffer of an ongoing request.
+ * @param request_id The correlation id of the request.
+ * @return The buffer of the request, or NULL if the request is not ongoing.
+ */
+static hues_request_buffer* hues_request_find(uint64_t request_id) {
+    hues_tail_sampler* sampler = &hues_glob_tail_sampler;
+    hues_request_buffer* found = NULL;
+    pthread_mutex_lock(&sampler->mutex);
+    for (size_t i = 0; i < sampler->buffers_count && request_id != 0; i++) {
+        if (__atomic_load_n(&sampler->buffers[i].request_id, __ATOMIC_ACQUIRE) == request_id) {
+            found = &sampler->buffers[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sampler->mutex);
+    return found;
+}
+
+int hues_request_attach(uint64_t request_id) {
+    hues_request_buffer* found = hues_request_find(request_id);
+    hues_thread_request = found;
+    hues_thread_request_id = found != NULL ? request_id : 0;
+    return found != NULL ? 0 : -1;
+}
+
+void hues_request_detach() {
+    hues_thread_request = NULL;
+    hues_thread_request_id = 0;
+}
+
+/**
+ * @fn static void hues_request_emit(hues_request_buffer* buffer)
+ * @brief Emits and clears the records buffered in a request.
+ * @param buffer The buffer of the request, locked by the caller.
+ */
+static void hues_request_emit(hues_request_buffer* buffer) {
+    size_t offset = 0;
+    while (offset < buffer->used) {
+        hues_queued_record* entry = (hues_queued_record*) (buffer->data + offset);
+        hues_record record = {
+            .level = entry->level,
+            .timestamp = entry->timestamp,
+            .sequence = entry->sequence,
+            .location = entry->location,
+            .text = (const char*) (entry + 1),
+            .length = entry->length,
+            .header_length = entry->header_length,
+            .arguments = (const char*) (entry + 1) + entry->length,
+            .arguments_length = entry->arguments_length
+        };
+        hues_emit(&record, &hues_glob_configuration.theme->format[entry->level]);
+        offset += HUES_QUEUED_RECORD_SIZE(entry->length + entry->arguments_length);
+    }
+    buffer->used = 0;
+}
+
+static int hues_request_append(const hues_record* record) {
+    hues_request_buffer* buffer = hues_thread_request;
+    if (buffer == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&buffer->mutex);
+    if (buffer->request_id != hues_thread_request_id) {  // The request ended on another thread
+        pthread_mutex_unlock(&buffer->mutex);
+        hues_request_detach();
+        return 0;
+    }
+    if (record->level > buffer->maximum_level) {
+        buffer->maximum_level = record->level;
+    }
+    size_t size = HUES_QUEUED_RECORD_SIZE(record->length + record->arguments_length);
+    if (!buffer->spilled && buffer->used + size > hues_glob_tail_sampler.buffer_size) {
+        // The whole request can no longer be discarded: keep what it logged so far and let the rest through
+        hues_request_emit(buffer);
+        buffer->spilled = 1;
+    }
+    if (buffer->spilled) {
+        pthread_mutex_unlock(&buffer->mutex);
+        return 0;
+    }
+    hues_queued_record* entry = (hues_queued_record*) (buffer->data + buffer->used);
+    *entry = (hues_queued_record) {
+        .level = record->level,
+        .timestamp = record->timestamp,
+        .sequence = record->sequence,
+        .location = record->location,
+        .length = record->length,
+        .header_length = record->header_length,
+        .arguments_length = record->arguments_length
+    };
+    memcpy(entry + 1, record->text, record->length);
+    memcpy((char*) (entry + 1) + record->length, record->arguments, record->arguments_length);
+    buffer->used += size;
+    pthread_mutex_unlock(&buffer->mutex);
+    return 1;
+}
+
+int hues_request_end(uint64_t request_id) {
+    hues_tail_sampler* sampler = &hues_glob_tail_sampler;
+    hues_request_buffer* buffer = hues_thread_request_id == request_id ? hues_thread_request : hues_request_find(request_id);
+    if (buffer == NULL) {
+        return -1;
+    }
+    if (hues_thread_request == buffer) {
+        hues_request_detach();
+    }
+    pthread_mutex_lock(&buffer->mutex);
+    if (buffer->request_id != request_id) {  // Ended concurrently
+        pthread_mutex_unlock(&buffer->mutex);
+        return -1;
+    }
+    int keep = buffer->spilled || buffer->maximum_level >= sampler->keep_level
+        || hues_monotonic_now() - buffer->start >= sampler->latency_threshold;
+    if (keep) {
+        hues_request_emit(buffer);
+    }
+    buffer->used = 0;
+    __atomic_store_n(&buffer->request_id, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&buffer->mutex);
+    pthread_mutex_lock(&sampler->mutex);
+    buffer->next_free = sampler->free_list;
+    sampler->free_list = buffer;
+    pthread_mutex_unlock(&sampler->mutex);
+    return keep;
+}
+
+/**
+ * @fn static void hues_emit(const hues_record* record, hues_level_format* theme_level)
+ * @brief Writes a formatted record to the console and to every sink accepting its level.
+ * @param record The record to write.
+ * @param theme_level The colors of the record level.
+ */
+static void hues_emit(const hues_record* record, hues_level_format* theme_level) {
+    if (hues_glob_configuration.console) {
+        const char* text = record->text;
+        size_t length = record->length;
+        char line[BUFFER_SIZE];
+        if (record->arguments_length > 0) {
+            length = hues_arguments_line(text, length, record->arguments, record->arguments_length, line, sizeof(line));
+            text = line;
+        }
+        int newline = length > 0 && text[length - 1] == '\n';
+        printf("%s%.*s" ESC_SEQ_RST "%s", theme_level->escape_sequence, (int) (length - newline), text, newline ? "\n" : "");
+    }
+    if (hues_glob_configuration.sinks == NULL) {
+        return;
+    }
+    if (__atomic_load_n(&hues_glob_writer.running, __ATOMIC_RELAXED)) {
+        hues_writer_enqueue(record);  // Delivers the record itself if the writer stopped meanwhile
+        return;
+    }
+    hues_dispatch(record);
+}
+
+/**
+ * @fn static void hues_dispatch(const hues_record* record)
+ * @brief Writes a record to every sink accepting its level.
+ * @param record The record to write.
+ */
+static void hues_dispatch(const hues_record* record) {
+    hues_record formatted;
+    char line[BUFFER_SIZE];
+    int formatted_ready = 0;
+    for (size_t i = 0; hues_glob_configuration.sinks[i] != NULL; i++) {
+        hues_sink* sink = hues_glob_configuration.sinks[i];
+        if (record->level < sink->minimum_level) {
+            continue;
+        }
+        if (record->arguments_length == 0 || sink->binary) {
+            sink->write_function(sink, record);
+            continue;
+        }
+        // Captured values are formatted once, here, for the sinks writing lines
+        if (!formatted_ready) {
+            formatted = *record;
+            formatted.text = line;
+            formatted.length = hues_arguments_line(record->text, record->length, record->arguments, record->arguments_length, line, sizeof(line));
+            formatted.arguments = NULL;
+            formatted.arguments_length = 0;
+            formatted_ready = 1;
+        }
+        sink->write_function(sink, &formatted);
+    }
+}
+
+/**
+ * @fn static void hues_flush_sinks()
+ * @brief Flushes every sink, on the calling thread.
+ */
+static void hues_flush_sinks() {
+    if (hues_glob_configuration.sinks == NULL) {
+        return;
+    }
+    for (size_t i = 0; hues_glob_configuration.sinks[i] != NULL; i++) {
+        hues_sink* sink = hues_glob_configuration.sinks[i];
+        if (sink->flush_function != NULL) {
+            sink->flush_function(sink);
+        }
+    }
+}
+
+void hues_flush() {
+    fflush(stdout);
+    hues_writer* writer = &hues_glob_writer;
+    if (!__atomic_load_n(&writer->running, __ATOMIC_RELAXED)) {
+        hues_flush_sinks();
+        return;
+    }
+    pthread_mutex_lock(&writer->mutex);
+    if (writer->stopping) {  // The writer may be gone already, the sinks are flushed here
+        pthread_mutex_unlock(&writer->mutex);
+        hues_flush_sinks();
+        return;
+    }
+    uint64_t request = ++writer->flush_requests;
+    pthread_cond_signal(&writer->not_empty);
+    while (writer->flushes < request && writer->running) {
+        pthread_cond_wait(&writer->not_full, &writer->mutex);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+/**
+ * @fn static void hues_writer_enqueue(const hues_record* record)
+ * @brief Copies a record in the queue of the writer, waiting for room if the queue is full.
+ * Once the writer is stopping, nothing is queued anymore: the record is delivered to the sinks by the calling thread.
+ * @param record The record to queue.
+ */
+static void hues_writer_enqueue(const hues_record* record) {
+    hues_writer* writer = &hues_glob_writer;
+    size_t length = record->length;
+    size_t arguments_length = record->arguments_length;
+    if (HUES_QUEUED_RECORD_SIZE(length + arguments_length) > writer->capacity / 2) {
+        length = writer->capacity / 2 - sizeof(hues_queued_record);
+        arguments_length = 0;
+    }
+    size_t size = HUES_QUEUED_RECORD_SIZE(length + arguments_length);
+    pthread_mutex_lock(&writer->mutex);
+    size_t offset = writer->write_position % writer->capacity;
+    size_t skip = offset + size > writer->capacity ? writer->capacity - offset : 0;
+    while ((writer->forking || writer->capacity - (writer->write_position - writer->read_position) < skip + size) && writer->running && !writer->stopping) {
+        pthread_cond_wait(&writer->not_full, &writer->mutex);
+        offset = writer->write_position % writer->capacity;
+        skip = offset + size > writer->capacity ? writer->capacity - offset : 0;
+    }
+    if (!writer->running || writer->stopping) {  // Stopped or stopping, possibly while waiting
+        pthread_mutex_unlock(&writer->mutex);
+        hues_dispatch(record);
+        return;
+    }
+    if (skip >= sizeof(hues_queued_record)) {
+        ((hues_queued_record*) (writer->data + offset))->length = SIZE_MAX;
+    }
+    writer->write_position += skip;
+    hues_queued_record* entry = (hues_queued_record*) (writer->data + writer->write_position % writer->capacity);
+    *entry = (hues_queued_record) {
+        .level = record->level,
+        .timestamp = record->timestamp,
+        .sequence = record->sequence,
+        .location = record->location,
+        .length = length,
+        .header_length = record->header_length < length ? record->header_length : length,
+        .arguments_length = arguments_length
+    };
+    memcpy(entry + 1, record->text, length);
+    memcpy((char*) (entry + 1) + length, record->arguments, arguments_length);
+    writer->write_position += size;
+    pthread_cond_signal(&writer->not_empty);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+/**
+ * @fn static void* hues_writer_run(void* argument)
+ * @brief Delivers the queued records to the sinks, flushing them whenever the queue runs empty.
+ * @param argument Unused.
+ * @return NULL.
+ */
+static void* hues_writer_run(void* argument) {
+    hues_writer* writer = &hues_glob_writer;
+    int flushed = 1;
+    pthread_mutex_lock(&writer->mutex);
+    while (1) {
+        if (writer->read_position == writer->write_position) {
+            if (writer->flushes < writer->flush_requests || !flushed) {
+                uint64_t request = writer->flush_requests;
+                writer->busy = 1;
+                pthread_mutex_unlock(&writer->mutex);
+                hues_flush_sinks();
+                pthread_mutex_lock(&writer->mutex);
+                writer->busy = 0;
+                writer->flushes = request;
+                flushed = 1;
+                pthread_cond_broadcast(&writer->not_full);
+                continue;
+            }
+            if (writer->stopping) {
+                break;
+            }
+            pthread_cond_wait(&writer->not_empty, &writer->mutex);
+            continue;
+        }
+        uint64_t position = writer->read_position;
+        uint64_t end = writer->write_position;
+        writer->busy = 1;
+        pthread_mutex_unlock(&writer->mutex);
+        while (position < end) {
+            size_t offset = position % writer->capacity;
+            hues_queued_record* entry = (hues_queued_record*) (writer->data + offset);
+            if (writer->capacity - offset < sizeof(hues_queued_record) || entry->length == SIZE_MAX) {
+                position += writer->capacity - offset;
+                continue;
+            }
+            hues_record record = {
+                .level = entry->level,
+                .timestamp = entry->timestamp,
+                .sequence = entry->sequence,
+                .location = entry->location,
+                .text = (const char*) (entry + 1),
+                .length = entry->length,
+                .header_length = entry->header_length,
+                .arguments = (const char*) (entry + 1) + entry->length,
+                .arguments_length = entry->arguments_length
+            };
+            hues_dispatch(&record);
+            position += HUES_QUEUED_RECORD_SIZE(entry->length + entry->arguments_length);
+        }
+        pthread_mutex_lock(&writer->mutex);
+        writer->busy = 0;
+        writer->read_position = end;
+        flushed = 0;
+        pthread_cond_broadcast(&writer->not_full);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+
+int hues_writer_start(size_t capacity) {
+    hues_writer* writer = &hues_glob_writer;
+    pthread_once(&hues_fork_handlers_once, hues_fork_handlers_register);
+    pthread_mutex_lock(&writer->mutex);
+    if (writer->running) {
+        pthread_mutex_unlock(&writer->mutex);
+        return 0;
+    }
+    capacity = (capacity + 7) & ~(size_t) 7;
+    if (capacity < 4 * HUES_QUEUED_RECORD_SIZE(BUFFER_SIZE)) {
+        capacity = 4 * HUES_QUEUED_RECORD_SIZE(BUFFER_SIZE);
+    }
+    writer->data = malloc(capacity);
+    writer->capacity = capacity;
+    writer->read_position = 0;
+    writer->write_position = 0;
+    writer->stopping = 0;
+    int result = 0;
+    __atomic_store_n(&writer->running, 1, __ATOMIC_RELAXED);
+    if (pthread_create(&writer->thread, NULL, hues_writer_run, NULL) != 0) {  // The thread waits for the mutex
+        __atomic_store_n(&writer->running, 0, __ATOMIC_RELAXED);
+        free(writer->data);
+        writer->data = NULL;
+        result = -1;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return result;
+}
+
+void hues_writer_stop() {
+    hues_writer* writer = &hues_glob_writer;
+    pthread_mutex_lock(&writer->mutex);
+    if (!writer->running || writer->stopping) {
+        pthread_mutex_unlock(&writer->mutex);
+        return;
+    }
+    // Producers deliver their records themselves from now on, the writer only drains what is already queued
+    writer->stopping = 1;
+    pthread_cond_signal(&writer->not_empty);
+    pthread_cond_broadcast(&writer->not_full);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+    pthread_mutex_lock(&writer->mutex);
+    __atomic_store_n(&writer->running, 0, __ATOMIC_RELAXED);
+    writer->stopping = 0;
+    free(writer->data);
+    writer->data = NULL;
+    pthread_cond_broadcast(&writer->not_full);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+/**
+ * @fn static void hues_fork_prepare()
+ * @brief Quiesces the writer and takes the locks of the library, so that the child starts with a consistent state.
+ */
+static void hues_fork_prepare() {
+    hues_writer* writer = &hues_glob_writer;
+    fflush(stdout);
+    pthread_mutex_lock(&hues_glob_tail_sampler.mutex);
+    pthread_mutex_lock(&writer->mutex);
+    writer->forking = 1;
+    while (writer->running && (writer->read_position != writer->write_position || writer->busy)) {
+        pthread_cond_wait(&writer->not_full, &writer->mutex);
+    }
+}
+
+/**
+ * @fn static void hues_fork_parent()
+ * @brief Releases the locks taken before the fork, in the parent.
+ */
+static void hues_fork_parent() {
+    hues_glob_writer.forking = 0;
+    pthread_cond_broadcast(&hues_glob_writer.not_full);
+    pthread_mutex_unlock(&hues_glob_writer.mutex);
+    pthread_mutex_unlock(&hues_glob_tail_sampler.mutex);
+}
+
+/**
+ * @fn static void hues_fork_child()
+ * @brief Invalidates the per-process caches and restarts the writer, in the child.
+ * Only the forking thread exists in the child: the requests of the other threads are released.
+ */
+static void hues_fork_child() {
+    hues_writer* writer = &hues_glob_writer;
+    hues_tail_sampler* sampler = &hues_glob_tail_sampler;
+    hues_cached_pid = 0;
+    hues_fork_generation++;
+    pthread_cond_init(&writer->not_empty, NULL);
+    pthread_cond_init(&writer->not_full, NULL);
+    writer->busy = 0;
+    writer->forking = 0;
+    if (writer->running && pthread_create(&writer->thread, NULL, hues_writer_run, NULL) != 0) {
+        writer->running = 0;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    for (size_t i = 0; i < sampler->buffers_count; i++) {
+        hues_request_buffer* buffer = &sampler->buffers[i];
+        pthread_mutex_init(&buffer->mutex, NULL);
+        if (buffer->request_id != 0 && buffer != hues_thread_request) {
+            buffer->request_id = 0;
+            buffer->next_free = sampler->free_list;
+            sampler->free_list = buffer;
+        }
+    }
+    pthread_mutex_unlock(&sampler->mutex);
+}
+
+static void hues_fork_handlers_register() {
+    pthread_atfork(hues_fork_prepare, hues_fork_parent, hues_fork_child);
+}
+
+void hues_sink_close(hues_sink* sink) {
+    hues_configuration_remove_sink(sink);
+    if (__atomic_load_n(&hues_glob_writer.running, __ATOMIC_RELAXED)) {
+        hues_flush();  // Waits for the writer to be done with the sink
+    }
+    if (sink->flush_function != NULL) {
+        sink->flush_function(sink);
+    }
+    if (sink->close_function != NULL) {
+        sink->close_function(sink);
+    }
+}
+
+/**
+ * @fn static size_t hues_signal_format_unsigned(char* buffer, uint64_t value, unsigned base)
+ * @brief Formats an unsigned integer without any library call.
+ * @param buffer A buffer of at least 20 characters.
+ * @param value The value to format.
+ * @param base The base, 10 or 16.
+ * @return The number of characters written.
+ */
+static size_t hues_signal_format_unsigned(char* buffer, uint64_t value, unsigned base) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value != 0);
+    for (size_t i = 0; i < count; i++) {
+        buffer[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+/**
+ * @fn static size_t hues_signal_append(char* buffer, size_t written, size_t buffer_size, const char* string, size_t length)
+ * @brief Appends characters to a buffer, truncating them to its size.
+ * @return The new number of characters in the buffer.
+ */
+static size_t hues_signal_append(char* buffer, size_t written, size_t buffer_size, const char* string, size_t length) {
+    for (size_t i = 0; i < length && written < buffer_size; i++) {
+        buffer[written++] = string[i];
+    }
+    return written;
+}
+
+void hues_log_signal_safe(hues_level_enum level, const char* format, ...) {
+    int fd = hues_glob_configuration.signal_fd;
+    if (fd < 0 || level < hues_glob_configuration.minimum_level) {
+        return;
+    }
+    int saved_errno = errno;
+    char buffer[BUFFER_SIZE / 4];
+    char number[24];
+    size_t reserved = sizeof(ESC_SEQ_RST);  // Reset sequence and newline
+    size_t size = sizeof(buffer) - reserved;
+    size_t written = 0;
+    hues_theme* theme = hues_glob_configuration.theme;
+    if (theme != NULL && level >= HUES_LEVEL_TRACE && level <= HUES_LEVEL_UNKNOWN) {
+        written = hues_signal_append(buffer, written, size, theme->format[level].escape_sequence, theme->format[level].escape_sequence_length);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t seconds = now.tv_sec % 86400;
+    uint64_t clock[3] = { seconds / 3600, seconds / 60 % 60, seconds % 60 };
+    written = hues_signal_append(buffer, written, size, "(", 1);
+    for (size_t i = 0; i < 3; i++) {
+        if (clock[i] < 10) {
+            written = hues_signal_append(buffer, written, size, "0", 1);
+        }
+        written = hues_signal_append(buffer, written, size, number, hues_signal_format_unsigned(number, clock[i], 10));
+        written = hues_signal_append(buffer, written, size, i < 2 ? ":" : " UTC) [", i < 2 ? 1 : 7);
+    }
+    const char* name = hues_level_name(level);
+    written = hues_signal_append(buffer, written, size, name, strlen(name));
+    written = hues_signal_append(buffer, written, size, "]  ", 3);
+    va_list list;
+    va_start(list, format);
+    for (const char* cursor = format; *cursor != '\0'; cursor++) {
+        if (*cursor != '%') {
+            written = hues_signal_append(buffer, written, size, cursor, 1);
+            continue;
+        }
+        size_t longs = 0;
+        int size_modifier = 0;
+        cursor++;
+        while (*cursor == 'l' || *cursor == 'z') {
+            longs += *cursor == 'l';
+            size_modifier |= *cursor == 'z';
+            cursor++;
+        }
+        switch (*cursor) {
+            case 'd':
+            case 'i': {
+                int64_t value = size_modifier ? (int64_t) va_arg(list, ssize_t) : longs > 1 ? va_arg(list, long long) : longs == 1 ? va_arg(list, long) : va_arg(list, int);
+                if (value < 0) {
+                    written = hues_signal_append(buffer, written, size, "-", 1);
+                }
+                written = hues_signal_append(buffer, written, size, number, hues_signal_format_unsigned(number, value < 0 ? -(uint64_t) value : (uint64_t) value, 10));
+                break;
+            }
+            case 'u':
+            case 'x': {
+                uint64_t value = size_modifier ? va_arg(list, size_t) : longs > 1 ? va_arg(list, unsigned long long) : longs == 1 ? va_arg(list, unsigned long) : va_arg(list, unsigned int);
+                written = hues_signal_append(buffer, written, size, number, hues_signal_format_unsigned(number, value, *cursor == 'x' ? 16 : 10));
+                break;
+            }
+            case 'p':
+                written = hues_signal_append(buffer, written, size, "0x", 2);
+                written = hues_signal_append(buffer, written, size, number, hues_signal_format_unsigned(number, (uintptr_t) va_arg(list, void*), 16));
+                break;
+            case 's': {
+                const char* string = va_arg(list, const char*);
+                string = string != NULL ? string : "(null)";
+                written = hues_signal_append(buffer, written, size, string, strlen(string));
+                break;
+            }
+            case 'c': {
+                char character = (char) va_arg(list, int);
+                written = hues_signal_append(buffer, written, size, &character, 1);
+                break;
+            }
+            case '%':
+                written = hues_signal_append(buffer, written, size, "%", 1);
+                break;
+            case '\0':
+                cursor--;
+                break;
+            default:
+                written = hues_signal_append(buffer, written, size, cursor - 1, 2);
+                break;
+        }
+    }
+    va_end(list);
+    if (written > 0 && buffer[written - 1] == '\n') {
+        written--;
+    }
+    written = hues_signal_append(buffer, written, sizeof(buffer), ESC_SEQ_RST "\n", sizeof(ESC_SEQ_RST));
+    size_t offset = 0;
+    while (offset < written) {
+        ssize_t result = write(fd, buffer + offset, written - offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        offset += result;
     }
-    written += snprintf(buffer + written + index, sizeof(buffer) - written - index, ESC_SEQ_RST);
-    printf("%s%s", buffer, index == -1 ? "\n" : "");
+    errno = saved_errno;
 }
 
 static uint32_t hues_theme_light_foreground_colors[] = { 0x212121, 0x008000, 0x000000, 0x808000, 0xDC143C, 0xFFFFFF, 0x808080 };
 static uint32_t hues_theme_light_background_colors[] = { 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFAE6, 0xFFF0F5, 0xFF0000, 0xFFFFFF };
 
 static uint32_t hues_theme_dark_foreground_colors[] = { 0xFFFFFF, 0xFFDF00, 0x90EE90, 0xFFA500, 0xFF69B4, 0xFFFF00, 0xFFFFFF };
-static uint32_t hues_theme_dark_foreground_colors[] = { 0x6161ED, 0x181818, 0x181818, 0x181818, 0x181818, 0xE60000, 0xE60000 };
+static uint32_t hues_theme_dark_background_colors[] = { 0x6161ED, 0x181818, 0x181818, 0x181818, 0x181818, 0xE60000, 0xE60000 };
 
 static void hues_register_format_functions() {
-    size_t levels_count = HUES_LEVEL_UNKNOWN + 1;
-    hues_format** formats = malloc((levels_count + 1) * sizeof(hues_format*));
-    size_t formats_count = 8;
+    size_t formats_count = 10;
+    hues_format** formats = malloc((formats_count + 1) * sizeof(hues_format*));
     hues_format* format_array = malloc(formats_count * sizeof(hues_format));
     format_array[0] = (hues_format) { "d", hues_function_format_date };
     format_array[1] = (hues_format) { "t", hues_function_format_time };
@@ -441,6 +1734,8 @@ static void hues_register_format_functions() {
     format_array[5] = (hues_format) { "l", hues_function_format_line_number };
     format_array[6] = (hues_format) { "c", hues_function_format_full_code_location };
     format_array[7] = (hues_format) { "p", hues_function_format_pid };
+    format_array[8] = (hues_format) { "T", hues_function_format_thread_id };
+    format_array[9] = (hues_format) { "S", hues_function_format_sequence };
     for (size_t i = 0; i < formats_count; i++) {
         formats[i] = &(format_array[i]);
     }
@@ -453,10 +1748,11 @@ void hues_theme_use_light() {
 }
 
 void hues_theme_use_dark() {
-    hues_theme_from_hex(hues_theme_dark_foreground_colors, hues_theme_dark_foreground_colors);
+    hues_theme_from_hex(hues_theme_dark_background_colors, hues_theme_dark_foreground_colors);
 }
 
 void hues_initialize() {
+    pthread_once(&hues_fork_handlers_once, hues_fork_handlers_register);
     hues_glob_configuration.minimum_level = HUES_LEVEL_TRACE;
     hues_glob_configuration.prefix = '#';
     hues_glob_configuration.header_format = "(#d-#t) [#L in #c]  ";
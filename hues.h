@@ -13,6 +13,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <time.h>
+#include <dlfcn.h>
 
 /**
  * @struct hues_color
@@ -73,6 +74,14 @@ typedef struct {
     const char* name;  /**< Log level name. */
 } hues_level;
 
+/**
+ * @fn extern const char* hues_level_name(hues_level_enum level)
+ * @brief Retrieves the name of a logging level.
+ * @param level The logging level.
+ * @return The name of the level, "???" for unknown levels.
+ */
+extern const char* hues_level_name(hues_level_enum level);
+
 /**
  * @struct hues_level_format
  * @brief Represents a logging level, foreground and background colors for that level.
@@ -81,6 +90,8 @@ typedef struct {
     hues_level_enum level;  /**< Log level. */
     hues_color background_color;  /**< Background color for this level. */
     hues_color foreground_color;  /**< Foreground color for this level. */
+    char escape_sequence[48];  /**< Escape sequences selecting both colors, computed when the theme is set. */
+    size_t escape_sequence_length;  /**< Length of the escape sequences. */
 } hues_level_format;
 
 /**
@@ -99,6 +110,8 @@ typedef struct {
     hues_level level;  /**< Log level. */
     const char* contents;  /**< Log message. */
     hues_code_location location;  /**< Code location of the log message. */
+    const void* arguments;  /**< Values captured in binary by hues_arguments_add_*, formatted by the consumers of the record, or NULL. Not kept in backtraces. */
+    size_t arguments_length;  /**< Length of the captured values. */
 } hues_message;
 
 /**
@@ -116,6 +129,49 @@ typedef struct {
     hues_format_function format_function;  /**< Function to format the log message. */
 } hues_format;
 
+/**
+ * @struct hues_record
+ * @brief Represents a formatted log record as handed to the sinks.
+ */
+typedef struct {
+    hues_level_enum level;  /**< Log level. */
+    uint64_t timestamp;  /**< Wall-clock time of the record, in nanoseconds since the epoch. */
+    uint64_t sequence;  /**< Sequence number of the record, unique in the process. */
+    hues_code_location location;  /**< Code location of the log message. */
+    const char* text;  /**< Formatted line (header and contents), without escape sequences. */
+    size_t length;  /**< Length of the formatted line. */
+    size_t header_length;  /**< Length of the header part of the formatted line. */
+    const void* arguments;  /**< Values captured in binary, not part of the formatted line, or NULL. */
+    size_t arguments_length;  /**< Length of the captured values. */
+} hues_record;
+
+typedef struct hues_sink hues_sink;
+
+/**
+ * @typedef void (*hues_sink_write_function)(hues_sink* sink, const hues_record* record)
+ * @brief Represents a function that writes a record to a sink.
+ */
+typedef void (*hues_sink_write_function)(hues_sink* sink, const hues_record* record);
+
+/**
+ * @typedef void (*hues_sink_function)(hues_sink* sink)
+ * @brief Represents a function that flushes or closes a sink.
+ */
+typedef void (*hues_sink_function)(hues_sink* sink);
+
+/**
+ * @struct hues_sink
+ * @brief Represents a destination for log records, in addition to the console.
+ */
+struct hues_sink {
+    hues_level_enum minimum_level;  /**< Minimum log level accepted by the sink. */
+    hues_sink_write_function write_function;  /**< Function writing a record. */
+    hues_sink_function flush_function;  /**< Function flushing buffered records, may be NULL. */
+    hues_sink_function close_function;  /**< Function releasing the sink, may be NULL. */
+    void* context;  /**< Sink-specific state. */
+    int binary;  /**< Whether the sink writes binary records, storing their captured values as they are. Other sinks get them formatted in the line. */
+};
+
 /**
  * @struct hues_configuration
  * @brief Represents a logging configuration.
@@ -127,6 +183,11 @@ typedef struct {
     char prefix;  /**< Prefix character. */
     hues_theme* theme;  /**< Logging theme. */
     size_t levels_count;  /**< Number of log levels. */
+    hues_sink** sinks;  /**< Additional log sinks, NULL-terminated. */
+    size_t backtrace_depth;  /**< Number of messages below the minimum level kept per thread, 0 to disable. */
+    hues_level_enum backtrace_trigger_level;  /**< Level of the messages triggering the output of the kept messages. */
+    int signal_fd;  /**< File descriptor written to by hues_log_signal_safe, -1 to disable. */
+    int console;  /**< Whether records are written to the console. */
 } hues_configuration;
 
 /**
@@ -199,6 +260,34 @@ hues_theme* hues_configuration_get_theme();
  */
 void hues_configuration_set_theme(hues_theme* theme);
 
+/**
+ * @fn int hues_configuration_get_signal_fd()
+ * @brief Retrieves the file descriptor written to by hues_log_signal_safe.
+ * @return The file descriptor, -1 if disabled.
+ */
+int hues_configuration_get_signal_fd();
+
+/**
+ * @fn void hues_configuration_set_signal_fd(int fd)
+ * @brief Sets the file descriptor written to by hues_log_signal_safe. It must be open before any signal handler may log.
+ * @param fd The file descriptor, -1 to disable.
+ */
+void hues_configuration_set_signal_fd(int fd);
+
+/**
+ * @fn int hues_configuration_get_console()
+ * @brief Retrieves whether records are written to the console.
+ * @return 1 if records are written to the console, 0 otherwise.
+ */
+int hues_configuration_get_console();
+
+/**
+ * @fn void hues_configuration_set_console(int enabled)
+ * @brief Sets whether records are written to the console, in addition to the sinks.
+ * @param enabled 1 to write records to the console, 0 otherwise.
+ */
+void hues_configuration_set_console(int enabled);
+
 /**
  * @fn void hues_configuration_add_format(hues_format* format)
  * @brief Adds a log message format to the logging configurationiguration.
@@ -206,6 +295,50 @@ void hues_configuration_set_theme(hues_theme* theme);
  */
 void hues_configuration_add_format(hues_format* format);
 
+/**
+ * @fn size_t hues_configuration_get_backtrace_depth()
+ * @brief Retrieves the number of messages below the minimum level kept per thread.
+ * @return The backtrace depth, 0 if disabled.
+ */
+size_t hues_configuration_get_backtrace_depth();
+
+/**
+ * @fn hues_level_enum hues_configuration_get_backtrace_trigger_level()
+ * @brief Retrieves the level of the messages triggering the output of the kept messages.
+ * @return The backtrace trigger level.
+ */
+hues_level_enum hues_configuration_get_backtrace_trigger_level();
+
+/**
+ * @fn void hues_configuration_set_backtrace(size_t depth, hues_level_enum trigger_level)
+ * @brief Keeps the last messages below the minimum level of each thread, unformatted, and outputs them before any message at or above the trigger level.
+ * Kept messages must have a static format string, and at most 8 arguments.
+ * @param depth The number of messages kept per thread, 0 to disable.
+ * @param trigger_level The level of the messages triggering the output of the kept messages.
+ */
+void hues_configuration_set_backtrace(size_t depth, hues_level_enum trigger_level);
+
+/**
+ * @fn hues_sink** hues_configuration_get_sinks()
+ * @brief Retrieves the log sinks from the logging configuration.
+ * @return A pointer to the NULL-terminated array of log sinks.
+ */
+hues_sink** hues_configuration_get_sinks();
+
+/**
+ * @fn void hues_configuration_add_sink(hues_sink* sink)
+ * @brief Adds a log sink to the logging configuration.
+ * @param sink A pointer to the new log sink.
+ */
+void hues_configuration_add_sink(hues_sink* sink);
+
+/**
+ * @fn void hues_configuration_remove_sink(hues_sink* sink)
+ * @brief Removes a log sink from the logging configuration, without closing it.
+ * @param sink A pointer to the log sink to remove.
+ */
+void hues_configuration_remove_sink(hues_sink* sink);
+
 /**
  * @fn extern void hues_theme_from_hex(uint32_t* bg_hex, uint32_t* fg_hex)
  * @brief Converts hexadecimal color values to an RGB theme.
@@ -244,12 +377,926 @@ extern size_t hues_format_p(char* buff, size_t buffsz, const char* format, ...);
  */
 extern void hues_log(hues_message* contents, ...);
 
+/**
+ * @fn extern void hues_log_signal_safe(hues_level_enum level, const char* format, ...)
+ * @brief Logs a message from a signal handler or a crash path: no allocation, no lock, a single write(2) to the signal file descriptor.
+ * Only the %d, %i, %u, %x, %p, %s, %c and %% conversions are supported, with the l, ll and z length modifiers.
+ * @param level The log level of the message.
+ * @param format The format string of the message.
+ * @param ... Additional arguments used with the format string.
+ */
+extern void hues_log_signal_safe(hues_level_enum level, const char* format, ...);
+
 /**
  * @fn extern void hues_initialize()
  * @brief Initializes the logging system.
  */
 extern void hues_initialize();
 
+/**
+ * @fn extern void hues_backtrace_dump()
+ * @brief Outputs and clears the messages kept in the backtrace of the calling thread.
+ */
+extern void hues_backtrace_dump();
+
+/**
+ * @fn extern int hues_tail_sampling_configure(size_t buffers_count, size_t buffer_size, hues_level_enum keep_level, uint64_t latency_threshold)
+ * @brief Configures the tail sampling of requests: the records of a request are buffered until it ends, then kept or discarded as a whole.
+ * The buffers are allocated once, by the first call enabling it, and recycled from one request to the next until the process exits.
+ * Later calls may only change the keep level and the latency threshold: the pool cannot be resized or disabled, as threads may still refer to its buffers.
+ * @param buffers_count The maximum number of concurrent requests, 0 to disable.
+ * @param buffer_size The size of the buffer of each request in bytes. A request overflowing it is kept.
+ * @param keep_level Requests with a record at or above this level are kept.
+ * @param latency_threshold Requests lasting at least this long, in nanoseconds, are kept.
+ * @return 0 on success, -1 if the pool is already allocated with another count or size of buffers.
+ */
+extern int hues_tail_sampling_configure(size_t buffers_count, size_t buffer_size, hues_level_enum keep_level, uint64_t latency_threshold);
+
+/**
+ * @fn extern int hues_request_begin(uint64_t request_id)
+ * @brief Begins a request and attaches the calling thread to it: its records are buffered until the request ends.
+ * @param request_id The correlation id of the request, not 0.
+ * @return 0 on success, -1 if no buffer is available, in which case records are emitted right away.
+ */
+extern int hues_request_begin(uint64_t request_id);
+
+/**
+ * @fn extern int hues_request_attach(uint64_t request_id)
+ * @brief Attaches the calling thread to an ongoing request, so that its records are buffered with the request.
+ * @param request_id The correlation id of the request.
+ * @return 0 on success, -1 if the request is not ongoing.
+ */
+extern int hues_request_attach(uint64_t request_id);
+
+/**
+ * @fn extern void hues_request_detach()
+ * @brief Detaches the calling thread from its request, its records are emitted right away again.
+ */
+extern void hues_request_detach();
+
+/**
+ * @fn extern int hues_request_end(uint64_t request_id)
+ * @brief Ends a request, emitting its buffered records if it logged at or above the keep level or exceeded the latency threshold.
+ * @param request_id The correlation id of the request.
+ * @return 1 if the records were kept, 0 if they were discarded, -1 if the request is not ongoing.
+ */
+extern int hues_request_end(uint64_t request_id);
+
+/**
+ * @fn extern int hues_writer_start(size_t capacity)
+ * @brief Starts the background writer: records are then queued and delivered to the sinks by a dedicated thread.
+ * The console output is not affected. The writer keeps running in the children of a fork.
+ * @param capacity The size of the queue in bytes.
+ * @return 0 on success, -1 if the thread could not be created.
+ */
+extern int hues_writer_start(size_t capacity);
+
+/**
+ * @fn extern void hues_writer_stop()
+ * @brief Delivers the queued records, flushes the sinks and stops the background writer.
+ */
+extern void hues_writer_stop();
+
+/**
+ * @fn extern void hues_flush()
+ * @brief Flushes every configured log sink.
+ */
+extern void hues_flush();
+
+/**
+ * @fn extern void hues_sink_close(hues_sink* sink)
+ * @brief Removes a log sink from the configuration, flushes it and releases it.
+ * @param sink A pointer to the log sink.
+ */
+extern void hues_sink_close(hues_sink* sink);
+
+/**
+ * @def HUES_RING_MAGIC
+ * @brief Magic number at the start of a mapped ring ("HUES").
+ */
+#define HUES_RING_MAGIC 0x53455548u
+
+/**
+ * @def HUES_RING_VERSION
+ * @brief Version of the mapped ring layout.
+ */
+#define HUES_RING_VERSION 2
+
+/**
+ * @def HUES_RECORD_MAGIC
+ * @brief Magic number at the start of every binary record ("HREC").
+ */
+#define HUES_RECORD_MAGIC 0x43455248u
+
+/**
+ * @def HUES_RECORD_FLAG_PADDING
+ * @brief Marks a record that only pads the ring up to its end.
+ */
+#define HUES_RECORD_FLAG_PADDING 0x01
+
+/**
+ * @def HUES_RECORD_FLAG_ARGUMENTS
+ * @brief Marks a record whose payload ends with captured values, followed by their 16-bit length.
+ */
+#define HUES_RECORD_FLAG_ARGUMENTS 0x02
+
+/**
+ * @def HUES_SEQUENCE_BATCH
+ * @brief Number of consecutive sequence numbers a thread takes at a time. The numbers of a batch are used in order,
+ * the first one always, so that a missing number followed by another of its batch is a missing record.
+ */
+#define HUES_SEQUENCE_BATCH 64
+
+/**
+ * @fn extern uint64_t hues_sequence_next()
+ * @brief Takes the next sequence number of the batch of the calling thread, the shared counter being touched once per batch.
+ * Numbers are used in order within a batch, and the first number of every batch is used. They are not monotonic across threads:
+ * a thread logging rarely keeps using an old batch, so numbers only order the records of a single thread.
+ * @return The sequence number, unique in the process.
+ */
+extern uint64_t hues_sequence_next();
+
+/**
+ * @struct hues_record_header
+ * @brief Header preceding every binary record. The payload holds the code location followed by the formatted line,
+ * and the captured values with HUES_RECORD_FLAG_ARGUMENTS.
+ */
+typedef struct {
+    uint32_t magic;  /**< HUES_RECORD_MAGIC. On a bus, stored last with release ordering, which publishes the record. */
+    uint32_t length;  /**< Payload length in bytes. */
+    uint64_t sequence;  /**< Sequence number of the record. */
+    uint64_t timestamp;  /**< Nanoseconds since the epoch. */
+    uint32_t checksum;  /**< Checksum of the header (with a zero checksum) and the payload. In a ring, stored last with release ordering, which publishes the record. */
+    uint8_t level;  /**< Log level. */
+    uint8_t flags;  /**< HUES_RECORD_FLAG_* bits. */
+    uint16_t location_length;  /**< Length of the code location at the start of the payload. */
+} hues_record_header;
+
+/**
+ * @struct hues_ring_header
+ * @brief Header of a mapped ring, followed by its data area.
+ */
+typedef struct {
+    uint32_t magic;  /**< HUES_RING_MAGIC. */
+    uint32_t version;  /**< HUES_RING_VERSION. */
+    uint64_t capacity;  /**< Size of the data area in bytes. */
+    uint64_t write_position;  /**< Monotonic byte position of the next record. */
+    uint64_t generation;  /**< Number of times the ring has been opened for writing. */
+    uint64_t reserved[4];  /**< Reserved, zero. */
+} hues_ring_header;
+
+/**
+ * @def HUES_BUS_MAGIC
+ * @brief Magic number at the start of a shared memory log bus ("HBUS").
+ */
+#define HUES_BUS_MAGIC 0x53554248u
+
+/**
+ * @struct hues_bus_header
+ * @brief Header of a shared memory log bus, followed by its data area.
+ * Producer processes reserve records by advancing the write position; a single collector consumes them, zeroes them and advances the read position.
+ */
+typedef struct {
+    uint32_t magic;  /**< HUES_BUS_MAGIC. */
+    uint32_t version;  /**< HUES_RING_VERSION. */
+    uint64_t capacity;  /**< Size of the data area in bytes. */
+    uint64_t write_position;  /**< Monotonic byte position of the next record to reserve. */
+    uint64_t read_position;  /**< Monotonic byte position of the next record to consume. */
+    uint64_t dropped;  /**< Number of records dropped because the bus was full. */
+    uint64_t reserved[3];  /**< Reserved, zero. */
+} hues_bus_header;
+
+/**
+ * @def HUES_RECORD_SIZE(length)
+ * @brief Size taken by a record with the given payload length, padded to 8 bytes.
+ */
+#define HUES_RECORD_SIZE(length) ((sizeof(hues_record_header) + (length) + 7) & ~(size_t) 7)
+
+/**
+ * @fn extern uint32_t hues_checksum(const void* data, size_t length, uint32_t previous)
+ * @brief Computes the CRC32C of a buffer, or continues the CRC32C of preceding buffers, with the SSE4.2 crc32 instruction when available.
+ * @param data A pointer to the buffer.
+ * @param length The length of the buffer.
+ * @param previous The checksum of the preceding buffers, 0 for the first one.
+ * @return The checksum of the buffers so far.
+ */
+extern uint32_t hues_checksum(const void* data, size_t length, uint32_t previous);
+
+/**
+ * @fn extern uint32_t hues_record_checksum(const hues_record_header* header, const void* payload)
+ * @brief Computes the checksum of a binary record.
+ * @param header A pointer to the record header, its checksum field is ignored.
+ * @param payload A pointer to the record payload.
+ * @return The checksum of the record.
+ */
+extern uint32_t hues_record_checksum(const hues_record_header* header, const void* payload);
+
+/**
+ * @fn extern hues_sink* hues_flight_recorder_open(const char* path, size_t capacity)
+ * @brief Opens a flight recorder: a ring of records kept in a shared file mapping, which survives the process being killed.
+ * @param path The path of the ring file, created if needed. An existing ring keeps its capacity.
+ * @param capacity The size of the ring data area in bytes.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+extern hues_sink* hues_flight_recorder_open(const char* path, size_t capacity);
+
+/**
+ * @fn extern hues_sink* hues_shm_ring_open(const char* name, size_t capacity)
+ * @brief Opens a ring of records in POSIX shared memory, which hues-tail can follow live. Nothing is written to disk.
+ * @param name The name of the shared memory object, starting with a slash. It is not unlinked when the sink is closed.
+ * @param capacity The size of the ring data area in bytes.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+extern hues_sink* hues_shm_ring_open(const char* name, size_t capacity);
+
+/**
+ * @fn extern hues_sink* hues_bus_open(const char* name)
+ * @brief Attaches to a shared memory log bus created by hues-collect, so that several processes log through a single collector.
+ * Records are dropped, and counted in the bus header, while the bus is full.
+ * @param name The name of the shared memory object, starting with a slash.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+extern hues_sink* hues_bus_open(const char* name);
+
+/**
+ * @fn extern int hues_bus_record_size(const hues_bus_header* bus, uint64_t position, size_t* size)
+ * @brief Checks whether the record at a position of a bus is complete, for collectors.
+ * @param bus A pointer to the mapped bus.
+ * @param position The monotonic position of the record.
+ * @param size The size taken by the record, including padding, when it is complete.
+ * @return 1 if the record is complete, 0 if it is not written yet, -1 if it is corrupt.
+ */
+extern int hues_bus_record_size(const hues_bus_header* bus, uint64_t position, size_t* size);
+
+/**
+ * @fn extern size_t hues_record_encode(const hues_record* record, uint64_t sequence, void* buffer, size_t size)
+ * @brief Encodes a record as a binary record, truncating its text to fit the buffer.
+ * @param record The record to encode.
+ * @param sequence The sequence number of the record.
+ * @param buffer A buffer aligned to 8 bytes receiving the binary record.
+ * @param size The size of the buffer.
+ * @return The size taken by the binary record, including padding, or 0 if the buffer cannot hold its code location.
+ */
+extern size_t hues_record_encode(const hues_record* record, uint64_t sequence, void* buffer, size_t size);
+
+/**
+ * @enum hues_argument_type
+ * @brief Enumerates the types of the values captured in binary, each stored as a byte followed by the value.
+ */
+typedef enum {
+    HUES_ARGUMENT_INT = 1,  /**< Signed integer, on 8 bytes. */
+    HUES_ARGUMENT_UINT = 2,  /**< Unsigned integer or size, on 8 bytes. */
+    HUES_ARGUMENT_DOUBLE = 3,  /**< Floating point number, on 8 bytes. */
+    HUES_ARGUMENT_POINTER = 4,  /**< Pointer, on 8 bytes. */
+    HUES_ARGUMENT_STRING = 5,  /**< String, as a length byte and its characters. */
+    HUES_ARGUMENT_STRING_CUT = 6,  /**< String cut at HUES_ARGUMENT_STRING_SIZE characters, likewise. */
+    HUES_ARGUMENT_RESULT = 7,  /**< No value: the next value is the one returned rather than an argument. */
+} hues_argument_type;
+
+/**
+ * @def HUES_ARGUMENT_STRING_SIZE
+ * @brief Maximum number of characters captured from a string.
+ */
+#define HUES_ARGUMENT_STRING_SIZE 64
+
+/**
+ * @fn extern size_t hues_arguments_line(const char* text, size_t text_length, const void* arguments, size_t arguments_length, char* buffer, size_t size)
+ * @brief Formats a line followed by the values captured for it, such as "'open' called at ... with ("/etc/hosts", 0) returned 3",
+ * keeping the newline at its end.
+ * @param text The line.
+ * @param text_length The length of the line.
+ * @param arguments The captured values.
+ * @param arguments_length The length of the captured values.
+ * @param buffer The buffer receiving the line, null-terminated.
+ * @param size The size of the buffer, at least 2.
+ * @return The length of the line formatted, truncated to fit the buffer.
+ */
+extern size_t hues_arguments_line(const char* text, size_t text_length, const void* arguments, size_t arguments_length, char* buffer, size_t size);
+
+/**
+ * @fn extern const void* hues_record_arguments(const hues_record_header* header, size_t* text_length, size_t* arguments_length)
+ * @brief Finds the values captured for a binary record, stored after its line.
+ * @param header A pointer to the record, checked beforehand.
+ * @param text_length The length of the line, without the captured values.
+ * @param arguments_length The length of the captured values, 0 if there are none.
+ * @return The captured values, in the record, or NULL if there are none.
+ */
+extern const void* hues_record_arguments(const hues_record_header* header, size_t* text_length, size_t* arguments_length);
+
+/**
+ * @fn extern const char* hues_record_line(const hues_record_header* header, char* buffer, size_t size, size_t* length)
+ * @brief Retrieves the formatted line of a binary record, formatting its captured values into it if it has any.
+ * @param header A pointer to the record, checked beforehand.
+ * @param buffer A buffer used if the record has captured values.
+ * @param size The size of the buffer, at least 2.
+ * @param length The length of the line.
+ * @return The line, in the record or in the buffer.
+ */
+extern const char* hues_record_line(const hues_record_header* header, char* buffer, size_t size, size_t* length);
+
+/**
+ * @def HUES_FILE_MAGIC
+ * @brief Magic number at the start of a binary log file ("HFIL").
+ */
+#define HUES_FILE_MAGIC 0x4c494648u
+
+/**
+ * @def HUES_FILE_VERSION
+ * @brief Version of the log file layout.
+ */
+#define HUES_FILE_VERSION 2
+
+/**
+ * @enum hues_file_format
+ * @brief Enumerates the layouts of a log file.
+ */
+typedef enum {
+    HUES_FILE_FORMAT_TEXT = 0,  /**< One formatted line per record, without escape sequences. */
+    HUES_FILE_FORMAT_BINARY = 1,  /**< A hues_file_header followed by binary records. */
+} hues_file_format;
+
+/**
+ * @enum hues_file_compression
+ * @brief Enumerates the compressions of a log file.
+ */
+typedef enum {
+    HUES_FILE_COMPRESSION_NONE = 0,  /**< Records are written as is. */
+    HUES_FILE_COMPRESSION_LZ4 = 1,  /**< A hues_file_header followed by blocks of records, each compressed on its own in the LZ4 block format. */
+} hues_file_compression;
+
+/**
+ * @struct hues_file_header
+ * @brief Represents the header at the start of every segment of a binary or compressed log file.
+ */
+typedef struct {
+    uint32_t magic;  /**< HUES_FILE_MAGIC. */
+    uint32_t version;  /**< HUES_FILE_VERSION. */
+    uint32_t format;  /**< hues_file_format of the segment. */
+    uint32_t compression;  /**< hues_file_compression of the segment. */
+} hues_file_header;
+
+/**
+ * @def HUES_BLOCK_MAGIC
+ * @brief Magic number at the start of a block of a compressed log file ("HBLK").
+ */
+#define HUES_BLOCK_MAGIC 0x4b4c4248u
+
+/**
+ * @struct hues_block_header
+ * @brief Represents the header of a block of a compressed log file. Blocks start on 8-byte boundaries and hold whole records,
+ * so that a file can be decompressed from any block, and a reader can resynchronize on the next block after corruption.
+ */
+typedef struct {
+    uint32_t magic;  /**< HUES_BLOCK_MAGIC. */
+    uint32_t checksum;  /**< Checksum of the header, its checksum field zeroed, and of the stored data. */
+    uint32_t stored_size;  /**< Size of the data following the header, padding excluded. */
+    uint32_t size;  /**< Size of the data once decompressed. Blocks that would not shrink are stored as is, with both sizes equal. */
+} hues_block_header;
+
+/**
+ * @def HUES_BLOCK_SIZE(stored_size)
+ * @brief Size taken by a block with the given stored data size, padded to 8 bytes.
+ */
+#define HUES_BLOCK_SIZE(stored_size) ((sizeof(hues_block_header) + (stored_size) + 7) & ~(size_t) 7)
+
+/**
+ * @def HUES_LZ4_BOUND(size)
+ * @brief Maximum size of the LZ4 compression of data of the given size.
+ */
+#define HUES_LZ4_BOUND(size) ((size) + (size) / 255 + 16)
+
+/**
+ * @fn extern size_t hues_lz4_compress(const char* source, size_t size, char* destination, size_t capacity)
+ * @brief Compresses data in the LZ4 block format.
+ * @param source The data to compress.
+ * @param size The size of the data.
+ * @param destination The buffer receiving the compressed data.
+ * @param capacity The size of the buffer, HUES_LZ4_BOUND(size) to always succeed.
+ * @return The size of the compressed data, 0 if the buffer is too small.
+ */
+extern size_t hues_lz4_compress(const char* source, size_t size, char* destination, size_t capacity);
+
+/**
+ * @fn extern long hues_lz4_decompress(const char* source, size_t size, char* destination, size_t capacity)
+ * @brief Decompresses data in the LZ4 block format.
+ * @param source The compressed data.
+ * @param size The size of the compressed data.
+ * @param destination The buffer receiving the decompressed data.
+ * @param capacity The size of the buffer.
+ * @return The size of the decompressed data, -1 if the data is malformed or the buffer too small.
+ */
+extern long hues_lz4_decompress(const char* source, size_t size, char* destination, size_t capacity);
+
+/**
+ * @fn extern size_t hues_block_encode(const char* data, size_t size, void* block, size_t capacity)
+ * @brief Compresses data into a block of a compressed log file.
+ * @param data The data, made of whole records.
+ * @param size The size of the data, less than 4 GiB.
+ * @param block A buffer aligned to 8 bytes receiving the block.
+ * @param capacity The size of the buffer, HUES_BLOCK_SIZE(size) to always succeed.
+ * @return The size taken by the block, including padding, 0 if the buffer is too small.
+ */
+extern size_t hues_block_encode(const char* data, size_t size, void* block, size_t capacity);
+
+/**
+ * @fn extern long hues_block_decode(const hues_block_header* block, size_t available, char* data, size_t capacity)
+ * @brief Checks and decompresses a block of a compressed log file.
+ * @param block A pointer to the block.
+ * @param available The number of bytes readable from the block on.
+ * @param data The buffer receiving the decompressed data.
+ * @param capacity The size of the buffer, block->size to always succeed.
+ * @return The size of the decompressed data, -1 if the block is truncated or corrupt.
+ */
+extern long hues_block_decode(const hues_block_header* block, size_t available, char* data, size_t capacity);
+
+/**
+ * @def HUES_INDEX_MAGIC
+ * @brief Magic number at the start of the sidecar index of a log file segment ("HIDX").
+ */
+#define HUES_INDEX_MAGIC 0x58444948u
+
+/**
+ * @def HUES_INDEX_VERSION
+ * @brief Version of the sidecar index layout.
+ */
+#define HUES_INDEX_VERSION 1
+
+/**
+ * @def HUES_INDEX_SUFFIX
+ * @brief Suffix appended to the path of a segment to name its sidecar index.
+ */
+#define HUES_INDEX_SUFFIX ".idx"
+
+/**
+ * @struct hues_index_header
+ * @brief Represents the header of a sidecar index, followed by its entries.
+ */
+typedef struct {
+    uint32_t magic;  /**< HUES_INDEX_MAGIC. */
+    uint32_t version;  /**< HUES_INDEX_VERSION. */
+    uint32_t interval;  /**< Size of the segment covered by each entry when it was written, in bytes. */
+    uint32_t reserved;  /**< Reserved, zero. */
+} hues_index_header;
+
+/**
+ * @struct hues_index_entry
+ * @brief Represents an entry of a sidecar index: a chunk of its segment made of whole records, or whole blocks if it is compressed.
+ * Entries follow each other in the segment. Parts of the segment not covered by any entry, such as the tail of a live segment, must be scanned.
+ */
+typedef struct {
+    uint64_t offset;  /**< Offset of the chunk in the segment. */
+    uint64_t size;  /**< Size of the chunk in the segment. */
+    uint64_t minimum_timestamp;  /**< Earliest timestamp of the records of the chunk, in nanoseconds since the epoch. */
+    uint64_t maximum_timestamp;  /**< Latest timestamp of the records of the chunk. */
+    uint32_t levels;  /**< Bitmap of the levels of the records of the chunk, bit n for level n. */
+    uint32_t count;  /**< Number of records in the chunk. */
+} hues_index_entry;
+
+/**
+ * @fn extern hues_index_entry* hues_index_load(const char* segment_path, size_t* count)
+ * @brief Reads the sidecar index of a log file segment, ignoring a truncated last entry.
+ * @param segment_path The path of the segment, without HUES_INDEX_SUFFIX.
+ * @param count Receives the number of entries.
+ * @return The entries, to free, or NULL if the segment has no valid index.
+ */
+extern hues_index_entry* hues_index_load(const char* segment_path, size_t* count);
+
+/**
+ * @fn extern int hues_index_entry_matches(const hues_index_entry* entry, uint64_t from, uint64_t to, hues_level_enum minimum_level)
+ * @brief Checks whether a chunk may hold records in a time range, at or above a level.
+ * @param entry The entry of the chunk.
+ * @param from The start of the time range, in nanoseconds since the epoch.
+ * @param to The end of the time range, included.
+ * @param minimum_level The minimum level.
+ * @return 1 if the chunk must be read, 0 if it can be skipped.
+ */
+extern int hues_index_entry_matches(const hues_index_entry* entry, uint64_t from, uint64_t to, hues_level_enum minimum_level);
+
+/**
+ * @fn extern int hues_time_parse(const char* text, uint64_t* timestamp)
+ * @brief Parses a time bounding a query, as given on the command line of the tools.
+ * @param text The time, as YYYY-MM-DD HH:MM[:SS] or HH:MM[:SS] today in local time, or @seconds since the epoch.
+ * @param timestamp Receives the time, in nanoseconds since the epoch.
+ * @return 0 on success, -1 if the time cannot be parsed.
+ */
+extern int hues_time_parse(const char* text, uint64_t* timestamp);
+
+/**
+ * @def HUES_BLOOM_MAGIC
+ * @brief Magic number ending a segment that carries a token bloom filter ("HBLM").
+ */
+#define HUES_BLOOM_MAGIC 0x4d4c4248u
+
+/**
+ * @def HUES_BLOOM_HASHES
+ * @brief Number of bits set in a bloom filter for every token.
+ */
+#define HUES_BLOOM_HASHES 7
+
+/**
+ * @def HUES_BLOOM_MINIMUM_TOKEN
+ * @brief Length of the shortest token added to a bloom filter, shorter tokens are too common to be worth searching.
+ */
+#define HUES_BLOOM_MINIMUM_TOKEN 3
+
+/**
+ * @struct hues_bloom_footer
+ * @brief Represents the footer ending a rotated segment of a binary or compressed log file, preceded by a bloom filter of the tokens of its records.
+ * Tokens are maximal runs of letters, digits, '_' and '-', such as words and request ids.
+ */
+typedef struct {
+    uint64_t bits;  /**< Number of bits of the filter, a power of two. */
+    uint32_t hashes;  /**< Number of bits set for every token. */
+    uint32_t checksum;  /**< Checksum of the filter. */
+    uint32_t size;  /**< Size of the filter and the footer, in bytes. */
+    uint32_t magic;  /**< HUES_BLOOM_MAGIC, the last bytes of the segment. */
+} hues_bloom_footer;
+
+/**
+ * @fn extern int hues_token_character(char character)
+ * @brief Checks whether a character belongs to a token: a letter, a digit, '_' or '-'. Bloom filters hold the tokens of the
+ * records, so that searching for whole words must delimit them the same way.
+ * @param character The character.
+ * @return 1 if the character belongs to a token, 0 if it delimits tokens.
+ */
+extern int hues_token_character(char character);
+
+/**
+ * @fn extern void hues_bloom_add(uint64_t* filter, uint64_t bits, const char* text, size_t length)
+ * @brief Adds the tokens of a text to a bloom filter.
+ * @param filter The filter.
+ * @param bits The number of bits of the filter, a power of two.
+ * @param text The text.
+ * @param length The length of the text.
+ */
+extern void hues_bloom_add(uint64_t* filter, uint64_t bits, const char* text, size_t length);
+
+/**
+ * @fn extern int hues_bloom_may_contain(const uint64_t* filter, uint64_t bits, const char* text, size_t length)
+ * @brief Checks whether the tokens of a text may all have been added to a bloom filter.
+ * @param filter The filter.
+ * @param bits The number of bits of the filter, a power of two.
+ * @param text The text.
+ * @param length The length of the text.
+ * @return 0 if a token of the text was never added, 1 otherwise.
+ */
+extern int hues_bloom_may_contain(const uint64_t* filter, uint64_t bits, const char* text, size_t length);
+
+/**
+ * @fn extern uint64_t hues_bloom_fold(uint64_t* filter, uint64_t bits)
+ * @brief Halves a bloom filter, OR-ing its halves, as long as at most half of its bits end up set.
+ * Filters are sized for large segments: folding shrinks the filter of a segment to its actual number of tokens.
+ * @param filter The filter, folded in place.
+ * @param bits The number of bits of the filter, a power of two.
+ * @return The number of bits of the folded filter.
+ */
+extern uint64_t hues_bloom_fold(uint64_t* filter, uint64_t bits);
+
+/**
+ * @fn extern const hues_bloom_footer* hues_bloom_footer_find(const void* segment, size_t size)
+ * @brief Looks for a valid bloom filter footer at the end of a segment.
+ * @param segment The segment, mapped or read in memory.
+ * @param size The size of the segment.
+ * @return The footer, the filter preceding it, or NULL if the segment has none.
+ */
+extern const hues_bloom_footer* hues_bloom_footer_find(const void* segment, size_t size);
+
+/**
+ * @typedef void (*hues_file_rotate_function)(const char* segment_path, void* context)
+ * @brief Represents a function called with the path of a segment once it is rotated out.
+ */
+typedef void (*hues_file_rotate_function)(const char* segment_path, void* context);
+
+/**
+ * @struct hues_file_options
+ * @brief Represents the options of a log file.
+ * Rotated segments are renamed to path.1, path.2 and so on, the highest number being the most recent.
+ */
+typedef struct {
+    const char* path;  /**< Path of the live segment. */
+    hues_file_format format;  /**< Layout of the file. */
+    hues_file_compression compression;  /**< Compression of the file, done by the thread flushing it: the writer when it runs. */
+    size_t compression_threads;  /**< Number of threads compressing 64 KiB chunks in parallel, 0 or 1 to compress on the thread flushing the file. */
+    int direct;  /**< Whether to bypass the page cache with O_DIRECT, writing aligned buffers from a dedicated thread. */
+    size_t index_interval;  /**< Size of the segment covered by each entry of its sidecar index, 0 for no index. Binary files only; compressed files round it up to whole blocks. */
+    size_t bloom_size;  /**< Size of the token bloom filter ending each rotated segment before it is folded, rounded down to a power of two, 0 for none. Text files without compression have none. */
+    size_t max_segment_size;  /**< Size after which the live segment is rotated, 0 to never rotate. */
+    size_t max_segments;  /**< Number of rotated segments kept, 0 to keep them all. */
+    hues_file_rotate_function rotate_function;  /**< Function called after each rotation, may be NULL. */
+    void* rotate_context;  /**< Context handed to the rotate function. */
+} hues_file_options;
+
+typedef struct hues_file hues_file;
+
+/**
+ * @fn extern hues_file* hues_file_open(const hues_file_options* options)
+ * @brief Opens a log file for appending, with buffered writes and size-based rotation.
+ * @param options The options of the file, copied.
+ * @return The file, or NULL on error, with errno set to EINVAL for an index on a text file.
+ */
+extern hues_file* hues_file_open(const hues_file_options* options);
+
+/**
+ * @fn extern int hues_file_write(hues_file* file, const hues_record* record)
+ * @brief Appends a record to a log file, in the layout of the file.
+ * @param file The file.
+ * @param record The record to append.
+ * @return 0 on success, -1 on error.
+ */
+extern int hues_file_write(hues_file* file, const hues_record* record);
+
+/**
+ * @fn extern int hues_file_write_encoded(hues_file* file, const hues_record_header* header)
+ * @brief Appends an already encoded binary record to a log file: as is in binary files, as its text in text files.
+ * @param file The file.
+ * @param header A pointer to the binary record, followed by its payload.
+ * @return 0 on success, -1 on error.
+ */
+extern int hues_file_write_encoded(hues_file* file, const hues_record_header* header);
+
+/**
+ * @fn extern int hues_file_flush(hues_file* file)
+ * @brief Writes the buffered records of a log file.
+ * @param file The file.
+ * @return 0 on success, -1 on error.
+ */
+extern int hues_file_flush(hues_file* file);
+
+/**
+ * @fn extern int hues_file_rotate(hues_file* file)
+ * @brief Rotates the live segment of a log file, whatever its size.
+ * @param file The file.
+ * @return 0 on success, -1 on error.
+ */
+extern int hues_file_rotate(hues_file* file);
+
+/**
+ * @fn extern void hues_file_close(hues_file* file)
+ * @brief Flushes and closes a log file.
+ * @param file The file.
+ */
+extern void hues_file_close(hues_file* file);
+
+/**
+ * @fn extern hues_sink* hues_file_sink_open(const hues_file_options* options)
+ * @brief Opens a log file as a sink.
+ * @param options The options of the file, copied.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+extern hues_sink* hues_file_sink_open(const hues_file_options* options);
+
+/**
+ * @def HUES_COLUMNAR_MAGIC
+ * @brief Magic number at the start and the end of a columnar log archive ("HCOL").
+ */
+#define HUES_COLUMNAR_MAGIC 0x4c4f4348u
+
+/**
+ * @def HUES_COLUMNAR_VERSION
+ * @brief Version of the columnar log archive layout.
+ */
+#define HUES_COLUMNAR_VERSION 3
+
+/**
+ * @def HUES_COLUMNAR_GROUP_ROWS
+ * @brief Maximum number of records in a row group of a columnar log archive.
+ */
+#define HUES_COLUMNAR_GROUP_ROWS 65536
+
+/**
+ * @struct hues_columnar_group
+ * @brief Represents the header of a row group of a columnar log archive, followed by its columns, in this order:
+ * callsite codes into the dictionary of the archive as 32-bit integers, levels as bytes, timestamp deltas and sequence deltas
+ * as zigzag varints, text lengths as varints and text bytes, then the values captured for the records, by type: their number
+ * per record as varints, their hues_argument_type bytes, integers as varints (zigzag for signed ones) and pointers as varints,
+ * doubles on 8 bytes, and strings as a length byte followed by their characters. The group is padded to 8 bytes.
+ * An archive is a hues_file_header holding HUES_COLUMNAR_MAGIC and HUES_COLUMNAR_VERSION, row groups, the callsite dictionary
+ * and a hues_columnar_footer.
+ */
+typedef struct {
+    uint32_t magic;  /**< HUES_COLUMNAR_MAGIC. */
+    uint32_t rows;  /**< Number of records in the group. */
+    uint64_t minimum_timestamp;  /**< Earliest timestamp of the group, in nanoseconds since the epoch. */
+    uint64_t maximum_timestamp;  /**< Latest timestamp of the group. */
+    uint64_t first_timestamp;  /**< Timestamp of the first record, the base of the timestamp deltas. */
+    uint64_t first_sequence;  /**< Sequence number of the first record, the base of the sequence deltas. */
+    uint32_t levels;  /**< Bitmap of the levels of the group, bit n for level n. */
+    uint32_t timestamps_size;  /**< Size of the timestamp column. */
+    uint32_t sequences_size;  /**< Size of the sequence column. */
+    uint32_t lengths_size;  /**< Size of the text length column. */
+    uint32_t text_size;  /**< Size of the text column. */
+    uint32_t counts_size;  /**< Size of the column of the numbers of captured values. */
+    uint32_t values_count;  /**< Number of captured values, the size of the type column. */
+    uint32_t integers_size;  /**< Size of the integer and pointer column. */
+    uint32_t doubles_size;  /**< Size of the double column. */
+    uint32_t strings_size;  /**< Size of the string column. */
+    uint32_t checksum;  /**< Checksum of the columns. */
+    uint32_t reserved;  /**< Reserved, zero. */
+} hues_columnar_group;
+
+/**
+ * @def HUES_COLUMNAR_GROUP_SIZE(group)
+ * @brief Size taken by a row group, header and padding included.
+ */
+#define HUES_COLUMNAR_GROUP_SIZE(group) ((sizeof(hues_columnar_group) + (group)->timestamps_size + (group)->sequences_size + (size_t) (group)->rows * 5 \
+    + (group)->lengths_size + (group)->text_size + (group)->counts_size + (group)->values_count + (group)->integers_size + (group)->doubles_size \
+    + (group)->strings_size + 7) & ~(size_t) 7)
+
+/**
+ * @struct hues_columnar_footer
+ * @brief Represents the footer of a columnar log archive. The dictionary holds every callsite, as a 32-bit length followed by its characters.
+ */
+typedef struct {
+    uint64_t dictionary_offset;  /**< Offset of the callsite dictionary. */
+    uint32_t dictionary_count;  /**< Number of callsites in the dictionary. */
+    uint32_t dictionary_checksum;  /**< Checksum of the dictionary. */
+    uint32_t groups_count;  /**< Number of row groups. */
+    uint32_t magic;  /**< HUES_COLUMNAR_MAGIC, the last bytes of the archive. */
+} hues_columnar_footer;
+
+typedef struct hues_columnar_writer hues_columnar_writer;
+
+/**
+ * @fn extern hues_columnar_writer* hues_columnar_writer_open(const char* path)
+ * @brief Creates a columnar log archive, replacing any file at its path.
+ * @param path The path of the archive.
+ * @return The writer, or NULL on error.
+ */
+extern hues_columnar_writer* hues_columnar_writer_open(const char* path);
+
+/**
+ * @fn extern int hues_columnar_writer_append(hues_columnar_writer* writer, const hues_record_header* header)
+ * @brief Appends a binary record to a columnar log archive.
+ * @param writer The writer.
+ * @param header A pointer to the binary record, followed by its payload.
+ * @return 0 on success, -1 on error.
+ */
+extern int hues_columnar_writer_append(hues_columnar_writer* writer, const hues_record_header* header);
+
+/**
+ * @fn extern int hues_columnar_writer_close(hues_columnar_writer* writer)
+ * @brief Writes the last row group, the dictionary and the footer of a columnar log archive, and closes it.
+ * @param writer The writer.
+ * @return 0 on success, -1 on error, in which case the archive is incomplete.
+ */
+extern int hues_columnar_writer_close(hues_columnar_writer* writer);
+
+/**
+ * @struct hues_columnar_archive
+ * @brief Represents a columnar log archive mapped for reading.
+ */
+typedef struct {
+    const char* mapping;  /**< Mapped archive. */
+    size_t size;  /**< Size of the archive. */
+    const hues_columnar_footer* footer;  /**< Footer of the archive. */
+    const char** callsites;  /**< Callsites of the dictionary, not terminated. */
+    uint32_t* callsite_lengths;  /**< Lengths of the callsites. */
+} hues_columnar_archive;
+
+/**
+ * @struct hues_columnar_rows
+ * @brief Represents the decoded columns of a row group.
+ */
+typedef struct {
+    size_t rows;  /**< Number of records. */
+    uint64_t* timestamps;  /**< Timestamps. */
+    uint64_t* sequences;  /**< Sequence numbers. */
+    const uint8_t* levels;  /**< Levels, in the archive. */
+    const uint32_t* callsites;  /**< Callsite codes, in the archive. */
+    uint32_t* text_offsets;  /**< Offsets of the texts, rows + 1 of them. */
+    const char* text;  /**< Texts, in the archive. */
+    uint32_t* value_offsets;  /**< Index of the first captured value of each record, rows + 1 of them. */
+    const uint8_t* value_types;  /**< Types of the captured values, in the archive. */
+    uint64_t* values;  /**< Captured values: integers, pointers, bits of doubles, offsets of strings in strings, 0 for HUES_ARGUMENT_RESULT. */
+    size_t values_capacity;  /**< Number of captured values the values array holds, grown as needed. */
+    const uint8_t* strings;  /**< Captured strings, each a length byte followed by its characters, in the archive. */
+} hues_columnar_rows;
+
+/**
+ * @fn extern hues_columnar_archive* hues_columnar_archive_open(const char* path)
+ * @brief Maps a columnar log archive and reads its dictionary.
+ * @param path The path of the archive.
+ * @return The archive, or NULL if it cannot be read or is not a complete archive.
+ */
+extern hues_columnar_archive* hues_columnar_archive_open(const char* path);
+
+/**
+ * @fn extern const hues_columnar_group* hues_columnar_archive_next(const hues_columnar_archive* archive, const hues_columnar_group* group)
+ * @brief Iterates over the row groups of a columnar log archive.
+ * @param archive The archive.
+ * @param group The current group, NULL to start with the first one.
+ * @return The next group, or NULL after the last one or on a corrupt group.
+ */
+extern const hues_columnar_group* hues_columnar_archive_next(const hues_columnar_archive* archive, const hues_columnar_group* group);
+
+/**
+ * @fn extern int hues_columnar_decode(const hues_columnar_archive* archive, const hues_columnar_group* group, hues_columnar_rows* rows)
+ * @brief Checks and decodes the columns of a row group.
+ * @param archive The archive of the group.
+ * @param group The group.
+ * @param rows The decoded columns. Its arrays hold HUES_COLUMNAR_GROUP_ROWS values, allocated on the first call if NULL, to free,
+ * except values, grown to the captured values of the group.
+ * @return 0 on success, -1 if the group is corrupt.
+ */
+extern int hues_columnar_decode(const hues_columnar_archive* archive, const hues_columnar_group* group, hues_columnar_rows* rows);
+
+/**
+ * @fn extern size_t hues_columnar_arguments(const hues_columnar_rows* rows, size_t row, void* buffer, size_t size)
+ * @brief Encodes the values captured for a decoded record as in binary records, to format them with hues_arguments_line.
+ * @param rows The decoded columns.
+ * @param row The index of the record.
+ * @param buffer The buffer receiving the values.
+ * @param size The size of the buffer. Values that do not fit are dropped.
+ * @return The length of the values encoded, 0 if the record has none.
+ */
+extern size_t hues_columnar_arguments(const hues_columnar_rows* rows, size_t row, void* buffer, size_t size);
+
+/**
+ * @fn extern void hues_columnar_archive_close(hues_columnar_archive* archive)
+ * @brief Unmaps a columnar log archive.
+ * @param archive The archive.
+ */
+extern void hues_columnar_archive_close(hues_columnar_archive* archive);
+
+/**
+ * @def HUES_COLLECTOR_BATCH_SIZE
+ * @brief Maximum size of a batch of binary records sent to hues-collectd in one message.
+ */
+#define HUES_COLLECTOR_BATCH_SIZE (64 * 1024)
+
+/**
+ * @fn extern hues_sink* hues_collector_connect(const char* path, size_t batch_size)
+ * @brief Connects to hues-collectd over a UNIX sequenced-packet socket. Records are sent as batches of binary records,
+ * when a batch is full and whenever the sink is flushed, so that the collector does the disk I/O for the process.
+ * While the collector is unreachable, records are dropped and a reconnection is attempted on every flush.
+ * @param path The path of the socket of the collector.
+ * @param batch_size The size of a batch in bytes, at most HUES_COLLECTOR_BATCH_SIZE.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+extern hues_sink* hues_collector_connect(const char* path, size_t batch_size);
+
+/**
+ * @def HUES_SYSLOG_PATH
+ * @brief Default path of the syslog socket.
+ */
+#define HUES_SYSLOG_PATH "/dev/log"
+
+/**
+ * @def HUES_JOURNALD_PATH
+ * @brief Default path of the socket of the journald native protocol.
+ */
+#define HUES_JOURNALD_PATH "/run/systemd/journal/socket"
+
+/**
+ * @fn extern hues_sink* hues_syslog_open(const char* path, const char* identifier, int facility)
+ * @brief Opens a sink sending RFC 3164 messages to the syslog daemon, one datagram per record.
+ * Datagrams are batched and sent with a single sendmmsg(2) when 64 are pending and whenever the sink is flushed.
+ * Levels map to severities: TRACE and DEBUG to debug, INFO to info, WARN to warning, SEVERE to err and CRITICAL to crit.
+ * @param path The path of the syslog socket, NULL for HUES_SYSLOG_PATH.
+ * @param identifier The name of the program, NULL for the name it was invoked with.
+ * @param facility The syslog facility, such as LOG_USER or LOG_LOCAL0.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+extern hues_sink* hues_syslog_open(const char* path, const char* identifier, int facility);
+
+/**
+ * @fn extern hues_sink* hues_journald_open(const char* path, const char* identifier)
+ * @brief Opens a sink sending records to journald with its native protocol: the message, its priority and its
+ * code location as the CODE_FILE, CODE_LINE and CODE_FUNC fields, so that they can be queried with journalctl.
+ * Entries are batched like those of hues_syslog_open.
+ * @param path The path of the journald socket, NULL for HUES_JOURNALD_PATH.
+ * @param identifier The name of the program, NULL for the name it was invoked with.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+extern hues_sink* hues_journald_open(const char* path, const char* identifier);
+
+/**
+ * @struct hues_network_options
+ * @brief Represents the options of a network sink.
+ */
+typedef struct {
+    const char* host;  /**< Host name or address of the log relay. */
+    const char* port;  /**< Port or service name of the log relay. */
+    int type;  /**< SOCK_STREAM for TCP, SOCK_DGRAM for UDP. */
+    hues_file_format format;  /**< Layout of the records: newline-terminated lines, or binary records. */
+    size_t buffer_size;  /**< Memory cap of the records waiting to be sent, 0 for 4 MiB. Records are dropped while it is full. */
+    size_t datagram_size;  /**< Maximum size of a UDP datagram, 0 for 8 KiB. Lower it to 1400 to avoid IP fragmentation. */
+} hues_network_options;
+
+/**
+ * @fn extern hues_sink* hues_network_open(const hues_network_options* options)
+ * @brief Opens a sink forwarding records to a log relay over TCP or UDP, and starts the background writer if needed,
+ * so that producers never wait for the network.
+ * Records are sent in large batches: stream writes of up to 64 KiB, or datagrams packing as many whole records as fit.
+ * The socket is non-blocking: while the relay is slow or unreachable, records accumulate up to the memory cap, and
+ * reconnections are attempted as records come and on flushes, with an exponential backoff from 100 ms up to 30 s.
+ * The host is resolved here, once; when none of its addresses accepts a connection, it is resolved again by a thread of the sink.
+ * The background writer is shared by every sink and keeps running once the sink is closed: stop it with hues_writer_stop.
+ * @param options The options of the sink, copied.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+extern hues_sink* hues_network_open(const hues_network_options* options);
+
 /**
  * @def BUFFER_SIZE 4096
  * @brief Buffer size for logging messages.
@@ -322,178 +1369,469 @@ extern void hues_initialize();
  */
 #define critical(message_format, ...) hues_log(&(hues_message) { CRITICAL, .contents = message_format, .location = CODE_LOC }, CRITICAL, CODE_LOC, ##__VA_ARGS__)
 
-// Define the macro for hooking funcs with no args and no return value
-#define HOOK_FUNCTION_0_ARG_VOID(funcname)                           \
-    typedef void (*funcname##_type)();                               \
-    funcname##_type original_##funcname = (funcname##_type)funcname; \
-    void hooked_##funcname(hues_code_location location)                      \
-    {                                                                \
-        trace("'" #funcname "' called at #c\n", location);         \
-        /* Additional hook logic here */                             \
-        original_##funcname();                                       \
-    }                                                                \
-    void funcname()                                                  \
-    {                                                                \
-        hooked_##funcname(CODE_LOC);                            \
-    }
-// Define the macro for hooking funcs with no args and a return value
-#define HOOK_FUNCTION_0_ARG(funcname, ret_type)                      \
-    typedef ret_type (*funcname##_type)();                           \
-    funcname##_type original_##funcname = (funcname##_type)funcname; \
-    ret_type hooked_##funcname(hues_code_location location)                  \
-    {                                                                \
-        trace("'" #funcname "' called at #c\n", location);         \
-        /* Additional hook logic here */                             \
-        return original_##funcname();                                \
-    }                                                                \
-    ret_type funcname()                                              \
-    {                                                                \
-        return hooked_##funcname(CODE_LOC);                     \
-    }
+/**
+ * @struct hues_hook
+ * @brief Represents a hooked function, defined by the HUES_HOOK macros.
+ */
+typedef struct {
+    const char* name;  /**< Name of the function. */
+    const char* message;  /**< Message traced on every call while tracing. */
+    const char* sample_message;  /**< Message traced on every sampled call, given its latency. */
+    uint32_t id;  /**< Identifier in the profiling reports, 0 until the first call profiled. */
+    uint32_t sample_every;  /**< Samples one call in this many, 0 for none. */
+    uint64_t sample_interval;  /**< Samples a call per thread at this interval at most, in nanoseconds, 0 for none. */
+} hues_hook;
 
-// Define the macro for hooking funcs with one argument and no return value
-#define HOOK_FUNCTION_1_ARG_VOID(funcname, arg_type)                 \
-    typedef void (*funcname##_type)(arg_type);                       \
-    funcname##_type original_##funcname = (funcname##_type)funcname; \
-    void hooked_##funcname(arg_type arg, hues_code_location location)        \
-    {                                                                \
-        trace("'" #funcname "' called at #c\n", location);         \
-        /* Additional hook logic here */                             \
-        original_##funcname(arg);                                    \
-    }                                                                \
-    void funcname(arg_type arg)                                      \
-    {                                                                \
-        hooked_##funcname(arg, CODE_LOC);                       \
-    }
-// Define the macro for hooking funcs with one argument and a return value
-#define HOOK_FUNCTION_1_ARG(funcname, ret_type, arg_type)            \
-    typedef ret_type (*funcname##_type)(arg_type);                   \
-    funcname##_type original_##funcname = (funcname##_type)funcname; \
-    inline ret_type hooked_##funcname(arg_type arg, hues_code_location location)    \
-    {                                                                \
-        trace("'" #funcname "' called at #c\n", location);              \
-        /* Additional hook logic here */                             \
-        return original_##funcname(arg);                             \
-    }                                                                \
-    ret_type funcname(arg_type arg)                                  \
-    {                                                                \
-        return hooked_##funcname(arg, CODE_LOC);                \
-    }
+/**
+ * @def HUES_ARGUMENTS_SIZE
+ * @brief Maximum size of the values captured for a call, the values that do not fit are dropped.
+ */
+#define HUES_ARGUMENTS_SIZE 512
 
-// Define the macro for hooking funcs with void return type and 2 args
-#define HOOK_FUNCTION_2_ARG_VOID(funcname, arg_type1, arg_type2)                \
-    typedef void (*funcname##_type)(arg_type1, arg_type2);                      \
-    funcname##_type original_##funcname = (funcname##_type)funcname;            \
-    void hooked_##funcname(arg_type1 arg1, arg_type2 arg2, hues_code_location location) \
-    {                                                                           \
-        trace("'" #funcname "' called at #c\n", location);                    \
-        /* Additional hook logic here */                                        \
-        original_##funcname(arg1, arg2);                                        \
-    }                                                                           \
-    void funcname(arg_type1 arg1, arg_type2 arg2)                               \
-    {                                                                           \
-        hooked_##funcname(arg1, arg2, CODE_LOC);                           \
-    }
-// Define the macro for hooking funcs with non-void return type and 2 args
-#define HOOK_FUNCTION_2_ARG(funcname, ret_type, arg_type1, arg_type2)               \
-    typedef ret_type (*funcname##_type)(arg_type1, arg_type2);                      \
-    funcname##_type original_##funcname = (funcname##_type)funcname;                \
-    ret_type hooked_##funcname(arg_type1 arg1, arg_type2 arg2, hues_code_location location) \
-    {                                                                               \
-        trace("'" #funcname "' called at #c\n", location);                        \
-        /* Additional hook logic here */                                            \
-        return original_##funcname(arg1, arg2);                                     \
-    }                                                                               \
-    ret_type funcname(arg_type1 arg1, arg_type2 arg2)                               \
-    {                                                                               \
-        return hooked_##funcname(arg1, arg2, CODE_LOC);                        \
-    }
+/**
+ * @struct hues_arguments
+ * @brief Represents the values captured for a call, in binary, as read by hues_arguments_line.
+ */
+typedef struct {
+    size_t length;  /**< Length of the values captured. */
+    uint8_t data[HUES_ARGUMENTS_SIZE];  /**< Values captured, each a hues_argument_type byte followed by the value. */
+} hues_arguments;
 
-// Define the macro for hooking funcs with void return type and 3 args
-#define HOOK_FUNCTION_3_ARG_VOID(funcname, arg_type1, arg_type2, arg_type3)                     \
-    typedef void (*funcname##_type)(arg_type1, arg_type2, arg_type3);                           \
-    funcname##_type original_##funcname = (funcname##_type)funcname;                            \
-    void hooked_##funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, hues_code_location location) \
-    {                                                                                           \
-        trace("'" #funcname "' called at #c\n", location);                                    \
-        /* Additional hook logic here */                                                        \
-        original_##funcname(arg1, arg2, arg3);                                                  \
-    }                                                                                           \
-    void funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3)                               \
-    {                                                                                           \
-        hooked_##funcname(arg1, arg2, arg3, CODE_LOC);                                     \
-    }
-// Define the macro for hooking funcs with non-void return type and 3 args
-#define HOOK_FUNCTION_3_ARG(funcname, ret_type, arg_type1, arg_type2, arg_type3)                    \
-    typedef ret_type (*funcname##_type)(arg_type1, arg_type2, arg_type3);                           \
-    funcname##_type original_##funcname = (funcname##_type)funcname;                                \
-    ret_type hooked_##funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, hues_code_location location) \
-    {                                                                                               \
-        trace("'" #funcname "' called at #c\n", location);                                        \
-        /* Additional hook logic here */                                                            \
-        return original_##funcname(arg1, arg2, arg3);                                               \
-    }                                                                                               \
-    ret_type funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3)                               \
-    {                                                                                               \
-        return hooked_##funcname(arg1, arg2, arg3, CODE_LOC);                                  \
-    }
+/**
+ * @fn extern void hues_arguments_add_int(hues_arguments* arguments, long long value)
+ * @brief Captures a signed integer.
+ * @param arguments The values captured.
+ * @param value The value.
+ */
+extern void hues_arguments_add_int(hues_arguments* arguments, long long value);
 
-// Define the macro for hooking funcs with void return type and 4 args
-#define HOOK_FUNCTION_4_ARG_VOID(funcname, arg_type1, arg_type2, arg_type3, arg_type4)                          \
-    typedef void (*funcname##_type)(arg_type1, arg_type2, arg_type3, arg_type4);                                \
-    funcname##_type original_##funcname = (funcname##_type)funcname;                                            \
-    void hooked_##funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, arg_type4 arg4, hues_code_location location) \
-    {                                                                                                           \
-        trace("'" #funcname "' called at #c\n", location);                                                    \
-        /* Additional hook logic here */                                                                        \
-        original_##funcname(arg1, arg2, arg3, arg4);                                                            \
-    }                                                                                                           \
-    void funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, arg_type4 arg4)                               \
-    {                                                                                                           \
-        hooked_##funcname(arg1, arg2, arg3, arg4, CODE_LOC);                                               \
-    }
-// Define the macro for hooking funcs with non-void return type and 4 args
-#define HOOK_FUNCTION_4_ARG(funcname, ret_type, arg_type1, arg_type2, arg_type3, arg_type4)                         \
-    typedef ret_type (*funcname##_type)(arg_type1, arg_type2, arg_type3, arg_type4);                                \
-    funcname##_type original_##funcname = (funcname##_type)funcname;                                                \
-    ret_type hooked_##funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, arg_type4 arg4, hues_code_location location) \
-    {                                                                                                               \
-        trace("'" #funcname "' called at #c\n", location);                                                        \
-        /* Additional hook logic here */                                                                            \
-        return original_##funcname(arg1, arg2, arg3, arg4);                                                         \
-    }                                                                                                               \
-    ret_type funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, arg_type4 arg4)                               \
-    {                                                                                                               \
-        return hooked_##funcname(arg1, arg2, arg3, arg4, CODE_LOC);                                            \
-    }
+/**
+ * @fn extern void hues_arguments_add_uint(hues_arguments* arguments, unsigned long long value)
+ * @brief Captures an unsigned integer or a size.
+ * @param arguments The values captured.
+ * @param value The value.
+ */
+extern void hues_arguments_add_uint(hues_arguments* arguments, unsigned long long value);
+
+/**
+ * @fn extern void hues_arguments_add_double(hues_arguments* arguments, double value)
+ * @brief Captures a floating point number.
+ * @param arguments The values captured.
+ * @param value The value.
+ */
+extern void hues_arguments_add_double(hues_arguments* arguments, double value);
+
+/**
+ * @fn extern void hues_arguments_add_pointer(hues_arguments* arguments, const void* value)
+ * @brief Captures a pointer, not what it points to.
+ * @param arguments The values captured.
+ * @param value The value.
+ */
+extern void hues_arguments_add_pointer(hues_arguments* arguments, const void* value);
+
+/**
+ * @fn extern void hues_arguments_add_string(hues_arguments* arguments, const char* value)
+ * @brief Captures a string, cut at HUES_ARGUMENT_STRING_SIZE characters. A NULL string is captured as a pointer.
+ * @param arguments The values captured.
+ * @param value The value.
+ */
+extern void hues_arguments_add_string(hues_arguments* arguments, const char* value);
+
+/**
+ * @fn extern void hues_arguments_add_result(hues_arguments* arguments)
+ * @brief Marks the next value captured as the one returned by the call.
+ * @param arguments The values captured.
+ */
+extern void hues_arguments_add_result(hues_arguments* arguments);
+
+/**
+ * @def HUES_ARGUMENT_ADD(arguments, value)
+ * @brief Captures a value by its type: strings, signed and unsigned integers, floating point numbers, and any other
+ * pointer. Structures passed by value cannot be captured.
+ * @param arguments The values captured.
+ * @param value The value.
+ */
+#define HUES_ARGUMENT_ADD(arguments, value)                                                                                      \
+    _Generic((value),                                                                                                          \
+        char*: hues_arguments_add_string, const char*: hues_arguments_add_string,                                              \
+        char: hues_arguments_add_int, signed char: hues_arguments_add_int, short: hues_arguments_add_int,                      \
+        int: hues_arguments_add_int, long: hues_arguments_add_int, long long: hues_arguments_add_int,                          \
+        _Bool: hues_arguments_add_uint, unsigned char: hues_arguments_add_uint, unsigned short: hues_arguments_add_uint,        \
+        unsigned int: hues_arguments_add_uint, unsigned long: hues_arguments_add_uint, unsigned long long: hues_arguments_add_uint, \
+        float: hues_arguments_add_double, double: hues_arguments_add_double, long double: hues_arguments_add_double,            \
+        default: hues_arguments_add_pointer)(arguments, value)
+
+/**
+ * @def HUES_HOOK_TRACING
+ * @brief Bit of hues_glob_hook_mode set while hooked functions trace their calls, the default.
+ */
+#define HUES_HOOK_TRACING 1
+
+/**
+ * @def HUES_HOOK_PROFILING
+ * @brief Bit of hues_glob_hook_mode set while hooked functions are profiled, taking precedence over tracing.
+ */
+#define HUES_HOOK_PROFILING 2
+
+/**
+ * @def HUES_HOOK_SAMPLING
+ * @brief Bit of hues_glob_hook_mode set while hooked functions count their calls and record a sample of them,
+ * taking precedence over tracing.
+ */
+#define HUES_HOOK_SAMPLING 4
+
+/**
+ * @def HUES_HOOK_TRACE
+ * @brief Returned by hues_hook_enter for a call to trace.
+ */
+#define HUES_HOOK_TRACE 0
+
+/**
+ * @def HUES_HOOK_COUNTED
+ * @brief Returned by hues_hook_enter for a call only counted, neither traced nor timed.
+ */
+#define HUES_HOOK_COUNTED 1
+
+/**
+ * @var hues_glob_hook_mode
+ * @brief What hooked functions do, read on every call: when 0, they call the original function right away.
+ */
+extern int hues_glob_hook_mode;
+
+/**
+ * @def HUES_HOOK_INIT(funcname)
+ * @brief Initializes the hook of a function.
+ * @param funcname The name of the function.
+ */
+#define HUES_HOOK_INIT(funcname) { .name = #funcname, .message = "'" #funcname "' called at #c\n", .sample_message = "'" #funcname "' called at #c took %llu ns\n" }
+
+/**
+ * @fn extern uint64_t hues_hook_enter(hues_hook* hook)
+ * @brief Called by a hooked function before the original one: while profiling or sampling, counts the call in the
+ * statistics of the calling thread, and reads the clock if the call is profiled or sampled.
+ * @param hook The hook of the function.
+ * @return The time of the call in nanoseconds, HUES_HOOK_TRACE if it is to be traced, or HUES_HOOK_COUNTED.
+ */
+extern uint64_t hues_hook_enter(hues_hook* hook);
+
+/**
+ * @fn extern uint64_t hues_hook_exit(hues_hook* hook, uint64_t start)
+ * @brief Called by a hooked function after the original one: adds the latency of a call timed to the statistics of
+ * the calling thread. Nothing is formatted nor locked, except on the first call by a thread.
+ * @param hook The hook of the function.
+ * @param start The value returned by hues_hook_enter.
+ * @return The latency of a sampled call to record, in nanoseconds, 0 otherwise.
+ */
+extern uint64_t hues_hook_exit(hues_hook* hook, uint64_t start);
+
+/**
+ * @fn extern void hues_hook_tracing_enable(int enabled)
+ * @brief Switches the tracing of the calls of hooked functions, at the TRACE level. While neither tracing nor
+ * profiling, a hooked function adds a load and a branch to the call of the original one.
+ * @param enabled Whether to trace.
+ */
+extern void hues_hook_tracing_enable(int enabled);
+
+/**
+ * @fn extern void hues_hook_profiling_enable(int enabled)
+ * @brief Switches the hooks to profiling: counting the calls and their latencies rather than tracing them.
+ * @param enabled Whether to profile. The statistics are kept when profiling stops.
+ */
+extern void hues_hook_profiling_enable(int enabled);
+
+/**
+ * @fn extern void hues_hook_sampling_enable(uint32_t every, uint64_t interval)
+ * @brief Switches the hooks to sampling: every call is counted by a per-thread counter, and a sample of them is timed
+ * and traced with its latency and captured arguments, so that hot functions are profiled at little cost.
+ * @param every Samples one call in this many on each thread, 0 for none.
+ * @param interval Also samples the first call on each thread after this interval since its last sample, in
+ * nanoseconds, with the resolution of the coarse clock, 0 for none. Both 0 stop sampling.
+ */
+extern void hues_hook_sampling_enable(uint32_t every, uint64_t interval);
 
-// Define the macro for hooking funcs with void return type and 5 args
-#define HOOK_FUNCTION_5_ARG_VOID(funcname, arg_type1, arg_type2, arg_type3, arg_type4, arg_type5)                               \
-    typedef void (*funcname##_type)(arg_type1, arg_type2, arg_type3, arg_type4, arg_type5);                                     \
-    funcname##_type original_##funcname = (funcname##_type)funcname;                                                            \
-    void hooked_##funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, arg_type4 arg4, arg_type5 arg5, hues_code_location location) \
-    {                                                                                                                           \
-        trace("'" #funcname "' called at #c\n", location);                                                                    \
-        /* Additional hook logic here */                                                                                        \
-        original_##funcname(arg1, arg2, arg3, arg4, arg5);                                                                      \
-    }                                                                                                                           \
-    void funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, arg_type4 arg4, arg_type5 arg5)                               \
-    {                                                                                                                           \
-        hooked_##funcname(arg1, arg2, arg3, arg4, arg5, CODE_LOC);                                                         \
+/**
+ * @fn extern void hues_hook_sampling_set(hues_hook* hook, uint32_t every, uint64_t interval)
+ * @brief Samples a hooked function at its own rate, such as &hues_hook_rename for HUES_HOOK(rename, ...).
+ * @param hook The hook of the function.
+ * @param every Samples one call in this many on each thread, 0 for none.
+ * @param interval Samples a call per thread at this interval at most, in nanoseconds, 0 for none. Both 0 restore the
+ * rate given to hues_hook_sampling_enable.
+ */
+extern void hues_hook_sampling_set(hues_hook* hook, uint32_t every, uint64_t interval);
+
+/**
+ * @fn extern void hues_hook_profile_report(FILE* stream)
+ * @brief Prints, for every hooked function profiled, the calls, the total time, and the mean, median and 99th
+ * percentile latencies. Percentiles are the upper bounds of histogram buckets, within 25% of the latency.
+ * @param stream The stream to print to.
+ */
+extern void hues_hook_profile_report(FILE* stream);
+
+/**
+ * @fn extern int hues_hook_profile_report_every(FILE* stream, uint64_t interval)
+ * @brief Starts a thread printing a profiling report periodically, replacing the previous one.
+ * @param stream The stream to print to.
+ * @param interval The interval between reports in nanoseconds, 0 to stop the reports.
+ * @return 0 on success, -1 if the thread cannot be started.
+ */
+extern int hues_hook_profile_report_every(FILE* stream, uint64_t interval);
+
+/**
+ * @fn extern void* hues_hook_original(const char* name, void* symbol)
+ * @brief Called by a hooked function on its first call with the original function found by dlsym, aborting if there is none.
+ * @param name The name of the function.
+ * @param symbol The address returned by dlsym.
+ * @return The address of the original function.
+ */
+extern void* hues_hook_original(const char* name, void* symbol);
+
+/**
+ * @def HUES_RTLD_NEXT
+ * @brief The pseudo-handle of dlsym looking past the object calling it, also for units built without _GNU_SOURCE.
+ */
+#ifdef RTLD_NEXT
+#define HUES_RTLD_NEXT RTLD_NEXT
+#else
+#define HUES_RTLD_NEXT ((void*) -1l)
+#endif
+
+// Count the parameter types of a hook, 0 to 16, and name the parameters hues_arg<N> down to hues_arg1
+#define HUES_HOOK_CONCAT(a, b) HUES_HOOK_CONCAT_(a, b)
+#define HUES_HOOK_CONCAT_(a, b) a##b
+
+#define HUES_HOOK_COUNT(...) HUES_HOOK_COUNT_N(0, ##__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define HUES_HOOK_ANY(...) HUES_HOOK_COUNT_N(0, ##__VA_ARGS__, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0)
+#define HUES_HOOK_COUNT_N(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define HUES_HOOK_PARAMETERS(...) HUES_HOOK_CONCAT(HUES_HOOK_PARAMETERS_, HUES_HOOK_COUNT(__VA_ARGS__))(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_TAIL(...) HUES_HOOK_CONCAT(HUES_HOOK_PARAMETERS_TAIL_, HUES_HOOK_ANY(__VA_ARGS__))(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_TAIL_0(...)
+#define HUES_HOOK_PARAMETERS_TAIL_1(...) , HUES_HOOK_PARAMETERS(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS(...) HUES_HOOK_CONCAT(HUES_HOOK_ARGUMENTS_, HUES_HOOK_COUNT(__VA_ARGS__))(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_TAIL(...) HUES_HOOK_CONCAT(HUES_HOOK_ARGUMENTS_TAIL_, HUES_HOOK_ANY(__VA_ARGS__))(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_TAIL_0(...)
+#define HUES_HOOK_ARGUMENTS_TAIL_1(...) , HUES_HOOK_ARGUMENTS(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_0() void
+#define HUES_HOOK_PARAMETERS_1(type) type hues_arg1
+#define HUES_HOOK_PARAMETERS_2(type, ...) type hues_arg2, HUES_HOOK_PARAMETERS_1(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_3(type, ...) type hues_arg3, HUES_HOOK_PARAMETERS_2(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_4(type, ...) type hues_arg4, HUES_HOOK_PARAMETERS_3(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_5(type, ...) type hues_arg5, HUES_HOOK_PARAMETERS_4(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_6(type, ...) type hues_arg6, HUES_HOOK_PARAMETERS_5(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_7(type, ...) type hues_arg7, HUES_HOOK_PARAMETERS_6(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_8(type, ...) type hues_arg8, HUES_HOOK_PARAMETERS_7(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_9(type, ...) type hues_arg9, HUES_HOOK_PARAMETERS_8(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_10(type, ...) type hues_arg10, HUES_HOOK_PARAMETERS_9(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_11(type, ...) type hues_arg11, HUES_HOOK_PARAMETERS_10(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_12(type, ...) type hues_arg12, HUES_HOOK_PARAMETERS_11(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_13(type, ...) type hues_arg13, HUES_HOOK_PARAMETERS_12(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_14(type, ...) type hues_arg14, HUES_HOOK_PARAMETERS_13(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_15(type, ...) type hues_arg15, HUES_HOOK_PARAMETERS_14(__VA_ARGS__)
+#define HUES_HOOK_PARAMETERS_16(type, ...) type hues_arg16, HUES_HOOK_PARAMETERS_15(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_0()
+#define HUES_HOOK_ARGUMENTS_1(type) hues_arg1
+#define HUES_HOOK_ARGUMENTS_2(type, ...) hues_arg2, HUES_HOOK_ARGUMENTS_1(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_3(type, ...) hues_arg3, HUES_HOOK_ARGUMENTS_2(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_4(type, ...) hues_arg4, HUES_HOOK_ARGUMENTS_3(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_5(type, ...) hues_arg5, HUES_HOOK_ARGUMENTS_4(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_6(type, ...) hues_arg6, HUES_HOOK_ARGUMENTS_5(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_7(type, ...) hues_arg7, HUES_HOOK_ARGUMENTS_6(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_8(type, ...) hues_arg8, HUES_HOOK_ARGUMENTS_7(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_9(type, ...) hues_arg9, HUES_HOOK_ARGUMENTS_8(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_10(type, ...) hues_arg10, HUES_HOOK_ARGUMENTS_9(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_11(type, ...) hues_arg11, HUES_HOOK_ARGUMENTS_10(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_12(type, ...) hues_arg12, HUES_HOOK_ARGUMENTS_11(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_13(type, ...) hues_arg13, HUES_HOOK_ARGUMENTS_12(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_14(type, ...) hues_arg14, HUES_HOOK_ARGUMENTS_13(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_15(type, ...) hues_arg15, HUES_HOOK_ARGUMENTS_14(__VA_ARGS__)
+#define HUES_HOOK_ARGUMENTS_16(type, ...) hues_arg16, HUES_HOOK_ARGUMENTS_15(__VA_ARGS__)
+
+// What a hook captures of a call, in binary: nothing, or its arguments and the value it returns, traced after the call
+#define HUES_HOOK_CAPTURE_NONE(arguments, ...)
+#define HUES_HOOK_CAPTURE_NONE_RESULT(arguments, value)
+#define HUES_HOOK_CAPTURE_NONE_ANY 0
+#define HUES_HOOK_CAPTURE_ALL(arguments, ...) HUES_HOOK_CONCAT(HUES_HOOK_CAPTURE_, HUES_HOOK_COUNT(__VA_ARGS__))(arguments, ##__VA_ARGS__)
+#define HUES_HOOK_CAPTURE_ALL_RESULT(arguments, value) hues_arguments_add_result(arguments); HUES_ARGUMENT_ADD(arguments, value);
+#define HUES_HOOK_CAPTURE_ALL_ANY 1
+#define HUES_HOOK_CAPTURE_0(arguments)
+#define HUES_HOOK_CAPTURE_1(arguments, type) HUES_ARGUMENT_ADD(arguments, hues_arg1);
+#define HUES_HOOK_CAPTURE_2(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg2); HUES_HOOK_CAPTURE_1(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_3(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg3); HUES_HOOK_CAPTURE_2(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_4(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg4); HUES_HOOK_CAPTURE_3(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_5(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg5); HUES_HOOK_CAPTURE_4(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_6(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg6); HUES_HOOK_CAPTURE_5(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_7(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg7); HUES_HOOK_CAPTURE_6(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_8(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg8); HUES_HOOK_CAPTURE_7(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_9(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg9); HUES_HOOK_CAPTURE_8(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_10(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg10); HUES_HOOK_CAPTURE_9(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_11(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg11); HUES_HOOK_CAPTURE_10(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_12(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg12); HUES_HOOK_CAPTURE_11(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_13(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg13); HUES_HOOK_CAPTURE_12(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_14(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg14); HUES_HOOK_CAPTURE_13(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_15(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg15); HUES_HOOK_CAPTURE_14(arguments, __VA_ARGS__)
+#define HUES_HOOK_CAPTURE_16(arguments, type, ...) HUES_ARGUMENT_ADD(arguments, hues_arg16); HUES_HOOK_CAPTURE_15(arguments, __VA_ARGS__)
+
+/**
+ * @def HUES_HOOK_DEFINE(funcname, ret_type, trace_format, sample_format, capture, ...)
+ * @brief Defines funcname calling the original function, the next definition of funcname after the object defining the
+ * hook, found by dlsym(RTLD_NEXT) on the first call: it must come from a shared library, and functions dlsym itself
+ * calls, such as malloc, cannot be hooked. Programs link with -ldl before glibc 2.34. While hooks are off, it calls it
+ * right away; otherwise hooked_funcname, kept out of line, traces or profiles the call around it. The values captured
+ * are copied in binary, only for the calls traced or sampled, and formatted by the consumers of the records.
+ * @param funcname The name of the function.
+ * @param ret_type The return type of the function.
+ * @param trace_format The message traced on every call: before it, or after it when the call is captured.
+ * @param sample_format The message traced on every sampled call, given its latency.
+ * @param capture HUES_HOOK_CAPTURE_NONE, or HUES_HOOK_CAPTURE_ALL to capture the arguments and the value returned.
+ * @param ... The types of the parameters of the function, up to 16. Variadic functions, such as open, cannot be hooked.
+ */
+#define HUES_HOOK_DEFINE(funcname, ret_type, trace_format, sample_format, capture, ...)                                                                      \
+    typedef ret_type (*funcname##_type)(HUES_HOOK_PARAMETERS(__VA_ARGS__));                                                                                  \
+    static funcname##_type original_##funcname;                                                                                                              \
+    static funcname##_type hues_hook_original_##funcname()                                                                                                   \
+    {                                                                                                                                                        \
+        funcname##_type original = __atomic_load_n(&original_##funcname, __ATOMIC_RELAXED);                                                                  \
+        if (__builtin_expect(original == NULL, 0)) {                                                                                                         \
+            original = (funcname##_type) hues_hook_original(#funcname, dlsym(HUES_RTLD_NEXT, #funcname));                                                    \
+            __atomic_store_n(&original_##funcname, original, __ATOMIC_RELAXED);                                                                              \
+        }                                                                                                                                                    \
+        return original;                                                                                                                                     \
+    }                                                                                                                                                        \
+    static hues_hook hues_hook_##funcname = { .name = #funcname, .message = trace_format, .sample_message = sample_format };                                 \
+    static __attribute__((noinline)) ret_type hooked_##funcname(hues_code_location location HUES_HOOK_PARAMETERS_TAIL(__VA_ARGS__))                          \
+    {                                                                                                                                                        \
+        uint64_t hues_hook_start = hues_hook_enter(&hues_hook_##funcname);                                                                                   \
+        hues_arguments hues_hook_arguments;                                                                                                                  \
+        hues_hook_arguments.length = 0;                                                                                                                      \
+        int hues_hook_captured = capture##_ANY && hues_hook_start != HUES_HOOK_COUNTED                                                                       \
+            && !(__atomic_load_n(&hues_glob_hook_mode, __ATOMIC_RELAXED) & HUES_HOOK_PROFILING);                                                             \
+        if (hues_hook_captured) {                                                                                                                            \
+            capture(&hues_hook_arguments, ##__VA_ARGS__)                                                                                                     \
+        }                                                                                                                                                    \
+        if (hues_hook_start == HUES_HOOK_TRACE && !capture##_ANY) {                                                                                          \
+            hues_log(&(hues_message) { TRACE, .contents = trace_format, .location = location }, TRACE, location, location);                                  \
+        }                                                                                                                                                    \
+        ret_type hues_hook_result = hues_hook_original_##funcname()(HUES_HOOK_ARGUMENTS(__VA_ARGS__));                                                       \
+        uint64_t hues_hook_latency = hues_hook_exit(&hues_hook_##funcname, hues_hook_start);                                                                 \
+        if (hues_hook_captured) {                                                                                                                            \
+            capture##_RESULT(&hues_hook_arguments, hues_hook_result)                                                                                         \
+        }                                                                                                                                                    \
+        if (hues_hook_start == HUES_HOOK_TRACE && capture##_ANY) {                                                                                           \
+            hues_log(&(hues_message) { TRACE, .contents = trace_format, .location = location, .arguments = hues_hook_arguments.data,                         \
+                                       .arguments_length = hues_hook_arguments.length }, TRACE, location, location);                                         \
+        }                                                                                                                                                    \
+        if (hues_hook_latency != 0) {                                                                                                                        \
+            hues_log(&(hues_message) { TRACE, .contents = sample_format, .location = location, .arguments = hues_hook_arguments.data,                        \
+                                       .arguments_length = hues_hook_arguments.length }, TRACE, location, location, (unsigned long long) hues_hook_latency); \
+        }                                                                                                                                                    \
+        return hues_hook_result;                                                                                                                             \
+    }                                                                                                                                                        \
+    ret_type funcname(HUES_HOOK_PARAMETERS(__VA_ARGS__))                                                                                                     \
+    {                                                                                                                                                        \
+        if (__builtin_expect(__atomic_load_n(&hues_glob_hook_mode, __ATOMIC_RELAXED) == 0, 1)) {                                                             \
+            return hues_hook_original_##funcname()(HUES_HOOK_ARGUMENTS(__VA_ARGS__));                                                                        \
+        }                                                                                                                                                    \
+        return hooked_##funcname(CODE_LOC HUES_HOOK_ARGUMENTS_TAIL(__VA_ARGS__));                                                                            \
     }
-// Define the macro for hooking funcs with non-void return type and 5 args
-#define HOOK_FUNCTION_5_ARG(funcname, ret_type, arg_type1, arg_type2, arg_type3, arg_type4, arg_type5)                              \
-    typedef ret_type (*funcname##_type)(arg_type1, arg_type2, arg_type3, arg_type4, arg_type5);                                     \
-    funcname##_type original_##funcname = (funcname##_type)funcname;                                                                \
-    ret_type hooked_##funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, arg_type4 arg4, arg_type5 arg5, hues_code_location location) \
-    {                                                                                                                               \
-        trace("'" #funcname "' called at #c\n", location);                                                                        \
-        /* Additional hook logic here */                                                                                            \
-        return original_##funcname(arg1, arg2, arg3, arg4, arg5);                                                                   \
-    }                                                                                                                               \
-    ret_type funcname(arg_type1 arg1, arg_type2 arg2, arg_type3 arg3, arg_type4 arg4, arg_type5 arg5)                               \
-    {                                                                                                                               \
-        return hooked_##funcname(arg1, arg2, arg3, arg4, arg5, CODE_LOC);                                                      \
+
+/**
+ * @def HUES_HOOK_DEFINE_VOID(funcname, trace_format, sample_format, capture, ...)
+ * @brief Same as HUES_HOOK_DEFINE, for a function returning nothing.
+ */
+#define HUES_HOOK_DEFINE_VOID(funcname, trace_format, sample_format, capture, ...)                                                                           \
+    typedef void (*funcname##_type)(HUES_HOOK_PARAMETERS(__VA_ARGS__));                                                                                      \
+    static funcname##_type original_##funcname;                                                                                                              \
+    static funcname##_type hues_hook_original_##funcname()                                                                                                   \
+    {                                                                                                                                                        \
+        funcname##_type original = __atomic_load_n(&original_##funcname, __ATOMIC_RELAXED);                                                                  \
+        if (__builtin_expect(original == NULL, 0)) {                                                                                                         \
+            original = (funcname##_type) hues_hook_original(#funcname, dlsym(HUES_RTLD_NEXT, #funcname));                                                    \
+            __atomic_store_n(&original_##funcname, original, __ATOMIC_RELAXED);                                                                              \
+        }                                                                                                                                                    \
+        return original;                                                                                                                                     \
+    }                                                                                                                                                        \
+    static hues_hook hues_hook_##funcname = { .name = #funcname, .message = trace_format, .sample_message = sample_format };                                 \
+    static __attribute__((noinline)) void hooked_##funcname(hues_code_location location HUES_HOOK_PARAMETERS_TAIL(__VA_ARGS__))                              \
+    {                                                                                                                                                        \
+        uint64_t hues_hook_start = hues_hook_enter(&hues_hook_##funcname);                                                                                   \
+        hues_arguments hues_hook_arguments;                                                                                                                  \
+        hues_hook_arguments.length = 0;                                                                                                                      \
+        int hues_hook_captured = capture##_ANY && hues_hook_start != HUES_HOOK_COUNTED                                                                       \
+            && !(__atomic_load_n(&hues_glob_hook_mode, __ATOMIC_RELAXED) & HUES_HOOK_PROFILING);                                                             \
+        if (hues_hook_captured) {                                                                                                                            \
+            capture(&hues_hook_arguments, ##__VA_ARGS__)                                                                                                     \
+        }                                                                                                                                                    \
+        if (hues_hook_start == HUES_HOOK_TRACE && !capture##_ANY) {                                                                                          \
+            hues_log(&(hues_message) { TRACE, .contents = trace_format, .location = location }, TRACE, location, location);                                  \
+        }                                                                                                                                                    \
+        hues_hook_original_##funcname()(HUES_HOOK_ARGUMENTS(__VA_ARGS__));                                                                                   \
+        uint64_t hues_hook_latency = hues_hook_exit(&hues_hook_##funcname, hues_hook_start);                                                                 \
+        if (hues_hook_start == HUES_HOOK_TRACE && capture##_ANY) {                                                                                           \
+            hues_log(&(hues_message) { TRACE, .contents = trace_format, .location = location, .arguments = hues_hook_arguments.data,                         \
+                                       .arguments_length = hues_hook_arguments.length }, TRACE, location, location);                                         \
+        }                                                                                                                                                    \
+        if (hues_hook_latency != 0) {                                                                                                                        \
+            hues_log(&(hues_message) { TRACE, .contents = sample_format, .location = location, .arguments = hues_hook_arguments.data,                        \
+                                       .arguments_length = hues_hook_arguments.length }, TRACE, location, location, (unsigned long long) hues_hook_latency); \
+        }                                                                                                                                                    \
+    }                                                                                                                                                        \
+    void funcname(HUES_HOOK_PARAMETERS(__VA_ARGS__))                                                                                                         \
+    {                                                                                                                                                        \
+        if (__builtin_expect(__atomic_load_n(&hues_glob_hook_mode, __ATOMIC_RELAXED) == 0, 1)) {                                                             \
+            hues_hook_original_##funcname()(HUES_HOOK_ARGUMENTS(__VA_ARGS__));                                                                               \
+            return;                                                                                                                                          \
+        }                                                                                                                                                    \
+        hooked_##funcname(CODE_LOC HUES_HOOK_ARGUMENTS_TAIL(__VA_ARGS__));                                                                                   \
     }
 
+/**
+ * @def HUES_HOOK(funcname, ret_type, ...)
+ * @brief Hooks a function returning a value.
+ * @param funcname The name of the function.
+ * @param ret_type The return type of the function.
+ * @param ... The types of the parameters of the function, up to 16.
+ */
+#define HUES_HOOK(funcname, ret_type, ...) HUES_HOOK_DEFINE(funcname, ret_type, "'" #funcname "' called at #c\n", "'" #funcname "' called at #c took %llu ns\n", HUES_HOOK_CAPTURE_NONE, ##__VA_ARGS__)
+
+/**
+ * @def HUES_HOOK_VOID(funcname, ...)
+ * @brief Hooks a function returning nothing.
+ * @param funcname The name of the function.
+ * @param ... The types of the parameters of the function, up to 16.
+ */
+#define HUES_HOOK_VOID(funcname, ...) HUES_HOOK_DEFINE_VOID(funcname, "'" #funcname "' called at #c\n", "'" #funcname "' called at #c took %llu ns\n", HUES_HOOK_CAPTURE_NONE, ##__VA_ARGS__)
+
+/**
+ * @def HUES_HOOK_CAPTURE(funcname, ret_type, ...)
+ * @brief Hooks a function returning a value, tracing its arguments and the value returned too, such as
+ * "'rename' called at main.c:12 with ("app.log", "app.log.1") returned 0". They are captured by type with HUES_ARGUMENT_ADD.
+ * @param funcname The name of the function.
+ * @param ret_type The return type of the function.
+ * @param ... The types of the parameters of the function, up to 16.
+ */
+#define HUES_HOOK_CAPTURE(funcname, ret_type, ...) HUES_HOOK_DEFINE(funcname, ret_type, "'" #funcname "' called at #c\n", "'" #funcname "' called at #c took %llu ns\n", HUES_HOOK_CAPTURE_ALL, ##__VA_ARGS__)
+
+/**
+ * @def HUES_HOOK_CAPTURE_VOID(funcname, ...)
+ * @brief Hooks a function returning nothing, tracing its arguments too.
+ * @param funcname The name of the function.
+ * @param ... The types of the parameters of the function, up to 16.
+ */
+#define HUES_HOOK_CAPTURE_VOID(funcname, ...) HUES_HOOK_DEFINE_VOID(funcname, "'" #funcname "' called at #c\n", "'" #funcname "' called at #c took %llu ns\n", HUES_HOOK_CAPTURE_ALL, ##__VA_ARGS__)
+
+// Former names of the hook macros, by number of arguments
+#define HOOK_FUNCTION_0_ARG_VOID(funcname) HUES_HOOK_VOID(funcname)
+#define HOOK_FUNCTION_0_ARG(funcname, ret_type) HUES_HOOK(funcname, ret_type)
+#define HOOK_FUNCTION_1_ARG_VOID(funcname, arg_type) HUES_HOOK_VOID(funcname, arg_type)
+#define HOOK_FUNCTION_1_ARG(funcname, ret_type, arg_type) HUES_HOOK(funcname, ret_type, arg_type)
+#define HOOK_FUNCTION_2_ARG_VOID(funcname, arg_type1, arg_type2) HUES_HOOK_VOID(funcname, arg_type1, arg_type2)
+#define HOOK_FUNCTION_2_ARG(funcname, ret_type, arg_type1, arg_type2) HUES_HOOK(funcname, ret_type, arg_type1, arg_type2)
+#define HOOK_FUNCTION_3_ARG_VOID(funcname, arg_type1, arg_type2, arg_type3) HUES_HOOK_VOID(funcname, arg_type1, arg_type2, arg_type3)
+#define HOOK_FUNCTION_3_ARG(funcname, ret_type, arg_type1, arg_type2, arg_type3) HUES_HOOK(funcname, ret_type, arg_type1, arg_type2, arg_type3)
+#define HOOK_FUNCTION_4_ARG_VOID(funcname, arg_type1, arg_type2, arg_type3, arg_type4) HUES_HOOK_VOID(funcname, arg_type1, arg_type2, arg_type3, arg_type4)
+#define HOOK_FUNCTION_4_ARG(funcname, ret_type, arg_type1, arg_type2, arg_type3, arg_type4) HUES_HOOK(funcname, ret_type, arg_type1, arg_type2, arg_type3, arg_type4)
+#define HOOK_FUNCTION_5_ARG_VOID(funcname, arg_type1, arg_type2, arg_type3, arg_type4, arg_type5) \
+    HUES_HOOK_VOID(funcname, arg_type1, arg_type2, arg_type3, arg_type4, arg_type5)
+#define HOOK_FUNCTION_5_ARG(funcname, ret_type, arg_type1, arg_type2, arg_type3, arg_type4, arg_type5) \
+    HUES_HOOK(funcname, ret_type, arg_type1, arg_type2, arg_type3, arg_type4, arg_type5)
+
 #endif // LOG_H__
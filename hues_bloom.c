@@ -0,0 +1,130 @@
+/**
+ * @file hues_bloom.c
+ * @brief Bloom filters of the tokens of log records, ending rotated segments
+ */
+
+#include "hues.h"
+
+/**
+ * @def HUES_BLOOM_MINIMUM_BITS
+ * @brief Number of bits below which a bloom filter is not folded.
+ */
+#define HUES_BLOOM_MINIMUM_BITS 512
+
+int hues_token_character(char character) {
+    return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') || (character >= '0' && character <= '9')
+        || character == '_' || character == '-';
+}
+
+/**
+ * @fn static uint64_t hues_bloom_hash(const char* token, size_t length)
+ * @brief Hashes a token with FNV-1a, its bits then mixed as in MurmurHash3 so that both halves are usable.
+ * @param token The token.
+ * @param length The length of the token.
+ * @return The hash.
+ */
+static uint64_t hues_bloom_hash(const char* token, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t) token[i]) * 0x100000001b3ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * @fn static const char* hues_bloom_next_token(const char** cursor, const char* end, size_t* length)
+ * @brief Finds the next token of a text long enough to be in a bloom filter.
+ * @param cursor The position to search from, advanced past the token.
+ * @param end The end of the text.
+ * @param length Receives the length of the token.
+ * @return The token, or NULL if there is none left.
+ */
+static const char* hues_bloom_next_token(const char** cursor, const char* end, size_t* length) {
+    const char* position = *cursor;
+    while (position < end) {
+        while (position < end && !hues_token_character(*position)) {
+            position++;
+        }
+        const char* token = position;
+        while (position < end && hues_token_character(*position)) {
+            position++;
+        }
+        if (position - token >= HUES_BLOOM_MINIMUM_TOKEN) {
+            *cursor = position;
+            *length = position - token;
+            return token;
+        }
+    }
+    *cursor = end;
+    return NULL;
+}
+
+void hues_bloom_add(uint64_t* filter, uint64_t bits, const char* text, size_t length) {
+    const char* cursor = text;
+    const char* end = text + length;
+    const char* token;
+    size_t token_length;
+    while ((token = hues_bloom_next_token(&cursor, end, &token_length)) != NULL) {
+        uint64_t hash = hues_bloom_hash(token, token_length);
+        uint64_t step = (hash >> 32) | 1;
+        for (int i = 0; i < HUES_BLOOM_HASHES; i++) {
+            uint64_t bit = (hash + i * step) & (bits - 1);
+            filter[bit / 64] |= 1ull << (bit % 64);
+        }
+    }
+}
+
+int hues_bloom_may_contain(const uint64_t* filter, uint64_t bits, const char* text, size_t length) {
+    const char* cursor = text;
+    const char* end = text + length;
+    const char* token;
+    size_t token_length;
+    while ((token = hues_bloom_next_token(&cursor, end, &token_length)) != NULL) {
+        uint64_t hash = hues_bloom_hash(token, token_length);
+        uint64_t step = (hash >> 32) | 1;
+        for (int i = 0; i < HUES_BLOOM_HASHES; i++) {
+            uint64_t bit = (hash + i * step) & (bits - 1);
+            if ((filter[bit / 64] & (1ull << (bit % 64))) == 0) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+uint64_t hues_bloom_fold(uint64_t* filter, uint64_t bits) {
+    // Bits are picked modulo a power of two: bit b of a filter is bit b mod bits/2 of the folded filter
+    while (bits > HUES_BLOOM_MINIMUM_BITS) {
+        uint64_t words = bits / 128;
+        uint64_t set = 0;
+        for (uint64_t i = 0; i < words; i++) {
+            set += __builtin_popcountll(filter[i] | filter[i + words]);
+        }
+        if (set > bits / 4) {
+            break;
+        }
+        for (uint64_t i = 0; i < words; i++) {
+            filter[i] |= filter[i + words];
+        }
+        bits /= 2;
+    }
+    return bits;
+}
+
+const hues_bloom_footer* hues_bloom_footer_find(const void* segment, size_t size) {
+    if (size < sizeof(hues_bloom_footer) || size % 8 != 0) {
+        return NULL;
+    }
+    const hues_bloom_footer* footer = (const hues_bloom_footer*) ((const char*) segment + size - sizeof(hues_bloom_footer));
+    if (footer->magic != HUES_BLOOM_MAGIC || footer->size > size || footer->bits < 64 || (footer->bits & (footer->bits - 1)) != 0
+        || footer->size != footer->bits / 8 + sizeof(hues_bloom_footer)) {
+        return NULL;
+    }
+    const char* filter = (const char*) footer - footer->bits / 8;
+    return hues_checksum(filter, footer->bits / 8, 0) == footer->checksum ? footer : NULL;
+}
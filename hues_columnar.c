@@ -0,0 +1,614 @@
+/**
+ * @file hues_columnar.c
+ * @brief Columnar log archives, for analytics over past records
+ */
+
+#include "hues.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @def HUES_COLUMNAR_VARINT_SIZE
+ * @brief Maximum size of a varint.
+ */
+#define HUES_COLUMNAR_VARINT_SIZE 10
+
+/**
+ * @struct hues_columnar_column
+ * @brief Represents a column of variable size of the row group being filled.
+ */
+typedef struct {
+    uint8_t* data;  /**< Encoded values. */
+    size_t size;  /**< Size of the encoded values. */
+    size_t capacity;  /**< Capacity of the buffer. */
+} hues_columnar_column;
+
+/**
+ * @struct hues_columnar_writer
+ * @brief Represents a columnar log archive being written, one row group at a time.
+ */
+struct hues_columnar_writer {
+    int fd;  /**< Descriptor of the archive. */
+    uint64_t offset;  /**< Size of the archive so far. */
+    uint32_t groups_count;  /**< Number of row groups written. */
+    size_t rows;  /**< Number of records in the row group being filled. */
+    uint64_t* timestamps;  /**< Timestamps of the row group. */
+    uint64_t* sequences;  /**< Sequence numbers of the row group. */
+    uint8_t* levels;  /**< Levels of the row group. */
+    uint32_t* callsites;  /**< Callsite codes of the row group. */
+    uint32_t* text_lengths;  /**< Text lengths of the row group. */
+    char* text;  /**< Texts of the row group. */
+    size_t text_size;  /**< Size of the texts. */
+    size_t text_capacity;  /**< Capacity of the text buffer. */
+    uint32_t* value_counts;  /**< Numbers of values captured for the records of the row group. */
+    hues_columnar_column value_types;  /**< Types of the captured values of the row group. */
+    hues_columnar_column integers;  /**< Captured integers and pointers of the row group, as varints. */
+    hues_columnar_column doubles;  /**< Captured doubles of the row group. */
+    hues_columnar_column strings;  /**< Captured strings of the row group, each a length byte followed by its characters. */
+    char** names;  /**< Callsites of the dictionary. */
+    uint32_t* name_lengths;  /**< Lengths of the callsites. */
+    uint32_t names_count;  /**< Number of callsites. */
+    uint32_t names_capacity;  /**< Capacity of the callsite arrays. */
+    uint32_t* table;  /**< Open addressing table of callsite codes plus one, 0 for an empty slot. */
+    size_t table_capacity;  /**< Number of slots of the table, a power of two. */
+};
+
+static size_t hues_columnar_put_varint(uint8_t* output, uint64_t value) {
+    size_t size = 0;
+    while (value >= 0x80) {
+        output[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    output[size++] = (uint8_t) value;
+    return size;
+}
+
+/**
+ * @fn static int hues_columnar_get_varint(const uint8_t** input, const uint8_t* end, uint64_t* value)
+ * @brief Reads a varint.
+ * @param input The position to read at, advanced past the varint.
+ * @param end The end of the column.
+ * @param value Receives the value.
+ * @return 0 on success, -1 if the varint is truncated or too long.
+ */
+static int hues_columnar_get_varint(const uint8_t** input, const uint8_t* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && *input < end; shift += 7) {
+        uint8_t byte = *(*input)++;
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static uint64_t hues_columnar_zigzag(uint64_t previous, uint64_t value) {
+    int64_t delta = (int64_t) (value - previous);
+    return ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+}
+
+static uint64_t hues_columnar_unzigzag(uint64_t previous, uint64_t zigzag) {
+    return previous + ((zigzag >> 1) ^ -(zigzag & 1));
+}
+
+static uint64_t hues_columnar_hash(const char* name, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t) name[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * @fn static uint8_t* hues_columnar_column_reserve(hues_columnar_column* column, size_t size)
+ * @brief Makes room at the end of a column.
+ * @param column The column.
+ * @param size The number of bytes to make room for.
+ * @return The end of the column.
+ */
+static uint8_t* hues_columnar_column_reserve(hues_columnar_column* column, size_t size) {
+    if (column->size + size > column->capacity) {
+        column->capacity = column->capacity > 0 ? column->capacity : 4096;
+        while (column->size + size > column->capacity) {
+            column->capacity *= 2;
+        }
+        column->data = realloc(column->data, column->capacity);
+    }
+    return column->data + column->size;
+}
+
+/**
+ * @fn static uint8_t* hues_columnar_column_copy(uint8_t* output, hues_columnar_column* column)
+ * @brief Copies a column into a row group and empties it.
+ * @param output The position of the column in the row group.
+ * @param column The column.
+ * @return The end of the column in the row group.
+ */
+static uint8_t* hues_columnar_column_copy(uint8_t* output, hues_columnar_column* column) {
+    if (column->size > 0) {
+        memcpy(output, column->data, column->size);
+    }
+    output += column->size;
+    column->size = 0;
+    return output;
+}
+
+static int hues_columnar_write_fully(int fd, const void* data, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t written = write(fd, (const char*) data + offset, size - offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        offset += written;
+    }
+    return 0;
+}
+
+/**
+ * @fn static uint32_t hues_columnar_callsite(hues_columnar_writer* writer, const char* name, size_t length)
+ * @brief Looks up the code of a callsite in the dictionary of an archive, adding it if it is new.
+ * @param writer The writer.
+ * @param name The callsite.
+ * @param length The length of the callsite.
+ * @return The code of the callsite.
+ */
+static uint32_t hues_columnar_callsite(hues_columnar_writer* writer, const char* name, size_t length) {
+    if (2 * (writer->names_count + 1) > writer->table_capacity) {
+        // Keep the table at most half full
+        free(writer->table);
+        writer->table_capacity *= 2;
+        writer->table = calloc(writer->table_capacity, sizeof(uint32_t));
+        for (uint32_t code = 0; code < writer->names_count; code++) {
+            size_t slot = hues_columnar_hash(writer->names[code], writer->name_lengths[code]) & (writer->table_capacity - 1);
+            while (writer->table[slot] != 0) {
+                slot = (slot + 1) & (writer->table_capacity - 1);
+            }
+            writer->table[slot] = code + 1;
+        }
+    }
+    size_t slot = hues_columnar_hash(name, length) & (writer->table_capacity - 1);
+    while (writer->table[slot] != 0) {
+        uint32_t code = writer->table[slot] - 1;
+        if (writer->name_lengths[code] == length && memcmp(writer->names[code], name, length) == 0) {
+            return code;
+        }
+        slot = (slot + 1) & (writer->table_capacity - 1);
+    }
+    if (writer->names_count == writer->names_capacity) {
+        writer->names_capacity *= 2;
+        writer->names = realloc(writer->names, writer->names_capacity * sizeof(char*));
+        writer->name_lengths = realloc(writer->name_lengths, writer->names_capacity * sizeof(uint32_t));
+    }
+    uint32_t code = writer->names_count++;
+    writer->names[code] = malloc(length + 1);
+    memcpy(writer->names[code], name, length);
+    writer->name_lengths[code] = length;
+    writer->table[slot] = code + 1;
+    return code;
+}
+
+/**
+ * @fn static uint32_t hues_columnar_arguments_append(hues_columnar_writer* writer, const uint8_t* data, size_t length)
+ * @brief Adds the values captured for a record to the columns of their types, up to the first truncated or unknown one.
+ * @param writer The writer.
+ * @param data The captured values, as stored in the record.
+ * @param length The length of the captured values.
+ * @return The number of values added.
+ */
+static uint32_t hues_columnar_arguments_append(hues_columnar_writer* writer, const uint8_t* data, size_t length) {
+    uint32_t count = 0;
+    size_t offset = 0;
+    while (offset < length) {
+        uint8_t type = data[offset];
+        const uint8_t* value = data + offset + 1;
+        size_t available = length - offset - 1;
+        if (type == HUES_ARGUMENT_STRING || type == HUES_ARGUMENT_STRING_CUT) {
+            if (available < 1 || available - 1 < value[0]) {
+                break;
+            }
+            memcpy(hues_columnar_column_reserve(&writer->strings, 1 + value[0]), value, 1 + value[0]);
+            writer->strings.size += 1 + value[0];
+            offset += 2 + value[0];
+        } else if (type == HUES_ARGUMENT_RESULT) {
+            offset++;
+        } else if (type >= HUES_ARGUMENT_INT && type <= HUES_ARGUMENT_POINTER && available >= sizeof(uint64_t)) {
+            uint64_t number;
+            memcpy(&number, value, sizeof(number));
+            if (type == HUES_ARGUMENT_DOUBLE) {
+                memcpy(hues_columnar_column_reserve(&writer->doubles, sizeof(number)), &number, sizeof(number));
+                writer->doubles.size += sizeof(number);
+            } else {
+                number = type == HUES_ARGUMENT_INT ? hues_columnar_zigzag(0, number) : number;
+                writer->integers.size += hues_columnar_put_varint(hues_columnar_column_reserve(&writer->integers, HUES_COLUMNAR_VARINT_SIZE), number);
+            }
+            offset += 1 + sizeof(number);
+        } else {
+            break;
+        }
+        *hues_columnar_column_reserve(&writer->value_types, 1) = type;
+        writer->value_types.size++;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @fn static int hues_columnar_group_write(hues_columnar_writer* writer)
+ * @brief Encodes and writes the row group being filled, and starts a new one.
+ * @param writer The writer.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_columnar_group_write(hues_columnar_writer* writer) {
+    size_t rows = writer->rows;
+    if (rows == 0) {
+        return 0;
+    }
+    size_t capacity = sizeof(hues_columnar_group) + rows * (5 + 4 * HUES_COLUMNAR_VARINT_SIZE) + writer->text_size + writer->value_types.size
+        + writer->integers.size + writer->doubles.size + writer->strings.size + 8;
+    char* output = calloc(1, capacity);
+    hues_columnar_group* group = (hues_columnar_group*) output;
+    group->magic = HUES_COLUMNAR_MAGIC;
+    group->rows = rows;
+    group->first_timestamp = writer->timestamps[0];
+    group->first_sequence = writer->sequences[0];
+    group->minimum_timestamp = writer->timestamps[0];
+    group->maximum_timestamp = writer->timestamps[0];
+    char* columns = output + sizeof(hues_columnar_group);
+    memcpy(columns, writer->callsites, rows * sizeof(uint32_t));
+    memcpy(columns + rows * sizeof(uint32_t), writer->levels, rows);
+    uint8_t* cursor = (uint8_t*) columns + rows * 5;
+    uint8_t* start = cursor;
+    for (size_t i = 0; i < rows; i++) {
+        group->levels |= 1u << (writer->levels[i] & 31);
+        group->minimum_timestamp = writer->timestamps[i] < group->minimum_timestamp ? writer->timestamps[i] : group->minimum_timestamp;
+        group->maximum_timestamp = writer->timestamps[i] > group->maximum_timestamp ? writer->timestamps[i] : group->maximum_timestamp;
+        cursor += hues_columnar_put_varint(cursor, hues_columnar_zigzag(i > 0 ? writer->timestamps[i - 1] : group->first_timestamp, writer->timestamps[i]));
+    }
+    group->timestamps_size = cursor - start;
+    start = cursor;
+    for (size_t i = 0; i < rows; i++) {
+        cursor += hues_columnar_put_varint(cursor, hues_columnar_zigzag(i > 0 ? writer->sequences[i - 1] : group->first_sequence, writer->sequences[i]));
+    }
+    group->sequences_size = cursor - start;
+    start = cursor;
+    for (size_t i = 0; i < rows; i++) {
+        cursor += hues_columnar_put_varint(cursor, writer->text_lengths[i]);
+    }
+    group->lengths_size = cursor - start;
+    memcpy(cursor, writer->text, writer->text_size);
+    cursor += writer->text_size;
+    group->text_size = writer->text_size;
+    start = cursor;
+    for (size_t i = 0; i < rows; i++) {
+        cursor += hues_columnar_put_varint(cursor, writer->value_counts[i]);
+    }
+    group->counts_size = cursor - start;
+    group->values_count = writer->value_types.size;
+    group->integers_size = writer->integers.size;
+    group->doubles_size = writer->doubles.size;
+    group->strings_size = writer->strings.size;
+    cursor = hues_columnar_column_copy(cursor, &writer->value_types);
+    cursor = hues_columnar_column_copy(cursor, &writer->integers);
+    cursor = hues_columnar_column_copy(cursor, &writer->doubles);
+    cursor = hues_columnar_column_copy(cursor, &writer->strings);
+    group->checksum = hues_checksum(columns, (char*) cursor - columns, 0);
+    size_t size = HUES_COLUMNAR_GROUP_SIZE(group);
+    int result = hues_columnar_write_fully(writer->fd, output, size);
+    free(output);
+    writer->offset += size;
+    writer->groups_count++;
+    writer->rows = 0;
+    writer->text_size = 0;
+    return result;
+}
+
+hues_columnar_writer* hues_columnar_writer_open(const char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    hues_file_header header = { .magic = HUES_COLUMNAR_MAGIC, .version = HUES_COLUMNAR_VERSION };
+    if (fd < 0 || hues_columnar_write_fully(fd, &header, sizeof(header)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    hues_columnar_writer* writer = calloc(1, sizeof(hues_columnar_writer));
+    writer->fd = fd;
+    writer->offset = sizeof(header);
+    writer->timestamps = malloc(HUES_COLUMNAR_GROUP_ROWS * sizeof(uint64_t));
+    writer->sequences = malloc(HUES_COLUMNAR_GROUP_ROWS * sizeof(uint64_t));
+    writer->levels = malloc(HUES_COLUMNAR_GROUP_ROWS);
+    writer->callsites = malloc(HUES_COLUMNAR_GROUP_ROWS * sizeof(uint32_t));
+    writer->text_lengths = malloc(HUES_COLUMNAR_GROUP_ROWS * sizeof(uint32_t));
+    writer->text_capacity = 1024 * 1024;
+    writer->text = malloc(writer->text_capacity);
+    writer->value_counts = malloc(HUES_COLUMNAR_GROUP_ROWS * sizeof(uint32_t));
+    writer->names_capacity = 64;
+    writer->names = malloc(writer->names_capacity * sizeof(char*));
+    writer->name_lengths = malloc(writer->names_capacity * sizeof(uint32_t));
+    writer->table_capacity = 128;
+    writer->table = calloc(writer->table_capacity, sizeof(uint32_t));
+    return writer;
+}
+
+int hues_columnar_writer_append(hues_columnar_writer* writer, const hues_record_header* header) {
+    if (header->flags & HUES_RECORD_FLAG_PADDING) {
+        return 0;
+    }
+    const char* payload = (const char*) (header + 1);
+    size_t location_length = header->location_length <= header->length ? header->location_length : header->length;
+    size_t text_length;
+    size_t arguments_length;
+    const void* arguments = hues_record_arguments(header, &text_length, &arguments_length);
+    const char* text = payload + location_length;
+    size_t row = writer->rows;
+    writer->value_counts[row] = arguments != NULL ? hues_columnar_arguments_append(writer, arguments, arguments_length) : 0;
+    writer->timestamps[row] = header->timestamp;
+    writer->sequences[row] = header->sequence;
+    writer->levels[row] = header->level;
+    writer->callsites[row] = hues_columnar_callsite(writer, payload, location_length);
+    writer->text_lengths[row] = text_length;
+    if (writer->text_size + text_length > writer->text_capacity) {
+        while (writer->text_size + text_length > writer->text_capacity) {
+            writer->text_capacity *= 2;
+        }
+        writer->text = realloc(writer->text, writer->text_capacity);
+    }
+    memcpy(writer->text + writer->text_size, text, text_length);
+    writer->text_size += text_length;
+    writer->rows++;
+    return writer->rows == HUES_COLUMNAR_GROUP_ROWS ? hues_columnar_group_write(writer) : 0;
+}
+
+int hues_columnar_writer_close(hues_columnar_writer* writer) {
+    int result = hues_columnar_group_write(writer);
+    size_t size = 0;
+    for (uint32_t code = 0; code < writer->names_count; code++) {
+        size += sizeof(uint32_t) + writer->name_lengths[code];
+    }
+    size = (size + 7) & ~(size_t) 7;
+    char* dictionary = calloc(1, size + sizeof(hues_columnar_footer));
+    char* cursor = dictionary;
+    for (uint32_t code = 0; code < writer->names_count; code++) {
+        memcpy(cursor, &writer->name_lengths[code], sizeof(uint32_t));
+        memcpy(cursor + sizeof(uint32_t), writer->names[code], writer->name_lengths[code]);
+        cursor += sizeof(uint32_t) + writer->name_lengths[code];
+        free(writer->names[code]);
+    }
+    hues_columnar_footer footer = {
+        .dictionary_offset = writer->offset,
+        .dictionary_count = writer->names_count,
+        .dictionary_checksum = hues_checksum(dictionary, size, 0),
+        .groups_count = writer->groups_count,
+        .magic = HUES_COLUMNAR_MAGIC
+    };
+    memcpy(dictionary + size, &footer, sizeof(footer));
+    result |= hues_columnar_write_fully(writer->fd, dictionary, size + sizeof(footer));
+    result |= close(writer->fd);
+    free(dictionary);
+    free(writer->table);
+    free(writer->name_lengths);
+    free(writer->names);
+    free(writer->strings.data);
+    free(writer->doubles.data);
+    free(writer->integers.data);
+    free(writer->value_types.data);
+    free(writer->value_counts);
+    free(writer->text);
+    free(writer->text_lengths);
+    free(writer->callsites);
+    free(writer->levels);
+    free(writer->sequences);
+    free(writer->timestamps);
+    free(writer);
+    return result != 0 ? -1 : 0;
+}
+
+hues_columnar_archive* hues_columnar_archive_open(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(hues_file_header) + sizeof(hues_columnar_footer)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    size_t size = status.st_size;
+    const char* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    const hues_file_header* header = (const hues_file_header*) mapping;
+    const hues_columnar_footer* footer = (const hues_columnar_footer*) (mapping + size - sizeof(hues_columnar_footer));
+    size_t dictionary_size = size - sizeof(hues_columnar_footer) - footer->dictionary_offset;
+    if (header->magic != HUES_COLUMNAR_MAGIC || header->version != HUES_COLUMNAR_VERSION || footer->magic != HUES_COLUMNAR_MAGIC
+        || footer->dictionary_offset < sizeof(hues_file_header) || footer->dictionary_offset > size - sizeof(hues_columnar_footer)
+        || hues_checksum(mapping + footer->dictionary_offset, dictionary_size, 0) != footer->dictionary_checksum) {
+        munmap((void*) mapping, size);
+        return NULL;
+    }
+    hues_columnar_archive* archive = malloc(sizeof(hues_columnar_archive));
+    archive->mapping = mapping;
+    archive->size = size;
+    archive->footer = footer;
+    archive->callsites = malloc((footer->dictionary_count + 1) * sizeof(char*));
+    archive->callsite_lengths = malloc((footer->dictionary_count + 1) * sizeof(uint32_t));
+    const char* cursor = mapping + footer->dictionary_offset;
+    const char* end = cursor + dictionary_size;
+    for (uint32_t code = 0; code < footer->dictionary_count; code++) {
+        uint32_t length = 0;
+        if ((size_t) (end - cursor) >= sizeof(uint32_t)) {
+            memcpy(&length, cursor, sizeof(uint32_t));
+        }
+        if ((size_t) (end - cursor) < sizeof(uint32_t) + length) {
+            hues_columnar_archive_close(archive);
+            return NULL;
+        }
+        archive->callsites[code] = cursor + sizeof(uint32_t);
+        archive->callsite_lengths[code] = length;
+        cursor += sizeof(uint32_t) + length;
+    }
+    return archive;
+}
+
+const hues_columnar_group* hues_columnar_archive_next(const hues_columnar_archive* archive, const hues_columnar_group* group) {
+    size_t offset = group == NULL ? sizeof(hues_file_header) : (size_t) ((const char*) group - archive->mapping) + HUES_COLUMNAR_GROUP_SIZE(group);
+    size_t end = archive->footer->dictionary_offset;
+    if (offset + sizeof(hues_columnar_group) > end) {
+        return NULL;
+    }
+    group = (const hues_columnar_group*) (archive->mapping + offset);
+    if (group->magic != HUES_COLUMNAR_MAGIC || group->rows == 0 || group->rows > HUES_COLUMNAR_GROUP_ROWS || HUES_COLUMNAR_GROUP_SIZE(group) > end - offset) {
+        return NULL;
+    }
+    return group;
+}
+
+/**
+ * @fn static int hues_columnar_decode_arguments(const hues_columnar_group* group, hues_columnar_rows* rows, const uint8_t* cursor)
+ * @brief Decodes the columns of the values captured for the records of a row group, checked beforehand.
+ * @param group The group.
+ * @param rows The decoded columns.
+ * @param cursor The start of the column of the numbers of captured values.
+ * @return 0 on success, -1 if the columns are inconsistent.
+ */
+static int hues_columnar_decode_arguments(const hues_columnar_group* group, hues_columnar_rows* rows, const uint8_t* cursor) {
+    size_t count = group->rows;
+    const uint8_t* end = cursor + group->counts_size;
+    rows->value_offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t values;
+        if (hues_columnar_get_varint(&cursor, end, &values) != 0 || values > group->values_count - rows->value_offsets[i]) {
+            return -1;
+        }
+        rows->value_offsets[i + 1] = rows->value_offsets[i] + values;
+    }
+    if (rows->value_offsets[count] != group->values_count) {
+        return -1;
+    }
+    if (group->values_count > rows->values_capacity) {
+        rows->values_capacity = group->values_count;
+        free(rows->values);
+        rows->values = malloc(rows->values_capacity * sizeof(uint64_t));
+    }
+    rows->value_types = end;
+    const uint8_t* integers = end + group->values_count;
+    const uint8_t* integers_end = integers + group->integers_size;
+    size_t doubles = 0;
+    const uint8_t* doubles_start = integers_end;
+    size_t strings = 0;
+    rows->strings = doubles_start + group->doubles_size;
+    for (uint32_t i = 0; i < group->values_count; i++) {
+        uint8_t type = rows->value_types[i];
+        uint64_t value = 0;
+        if (type == HUES_ARGUMENT_INT || type == HUES_ARGUMENT_UINT || type == HUES_ARGUMENT_POINTER) {
+            if (hues_columnar_get_varint(&integers, integers_end, &value) != 0) {
+                return -1;
+            }
+            value = type == HUES_ARGUMENT_INT ? hues_columnar_unzigzag(0, value) : value;
+        } else if (type == HUES_ARGUMENT_DOUBLE) {
+            if (group->doubles_size - doubles < sizeof(value)) {
+                return -1;
+            }
+            memcpy(&value, doubles_start + doubles, sizeof(value));
+            doubles += sizeof(value);
+        } else if (type == HUES_ARGUMENT_STRING || type == HUES_ARGUMENT_STRING_CUT) {
+            if (strings >= group->strings_size || group->strings_size - strings - 1 < rows->strings[strings]) {
+                return -1;
+            }
+            value = strings;
+            strings += 1 + rows->strings[strings];
+        } else if (type != HUES_ARGUMENT_RESULT) {
+            return -1;
+        }
+        rows->values[i] = value;
+    }
+    return 0;
+}
+
+int hues_columnar_decode(const hues_columnar_archive* archive, const hues_columnar_group* group, hues_columnar_rows* rows) {
+    const char* columns = (const char*) (group + 1);
+    size_t count = group->rows;
+    size_t size = count * 5 + group->timestamps_size + group->sequences_size + group->lengths_size + group->text_size + group->counts_size
+        + group->values_count + group->integers_size + group->doubles_size + group->strings_size;
+    if (hues_checksum(columns, size, 0) != group->checksum) {
+        return -1;
+    }
+    if (rows->timestamps == NULL) {
+        rows->timestamps = malloc(HUES_COLUMNAR_GROUP_ROWS * sizeof(uint64_t));
+        rows->sequences = malloc(HUES_COLUMNAR_GROUP_ROWS * sizeof(uint64_t));
+        rows->text_offsets = malloc((HUES_COLUMNAR_GROUP_ROWS + 1) * sizeof(uint32_t));
+        rows->value_offsets = malloc((HUES_COLUMNAR_GROUP_ROWS + 1) * sizeof(uint32_t));
+    }
+    rows->rows = count;
+    rows->callsites = (const uint32_t*) columns;
+    rows->levels = (const uint8_t*) columns + count * sizeof(uint32_t);
+    for (size_t i = 0; i < count; i++) {
+        if (rows->callsites[i] >= archive->footer->dictionary_count) {
+            return -1;
+        }
+    }
+    const uint8_t* cursor = rows->levels + count;
+    const uint8_t* end = cursor + group->timestamps_size;
+    uint64_t value = group->first_timestamp;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t zigzag;
+        if (hues_columnar_get_varint(&cursor, end, &zigzag) != 0) {
+            return -1;
+        }
+        value = rows->timestamps[i] = hues_columnar_unzigzag(value, zigzag);
+    }
+    end = cursor + group->sequences_size;
+    value = group->first_sequence;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t zigzag;
+        if (hues_columnar_get_varint(&cursor, end, &zigzag) != 0) {
+            return -1;
+        }
+        value = rows->sequences[i] = hues_columnar_unzigzag(value, zigzag);
+    }
+    end = cursor + group->lengths_size;
+    rows->text_offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t length;
+        if (hues_columnar_get_varint(&cursor, end, &length) != 0 || length > group->text_size - rows->text_offsets[i]) {
+            return -1;
+        }
+        rows->text_offsets[i + 1] = rows->text_offsets[i] + length;
+    }
+    rows->text = (const char*) end;
+    return hues_columnar_decode_arguments(group, rows, end + group->text_size);
+}
+
+size_t hues_columnar_arguments(const hues_columnar_rows* rows, size_t row, void* buffer, size_t size) {
+    uint8_t* output = buffer;
+    size_t length = 0;
+    for (uint32_t i = rows->value_offsets[row]; i < rows->value_offsets[row + 1]; i++) {
+        uint8_t type = rows->value_types[i];
+        int string = type == HUES_ARGUMENT_STRING || type == HUES_ARGUMENT_STRING_CUT;
+        size_t value_size = type == HUES_ARGUMENT_RESULT ? 0 : string ? 1 + (size_t) rows->strings[rows->values[i]] : sizeof(uint64_t);
+        if (size - length < 1 + value_size) {
+            break;
+        }
+        output[length] = type;
+        memcpy(output + length + 1, string ? (const void*) (rows->strings + rows->values[i]) : (const void*) &rows->values[i], value_size);
+        length += 1 + value_size;
+    }
+    return length;
+}
+
+void hues_columnar_archive_close(hues_columnar_archive* archive) {
+    munmap((void*) archive->mapping, archive->size);
+    free(archive->callsite_lengths);
+    free(archive->callsites);
+    free(archive);
+}
@@ -0,0 +1,1177 @@
+/**
+ * @file hues_file.c
+ * @brief Log files with buffered writes and size-based rotation
+ */
+
+#define _GNU_SOURCE  // O_DIRECT
+
+#include "hues.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/**
+ * @def HUES_FILE_BUFFER_SIZE
+ * @brief Size of the output buffer of a log file, written with a single write(2) when full or flushed.
+ */
+#define HUES_FILE_BUFFER_SIZE (256 * 1024)
+
+/**
+ * @def HUES_FILE_BLOCK_SIZE
+ * @brief Amount of records compressed together into a block, unless a single record is larger.
+ * Matches the window of the LZ4 format, beyond which larger blocks barely compress better.
+ */
+#define HUES_FILE_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @def HUES_FILE_LOCATION_BOUND
+ * @brief Upper bound of the size taken by the code location in a binary record.
+ */
+#define HUES_FILE_LOCATION_BOUND 256
+
+/**
+ * @def HUES_FILE_DIRECT_ALIGNMENT
+ * @brief Alignment of the offsets, sizes and memory of the writes to a file opened with O_DIRECT.
+ * Matches the logical block size of common devices, and the page size.
+ */
+#define HUES_FILE_DIRECT_ALIGNMENT 4096
+
+/**
+ * @def HUES_FILE_DIRECT_SIZE
+ * @brief Size of each of the two buffers of a file written with O_DIRECT.
+ */
+#define HUES_FILE_DIRECT_SIZE (1024 * 1024)
+
+/**
+ * @struct hues_file_direct
+ * @brief Represents the double buffering of a log file written with O_DIRECT, bypassing the page cache.
+ * One buffer fills while the other is written by a dedicated thread. A partial last block is written padded
+ * with zeros, then the file is truncated back to its real size: the block is written again once it fills.
+ */
+typedef struct {
+    char* buffers[2];  /**< Buffers, aligned to HUES_FILE_DIRECT_ALIGNMENT. */
+    size_t filling;  /**< Index of the buffer filling. */
+    size_t used;  /**< Number of bytes in the buffer filling. */
+    size_t written;  /**< Number of bytes of the buffer filling already written, as part of a padded block. */
+    uint64_t offset;  /**< Offset in the live segment of the buffer filling, aligned. */
+    int fd;  /**< Descriptor written by the in-flight write. */
+    const char* flight;  /**< Buffer written by the in-flight write, NULL if none. */
+    size_t flight_size;  /**< Size of the in-flight write, aligned. */
+    uint64_t flight_offset;  /**< Offset of the in-flight write. */
+    uint64_t flight_truncate;  /**< Size the live segment is truncated to after the in-flight write, 0 to leave it. */
+    int error;  /**< Whether a write failed since the last check. */
+    int stopping;  /**< Whether the thread must exit. */
+    pthread_t thread;  /**< Thread writing the buffers. */
+    pthread_mutex_t mutex;  /**< Protects the in-flight write. */
+    pthread_cond_t changed;  /**< Signaled when a write is submitted or completed. */
+} hues_file_direct;
+
+/**
+ * @enum hues_file_job_state
+ * @brief Enumerates the states of a compression job.
+ */
+typedef enum {
+    HUES_FILE_JOB_PENDING = 0,  /**< Submitted, waiting for or being compressed by a worker. */
+    HUES_FILE_JOB_DONE = 1,  /**< Compressed, waiting for its turn to be written. */
+} hues_file_job_state;
+
+/**
+ * @struct hues_file_job
+ * @brief Represents a chunk of records compressed by a worker of a compression pipeline.
+ */
+typedef struct {
+    char* data;  /**< Records to compress, swapped with the output buffer of the file on submission. */
+    size_t size;  /**< Size of the records. */
+    char* block;  /**< Compressed block. */
+    size_t block_size;  /**< Size taken by the compressed block. */
+    hues_index_entry chunk;  /**< Index statistics of the records. */
+    hues_file_job_state state;  /**< State of the job. */
+} hues_file_job;
+
+/**
+ * @struct hues_file_pipeline
+ * @brief Represents a pool of workers compressing the chunks of a log file in parallel.
+ * Jobs live in a ring indexed by their submission number, which doubles as a reorder buffer:
+ * workers complete them in any order, and they are written strictly in submission order.
+ */
+typedef struct {
+    hues_file_job* jobs;  /**< Ring of jobs. */
+    size_t jobs_count;  /**< Number of jobs in the ring. */
+    uint64_t submitted;  /**< Number of jobs submitted. */
+    uint64_t taken;  /**< Number of jobs taken by a worker. */
+    uint64_t written;  /**< Number of jobs written to the file. */
+    pthread_t* threads;  /**< Workers. */
+    size_t threads_count;  /**< Number of workers. */
+    int stopping;  /**< Whether the workers must exit. */
+    pthread_mutex_t mutex;  /**< Protects the counters and the job states. */
+    pthread_cond_t submission;  /**< Signaled when a job is submitted or the workers must exit. */
+    pthread_cond_t completion;  /**< Signaled when a job is compressed. */
+} hues_file_pipeline;
+
+/**
+ * @struct hues_file
+ * @brief Represents a log file open for appending.
+ */
+struct hues_file {
+    hues_file_options options;  /**< Options of the file, with its own copy of the path. */
+    char* directory;  /**< Directory holding the segments. */
+    const char* name;  /**< File name of the live segment, inside the path copy. */
+    int fd;  /**< Descriptor of the live segment. */
+    char* buffer;  /**< Pending output, aligned to 8 bytes. */
+    size_t used;  /**< Number of pending bytes. */
+    char* block;  /**< Compressed block of the pending output, NULL if the file is not compressed. */
+    hues_file_pipeline* pipeline;  /**< Workers compressing the blocks, NULL to compress them on the flushing thread. */
+    int pipeline_error;  /**< Whether writing a block compressed by the workers failed since the last check. */
+    hues_file_direct* direct;  /**< Double buffering of the output, NULL unless the file bypasses the page cache. */
+    uint64_t size;  /**< Size of the live segment, pending output included. */
+    uint64_t emitted;  /**< Size of the live segment, pending output excluded. */
+    int index_fd;  /**< Descriptor of the sidecar index of the live segment, -1 if the file has no index. */
+    hues_index_entry chunk;  /**< Index statistics of the records of the pending output. */
+    hues_index_entry entry;  /**< Index entry growing with each output, written once it covers the index interval. */
+    uint64_t* bloom;  /**< Token bloom filter of the live segment, NULL if the file has none. */
+    uint64_t bloom_bits;  /**< Number of bits of the bloom filter before it is folded. */
+    int bloom_complete;  /**< Whether the bloom filter holds every record of the live segment, which it does not after appending to a segment of a previous run. */
+    uint64_t last_segment;  /**< Number of the most recent rotated segment, 0 if none. */
+    pthread_mutex_t mutex;  /**< Serializes the writers. */
+};
+
+/**
+ * @fn static int hues_file_write_fully(int fd, const char* data, size_t size)
+ * @brief Writes a buffer to a file, retrying after partial writes.
+ * @param fd The file descriptor.
+ * @param data The buffer.
+ * @param size The size of the buffer.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_write_fully(int fd, const char* data, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t written = write(fd, data + offset, size - offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        offset += written;
+    }
+    return 0;
+}
+
+/**
+ * @fn static void* hues_file_direct_run(void* argument)
+ * @brief Writes the buffers of a file bypassing the page cache as they are submitted.
+ * @param argument The double buffering.
+ * @return NULL.
+ */
+static void* hues_file_direct_run(void* argument) {
+    hues_file_direct* direct = argument;
+    pthread_mutex_lock(&direct->mutex);
+    while (1) {
+        while (direct->flight == NULL && !direct->stopping) {
+            pthread_cond_wait(&direct->changed, &direct->mutex);
+        }
+        if (direct->flight == NULL) {
+            break;
+        }
+        pthread_mutex_unlock(&direct->mutex);
+        int error = 0;
+        size_t offset = 0;
+        while (offset < direct->flight_size) {
+            ssize_t written = pwrite(direct->fd, direct->flight + offset, direct->flight_size - offset, direct->flight_offset + offset);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                error = 1;
+                break;
+            }
+            offset += written;
+        }
+        if (direct->flight_truncate > 0 && ftruncate(direct->fd, direct->flight_truncate) != 0) {
+            error = 1;
+        }
+        pthread_mutex_lock(&direct->mutex);
+        direct->error |= error;
+        direct->flight = NULL;
+        pthread_cond_broadcast(&direct->changed);
+    }
+    pthread_mutex_unlock(&direct->mutex);
+    return NULL;
+}
+
+/**
+ * @fn static int hues_file_direct_wait(hues_file_direct* direct)
+ * @brief Waits for the in-flight write of a file bypassing the page cache.
+ * @param direct The double buffering.
+ * @return 0 on success, -1 if a write failed since the last check.
+ */
+static int hues_file_direct_wait(hues_file_direct* direct) {
+    pthread_mutex_lock(&direct->mutex);
+    while (direct->flight != NULL) {
+        pthread_cond_wait(&direct->changed, &direct->mutex);
+    }
+    int result = direct->error ? -1 : 0;
+    direct->error = 0;
+    pthread_mutex_unlock(&direct->mutex);
+    return result;
+}
+
+/**
+ * @fn static int hues_file_direct_submit(hues_file* file, size_t size, uint64_t truncate)
+ * @brief Hands the buffer filling to the thread of a file bypassing the page cache, and switches to the other buffer.
+ * The partial last block of the buffer, if any, is copied to the other buffer to be written again once it fills.
+ * @param file The file, locked.
+ * @param size The number of bytes to write, aligned.
+ * @param truncate The size to truncate the live segment to after the write, 0 to leave it.
+ * @return 0 on success, -1 if a write failed since the last check.
+ */
+static int hues_file_direct_submit(hues_file* file, size_t size, uint64_t truncate) {
+    hues_file_direct* direct = file->direct;
+    int result = hues_file_direct_wait(direct);
+    char* buffer = direct->buffers[direct->filling];
+    char* next = direct->buffers[1 - direct->filling];
+    size_t written = direct->used & ~(size_t) (HUES_FILE_DIRECT_ALIGNMENT - 1);
+    memcpy(next, buffer + written, direct->used - written);
+    pthread_mutex_lock(&direct->mutex);
+    direct->fd = file->fd;
+    direct->flight = buffer;
+    direct->flight_size = size;
+    direct->flight_offset = direct->offset;
+    direct->flight_truncate = truncate;
+    pthread_cond_broadcast(&direct->changed);
+    pthread_mutex_unlock(&direct->mutex);
+    direct->filling = 1 - direct->filling;
+    direct->offset += written;
+    direct->used -= written;
+    direct->written = direct->used;
+    return result;
+}
+
+/**
+ * @fn static int hues_file_direct_sync(hues_file* file)
+ * @brief Submits the buffered output of a file bypassing the page cache, its partial last block padded with zeros.
+ * @param file The file, locked.
+ * @return 0 on success, -1 if a write failed since the last check.
+ */
+static int hues_file_direct_sync(hues_file* file) {
+    hues_file_direct* direct = file->direct;
+    if (direct->used == direct->written) {
+        return 0;
+    }
+    if (direct->used % HUES_FILE_DIRECT_ALIGNMENT == 0) {
+        return direct->used > 0 ? hues_file_direct_submit(file, direct->used, 0) : 0;
+    }
+    size_t size = (direct->used + HUES_FILE_DIRECT_ALIGNMENT - 1) & ~(size_t) (HUES_FILE_DIRECT_ALIGNMENT - 1);
+    memset(direct->buffers[direct->filling] + direct->used, 0, size - direct->used);
+    return hues_file_direct_submit(file, size, direct->offset + direct->used);
+}
+
+/**
+ * @fn static int hues_file_emit(hues_file* file, const char* data, size_t size)
+ * @brief Writes bytes to the live segment of a log file, through the double buffering if it bypasses the page cache.
+ * @param file The file, locked.
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_emit(hues_file* file, const char* data, size_t size) {
+    file->emitted += size;
+    hues_file_direct* direct = file->direct;
+    if (direct == NULL) {
+        return hues_file_write_fully(file->fd, data, size);
+    }
+    int result = 0;
+    while (size > 0) {
+        size_t length = HUES_FILE_DIRECT_SIZE - direct->used;
+        length = length < size ? length : size;
+        memcpy(direct->buffers[direct->filling] + direct->used, data, length);
+        direct->used += length;
+        data += length;
+        size -= length;
+        if (direct->used == HUES_FILE_DIRECT_SIZE) {
+            result |= hues_file_direct_submit(file, HUES_FILE_DIRECT_SIZE, 0);
+        }
+    }
+    return result;
+}
+
+/**
+ * @fn static hues_file_direct* hues_file_direct_start()
+ * @brief Allocates the buffers of a file bypassing the page cache and starts its writing thread.
+ * @return The double buffering, or NULL on error.
+ */
+static hues_file_direct* hues_file_direct_start() {
+    hues_file_direct* direct = malloc(sizeof(hues_file_direct));
+    direct->buffers[0] = aligned_alloc(HUES_FILE_DIRECT_ALIGNMENT, HUES_FILE_DIRECT_SIZE);
+    direct->buffers[1] = aligned_alloc(HUES_FILE_DIRECT_ALIGNMENT, HUES_FILE_DIRECT_SIZE);
+    direct->filling = 0;
+    direct->used = 0;
+    direct->written = 0;
+    direct->offset = 0;
+    direct->flight = NULL;
+    direct->error = 0;
+    direct->stopping = 0;
+    pthread_mutex_init(&direct->mutex, NULL);
+    pthread_cond_init(&direct->changed, NULL);
+    if (direct->buffers[0] == NULL || direct->buffers[1] == NULL || pthread_create(&direct->thread, NULL, hues_file_direct_run, direct) != 0) {
+        pthread_cond_destroy(&direct->changed);
+        pthread_mutex_destroy(&direct->mutex);
+        free(direct->buffers[0]);
+        free(direct->buffers[1]);
+        free(direct);
+        return NULL;
+    }
+    return direct;
+}
+
+/**
+ * @fn static void hues_file_direct_stop(hues_file_direct* direct)
+ * @brief Stops the writing thread of a file bypassing the page cache, once its in-flight write completes, and releases it.
+ * @param direct The double buffering.
+ */
+static void hues_file_direct_stop(hues_file_direct* direct) {
+    pthread_mutex_lock(&direct->mutex);
+    direct->stopping = 1;
+    pthread_cond_broadcast(&direct->changed);
+    pthread_mutex_unlock(&direct->mutex);
+    pthread_join(direct->thread, NULL);
+    pthread_cond_destroy(&direct->changed);
+    pthread_mutex_destroy(&direct->mutex);
+    free(direct->buffers[0]);
+    free(direct->buffers[1]);
+    free(direct);
+}
+
+/**
+ * @fn static void hues_file_index_merge(hues_index_entry* entry, const hues_index_entry* chunk)
+ * @brief Adds the records of a chunk to the statistics of an index entry.
+ * @param entry The entry.
+ * @param chunk The statistics of the chunk.
+ */
+static void hues_file_index_merge(hues_index_entry* entry, const hues_index_entry* chunk) {
+    if (chunk->count == 0) {
+        return;
+    }
+    if (entry->count == 0 || chunk->minimum_timestamp < entry->minimum_timestamp) {
+        entry->minimum_timestamp = chunk->minimum_timestamp;
+    }
+    if (entry->count == 0 || chunk->maximum_timestamp > entry->maximum_timestamp) {
+        entry->maximum_timestamp = chunk->maximum_timestamp;
+    }
+    entry->levels |= chunk->levels;
+    entry->count += chunk->count;
+}
+
+/**
+ * @fn static void hues_file_index_note(hues_file* file, uint8_t level, uint64_t timestamp)
+ * @brief Counts a record appended to the pending output of a log file in its index statistics.
+ * @param file The file, locked.
+ * @param level The level of the record.
+ * @param timestamp The timestamp of the record.
+ */
+static void hues_file_index_note(hues_file* file, uint8_t level, uint64_t timestamp) {
+    if (file->index_fd >= 0) {
+        hues_index_entry record = { .minimum_timestamp = timestamp, .maximum_timestamp = timestamp, .levels = 1u << (level & 31), .count = 1 };
+        hues_file_index_merge(&file->chunk, &record);
+    }
+}
+
+/**
+ * @fn static int hues_file_index_write(hues_file* file)
+ * @brief Writes the growing index entry of a log file to its sidecar index, and starts a new one.
+ * @param file The file, locked.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_index_write(hues_file* file) {
+    int result = 0;
+    if (file->entry.size > 0) {
+        result = hues_file_write_fully(file->index_fd, (const char*) &file->entry, sizeof(hues_index_entry));
+    }
+    memset(&file->entry, 0, sizeof(hues_index_entry));
+    return result;
+}
+
+/**
+ * @fn static int hues_file_index_add(hues_file* file, uint64_t offset, const hues_index_entry* chunk)
+ * @brief Adds an output just written to the growing index entry of a log file, writing the entry once it covers the index interval.
+ * @param file The file, locked.
+ * @param offset The offset of the output in the live segment, the output ending where the segment does.
+ * @param chunk The index statistics of the records of the output.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_index_add(hues_file* file, uint64_t offset, const hues_index_entry* chunk) {
+    if (file->index_fd < 0 || file->emitted == offset) {
+        return 0;
+    }
+    if (file->entry.size == 0) {
+        file->entry.offset = offset;
+    }
+    file->entry.size = file->emitted - file->entry.offset;
+    hues_file_index_merge(&file->entry, chunk);
+    return file->entry.size >= file->options.index_interval ? hues_file_index_write(file) : 0;
+}
+
+/**
+ * @fn static int hues_file_index_open(hues_file* file)
+ * @brief Opens the sidecar index of the live segment of a log file, writing the index header if it is new.
+ * @param file The file.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_index_open(hues_file* file) {
+    size_t path_length = strlen(file->options.path) + sizeof(HUES_INDEX_SUFFIX);
+    char* path = malloc(path_length);
+    snprintf(path, path_length, "%s%s", file->options.path, HUES_INDEX_SUFFIX);
+    file->index_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    free(path);
+    struct stat status;
+    if (file->index_fd < 0 || fstat(file->index_fd, &status) != 0) {
+        return -1;
+    }
+    if (status.st_size == 0) {
+        hues_index_header header = {
+            .magic = HUES_INDEX_MAGIC,
+            .version = HUES_INDEX_VERSION,
+            .interval = file->options.index_interval
+        };
+        return hues_file_write_fully(file->index_fd, (const char*) &header, sizeof(header));
+    }
+    return 0;
+}
+
+/**
+ * @fn static int hues_file_index_close(hues_file* file)
+ * @brief Writes the growing index entry of a log file, even if it covers less than the index interval, and closes its sidecar index.
+ * @param file The file, locked.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_index_close(hues_file* file) {
+    if (file->index_fd < 0) {
+        return 0;
+    }
+    int result = hues_file_index_write(file);
+    close(file->index_fd);
+    file->index_fd = -1;
+    return result;
+}
+
+/**
+ * @fn static void hues_file_bloom_note(hues_file* file, const char* text, size_t length)
+ * @brief Adds the tokens of a record appended to a log file to the bloom filter of its live segment.
+ * @param file The file, locked.
+ * @param text The text of the record.
+ * @param length The length of the text.
+ */
+static void hues_file_bloom_note(hues_file* file, const char* text, size_t length) {
+    if (file->bloom != NULL) {
+        hues_bloom_add(file->bloom, file->bloom_bits, text, length);
+    }
+}
+
+/**
+ * @fn static int hues_file_bloom_write(hues_file* file)
+ * @brief Ends the live segment of a log file with its folded bloom filter and footer, and clears the filter for the next segment.
+ * @param file The file, locked, its pending output written.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_bloom_write(hues_file* file) {
+    int result = 0;
+    if (file->bloom_complete) {
+        uint64_t bits = hues_bloom_fold(file->bloom, file->bloom_bits);
+        hues_bloom_footer footer = {
+            .bits = bits,
+            .hashes = HUES_BLOOM_HASHES,
+            .checksum = hues_checksum(file->bloom, bits / 8, 0),
+            .size = bits / 8 + sizeof(hues_bloom_footer),
+            .magic = HUES_BLOOM_MAGIC
+        };
+        result = hues_file_emit(file, (const char*) file->bloom, bits / 8);
+        result |= hues_file_emit(file, (const char*) &footer, sizeof(footer));
+    }
+    memset(file->bloom, 0, file->bloom_bits / 8);
+    return result;
+}
+
+/**
+ * @fn static void* hues_file_pipeline_run(void* argument)
+ * @brief Compresses the jobs of a pipeline as they are submitted.
+ * @param argument The pipeline.
+ * @return NULL.
+ */
+static void* hues_file_pipeline_run(void* argument) {
+    hues_file_pipeline* pipeline = argument;
+    pthread_mutex_lock(&pipeline->mutex);
+    while (1) {
+        while (pipeline->taken == pipeline->submitted && !pipeline->stopping) {
+            pthread_cond_wait(&pipeline->submission, &pipeline->mutex);
+        }
+        if (pipeline->taken == pipeline->submitted) {
+            break;
+        }
+        hues_file_job* job = &pipeline->jobs[pipeline->taken++ % pipeline->jobs_count];
+        pthread_mutex_unlock(&pipeline->mutex);
+        job->block_size = hues_block_encode(job->data, job->size, job->block, HUES_BLOCK_SIZE(HUES_FILE_BUFFER_SIZE));
+        pthread_mutex_lock(&pipeline->mutex);
+        job->state = HUES_FILE_JOB_DONE;
+        pthread_cond_broadcast(&pipeline->completion);
+    }
+    pthread_mutex_unlock(&pipeline->mutex);
+    return NULL;
+}
+
+/**
+ * @fn static void hues_file_pipeline_write(hues_file* file, uint64_t until)
+ * @brief Writes the compressed jobs of a pipeline in submission order, waiting for them to be compressed.
+ * @param file The file, locked.
+ * @param until The number of jobs that must be written on return, the jobs already compressed past it are written too.
+ */
+static void hues_file_pipeline_write(hues_file* file, uint64_t until) {
+    hues_file_pipeline* pipeline = file->pipeline;
+    pthread_mutex_lock(&pipeline->mutex);
+    while (pipeline->written < pipeline->submitted) {
+        hues_file_job* job = &pipeline->jobs[pipeline->written % pipeline->jobs_count];
+        if (job->state != HUES_FILE_JOB_DONE) {
+            if (pipeline->written >= until) {
+                break;
+            }
+            pthread_cond_wait(&pipeline->completion, &pipeline->mutex);
+            continue;
+        }
+        // Only the thread holding the file writes, and the slot is not reused before it is counted as written
+        pthread_mutex_unlock(&pipeline->mutex);
+        uint64_t offset = file->emitted;
+        if (hues_file_emit(file, job->block, job->block_size) != 0 || hues_file_index_add(file, offset, &job->chunk) != 0) {
+            file->pipeline_error = 1;
+        }
+        file->size += job->block_size - job->size;
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->written++;
+    }
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+/**
+ * @fn static int hues_file_pipeline_submit(hues_file* file)
+ * @brief Hands the pending output of a log file to the compression workers, and writes the blocks they completed.
+ * @param file The file, locked.
+ * @return 0 on success, -1 if writing a block failed since the last check.
+ */
+static int hues_file_pipeline_submit(hues_file* file) {
+    hues_file_pipeline* pipeline = file->pipeline;
+    if (file->used > 0) {
+        if (pipeline->submitted - pipeline->written == pipeline->jobs_count) {
+            hues_file_pipeline_write(file, pipeline->written + 1);  // Make room in the ring
+        }
+        hues_file_job* job = &pipeline->jobs[pipeline->submitted % pipeline->jobs_count];
+        char* data = job->data;
+        job->data = file->buffer;
+        job->size = file->used;
+        job->chunk = file->chunk;
+        job->state = HUES_FILE_JOB_PENDING;
+        memset(&file->chunk, 0, sizeof(hues_index_entry));
+        file->buffer = data;
+        file->used = 0;
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->submitted++;
+        pthread_cond_signal(&pipeline->submission);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+    hues_file_pipeline_write(file, pipeline->written);
+    int result = file->pipeline_error ? -1 : 0;
+    file->pipeline_error = 0;
+    return result;
+}
+
+/**
+ * @fn static void hues_file_pipeline_stop(hues_file_pipeline* pipeline)
+ * @brief Stops the workers of a compression pipeline, once every job is written, and releases it.
+ * @param pipeline The pipeline.
+ */
+static void hues_file_pipeline_stop(hues_file_pipeline* pipeline) {
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->stopping = 1;
+    pthread_cond_broadcast(&pipeline->submission);
+    pthread_mutex_unlock(&pipeline->mutex);
+    for (size_t i = 0; i < pipeline->threads_count; i++) {
+        pthread_join(pipeline->threads[i], NULL);
+    }
+    for (size_t i = 0; i < pipeline->jobs_count; i++) {
+        free(pipeline->jobs[i].data);
+        free(pipeline->jobs[i].block);
+    }
+    pthread_cond_destroy(&pipeline->completion);
+    pthread_cond_destroy(&pipeline->submission);
+    pthread_mutex_destroy(&pipeline->mutex);
+    free(pipeline->threads);
+    free(pipeline->jobs);
+    free(pipeline);
+}
+
+/**
+ * @fn static hues_file_pipeline* hues_file_pipeline_start(size_t threads_count)
+ * @brief Starts the workers of a compression pipeline.
+ * @param threads_count The number of workers.
+ * @return The pipeline, or NULL if no worker could be started.
+ */
+static hues_file_pipeline* hues_file_pipeline_start(size_t threads_count) {
+    hues_file_pipeline* pipeline = malloc(sizeof(hues_file_pipeline));
+    pipeline->jobs_count = 2 * threads_count;
+    pipeline->jobs = malloc(pipeline->jobs_count * sizeof(hues_file_job));
+    for (size_t i = 0; i < pipeline->jobs_count; i++) {
+        pipeline->jobs[i].data = malloc(HUES_FILE_BUFFER_SIZE);
+        pipeline->jobs[i].block = malloc(HUES_BLOCK_SIZE(HUES_FILE_BUFFER_SIZE));
+    }
+    pipeline->submitted = 0;
+    pipeline->taken = 0;
+    pipeline->written = 0;
+    pipeline->stopping = 0;
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pthread_cond_init(&pipeline->submission, NULL);
+    pthread_cond_init(&pipeline->completion, NULL);
+    pipeline->threads = malloc(threads_count * sizeof(pthread_t));
+    pipeline->threads_count = 0;
+    while (pipeline->threads_count < threads_count && pthread_create(&pipeline->threads[pipeline->threads_count], NULL, hues_file_pipeline_run, pipeline) == 0) {
+        pipeline->threads_count++;
+    }
+    if (pipeline->threads_count == 0) {
+        hues_file_pipeline_stop(pipeline);
+        return NULL;
+    }
+    return pipeline;
+}
+
+/**
+ * @fn static int hues_file_output(hues_file* file)
+ * @brief Writes the pending output of a log file to its live segment, as a single block if the file is compressed.
+ * With compression workers, the block is only submitted: it is written later, once compressed.
+ * @param file The file.
+ * @return 0 on success, -1 on error, in which case the pending output is lost.
+ */
+static int hues_file_output(hues_file* file) {
+    if (file->pipeline != NULL) {
+        return hues_file_pipeline_submit(file);
+    }
+    const char* data = file->buffer;
+    size_t size = file->used;
+    if (file->block != NULL && size > 0) {
+        data = file->block;
+        size = hues_block_encode(file->buffer, file->used, file->block, HUES_BLOCK_SIZE(HUES_FILE_BUFFER_SIZE));
+        file->size += size - file->used;
+    }
+    file->used = 0;
+    uint64_t offset = file->emitted;
+    int result = hues_file_emit(file, data, size);
+    result |= hues_file_index_add(file, offset, &file->chunk);
+    memset(&file->chunk, 0, sizeof(hues_index_entry));
+    return result;
+}
+
+/**
+ * @fn static int hues_file_drain(hues_file* file)
+ * @brief Writes the pending output of a log file and waits for all of it to be written.
+ * If the file bypasses the page cache, the output is only submitted to its writing thread.
+ * @param file The file, locked.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_drain(hues_file* file) {
+    int result = hues_file_output(file);
+    if (file->pipeline != NULL) {
+        hues_file_pipeline_write(file, file->pipeline->submitted);
+        result |= file->pipeline_error ? -1 : 0;
+        file->pipeline_error = 0;
+    }
+    if (file->direct != NULL) {
+        result |= hues_file_direct_sync(file);
+    }
+    return result;
+}
+
+/**
+ * @fn static size_t hues_file_header_size(const hues_file* file)
+ * @brief Retrieves the size of the header at the start of every segment of a log file.
+ * @param file The file.
+ * @return The size of the segment header, 0 for uncompressed text files.
+ */
+static size_t hues_file_header_size(const hues_file* file) {
+    int plain = file->options.format == HUES_FILE_FORMAT_TEXT && file->options.compression == HUES_FILE_COMPRESSION_NONE;
+    return plain ? 0 : sizeof(hues_file_header);
+}
+
+/**
+ * @fn static int hues_file_segment_open(hues_file* file)
+ * @brief Opens the live segment of a log file, writing the segment header if it is new.
+ * @param file The file.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_segment_open(hues_file* file) {
+    struct stat status;
+    if (file->direct == NULL) {
+        file->fd = open(file->options.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    } else {
+        file->fd = open(file->options.path, O_RDWR | O_CREAT | O_DIRECT | O_CLOEXEC, 0644);
+        if (file->fd < 0 && errno == EINVAL) {
+            // The file system does not support O_DIRECT, such as tmpfs: keep the aligned writes through the page cache
+            file->fd = open(file->options.path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        }
+    }
+    if (file->fd < 0 || fstat(file->fd, &status) != 0) {
+        return -1;
+    }
+    file->size = status.st_size;
+    file->emitted = file->size;
+    file->bloom_complete = file->size == 0;
+    if (file->options.index_interval > 0 && hues_file_index_open(file) != 0) {
+        return -1;
+    }
+    if (file->direct != NULL) {
+        // Appending starts by writing again the partial last block of an existing segment
+        hues_file_direct* direct = file->direct;
+        direct->offset = file->size & ~(uint64_t) (HUES_FILE_DIRECT_ALIGNMENT - 1);
+        direct->used = file->size - direct->offset;
+        direct->written = direct->used;
+        if (direct->used > 0 && pread(file->fd, direct->buffers[direct->filling], HUES_FILE_DIRECT_ALIGNMENT, direct->offset) != (ssize_t) direct->used) {
+            return -1;
+        }
+    }
+    if (file->size == 0 && hues_file_header_size(file) > 0) {
+        // Written right away, as the pending output may be compressed
+        hues_file_header header = {
+            .magic = HUES_FILE_MAGIC,
+            .version = HUES_FILE_VERSION,
+            .format = file->options.format,
+            .compression = file->options.compression
+        };
+        file->size += sizeof(header);
+        return hues_file_emit(file, (const char*) &header, sizeof(header));
+    }
+    return 0;
+}
+
+/**
+ * @fn static uint64_t hues_file_segments_scan(hues_file* file, uint64_t remove_through)
+ * @brief Looks for the rotated segments of a log file, removing the oldest ones.
+ * Every file named after a removed segment is removed with it, such as its compressed copy.
+ * @param file The file.
+ * @param remove_through The number of the most recent segment to remove, 0 to remove none.
+ * @return The number of the most recent segment found.
+ */
+static uint64_t hues_file_segments_scan(hues_file* file, uint64_t remove_through) {
+    DIR* directory = opendir(file->directory);
+    if (directory == NULL) {
+        return 0;
+    }
+    size_t name_length = strlen(file->name);
+    uint64_t last = 0;
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (strncmp(entry->d_name, file->name, name_length) != 0 || entry->d_name[name_length] != '.') {
+            continue;
+        }
+        char* end;
+        const char* number = entry->d_name + name_length + 1;
+        uint64_t segment = strtoull(number, &end, 10);
+        if (end == number || *number < '0' || *number > '9' || (*end != '\0' && *end != '.')) {
+            continue;
+        }
+        if (segment <= remove_through) {
+            unlinkat(dirfd(directory), entry->d_name, 0);
+        } else if (segment > last) {
+            last = segment;
+        }
+    }
+    closedir(directory);
+    return last;
+}
+
+/**
+ * @fn static char* hues_file_segment_retire(hues_file* file, int* result)
+ * @brief Renames the live segment of a log file and its index, if any, to the next segment number, and removes the oldest segments.
+ * @param file The file, its live segment closed.
+ * @param result Set to -1 on error.
+ * @return The path of the segment, to be freed.
+ */
+static char* hues_file_segment_retire(hues_file* file, int* result) {
+    size_t path_length = strlen(file->options.path) + 24 + sizeof(HUES_INDEX_SUFFIX);
+    char* segment_path = malloc(path_length);
+    snprintf(segment_path, path_length, "%s.%llu", file->options.path, (unsigned long long) ++file->last_segment);
+    if (rename(file->options.path, segment_path) != 0) {
+        *result = -1;
+    }
+    char* index_path = malloc(2 * path_length);
+    char* segment_index_path = index_path + path_length;
+    snprintf(index_path, path_length, "%s%s", file->options.path, HUES_INDEX_SUFFIX);
+    snprintf(segment_index_path, path_length, "%s%s", segment_path, HUES_INDEX_SUFFIX);
+    if (rename(index_path, segment_index_path) != 0 && errno != ENOENT) {
+        *result = -1;
+    }
+    free(index_path);
+    if (file->options.max_segments > 0 && file->last_segment > file->options.max_segments) {
+        hues_file_segments_scan(file, file->last_segment - file->options.max_segments);
+    }
+    return segment_path;
+}
+
+/**
+ * @fn static int hues_file_segment_matches(const hues_file* file)
+ * @brief Checks whether the live segment of a log file, left by a previous run, was written with the format and compression
+ * of the file: a segment header of this version holding them, or no segment header for uncompressed text files.
+ * @param file The file.
+ * @return 1 if the segment can be appended to, or does not exist or is empty, 0 otherwise.
+ */
+static int hues_file_segment_matches(const hues_file* file) {
+    int fd = open(file->options.path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 1;
+    }
+    hues_file_header header;
+    ssize_t size = pread(fd, &header, sizeof(header), 0);
+    close(fd);
+    if (size == 0) {
+        return 1;
+    }
+    int headed = size == sizeof(header) && header.magic == HUES_FILE_MAGIC;
+    if (hues_file_header_size(file) == 0) {
+        return !headed;
+    }
+    return headed && header.version == HUES_FILE_VERSION && header.format == file->options.format && header.compression == file->options.compression;
+}
+
+/**
+ * @fn static int hues_file_rotate_locked(hues_file* file)
+ * @brief Renames the live segment of a log file to the next segment number and starts a new one.
+ * @param file The file, locked.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_rotate_locked(hues_file* file) {
+    int result = hues_file_drain(file);
+    if (file->bloom != NULL) {
+        result |= hues_file_bloom_write(file);
+    }
+    if (file->direct != NULL) {
+        result |= hues_file_direct_sync(file);
+        result |= hues_file_direct_wait(file->direct);
+    }
+    close(file->fd);
+    if (file->index_fd >= 0) {
+        result |= hues_file_index_close(file);
+    }
+    char* segment_path = hues_file_segment_retire(file, &result);
+    if (hues_file_segment_open(file) != 0) {
+        result = -1;
+    }
+    if (file->options.rotate_function != NULL) {
+        file->options.rotate_function(segment_path, file->options.rotate_context);
+    }
+    free(segment_path);
+    return result;
+}
+
+/**
+ * @fn static int hues_file_reserve(hues_file* file, size_t size)
+ * @brief Makes room in the output buffer of a log file, rotating its live segment first if it would grow too large.
+ * The pending output of a compressed file is written as a block when it would exceed the block size.
+ * @param file The file, locked.
+ * @param size The size about to be appended, at most HUES_FILE_BUFFER_SIZE.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_reserve(hues_file* file, size_t size) {
+    int result = 0;
+    size_t max_segment_size = file->options.max_segment_size;
+    if (max_segment_size > 0 && file->size > hues_file_header_size(file) && file->size + size > max_segment_size) {
+        result = hues_file_rotate_locked(file);
+    }
+    size_t limit = file->block != NULL ? HUES_FILE_BLOCK_SIZE : HUES_FILE_BUFFER_SIZE;
+    if (file->block == NULL && file->index_fd >= 0 && file->options.index_interval < limit) {
+        limit = file->options.index_interval;  // Outputs end on record boundaries, where index entries can end
+    }
+    if (file->used > 0 && file->used + size > limit && hues_file_output(file) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+/**
+ * @fn static int hues_file_append_text(hues_file* file, const char* text, size_t length)
+ * @brief Appends a line to a text log file, terminating it with a newline if needed.
+ * @param file The file, locked.
+ * @param text The line.
+ * @param length The length of the line.
+ * @return 0 on success, -1 on error.
+ */
+static int hues_file_append_text(hues_file* file, const char* text, size_t length) {
+    if (length >= HUES_FILE_BUFFER_SIZE) {
+        length = HUES_FILE_BUFFER_SIZE - 1;
+    }
+    int newline = length == 0 || text[length - 1] != '\n';
+    int result = hues_file_reserve(file, length + newline);
+    memcpy(file->buffer + file->used, text, length);
+    file->used += length;
+    if (newline) {
+        file->buffer[file->used++] = '\n';
+    }
+    file->size += length + newline;
+    return result;
+}
+
+size_t hues_block_encode(const char* data, size_t size, void* block, size_t capacity) {
+    hues_block_header* header = block;
+    char* stored = (char*) (header + 1);
+    if (capacity < HUES_BLOCK_SIZE(0)) {
+        return 0;
+    }
+    size_t room = capacity - sizeof(hues_block_header);
+    size_t stored_size = hues_lz4_compress(data, size, stored, room < size ? room : size);
+    if (stored_size == 0 || stored_size >= size) {
+        if (HUES_BLOCK_SIZE(size) > capacity) {
+            return 0;
+        }
+        memcpy(stored, data, size);
+        stored_size = size;
+    }
+    *header = (hues_block_header) {
+        .magic = HUES_BLOCK_MAGIC,
+        .stored_size = stored_size,
+        .size = size
+    };
+    memset(stored + stored_size, 0, HUES_BLOCK_SIZE(stored_size) - sizeof(hues_block_header) - stored_size);
+    header->checksum = hues_checksum(stored, stored_size, hues_checksum(header, sizeof(hues_block_header), 0));
+    return HUES_BLOCK_SIZE(stored_size);
+}
+
+long hues_block_decode(const hues_block_header* block, size_t available, char* data, size_t capacity) {
+    if (available < sizeof(hues_block_header) || block->magic != HUES_BLOCK_MAGIC || block->stored_size > available - sizeof(hues_block_header)) {
+        return -1;
+    }
+    hues_block_header copy = *block;
+    copy.checksum = 0;
+    if (hues_checksum(block + 1, block->stored_size, hues_checksum(&copy, sizeof(copy), 0)) != block->checksum) {
+        return -1;
+    }
+    if (block->stored_size == block->size) {
+        if (block->size > capacity) {
+            return -1;
+        }
+        memcpy(data, block + 1, block->size);
+        return block->size;
+    }
+    long size = hues_lz4_decompress((const char*) (block + 1), block->stored_size, data, capacity);
+    return size == (long) block->size ? size : -1;
+}
+
+hues_file* hues_file_open(const hues_file_options* options) {
+    if (options->path == NULL) {
+        return NULL;
+    }
+    if (options->index_interval > 0 && options->format == HUES_FILE_FORMAT_TEXT) {
+        errno = EINVAL;  // Text lines hold no level nor time an index could bound
+        return NULL;
+    }
+    hues_file* file = malloc(sizeof(hues_file));
+    file->options = *options;
+    file->options.path = strdup(options->path);
+    const char* name = strrchr(file->options.path, '/');
+    file->name = name == NULL ? file->options.path : name + 1;
+    file->directory = strdup(options->path);
+    char* slash = strrchr(file->directory, '/');
+    if (slash == NULL) {
+        free(file->directory);
+        file->directory = strdup(".");
+    } else if (slash == file->directory) {
+        slash[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+    file->buffer = malloc(HUES_FILE_BUFFER_SIZE);
+    file->used = 0;
+    file->block = options->compression == HUES_FILE_COMPRESSION_LZ4 ? malloc(HUES_BLOCK_SIZE(HUES_FILE_BUFFER_SIZE)) : NULL;
+    file->pipeline = NULL;
+    file->pipeline_error = 0;
+    file->index_fd = -1;
+    file->bloom = NULL;
+    file->bloom_bits = 0;
+    if (options->bloom_size >= 64 && hues_file_header_size(file) > 0) {
+        file->bloom_bits = 64 * 8;
+        while (file->bloom_bits * 2 <= options->bloom_size * 8) {
+            file->bloom_bits *= 2;
+        }
+        file->bloom = calloc(file->bloom_bits / 64, sizeof(uint64_t));
+    }
+    memset(&file->chunk, 0, sizeof(hues_index_entry));
+    memset(&file->entry, 0, sizeof(hues_index_entry));
+    file->direct = options->direct ? hues_file_direct_start() : NULL;
+    if (options->direct && file->direct == NULL) {
+        free(file->block);
+        free(file->buffer);
+        free(file->directory);
+        free((char*) file->options.path);
+        free(file);
+        return NULL;
+    }
+    if (file->block != NULL && options->compression_threads > 1) {
+        file->pipeline = hues_file_pipeline_start(options->compression_threads);
+    }
+    file->last_segment = hues_file_segments_scan(file, 0);
+    pthread_mutex_init(&file->mutex, NULL);
+    if (!hues_file_segment_matches(file)) {
+        // Written with other options, such as text before binary: start a new segment rather than mixing both
+        int result = 0;
+        char* segment_path = hues_file_segment_retire(file, &result);
+        if (file->options.rotate_function != NULL) {
+            file->options.rotate_function(segment_path, file->options.rotate_context);
+        }
+        free(segment_path);
+    }
+    if (hues_file_segment_open(file) != 0) {
+        if (file->fd >= 0) {
+            close(file->fd);
+        }
+        if (file->index_fd >= 0) {
+            close(file->index_fd);
+        }
+        if (file->pipeline != NULL) {
+            hues_file_pipeline_stop(file->pipeline);
+        }
+        if (file->direct != NULL) {
+            hues_file_direct_stop(file->direct);
+        }
+        pthread_mutex_destroy(&file->mutex);
+        free(file->bloom);
+        free(file->block);
+        free(file->buffer);
+        free(file->directory);
+        free((char*) file->options.path);
+        free(file);
+        return NULL;
+    }
+    return file;
+}
+
+int hues_file_write(hues_file* file, const hues_record* record) {
+    pthread_mutex_lock(&file->mutex);
+    int result;
+    if (file->options.format == HUES_FILE_FORMAT_TEXT) {
+        result = hues_file_append_text(file, record->text, record->length);
+        hues_file_index_note(file, record->level, record->timestamp);
+        hues_file_bloom_note(file, record->text, record->length);
+    } else {
+        size_t bound = HUES_RECORD_SIZE(HUES_FILE_LOCATION_BOUND + record->length + record->arguments_length + sizeof(uint16_t));
+        if (bound > HUES_FILE_BUFFER_SIZE) {
+            bound = HUES_FILE_BUFFER_SIZE;
+        }
+        result = hues_file_reserve(file, bound);
+        hues_record_header* header = (hues_record_header*) (file->buffer + file->used);
+        size_t size = hues_record_encode(record, record->sequence, header, HUES_FILE_BUFFER_SIZE - file->used);
+        file->used += size;
+        file->size += size;
+        hues_file_index_note(file, record->level, record->timestamp);
+        if (size > 0 && (header->flags & HUES_RECORD_FLAG_ARGUMENTS)) {
+            // The bloom filter holds the words of the line as readers format it
+            char line[BUFFER_SIZE];
+            size_t length;
+            const char* text = hues_record_line(header, line, sizeof(line), &length);
+            hues_file_bloom_note(file, text, length);
+        } else {
+            hues_file_bloom_note(file, record->text, record->length);
+        }
+    }
+    pthread_mutex_unlock(&file->mutex);
+    return result;
+}
+
+int hues_file_write_encoded(hues_file* file, const hues_record_header* header) {
+    if (header->flags & HUES_RECORD_FLAG_PADDING) {
+        return 0;
+    }
+    pthread_mutex_lock(&file->mutex);
+    int result = 0;
+    char line[BUFFER_SIZE];
+    size_t length;
+    if (file->options.format == HUES_FILE_FORMAT_TEXT) {
+        const char* text = hues_record_line(header, line, sizeof(line), &length);
+        result = hues_file_append_text(file, text, length);
+        hues_file_index_note(file, header->level, header->timestamp);
+        hues_file_bloom_note(file, text, length);
+    } else if (HUES_RECORD_SIZE(header->length) <= HUES_FILE_BUFFER_SIZE) {
+        size_t size = HUES_RECORD_SIZE(header->length);
+        result = hues_file_reserve(file, size);
+        memcpy(file->buffer + file->used, header, size);
+        file->used += size;
+        file->size += size;
+        hues_file_index_note(file, header->level, header->timestamp);
+        if (header->location_length <= header->length) {
+            const char* text = hues_record_line(header, line, sizeof(line), &length);
+            hues_file_bloom_note(file, text, length);
+        }
+    } else {
+        result = -1;
+    }
+    pthread_mutex_unlock(&file->mutex);
+    return result;
+}
+
+int hues_file_flush(hues_file* file) {
+    pthread_mutex_lock(&file->mutex);
+    int result = hues_file_drain(file);
+    pthread_mutex_unlock(&file->mutex);
+    return result;
+}
+
+int hues_file_rotate(hues_file* file) {
+    pthread_mutex_lock(&file->mutex);
+    int result = hues_file_rotate_locked(file);
+    pthread_mutex_unlock(&file->mutex);
+    return result;
+}
+
+void hues_file_close(hues_file* file) {
+    hues_file_drain(file);
+    if (file->pipeline != NULL) {
+        hues_file_pipeline_stop(file->pipeline);
+    }
+    if (file->direct != NULL) {
+        hues_file_direct_stop(file->direct);
+    }
+    hues_file_index_close(file);
+    close(file->fd);
+    pthread_mutex_destroy(&file->mutex);
+    free(file->bloom);
+    free(file->block);
+    free(file->buffer);
+    free(file->directory);
+    free((char*) file->options.path);
+    free(file);
+}
+
+static void hues_file_sink_write(hues_sink* sink, const hues_record* record) {
+    hues_file_write(sink->context, record);
+}
+
+static void hues_file_sink_flush(hues_sink* sink) {
+    hues_file_flush(sink->context);
+}
+
+static void hues_file_sink_close(hues_sink* sink) {
+    hues_file_close(sink->context);
+    free(sink);
+}
+
+hues_sink* hues_file_sink_open(const hues_file_options* options) {
+    hues_file* file = hues_file_open(options);
+    if (file == NULL) {
+        return NULL;
+    }
+    hues_sink* sink = malloc(sizeof(hues_sink));
+    *sink = (hues_sink) {
+        .minimum_level = HUES_LEVEL_TRACE,
+        .write_function = hues_file_sink_write,
+        .flush_function = hues_file_sink_flush,
+        .close_function = hues_file_sink_close,
+        .context = file,
+        .binary = options->format == HUES_FILE_FORMAT_BINARY
+    };
+    hues_configuration_add_sink(sink);
+    return sink;
+}
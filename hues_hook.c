@@ -0,0 +1,489 @@
+/**
+ * @file hues_hook.c
+ * @brief Function hooks: a trace line per call, or per-thread call counters and latency histograms in profiling mode,
+ * and the binary capture of their arguments
+ */
+
+#include "hues.h"
+
+#include <pthread.h>
+
+/**
+ * @def HUES_HOOK_MAX
+ * @brief Maximum number of hooked functions profiled, the calls of the others are not counted.
+ */
+#define HUES_HOOK_MAX 1024
+
+/**
+ * @def HUES_HOOK_BUCKETS
+ * @brief Number of buckets of a latency histogram: four per power of two of nanoseconds, so within 25% of the latency.
+ */
+#define HUES_HOOK_BUCKETS 256
+
+/**
+ * @struct hues_hook_stats
+ * @brief Represents the calls of a hooked function by a thread. Only the thread writes it.
+ */
+typedef struct {
+    uint64_t calls;  /**< Number of calls, all counted. */
+    uint64_t samples;  /**< Number of calls timed: all while profiling, the sampled ones while sampling. */
+    uint64_t total;  /**< Total time spent in the calls timed, in nanoseconds. */
+    uint64_t buckets[HUES_HOOK_BUCKETS];  /**< Number of calls timed by latency bucket. */
+    uint32_t unsampled;  /**< Number of calls since the last sampled one. */
+    uint64_t last_sample;  /**< Time of the last sampled call, on the coarse monotonic clock, in nanoseconds. */
+} hues_hook_stats;
+
+/**
+ * @struct hues_hook_thread
+ * @brief Represents the statistics of a thread. When the thread exits, they are added to those of the exited threads,
+ * and the block is handed to the next new thread.
+ */
+typedef struct hues_hook_thread {
+    hues_hook_stats* stats[HUES_HOOK_MAX];  /**< Statistics by hook identifier minus one, NULL until the hook is called. */
+    struct hues_hook_thread* next;  /**< Block allocated before. */
+    struct hues_hook_thread* next_idle;  /**< Next block waiting for a new thread. */
+} hues_hook_thread;
+
+/**
+ * @struct hues_hook_profiler
+ * @brief Represents the hooks profiled and the statistics of the threads calling them.
+ */
+typedef struct {
+    hues_hook* hooks[HUES_HOOK_MAX];  /**< Hooks profiled, by identifier minus one. */
+    uint32_t hooks_count;  /**< Number of hooks profiled. */
+    hues_hook_thread* threads;  /**< Blocks of statistics, most recent first. */
+    hues_hook_thread* idle;  /**< Blocks of the exited threads, waiting for new ones. */
+    hues_hook_stats* exited[HUES_HOOK_MAX];  /**< Statistics of the exited threads, by hook identifier minus one. */
+    pthread_mutex_t mutex;  /**< Protects the registration of hooks and threads, the statistics of the exited threads, and the reporter. */
+    pthread_t reporter;  /**< Thread printing reports periodically. */
+    int reporting;  /**< Whether the reporter runs. */
+    FILE* report_stream;  /**< Stream of the periodic reports. */
+    uint64_t report_interval;  /**< Interval between periodic reports, in nanoseconds. */
+    pthread_cond_t report_condition;  /**< Signaled to stop the reporter. */
+    uint32_t sample_every;  /**< Samples one call in this many, for the hooks without their own setting. 0 for none. */
+    uint64_t sample_interval;  /**< Samples a call per thread at this interval at most, in nanoseconds, likewise. */
+} hues_hook_profiler;
+
+int hues_glob_hook_mode = HUES_HOOK_TRACING;
+static hues_hook_profiler hues_glob_hook_profiler = { .mutex = PTHREAD_MUTEX_INITIALIZER, .report_condition = PTHREAD_COND_INITIALIZER };
+static __thread hues_hook_thread* hues_thread_hooks = NULL;
+static pthread_key_t hues_hook_key;
+static pthread_once_t hues_hook_key_once = PTHREAD_ONCE_INIT;
+
+static uint64_t hues_hook_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/**
+ * @fn static size_t hues_hook_bucket(uint64_t latency)
+ * @brief Finds the histogram bucket of a latency.
+ * @param latency The latency, in nanoseconds.
+ * @return The bucket.
+ */
+static size_t hues_hook_bucket(uint64_t latency) {
+    if (latency < 4) {
+        return latency;
+    }
+    int exponent = 63 - __builtin_clzll(latency);
+    return (exponent - 1) * 4 + ((latency >> (exponent - 2)) & 3);
+}
+
+/**
+ * @fn static uint64_t hues_hook_bucket_limit(size_t bucket)
+ * @brief Computes the highest latency of a histogram bucket.
+ * @param bucket The bucket.
+ * @return The latency, in nanoseconds.
+ */
+static uint64_t hues_hook_bucket_limit(size_t bucket) {
+    if (bucket + 1 < 4) {
+        return bucket;
+    }
+    size_t next = bucket + 1;
+    int exponent = next / 4 + 1;
+    return exponent > 63 ? UINT64_MAX : ((uint64_t) (4 + next % 4) << (exponent - 2)) - 1;
+}
+
+/**
+ * @fn static uint32_t hues_hook_register(hues_hook* hook)
+ * @brief Gives an identifier to a hook called for the first time while profiling.
+ * @param hook The hook.
+ * @return The identifier, UINT32_MAX if too many hooks are profiled.
+ */
+static uint32_t hues_hook_register(hues_hook* hook) {
+    hues_hook_profiler* profiler = &hues_glob_hook_profiler;
+    pthread_mutex_lock(&profiler->mutex);
+    uint32_t id = hook->id;
+    if (id == 0) {
+        id = profiler->hooks_count < HUES_HOOK_MAX ? ++profiler->hooks_count : UINT32_MAX;
+        if (id != UINT32_MAX) {
+            profiler->hooks[id - 1] = hook;
+            profiler->exited[id - 1] = calloc(1, sizeof(hues_hook_stats));  // Allocated here, so that exiting threads never allocate
+        }
+        __atomic_store_n(&hook->id, id, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&profiler->mutex);
+    return id;
+}
+
+/**
+ * @fn static void hues_hook_thread_exit(void* argument)
+ * @brief Adds the statistics of an exiting thread to those of the exited threads, and keeps its block for a new thread.
+ * @param argument The block of the thread.
+ */
+static void hues_hook_thread_exit(void* argument) {
+    hues_hook_profiler* profiler = &hues_glob_hook_profiler;
+    hues_hook_thread* thread = argument;
+    pthread_mutex_lock(&profiler->mutex);
+    for (uint32_t i = 0; i < profiler->hooks_count; i++) {
+        hues_hook_stats* stats = thread->stats[i];
+        hues_hook_stats* exited = profiler->exited[i];
+        if (stats == NULL || exited == NULL) {
+            continue;
+        }
+        exited->calls += stats->calls;
+        exited->samples += stats->samples;
+        exited->total += stats->total;
+        for (size_t j = 0; j < HUES_HOOK_BUCKETS; j++) {
+            exited->buckets[j] += stats->buckets[j];
+        }
+        memset(stats, 0, sizeof(hues_hook_stats));
+    }
+    thread->next_idle = profiler->idle;
+    profiler->idle = thread;
+    pthread_mutex_unlock(&profiler->mutex);
+    hues_thread_hooks = NULL;
+}
+
+static void hues_hook_key_create() {
+    pthread_key_create(&hues_hook_key, hues_hook_thread_exit);
+}
+
+/**
+ * @fn static hues_hook_stats* hues_hook_stats_get(hues_hook* hook)
+ * @brief Retrieves the statistics of the calling thread for a hook, allocating them on the first call.
+ * @param hook The hook.
+ * @return The statistics, NULL if too many hooks are profiled or they cannot be allocated.
+ */
+static hues_hook_stats* hues_hook_stats_get(hues_hook* hook) {
+    hues_hook_profiler* profiler = &hues_glob_hook_profiler;
+    uint32_t id = __atomic_load_n(&hook->id, __ATOMIC_ACQUIRE);
+    if (id == 0) {
+        id = hues_hook_register(hook);
+    }
+    if (id == UINT32_MAX) {
+        return NULL;
+    }
+    hues_hook_thread* thread = hues_thread_hooks;
+    if (thread == NULL) {
+        pthread_once(&hues_hook_key_once, hues_hook_key_create);
+        pthread_mutex_lock(&profiler->mutex);
+        thread = profiler->idle;
+        if (thread != NULL) {
+            profiler->idle = thread->next_idle;
+        }
+        pthread_mutex_unlock(&profiler->mutex);
+        if (thread == NULL) {
+            thread = calloc(1, sizeof(hues_hook_thread));
+            if (thread == NULL) {
+                return NULL;
+            }
+            pthread_mutex_lock(&profiler->mutex);
+            thread->next = profiler->threads;
+            __atomic_store_n(&profiler->threads, thread, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&profiler->mutex);
+        }
+        hues_thread_hooks = thread;
+        pthread_setspecific(hues_hook_key, thread);
+    }
+    hues_hook_stats* stats = thread->stats[id - 1];
+    if (stats == NULL) {
+        stats = calloc(1, sizeof(hues_hook_stats));
+        __atomic_store_n(&thread->stats[id - 1], stats, __ATOMIC_RELEASE);
+    }
+    return stats;
+}
+
+/**
+ * @fn static int hues_hook_sampled(const hues_hook* hook, hues_hook_stats* stats)
+ * @brief Decides whether to sample a call: one in every N calls of the thread, or the first one after an interval
+ * since the last sample of the thread. The interval is measured on the coarse clock, read without a system call.
+ * @param hook The hook of the function called.
+ * @param stats The statistics of the calling thread for the hook.
+ * @return Whether to time and record the call.
+ */
+static int hues_hook_sampled(const hues_hook* hook, hues_hook_stats* stats) {
+    uint32_t every = hook->sample_every;
+    uint64_t interval = hook->sample_interval;
+    if (every == 0 && interval == 0) {
+        every = __atomic_load_n(&hues_glob_hook_profiler.sample_every, __ATOMIC_RELAXED);
+        interval = __atomic_load_n(&hues_glob_hook_profiler.sample_interval, __ATOMIC_RELAXED);
+    }
+    if (every != 0 && ++stats->unsampled >= every) {
+        stats->unsampled = 0;
+        return 1;
+    }
+    if (interval != 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        uint64_t time = (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+        if (time - stats->last_sample >= interval) {
+            stats->last_sample = time;
+            stats->unsampled = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t hues_hook_enter(hues_hook* hook) {
+    int mode = __atomic_load_n(&hues_glob_hook_mode, __ATOMIC_RELAXED);
+    if (!(mode & (HUES_HOOK_PROFILING | HUES_HOOK_SAMPLING))) {
+        return HUES_HOOK_TRACE;
+    }
+    hues_hook_stats* stats = hues_hook_stats_get(hook);
+    if (stats == NULL) {
+        return HUES_HOOK_COUNTED;
+    }
+    // Single writer: relaxed stores keep the reporter from reading torn counters, without locked instructions
+    __atomic_store_n(&stats->calls, stats->calls + 1, __ATOMIC_RELAXED);
+    if (!(mode & HUES_HOOK_PROFILING) && !hues_hook_sampled(hook, stats)) {
+        return HUES_HOOK_COUNTED;
+    }
+    return hues_hook_now();
+}
+
+uint64_t hues_hook_exit(hues_hook* hook, uint64_t start) {
+    if (start <= HUES_HOOK_COUNTED) {
+        return 0;
+    }
+    uint64_t latency = hues_hook_now() - start;
+    hues_hook_stats* stats = hues_hook_stats_get(hook);
+    size_t bucket = hues_hook_bucket(latency);
+    __atomic_store_n(&stats->samples, stats->samples + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->total, stats->total + latency, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->buckets[bucket], stats->buckets[bucket] + 1, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&hues_glob_hook_mode, __ATOMIC_RELAXED) & HUES_HOOK_PROFILING) {
+        return 0;
+    }
+    return latency > 0 ? latency : 1;
+}
+
+void hues_hook_tracing_enable(int enabled) {
+    if (enabled) {
+        __atomic_fetch_or(&hues_glob_hook_mode, HUES_HOOK_TRACING, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&hues_glob_hook_mode, ~HUES_HOOK_TRACING, __ATOMIC_RELAXED);
+    }
+}
+
+void hues_hook_profiling_enable(int enabled) {
+    if (enabled) {
+        __atomic_fetch_or(&hues_glob_hook_mode, HUES_HOOK_PROFILING, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&hues_glob_hook_mode, ~HUES_HOOK_PROFILING, __ATOMIC_RELAXED);
+    }
+}
+
+void hues_hook_sampling_enable(uint32_t every, uint64_t interval) {
+    __atomic_store_n(&hues_glob_hook_profiler.sample_every, every, __ATOMIC_RELAXED);
+    __atomic_store_n(&hues_glob_hook_profiler.sample_interval, interval, __ATOMIC_RELAXED);
+    if (every != 0 || interval != 0) {
+        __atomic_fetch_or(&hues_glob_hook_mode, HUES_HOOK_SAMPLING, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&hues_glob_hook_mode, ~HUES_HOOK_SAMPLING, __ATOMIC_RELAXED);
+    }
+}
+
+void hues_hook_sampling_set(hues_hook* hook, uint32_t every, uint64_t interval) {
+    __atomic_store_n(&hook->sample_every, every, __ATOMIC_RELAXED);
+    __atomic_store_n(&hook->sample_interval, interval, __ATOMIC_RELAXED);
+}
+
+/**
+ * @fn static uint64_t hues_hook_percentile(const uint64_t* buckets, uint64_t calls, double percentile)
+ * @brief Estimates a percentile of the latencies of a histogram, as the highest latency of its bucket.
+ * @param buckets The histogram.
+ * @param calls The number of calls of the histogram.
+ * @param percentile The percentile, between 0 and 1.
+ * @return The latency, in nanoseconds.
+ */
+static uint64_t hues_hook_percentile(const uint64_t* buckets, uint64_t calls, double percentile) {
+    uint64_t rank = (uint64_t) (percentile * calls);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HUES_HOOK_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+            return hues_hook_bucket_limit(i);
+        }
+    }
+    return hues_hook_bucket_limit(HUES_HOOK_BUCKETS - 1);
+}
+
+void hues_hook_profile_report(FILE* stream) {
+    hues_hook_profiler* profiler = &hues_glob_hook_profiler;
+    pthread_mutex_lock(&profiler->mutex);
+    uint32_t count = profiler->hooks_count;
+    hues_hook_thread* threads = profiler->threads;
+    pthread_mutex_unlock(&profiler->mutex);
+    hues_hook_stats* sum = malloc(sizeof(hues_hook_stats));
+    fprintf(stream, "%-32s %12s %12s %14s %10s %10s %10s\n", "function", "calls", "timed", "total (us)", "mean (ns)", "p50 (ns)", "p99 (ns)");
+    for (uint32_t id = 1; id <= count; id++) {
+        memset(sum, 0, sizeof(hues_hook_stats));
+        // Locked, so that a thread exiting meanwhile is counted once
+        pthread_mutex_lock(&profiler->mutex);
+        if (profiler->exited[id - 1] != NULL) {
+            *sum = *profiler->exited[id - 1];
+        }
+        for (hues_hook_thread* thread = threads; thread != NULL; thread = thread->next) {
+            const hues_hook_stats* stats = __atomic_load_n(&thread->stats[id - 1], __ATOMIC_ACQUIRE);
+            if (stats == NULL) {
+                continue;
+            }
+            sum->calls += __atomic_load_n(&stats->calls, __ATOMIC_RELAXED);
+            sum->samples += __atomic_load_n(&stats->samples, __ATOMIC_RELAXED);
+            sum->total += __atomic_load_n(&stats->total, __ATOMIC_RELAXED);
+            for (size_t i = 0; i < HUES_HOOK_BUCKETS; i++) {
+                sum->buckets[i] += __atomic_load_n(&stats->buckets[i], __ATOMIC_RELAXED);
+            }
+        }
+        pthread_mutex_unlock(&profiler->mutex);
+        if (sum->samples == 0) {
+            if (sum->calls > 0) {
+                fprintf(stream, "%-32s %12llu %12d\n", profiler->hooks[id - 1]->name, (unsigned long long) sum->calls, 0);
+            }
+            continue;
+        }
+        // The buckets may be a few calls ahead of or behind the count while threads run
+        uint64_t samples = 0;
+        for (size_t i = 0; i < HUES_HOOK_BUCKETS; i++) {
+            samples += sum->buckets[i];
+        }
+        // While sampling, the total time of all the calls is extrapolated from the calls timed
+        double total = (double) sum->total * (sum->calls > sum->samples ? sum->calls : sum->samples) / sum->samples;
+        fprintf(stream, "%-32s %12llu %12llu %14.1f %10llu %10llu %10llu\n", profiler->hooks[id - 1]->name, (unsigned long long) sum->calls,
+                (unsigned long long) sum->samples, total / 1e3, (unsigned long long) (sum->total / sum->samples),
+                (unsigned long long) hues_hook_percentile(sum->buckets, samples, 0.5), (unsigned long long) hues_hook_percentile(sum->buckets, samples, 0.99));
+    }
+    fflush(stream);
+    free(sum);
+}
+
+/**
+ * @fn static void* hues_hook_reporter_run(void* argument)
+ * @brief Prints a profiling report at every interval until stopped.
+ * @param argument Unused.
+ * @return NULL.
+ */
+static void* hues_hook_reporter_run(void* argument) {
+    hues_hook_profiler* profiler = &hues_glob_hook_profiler;
+    pthread_mutex_lock(&profiler->mutex);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    while (profiler->reporting) {
+        uint64_t next = deadline.tv_nsec + profiler->report_interval;
+        deadline.tv_sec += next / 1000000000u;
+        deadline.tv_nsec = next % 1000000000u;
+        while (profiler->reporting && pthread_cond_timedwait(&profiler->report_condition, &profiler->mutex, &deadline) == 0) {
+        }
+        if (!profiler->reporting) {
+            break;
+        }
+        pthread_mutex_unlock(&profiler->mutex);
+        hues_hook_profile_report(profiler->report_stream);
+        pthread_mutex_lock(&profiler->mutex);
+    }
+    pthread_mutex_unlock(&profiler->mutex);
+    return NULL;
+}
+
+int hues_hook_profile_report_every(FILE* stream, uint64_t interval) {
+    hues_hook_profiler* profiler = &hues_glob_hook_profiler;
+    pthread_mutex_lock(&profiler->mutex);
+    if (profiler->reporting) {
+        profiler->reporting = 0;
+        pthread_cond_signal(&profiler->report_condition);
+        pthread_mutex_unlock(&profiler->mutex);
+        pthread_join(profiler->reporter, NULL);
+        pthread_mutex_lock(&profiler->mutex);
+    }
+    int result = 0;
+    if (interval > 0) {
+        profiler->report_stream = stream;
+        profiler->report_interval = interval;
+        profiler->reporting = 1;
+        if (pthread_create(&profiler->reporter, NULL, hues_hook_reporter_run, NULL) != 0) {
+            profiler->reporting = 0;
+            result = -1;
+        }
+    }
+    pthread_mutex_unlock(&profiler->mutex);
+    return result;
+}
+
+/**
+ * @fn static void hues_arguments_add_value(hues_arguments* arguments, uint8_t type, uint64_t value)
+ * @brief Captures a value stored on 8 bytes, dropping it if it does not fit.
+ * @param arguments The values captured.
+ * @param type The hues_argument_type of the value.
+ * @param value The value.
+ */
+static void hues_arguments_add_value(hues_arguments* arguments, uint8_t type, uint64_t value) {
+    if (HUES_ARGUMENTS_SIZE - arguments->length < 1 + sizeof(value)) {
+        return;
+    }
+    arguments->data[arguments->length] = type;
+    memcpy(arguments->data + arguments->length + 1, &value, sizeof(value));
+    arguments->length += 1 + sizeof(value);
+}
+
+void hues_arguments_add_int(hues_arguments* arguments, long long value) {
+    hues_arguments_add_value(arguments, HUES_ARGUMENT_INT, (uint64_t) value);
+}
+
+void hues_arguments_add_uint(hues_arguments* arguments, unsigned long long value) {
+    hues_arguments_add_value(arguments, HUES_ARGUMENT_UINT, value);
+}
+
+void hues_arguments_add_double(hues_arguments* arguments, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    hues_arguments_add_value(arguments, HUES_ARGUMENT_DOUBLE, bits);
+}
+
+void hues_arguments_add_pointer(hues_arguments* arguments, const void* value) {
+    hues_arguments_add_value(arguments, HUES_ARGUMENT_POINTER, (uint64_t) (uintptr_t) value);
+}
+
+void hues_arguments_add_string(hues_arguments* arguments, const char* value) {
+    if (value == NULL) {
+        hues_arguments_add_pointer(arguments, NULL);
+        return;
+    }
+    size_t length = strnlen(value, HUES_ARGUMENT_STRING_SIZE + 1);
+    uint8_t type = length > HUES_ARGUMENT_STRING_SIZE ? HUES_ARGUMENT_STRING_CUT : HUES_ARGUMENT_STRING;
+    length = length > HUES_ARGUMENT_STRING_SIZE ? HUES_ARGUMENT_STRING_SIZE : length;
+    if (HUES_ARGUMENTS_SIZE - arguments->length < 2 + length) {
+        return;
+    }
+    arguments->data[arguments->length] = type;
+    arguments->data[arguments->length + 1] = (uint8_t) length;
+    memcpy(arguments->data + arguments->length + 2, value, length);
+    arguments->length += 2 + length;
+}
+
+void hues_arguments_add_result(hues_arguments* arguments) {
+    if (arguments->length < HUES_ARGUMENTS_SIZE) {
+        arguments->data[arguments->length++] = HUES_ARGUMENT_RESULT;
+    }
+}
+
+void* hues_hook_original(const char* name, void* symbol) {
+    if (symbol == NULL) {
+        // Calling the hook itself would recurse forever
+        fprintf(stderr, "hues: no original '%s' after the hook, it must be defined in a shared library\n", name);
+        abort();
+    }
+    return symbol;
+}
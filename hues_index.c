@@ -0,0 +1,79 @@
+/**
+ * @file hues_index.c
+ * @brief Reading of the sidecar indexes written along log files
+ */
+
+#define _GNU_SOURCE  // strptime
+
+#include "hues.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+hues_index_entry* hues_index_load(const char* segment_path, size_t* count) {
+    size_t path_length = strlen(segment_path) + sizeof(HUES_INDEX_SUFFIX);
+    char* path = malloc(path_length);
+    snprintf(path, path_length, "%s%s", segment_path, HUES_INDEX_SUFFIX);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    free(path);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(hues_index_header)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    size_t size = status.st_size;
+    char* data = malloc(size);
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t length = read(fd, data + offset, size - offset);
+        if (length <= 0) {
+            break;
+        }
+        offset += length;
+    }
+    close(fd);
+    const hues_index_header* header = (const hues_index_header*) data;
+    if (offset < sizeof(hues_index_header) || header->magic != HUES_INDEX_MAGIC || header->version != HUES_INDEX_VERSION) {
+        free(data);
+        return NULL;
+    }
+    *count = (offset - sizeof(hues_index_header)) / sizeof(hues_index_entry);
+    hues_index_entry* entries = malloc((*count > 0 ? *count : 1) * sizeof(hues_index_entry));
+    memcpy(entries, data + sizeof(hues_index_header), *count * sizeof(hues_index_entry));
+    free(data);
+    return entries;
+}
+
+int hues_index_entry_matches(const hues_index_entry* entry, uint64_t from, uint64_t to, hues_level_enum minimum_level) {
+    return entry->maximum_timestamp >= from && entry->minimum_timestamp <= to && (entry->levels >> minimum_level) != 0;
+}
+
+int hues_time_parse(const char* text, uint64_t* timestamp) {
+    if (text[0] == '@') {
+        char* end;
+        double seconds = strtod(text + 1, &end);
+        *timestamp = (uint64_t) (seconds * 1e9);
+        return *end == '\0' && seconds >= 0 ? 0 : -1;
+    }
+    time_t now = time(NULL);
+    struct tm fields;
+    localtime_r(&now, &fields);
+    fields.tm_sec = 0;
+    const char* end = strptime(text, "%Y-%m-%d %H:%M", &fields);
+    if (end == NULL) {
+        localtime_r(&now, &fields);  // A failed parse may have changed the date
+        fields.tm_sec = 0;
+        end = strptime(text, "%H:%M", &fields);
+    }
+    if (end != NULL && *end == ':') {
+        end = strptime(end + 1, "%S", &fields);
+    }
+    if (end == NULL || *end != '\0') {
+        return -1;
+    }
+    fields.tm_isdst = -1;
+    *timestamp = (uint64_t) mktime(&fields) * 1000000000;
+    return 0;
+}
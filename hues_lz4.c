@@ -0,0 +1,203 @@
+/**
+ * @file hues_lz4.c
+ * @brief Compression in the LZ4 block format, without external dependency
+ */
+
+#include "hues.h"
+
+/**
+ * @def HUES_LZ4_HASH_BITS
+ * @brief Number of bits of the hash table indexing the positions of 4-byte sequences.
+ */
+#define HUES_LZ4_HASH_BITS 12
+
+/**
+ * @def HUES_LZ4_MINIMUM_MATCH
+ * @brief Minimum length of a match.
+ */
+#define HUES_LZ4_MINIMUM_MATCH 4
+
+/**
+ * @def HUES_LZ4_LAST_LITERALS
+ * @brief Number of bytes at the end of a block that must be literals.
+ */
+#define HUES_LZ4_LAST_LITERALS 5
+
+/**
+ * @def HUES_LZ4_MATCH_LIMIT
+ * @brief Minimum distance between the start of the last match and the end of a block.
+ */
+#define HUES_LZ4_MATCH_LIMIT 12
+
+/**
+ * @def HUES_LZ4_MAXIMUM_OFFSET
+ * @brief Maximum distance between a match and its earlier occurrence.
+ */
+#define HUES_LZ4_MAXIMUM_OFFSET 65535
+
+static uint32_t hues_lz4_read32(const char* position) {
+    uint32_t value;
+    memcpy(&value, position, sizeof(value));
+    return value;
+}
+
+static uint32_t hues_lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HUES_LZ4_HASH_BITS);
+}
+
+/**
+ * @fn static char* hues_lz4_write_length(char* output, size_t length)
+ * @brief Writes the extension bytes of a literal or match length that does not fit its token nibble.
+ * @param output The position to write at.
+ * @param length The length minus 15.
+ * @return The position after the extension bytes.
+ */
+static char* hues_lz4_write_length(char* output, size_t length) {
+    while (length >= 255) {
+        *output++ = (char) 255;
+        length -= 255;
+    }
+    *output++ = (char) length;
+    return output;
+}
+
+/**
+ * @fn static char* hues_lz4_write_sequence(char* output, const char* output_end, const char* literals, size_t literals_length, size_t offset, size_t match_length)
+ * @brief Writes a sequence: a token, literals and, unless it is the last sequence, a match.
+ * @param output The position to write at.
+ * @param output_end The end of the output buffer.
+ * @param literals The literals.
+ * @param literals_length The number of literals.
+ * @param offset The distance to the earlier occurrence of the match, 0 for the last sequence.
+ * @param match_length The length of the match.
+ * @return The position after the sequence, NULL if it does not fit.
+ */
+static char* hues_lz4_write_sequence(char* output, const char* output_end, const char* literals, size_t literals_length, size_t offset, size_t match_length) {
+    size_t bound = 1 + literals_length / 255 + 1 + literals_length + (offset != 0 ? 2 + match_length / 255 + 1 : 0);
+    if (bound > (size_t) (output_end - output)) {
+        return NULL;
+    }
+    char* token = output++;
+    *token = (char) ((literals_length < 15 ? literals_length : 15) << 4);
+    if (literals_length >= 15) {
+        output = hues_lz4_write_length(output, literals_length - 15);
+    }
+    memcpy(output, literals, literals_length);
+    output += literals_length;
+    if (offset == 0) {
+        return output;
+    }
+    *output++ = (char) (offset & 0xff);
+    *output++ = (char) (offset >> 8);
+    match_length -= HUES_LZ4_MINIMUM_MATCH;
+    *token |= (char) (match_length < 15 ? match_length : 15);
+    if (match_length >= 15) {
+        output = hues_lz4_write_length(output, match_length - 15);
+    }
+    return output;
+}
+
+size_t hues_lz4_compress(const char* source, size_t size, char* destination, size_t capacity) {
+    uint32_t table[1 << HUES_LZ4_HASH_BITS] = { 0 };
+    const char* end = source + size;
+    const char* anchor = source;
+    const char* cursor = source + 1;
+    char* output = destination;
+    const char* output_end = destination + capacity;
+    if (size > HUES_LZ4_MATCH_LIMIT) {
+        const char* match_limit = end - HUES_LZ4_MATCH_LIMIT;
+        const char* literals_limit = end - HUES_LZ4_LAST_LITERALS;
+        size_t misses = 0;
+        while (cursor < match_limit) {
+            uint32_t sequence = hues_lz4_read32(cursor);
+            uint32_t hash = hues_lz4_hash(sequence);
+            const char* candidate = source + table[hash];
+            table[hash] = cursor - source;
+            if (candidate >= cursor || cursor - candidate > HUES_LZ4_MAXIMUM_OFFSET || hues_lz4_read32(candidate) != sequence) {
+                cursor += 1 + (misses++ >> 6);  // Skip faster through incompressible data
+                continue;
+            }
+            misses = 0;
+            while (cursor > anchor && candidate > source && cursor[-1] == candidate[-1]) {
+                cursor--;
+                candidate--;
+            }
+            size_t match_length = HUES_LZ4_MINIMUM_MATCH;
+            while (cursor + match_length < literals_limit && cursor[match_length] == candidate[match_length]) {
+                match_length++;
+            }
+            output = hues_lz4_write_sequence(output, output_end, anchor, cursor - anchor, cursor - candidate, match_length);
+            if (output == NULL) {
+                return 0;
+            }
+            cursor += match_length;
+            anchor = cursor;
+            if (cursor < match_limit) {
+                table[hues_lz4_hash(hues_lz4_read32(cursor - 2))] = cursor - 2 - source;
+            }
+        }
+    }
+    output = hues_lz4_write_sequence(output, output_end, anchor, end - anchor, 0, 0);
+    return output == NULL ? 0 : (size_t) (output - destination);
+}
+
+/**
+ * @fn static int hues_lz4_read_length(const uint8_t** input, const uint8_t* input_end, size_t* length)
+ * @brief Reads the extension bytes of a literal or match length.
+ * @param input The position to read at, advanced past the extension bytes.
+ * @param input_end The end of the compressed data.
+ * @param length The length, incremented by the extension bytes.
+ * @return 0 on success, -1 if the data is truncated.
+ */
+static int hues_lz4_read_length(const uint8_t** input, const uint8_t* input_end, size_t* length) {
+    uint8_t byte;
+    do {
+        if (*input >= input_end) {
+            return -1;
+        }
+        byte = *(*input)++;
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+long hues_lz4_decompress(const char* source, size_t size, char* destination, size_t capacity) {
+    const uint8_t* input = (const uint8_t*) source;
+    const uint8_t* input_end = input + size;
+    char* output = destination;
+    while (input < input_end) {
+        uint8_t token = *input++;
+        size_t literals_length = token >> 4;
+        if (literals_length == 15 && hues_lz4_read_length(&input, input_end, &literals_length) != 0) {
+            return -1;
+        }
+        if (literals_length > (size_t) (input_end - input) || literals_length > capacity - (size_t) (output - destination)) {
+            return -1;
+        }
+        memcpy(output, input, literals_length);
+        output += literals_length;
+        input += literals_length;
+        if (input == input_end) {
+            break;  // The last sequence has no match
+        }
+        if (input_end - input < 2) {
+            return -1;
+        }
+        size_t offset = input[0] | (size_t) input[1] << 8;
+        input += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15 && hues_lz4_read_length(&input, input_end, &match_length) != 0) {
+            return -1;
+        }
+        match_length += HUES_LZ4_MINIMUM_MATCH;
+        if (offset == 0 || offset > (size_t) (output - destination) || match_length > capacity - (size_t) (output - destination)) {
+            return -1;
+        }
+        const char* match = output - offset;
+        for (size_t i = 0; i < match_length; i++) {
+            output[i] = match[i];  // Byte by byte, as the match may overlap the output
+        }
+        output += match_length;
+    }
+    return output - destination;
+}
@@ -0,0 +1,573 @@
+/**
+ * @file hues_preload.c
+ * @brief Interposer tracing the libc calls of an unmodified program, loaded with LD_PRELOAD=libhues_preload.so
+ */
+
+#define _GNU_SOURCE  // RTLD_NEXT
+
+#include "hues.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+/**
+ * @def HUES_PRELOAD_BUFFER_SIZE
+ * @brief Size of the buffer of binary records of a thread, written to the output file in one write(2) once full.
+ */
+#define HUES_PRELOAD_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @def HUES_PRELOAD_LOCATION_BOUND
+ * @brief Upper bound of the size taken by the code location in a binary record.
+ */
+#define HUES_PRELOAD_LOCATION_BOUND 256
+
+/**
+ * @def HUES_PRELOAD_FLUSH_ATTEMPTS
+ * @brief Number of times the buffer of another thread is tried when the process exits, while that thread writes to it.
+ */
+#define HUES_PRELOAD_FLUSH_ATTEMPTS 1000
+
+/**
+ * @def HUES_PRELOAD_HAS_MODE(flags)
+ * @brief Whether an open call with the given flags takes a mode. O_TMPFILE shares bits with O_DIRECTORY, so all of them must be set.
+ * @param flags The flags of the call.
+ */
+#define HUES_PRELOAD_HAS_MODE(flags) (((flags) & O_CREAT) || ((flags) & O_TMPFILE) == O_TMPFILE)
+
+/**
+ * @struct hues_preload_thread
+ * @brief Represents the buffer of records of a thread. Only the thread writes to it, except when the process exits or forks,
+ * and the buffers of exited threads are taken over by new ones.
+ */
+typedef struct hues_preload_thread {
+    int busy;  /**< Set while hues works for the thread, so that the libc calls hues makes are not traced, or while another thread flushes it. */
+    int idle;  /**< Set once the thread exited, until a new thread takes the buffer over. */
+    size_t length;  /**< Length of the records buffered. */
+    struct hues_preload_thread* next;  /**< Buffer allocated before. */
+    char data[HUES_PRELOAD_BUFFER_SIZE] __attribute__((aligned(8)));  /**< Binary records. */
+} hues_preload_thread;
+
+/**
+ * @struct hues_preload_call
+ * @brief Represents a call of an interposed function being recorded.
+ */
+typedef struct {
+    hues_preload_thread* thread;  /**< Buffer of the calling thread. */
+    uint64_t start;  /**< Value returned by hues_hook_enter. */
+    hues_arguments arguments;  /**< Arguments and value returned captured. */
+} hues_preload_call;
+
+/**
+ * @def HUES_PRELOAD_HOOK(funcname)
+ * @brief Initializes the hook of an interposed function, whose messages are the texts of its records.
+ * @param funcname The name of the function.
+ */
+#define HUES_PRELOAD_HOOK(funcname) { .name = #funcname, .message = "[TRACE] '" #funcname "' called\n", .sample_message = "[TRACE] '" #funcname "' took %llu ns\n" }
+
+/**
+ * @def HUES_PRELOAD_RESOLVE(funcname)
+ * @brief Looks the original function up, if the program calls it before the library is initialized.
+ * @param funcname The name of the function.
+ */
+#define HUES_PRELOAD_RESOLVE(funcname)                                           \
+    if (__builtin_expect(__atomic_load_n(&original_##funcname, __ATOMIC_RELAXED) == NULL, 0)) { \
+        hues_preload_resolve();                                                  \
+    }
+
+extern void* __libc_malloc(size_t size);
+
+static void* (*original_malloc)(size_t) = NULL;
+static int (*original_open)(const char*, int, ...) = NULL;
+static int (*original_open64)(const char*, int, ...) = NULL;
+static int (*original___open_2)(const char*, int) = NULL;
+static int (*original___open64_2)(const char*, int) = NULL;
+static int (*original_openat)(int, const char*, int, ...) = NULL;
+static int (*original_openat64)(int, const char*, int, ...) = NULL;
+static ssize_t (*original_read)(int, void*, size_t) = NULL;
+static ssize_t (*original___read_chk)(int, void*, size_t, size_t) = NULL;
+static ssize_t (*original_write)(int, const void*, size_t) = NULL;
+static int (*original_connect)(int, const struct sockaddr*, socklen_t) = NULL;
+
+static hues_hook hues_preload_hook_malloc = HUES_PRELOAD_HOOK(malloc);
+static hues_hook hues_preload_hook_open = HUES_PRELOAD_HOOK(open);
+static hues_hook hues_preload_hook_open64 = HUES_PRELOAD_HOOK(open64);
+static hues_hook hues_preload_hook_openat = HUES_PRELOAD_HOOK(openat);
+static hues_hook hues_preload_hook_openat64 = HUES_PRELOAD_HOOK(openat64);
+static hues_hook hues_preload_hook_read = HUES_PRELOAD_HOOK(read);
+static hues_hook hues_preload_hook_write = HUES_PRELOAD_HOOK(write);
+static hues_hook hues_preload_hook_connect = HUES_PRELOAD_HOOK(connect);
+
+static int hues_preload_running = 0;
+static int hues_preload_fd = -1;
+static int hues_preload_report = 0;
+static hues_preload_thread* hues_preload_threads = NULL;
+static pthread_key_t hues_preload_key;
+static __thread hues_preload_thread* hues_thread_preload __attribute__((tls_model("initial-exec"))) = NULL;
+static __thread int hues_thread_preload_exited __attribute__((tls_model("initial-exec"))) = 0;
+static __thread int hues_thread_preload_resolving __attribute__((tls_model("initial-exec"))) = 0;
+
+/**
+ * @fn static void hues_preload_resolve()
+ * @brief Looks the original functions up in the libraries loaded after this one. dlsym may allocate, so malloc is served by
+ * the allocator of the C library meanwhile.
+ */
+static void hues_preload_resolve() {
+    hues_thread_preload_resolving = 1;
+    __atomic_store_n(&original_malloc, (void* (*)(size_t)) dlsym(RTLD_NEXT, "malloc"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original_open, (int (*)(const char*, int, ...)) dlsym(RTLD_NEXT, "open"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original_open64, (int (*)(const char*, int, ...)) dlsym(RTLD_NEXT, "open64"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original___open_2, (int (*)(const char*, int)) dlsym(RTLD_NEXT, "__open_2"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original___open64_2, (int (*)(const char*, int)) dlsym(RTLD_NEXT, "__open64_2"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original_openat, (int (*)(int, const char*, int, ...)) dlsym(RTLD_NEXT, "openat"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original_openat64, (int (*)(int, const char*, int, ...)) dlsym(RTLD_NEXT, "openat64"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original_read, (ssize_t (*)(int, void*, size_t)) dlsym(RTLD_NEXT, "read"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original___read_chk, (ssize_t (*)(int, void*, size_t, size_t)) dlsym(RTLD_NEXT, "__read_chk"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original_write, (ssize_t (*)(int, const void*, size_t)) dlsym(RTLD_NEXT, "write"), __ATOMIC_RELAXED);
+    __atomic_store_n(&original_connect, (int (*)(int, const struct sockaddr*, socklen_t)) dlsym(RTLD_NEXT, "connect"), __ATOMIC_RELAXED);
+    hues_thread_preload_resolving = 0;
+}
+
+/**
+ * @fn static void hues_preload_flush(hues_preload_thread* thread)
+ * @brief Writes the records of a buffer to the output file. The file is open with O_APPEND, so the buffers of all threads
+ * and processes are appended whole, without a lock.
+ * @param thread The buffer, owned by the caller.
+ */
+static void hues_preload_flush(hues_preload_thread* thread) {
+    size_t written = 0;
+    while (written < thread->length) {
+        ssize_t result = original_write(hues_preload_fd, thread->data + written, thread->length - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        written += result;
+    }
+    thread->length = 0;
+}
+
+/**
+ * @fn static hues_preload_thread* hues_preload_thread_get()
+ * @brief Gives the calling thread a buffer: one left by an exited thread, or a new one, mapped rather than allocated.
+ * @return The buffer, NULL if the thread exits or no buffer can be mapped.
+ */
+static hues_preload_thread* hues_preload_thread_get() {
+    if (hues_thread_preload_exited) {
+        return NULL;
+    }
+    hues_preload_thread* thread = __atomic_load_n(&hues_preload_threads, __ATOMIC_ACQUIRE);
+    for (; thread != NULL; thread = thread->next) {
+        int idle = 1;
+        if (__atomic_load_n(&thread->idle, __ATOMIC_RELAXED) && __atomic_compare_exchange_n(&thread->idle, &idle, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (thread == NULL) {
+        void* mapping = mmap(NULL, sizeof(hues_preload_thread), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            return NULL;
+        }
+        thread = mapping;
+        thread->next = __atomic_load_n(&hues_preload_threads, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&hues_preload_threads, &thread->next, thread, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+    __atomic_store_n(&thread->busy, 1, __ATOMIC_RELAXED);  // pthread_setspecific may allocate
+    hues_thread_preload = thread;
+    pthread_setspecific(hues_preload_key, thread);
+    __atomic_store_n(&thread->busy, 0, __ATOMIC_RELEASE);
+    return thread;
+}
+
+/**
+ * @fn static void hues_preload_thread_exit(void* argument)
+ * @brief Flushes the buffer of an exiting thread and leaves it to the next thread.
+ * @param argument The buffer.
+ */
+static void hues_preload_thread_exit(void* argument) {
+    hues_preload_thread* thread = argument;
+    hues_thread_preload_exited = 1;
+    hues_thread_preload = NULL;
+    if (!__atomic_exchange_n(&thread->busy, 1, __ATOMIC_ACQUIRE)) {
+        hues_preload_flush(thread);
+        __atomic_store_n(&thread->busy, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&thread->idle, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @fn static int hues_preload_enter(hues_preload_call* call, hues_hook* hook)
+ * @brief Starts recording a call of an interposed function, unless hues itself makes it, or the call is only counted.
+ * @param call The call.
+ * @param hook The hook of the function.
+ * @return Whether to capture the call and end it with hues_preload_exit, otherwise the original function is called right away.
+ */
+static int hues_preload_enter(hues_preload_call* call, hues_hook* hook) {
+    if (!__atomic_load_n(&hues_preload_running, __ATOMIC_RELAXED) || __atomic_load_n(&hues_glob_hook_mode, __ATOMIC_RELAXED) == 0) {
+        return 0;
+    }
+    call->thread = hues_thread_preload != NULL ? hues_thread_preload : hues_preload_thread_get();
+    if (call->thread == NULL || __atomic_exchange_n(&call->thread->busy, 1, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    int error = errno;
+    call->start = hues_hook_enter(hook);
+    call->arguments.length = 0;
+    __atomic_store_n(&call->thread->busy, 0, __ATOMIC_RELEASE);
+    errno = error;
+    return call->start != HUES_HOOK_COUNTED;
+}
+
+/**
+ * @fn static void hues_preload_exit(hues_preload_call* call, hues_hook* hook)
+ * @brief Ends recording a call: adds its latency to the statistics, and buffers its record if it is traced or sampled.
+ * @param call The call, its arguments and value returned captured.
+ * @param hook The hook of the function.
+ */
+static void hues_preload_exit(hues_preload_call* call, hues_hook* hook) {
+    hues_preload_thread* thread = call->thread;
+    if (__atomic_exchange_n(&thread->busy, 1, __ATOMIC_ACQUIRE)) {
+        return;  // Flushed by the exiting process
+    }
+    int error = errno;
+    uint64_t latency = hues_hook_exit(hook, call->start);
+    if (call->start == HUES_HOOK_TRACE || latency != 0) {
+        char text[128];
+        int length = snprintf(text, sizeof(text), latency != 0 ? hook->sample_message : hook->message, (unsigned long long) latency);
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        hues_record record = {
+            .level = HUES_LEVEL_TRACE,
+            .timestamp = (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec,
+            .location = { "libc", hook->name, 0 },
+            .text = text,
+            .length = length > 0 ? (size_t) length : 0,
+            .header_length = sizeof("[TRACE] ") - 1,
+            .arguments = call->arguments.data,
+            .arguments_length = call->arguments.length
+        };
+        if (HUES_PRELOAD_BUFFER_SIZE - thread->length < HUES_RECORD_SIZE(HUES_PRELOAD_LOCATION_BOUND + sizeof(text) + HUES_ARGUMENTS_SIZE + sizeof(uint16_t))) {
+            hues_preload_flush(thread);
+        }
+        thread->length += hues_record_encode(&record, hues_sequence_next(), thread->data + thread->length, HUES_PRELOAD_BUFFER_SIZE - thread->length);
+    }
+    __atomic_store_n(&thread->busy, 0, __ATOMIC_RELEASE);
+    errno = error;
+}
+
+/**
+ * @fn static void hues_preload_fork_prepare()
+ * @brief Flushes the buffer of the forking thread, so that its records are not written twice.
+ */
+static void hues_preload_fork_prepare() {
+    hues_preload_thread* thread = hues_thread_preload;
+    if (thread != NULL && !__atomic_exchange_n(&thread->busy, 1, __ATOMIC_ACQUIRE)) {
+        hues_preload_flush(thread);
+        __atomic_store_n(&thread->busy, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @fn static void hues_preload_fork_child()
+ * @brief Empties the buffers in a forked child, their records being the parent's, and leaves those of the threads not copied
+ * to the next threads of the child.
+ */
+static void hues_preload_fork_child() {
+    for (hues_preload_thread* thread = hues_preload_threads; thread != NULL; thread = thread->next) {
+        thread->length = 0;
+        thread->busy = 0;
+        thread->idle = thread != hues_thread_preload;
+    }
+}
+
+/**
+ * @fn static void hues_preload_initialize()
+ * @brief Opens the output file and sets the hooks up from the environment, when the library is loaded:
+ * HUES_PRELOAD_OUTPUT, the binary log file (hues_preload.<pid>.bin by default);
+ * HUES_PRELOAD_SAMPLE, to record one call in this many with its latency rather than all of them;
+ * HUES_PRELOAD_PROFILE, to only count the calls and their latencies. Both print a profiling report on exit.
+ */
+__attribute__((constructor)) static void hues_preload_initialize() {
+    hues_preload_resolve();
+    char path[PATH_MAX];
+    const char* output = getenv("HUES_PRELOAD_OUTPUT");
+    if (output == NULL) {
+        snprintf(path, sizeof(path), "hues_preload.%d.bin", (int) getpid());
+        output = path;
+    }
+    hues_preload_fd = original_open(output, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    struct stat status;
+    if (hues_preload_fd < 0 || fstat(hues_preload_fd, &status) != 0) {
+        fprintf(stderr, "libhues_preload: cannot open %s: %s\n", output, strerror(errno));
+        return;
+    }
+    if (status.st_size == 0) {
+        hues_file_header header = { .magic = HUES_FILE_MAGIC, .version = HUES_FILE_VERSION, .format = HUES_FILE_FORMAT_BINARY, .compression = HUES_FILE_COMPRESSION_NONE };
+        original_write(hues_preload_fd, &header, sizeof(header));
+    }
+    if (pthread_key_create(&hues_preload_key, hues_preload_thread_exit) != 0) {
+        return;
+    }
+    pthread_atfork(hues_preload_fork_prepare, NULL, hues_preload_fork_child);
+    const char* sample = getenv("HUES_PRELOAD_SAMPLE");
+    if (sample != NULL && strtoul(sample, NULL, 10) > 0) {
+        hues_hook_tracing_enable(0);
+        hues_hook_sampling_enable(strtoul(sample, NULL, 10), 0);
+        hues_preload_report = 1;
+    }
+    const char* profile = getenv("HUES_PRELOAD_PROFILE");
+    if (profile != NULL && atoi(profile) != 0) {
+        hues_hook_tracing_enable(0);
+        hues_hook_profiling_enable(1);
+        hues_preload_report = 1;
+    }
+    __atomic_store_n(&hues_preload_running, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @fn static void hues_preload_finalize()
+ * @brief Stops tracing when the process exits, flushes the buffers of every thread and prints the profiling report.
+ * The buffers are left busy, so that the threads still running pass their calls through.
+ */
+__attribute__((destructor)) static void hues_preload_finalize() {
+    if (!__atomic_exchange_n(&hues_preload_running, 0, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    for (hues_preload_thread* thread = __atomic_load_n(&hues_preload_threads, __ATOMIC_ACQUIRE); thread != NULL; thread = thread->next) {
+        for (int attempt = 0; attempt < HUES_PRELOAD_FLUSH_ATTEMPTS; attempt++) {
+            if (!__atomic_exchange_n(&thread->busy, 1, __ATOMIC_ACQUIRE)) {
+                hues_preload_flush(thread);
+                break;
+            }
+            sched_yield();
+        }
+    }
+    if (hues_preload_report) {
+        hues_hook_profile_report(stderr);
+    }
+}
+
+void* malloc(size_t size) {
+    if (__builtin_expect(__atomic_load_n(&original_malloc, __ATOMIC_RELAXED) == NULL, 0)) {
+        if (hues_thread_preload_resolving) {
+            return __libc_malloc(size);
+        }
+        hues_preload_resolve();
+    }
+    hues_preload_call call;
+    if (!hues_preload_enter(&call, &hues_preload_hook_malloc)) {
+        return original_malloc(size);
+    }
+    HUES_ARGUMENT_ADD(&call.arguments, size);
+    void* result = original_malloc(size);
+    hues_arguments_add_result(&call.arguments);
+    HUES_ARGUMENT_ADD(&call.arguments, result);
+    hues_preload_exit(&call, &hues_preload_hook_malloc);
+    return result;
+}
+
+/**
+ * @fn static int hues_preload_open(int (*original)(const char*, int, ...), hues_hook* hook, const char* path, int flags, mode_t mode)
+ * @brief Calls open or open64, which programs built with 64-bit file offsets call instead.
+ * @param original The original function.
+ * @param hook The hook of the function.
+ * @param path The path of the file.
+ * @param flags The flags of the call.
+ * @param mode The mode of a file created, captured only with O_CREAT or O_TMPFILE.
+ * @return The value returned by the original function.
+ */
+static int hues_preload_open(int (*original)(const char*, int, ...), hues_hook* hook, const char* path, int flags, mode_t mode) {
+    hues_preload_call call;
+    if (!hues_preload_enter(&call, hook)) {
+        return original(path, flags, mode);
+    }
+    HUES_ARGUMENT_ADD(&call.arguments, path);
+    HUES_ARGUMENT_ADD(&call.arguments, flags);
+    if (HUES_PRELOAD_HAS_MODE(flags)) {
+        HUES_ARGUMENT_ADD(&call.arguments, mode);
+    }
+    int result = original(path, flags, mode);
+    hues_arguments_add_result(&call.arguments);
+    HUES_ARGUMENT_ADD(&call.arguments, result);
+    hues_preload_exit(&call, hook);
+    return result;
+}
+
+int open(const char* path, int flags, ...) {
+    HUES_PRELOAD_RESOLVE(open);
+    mode_t mode = 0;
+    if (HUES_PRELOAD_HAS_MODE(flags)) {
+        va_list list;
+        va_start(list, flags);
+        mode = va_arg(list, mode_t);
+        va_end(list);
+    }
+    return hues_preload_open(original_open, &hues_preload_hook_open, path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...) {
+    HUES_PRELOAD_RESOLVE(open64);
+    mode_t mode = 0;
+    if (HUES_PRELOAD_HAS_MODE(flags)) {
+        va_list list;
+        va_start(list, flags);
+        mode = va_arg(list, mode_t);
+        va_end(list);
+    }
+    return hues_preload_open(original_open64, &hues_preload_hook_open64, path, flags, mode);
+}
+
+/*
+ * Programs built with _FORTIFY_SOURCE call __open_2 when the mode is left out. A call that needs one is passed through, to fail as
+ * it would without the interposer; the others are traced as open.
+ */
+int __open_2(const char* path, int flags) {
+    HUES_PRELOAD_RESOLVE(open);
+    if (HUES_PRELOAD_HAS_MODE(flags)) {
+        return original___open_2(path, flags);
+    }
+    return hues_preload_open(original_open, &hues_preload_hook_open, path, flags, 0);
+}
+
+int __open64_2(const char* path, int flags) {
+    HUES_PRELOAD_RESOLVE(open64);
+    if (HUES_PRELOAD_HAS_MODE(flags)) {
+        return original___open64_2(path, flags);
+    }
+    return hues_preload_open(original_open64, &hues_preload_hook_open64, path, flags, 0);
+}
+
+/**
+ * @fn static int hues_preload_openat(int (*original)(int, const char*, int, ...), hues_hook* hook, int directory_fd, const char* path, int flags, mode_t mode)
+ * @brief Calls openat or openat64, which programs built with 64-bit file offsets call instead.
+ * @param original The original function.
+ * @param hook The hook of the function.
+ * @param directory_fd The directory a relative path starts from.
+ * @param path The path of the file.
+ * @param flags The flags of the call.
+ * @param mode The mode of a file created, captured only with O_CREAT or O_TMPFILE.
+ * @return The value returned by the original function.
+ */
+static int hues_preload_openat(int (*original)(int, const char*, int, ...), hues_hook* hook, int directory_fd, const char* path, int flags, mode_t mode) {
+    hues_preload_call call;
+    if (!hues_preload_enter(&call, hook)) {
+        return original(directory_fd, path, flags, mode);
+    }
+    HUES_ARGUMENT_ADD(&call.arguments, directory_fd);
+    HUES_ARGUMENT_ADD(&call.arguments, path);
+    HUES_ARGUMENT_ADD(&call.arguments, flags);
+    if (HUES_PRELOAD_HAS_MODE(flags)) {
+        HUES_ARGUMENT_ADD(&call.arguments, mode);
+    }
+    int result = original(directory_fd, path, flags, mode);
+    hues_arguments_add_result(&call.arguments);
+    HUES_ARGUMENT_ADD(&call.arguments, result);
+    hues_preload_exit(&call, hook);
+    return result;
+}
+
+int openat(int directory_fd, const char* path, int flags, ...) {
+    HUES_PRELOAD_RESOLVE(openat);
+    mode_t mode = 0;
+    if (HUES_PRELOAD_HAS_MODE(flags)) {
+        va_list list;
+        va_start(list, flags);
+        mode = va_arg(list, mode_t);
+        va_end(list);
+    }
+    return hues_preload_openat(original_openat, &hues_preload_hook_openat, directory_fd, path, flags, mode);
+}
+
+int openat64(int directory_fd, const char* path, int flags, ...) {
+    HUES_PRELOAD_RESOLVE(openat64);
+    mode_t mode = 0;
+    if (HUES_PRELOAD_HAS_MODE(flags)) {
+        va_list list;
+        va_start(list, flags);
+        mode = va_arg(list, mode_t);
+        va_end(list);
+    }
+    return hues_preload_openat(original_openat64, &hues_preload_hook_openat64, directory_fd, path, flags, mode);
+}
+
+/**
+ * @fn static ssize_t hues_preload_read(int fd, void* buffer, size_t size)
+ * @brief Calls read, for read and for its fortified version.
+ * @param fd The file descriptor.
+ * @param buffer The buffer filled.
+ * @param size The size to read.
+ * @return The value returned by the original function.
+ */
+static ssize_t hues_preload_read(int fd, void* buffer, size_t size) {
+    hues_preload_call call;
+    if (!hues_preload_enter(&call, &hues_preload_hook_read)) {
+        return original_read(fd, buffer, size);
+    }
+    HUES_ARGUMENT_ADD(&call.arguments, fd);
+    HUES_ARGUMENT_ADD(&call.arguments, buffer);
+    HUES_ARGUMENT_ADD(&call.arguments, size);
+    ssize_t result = original_read(fd, buffer, size);
+    hues_arguments_add_result(&call.arguments);
+    HUES_ARGUMENT_ADD(&call.arguments, result);
+    hues_preload_exit(&call, &hues_preload_hook_read);
+    return result;
+}
+
+ssize_t read(int fd, void* buffer, size_t size) {
+    HUES_PRELOAD_RESOLVE(read);
+    return hues_preload_read(fd, buffer, size);
+}
+
+/*
+ * Programs built with _FORTIFY_SOURCE call __read_chk when the size of the buffer is known. An overflowing call is passed through,
+ * to abort as it would without the interposer; the others are traced as read.
+ */
+ssize_t __read_chk(int fd, void* buffer, size_t size, size_t buffer_size) {
+    HUES_PRELOAD_RESOLVE(read);
+    if (size > buffer_size) {
+        return original___read_chk(fd, buffer, size, buffer_size);
+    }
+    return hues_preload_read(fd, buffer, size);
+}
+
+ssize_t write(int fd, const void* buffer, size_t size) {
+    HUES_PRELOAD_RESOLVE(write);
+    hues_preload_call call;
+    if (!hues_preload_enter(&call, &hues_preload_hook_write)) {
+        return original_write(fd, buffer, size);
+    }
+    HUES_ARGUMENT_ADD(&call.arguments, fd);
+    HUES_ARGUMENT_ADD(&call.arguments, buffer);
+    HUES_ARGUMENT_ADD(&call.arguments, size);
+    ssize_t result = original_write(fd, buffer, size);
+    hues_arguments_add_result(&call.arguments);
+    HUES_ARGUMENT_ADD(&call.arguments, result);
+    hues_preload_exit(&call, &hues_preload_hook_write);
+    return result;
+}
+
+int connect(int fd, const struct sockaddr* address, socklen_t address_length) {
+    HUES_PRELOAD_RESOLVE(connect);
+    hues_preload_call call;
+    if (!hues_preload_enter(&call, &hues_preload_hook_connect)) {
+        return original_connect(fd, address, address_length);
+    }
+    HUES_ARGUMENT_ADD(&call.arguments, fd);
+    HUES_ARGUMENT_ADD(&call.arguments, address);
+    HUES_ARGUMENT_ADD(&call.arguments, address_length);
+    int result = original_connect(fd, address, address_length);
+    hues_arguments_add_result(&call.arguments);
+    HUES_ARGUMENT_ADD(&call.arguments, result);
+    hues_preload_exit(&call, &hues_preload_hook_connect);
+    return result;
+}
@@ -0,0 +1,655 @@
+/**
+ * @file hues_ring.c
+ * @brief Rings of binary records kept in shared memory mappings
+ */
+
+#include "hues.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __x86_64__
+#include <nmmintrin.h>
+#endif
+
+/**
+ * @def HUES_RING_LOCATION_SIZE
+ * @brief Maximum size of the code location stored in a record.
+ */
+#define HUES_RING_LOCATION_SIZE 256
+
+/**
+ * @struct hues_ring
+ * @brief Represents a ring mapped for writing.
+ */
+typedef struct {
+    hues_ring_header* header;  /**< Mapped ring header. */
+    char* data;  /**< Mapped data area. */
+    size_t mapping_size;  /**< Size of the whole mapping. */
+    int fd;  /**< Descriptor of the mapped file. */
+} hues_ring;
+
+/**
+ * @def HUES_CRC32C_POLYNOMIAL
+ * @brief Reversed Castagnoli polynomial of CRC32C, the one the SSE4.2 crc32 instruction computes.
+ */
+#define HUES_CRC32C_POLYNOMIAL 0x82f63b78u
+
+/**
+ * @var hues_crc32c_table
+ * @brief CRC32C of every byte followed by 0 to 7 zero bytes, for the table driven computation.
+ */
+static uint32_t hues_crc32c_table[8][256];
+
+/**
+ * @var hues_crc32c_update
+ * @brief Computation of the CRC32C chosen for the CPU, taking and returning the CRC register without its final inversion.
+ */
+static uint32_t (*hues_crc32c_update)(uint32_t crc, const uint8_t* bytes, size_t length);
+
+static pthread_once_t hues_crc32c_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @fn static uint32_t hues_crc32c_software(uint32_t crc, const uint8_t* bytes, size_t length)
+ * @brief Computes a CRC32C 8 bytes at a time with lookup tables (slicing-by-8).
+ * @param crc The CRC register.
+ * @param bytes The data.
+ * @param length The length of the data.
+ * @return The CRC register.
+ */
+static uint32_t hues_crc32c_software(uint32_t crc, const uint8_t* bytes, size_t length) {
+    const uint32_t (*table)[256] = (const uint32_t (*)[256]) hues_crc32c_table;
+    while (length >= 8) {
+        crc ^= bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+        crc = table[7][crc & 0xff] ^ table[6][(crc >> 8) & 0xff] ^ table[5][(crc >> 16) & 0xff] ^ table[4][crc >> 24]
+            ^ table[3][bytes[4]] ^ table[2][bytes[5]] ^ table[1][bytes[6]] ^ table[0][bytes[7]];
+        bytes += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = table[0][(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef __x86_64__
+/**
+ * @fn static uint32_t hues_crc32c_hardware(uint32_t crc, const uint8_t* bytes, size_t length)
+ * @brief Computes a CRC32C 8 bytes at a time with the SSE4.2 crc32 instruction.
+ * @param crc The CRC register.
+ * @param bytes The data.
+ * @param length The length of the data.
+ * @return The CRC register.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t hues_crc32c_hardware(uint32_t crc, const uint8_t* bytes, size_t length) {
+    uint64_t value = crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        value = _mm_crc32_u64(value, word);
+        bytes += 8;
+        length -= 8;
+    }
+    crc = (uint32_t) value;
+    while (length-- > 0) {
+        crc = _mm_crc32_u8(crc, *bytes++);
+    }
+    return crc;
+}
+#endif
+
+/**
+ * @fn static void hues_crc32c_initialize()
+ * @brief Fills the CRC32C tables and picks the computation the CPU supports.
+ */
+static void hues_crc32c_initialize() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ HUES_CRC32C_POLYNOMIAL : crc >> 1;
+        }
+        hues_crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int slice = 1; slice < 8; slice++) {
+            uint32_t previous = hues_crc32c_table[slice - 1][i];
+            hues_crc32c_table[slice][i] = (previous >> 8) ^ hues_crc32c_table[0][previous & 0xff];
+        }
+    }
+    hues_crc32c_update = hues_crc32c_software;
+#ifdef __x86_64__
+    if (__builtin_cpu_supports("sse4.2")) {
+        hues_crc32c_update = hues_crc32c_hardware;
+    }
+#endif
+}
+
+uint32_t hues_checksum(const void* data, size_t length, uint32_t previous) {
+    pthread_once(&hues_crc32c_once, hues_crc32c_initialize);
+    return ~hues_crc32c_update(~previous, data, length);
+}
+
+uint32_t hues_record_checksum(const hues_record_header* header, const void* payload) {
+    hues_record_header copy = *header;
+    copy.checksum = 0;
+    uint32_t checksum = hues_checksum(&copy, sizeof(copy), 0);
+    return payload != NULL ? hues_checksum(payload, header->length, checksum) : checksum;
+}
+
+/**
+ * @fn static size_t hues_arguments_print(char* buffer, size_t used, size_t limit, const char* format, ...)
+ * @brief Appends formatted text to a buffer, truncating it at a limit.
+ * @param buffer The buffer.
+ * @param used The length already in the buffer.
+ * @param limit The maximum length of the buffer contents.
+ * @param format The printf format of the text.
+ * @return The new length of the buffer contents.
+ */
+static size_t hues_arguments_print(char* buffer, size_t used, size_t limit, const char* format, ...) {
+    if (used >= limit) {
+        return used;
+    }
+    va_list list;
+    va_start(list, format);
+    int written = vsnprintf(buffer + used, limit - used + 1, format, list);
+    va_end(list);
+    return written < 0 ? used : used + written < limit ? used + written : limit;
+}
+
+size_t hues_arguments_line(const char* text, size_t text_length, const void* arguments, size_t arguments_length, char* buffer, size_t size) {
+    int newline = text_length > 0 && text[text_length - 1] == '\n';
+    size_t limit = size - 2;  // Room for the newline and the null character
+    size_t used = text_length - newline < limit ? text_length - newline : limit;
+    memcpy(buffer, text, used);
+    const uint8_t* data = arguments;
+    size_t offset = 0;
+    size_t count = 0;
+    int result = 0;
+    while (offset < arguments_length) {
+        uint8_t type = data[offset++];
+        if (type == HUES_ARGUMENT_RESULT) {
+            used = hues_arguments_print(buffer, used, limit, count > 0 ? ") returned " : " returned ");
+            result = 1;
+            continue;
+        }
+        if (!result) {
+            used = hues_arguments_print(buffer, used, limit, count == 0 ? " with (" : ", ");
+            count++;
+        }
+        if (type == HUES_ARGUMENT_STRING || type == HUES_ARGUMENT_STRING_CUT) {
+            size_t length = offset < arguments_length ? data[offset++] : 0;
+            length = length < arguments_length - offset ? length : arguments_length - offset;
+            used = hues_arguments_print(buffer, used, limit, "\"");
+            for (size_t i = 0; i < length && used < limit; i++) {
+                buffer[used++] = data[offset + i] >= 0x20 && data[offset + i] < 0x7f ? data[offset + i] : '.';
+            }
+            used = hues_arguments_print(buffer, used, limit, type == HUES_ARGUMENT_STRING_CUT ? "...\"" : "\"");
+            offset += length;
+            continue;
+        }
+        if (arguments_length - offset < sizeof(uint64_t)) {
+            break;
+        }
+        uint64_t value;
+        memcpy(&value, data + offset, sizeof(value));
+        offset += sizeof(value);
+        if (type == HUES_ARGUMENT_INT) {
+            used = hues_arguments_print(buffer, used, limit, "%lld", (long long) value);
+        } else if (type == HUES_ARGUMENT_UINT) {
+            used = hues_arguments_print(buffer, used, limit, "%llu", (unsigned long long) value);
+        } else if (type == HUES_ARGUMENT_DOUBLE) {
+            double number;
+            memcpy(&number, &value, sizeof(number));
+            used = hues_arguments_print(buffer, used, limit, "%g", number);
+        } else if (type == HUES_ARGUMENT_POINTER) {
+            used = value == 0 ? hues_arguments_print(buffer, used, limit, "NULL") : hues_arguments_print(buffer, used, limit, "0x%llx", (unsigned long long) value);
+        } else {
+            break;
+        }
+    }
+    if (count > 0 && !result) {
+        used = hues_arguments_print(buffer, used, limit, ")");
+    }
+    if (newline) {
+        buffer[used++] = '\n';
+    }
+    buffer[used] = '\0';
+    return used;
+}
+
+const void* hues_record_arguments(const hues_record_header* header, size_t* text_length, size_t* arguments_length) {
+    const char* payload = (const char*) (header + 1);
+    size_t location_length = header->location_length <= header->length ? header->location_length : header->length;
+    uint16_t stored_length;
+    *text_length = header->length - location_length;
+    *arguments_length = 0;
+    if (!(header->flags & HUES_RECORD_FLAG_ARGUMENTS) || *text_length < sizeof(stored_length)) {
+        return NULL;
+    }
+    memcpy(&stored_length, payload + header->length - sizeof(stored_length), sizeof(stored_length));
+    if (stored_length > *text_length - sizeof(stored_length)) {
+        return NULL;
+    }
+    *text_length -= stored_length + sizeof(stored_length);
+    *arguments_length = stored_length;
+    return payload + location_length + *text_length;
+}
+
+const char* hues_record_line(const hues_record_header* header, char* buffer, size_t size, size_t* length) {
+    const char* payload = (const char*) (header + 1);
+    size_t location_length = header->location_length <= header->length ? header->location_length : header->length;
+    size_t text_length;
+    size_t arguments_length;
+    const void* arguments = hues_record_arguments(header, &text_length, &arguments_length);
+    if (arguments == NULL) {
+        *length = text_length;
+        return payload + location_length;
+    }
+    *length = hues_arguments_line(payload + location_length, text_length, arguments, arguments_length, buffer, size);
+    return buffer;
+}
+
+/**
+ * @fn static hues_ring* hues_ring_map(int fd, size_t capacity)
+ * @brief Maps a ring file for writing, initializing it if it does not hold a ring yet.
+ * @param fd A descriptor of the ring file, open for reading and writing.
+ * @param capacity The size of the data area for a new ring.
+ * @return The mapped ring, or NULL on error.
+ */
+static hues_ring* hues_ring_map(int fd, size_t capacity) {
+    hues_ring_header existing;
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        return NULL;
+    }
+    int reuse = (size_t) status.st_size >= sizeof(existing)
+        && pread(fd, &existing, sizeof(existing), 0) == sizeof(existing)
+        && existing.magic == HUES_RING_MAGIC
+        && existing.version == HUES_RING_VERSION
+        && (size_t) status.st_size >= sizeof(existing) + existing.capacity;
+    if (reuse) {
+        capacity = existing.capacity;
+    } else {
+        capacity = (capacity + 7) & ~(size_t) 7;
+        if (capacity < 4 * HUES_RECORD_SIZE(HUES_RING_LOCATION_SIZE) || ftruncate(fd, sizeof(hues_ring_header) + capacity) != 0) {
+            return NULL;
+        }
+    }
+    size_t mapping_size = sizeof(hues_ring_header) + capacity;
+    void* mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    hues_ring* ring = malloc(sizeof(hues_ring));
+    ring->header = mapping;
+    ring->data = (char*) mapping + sizeof(hues_ring_header);
+    ring->mapping_size = mapping_size;
+    ring->fd = fd;
+    if (!reuse) {
+        memset(mapping, 0, mapping_size);
+        ring->header->version = HUES_RING_VERSION;
+        ring->header->capacity = capacity;
+        __atomic_store_n(&ring->header->magic, HUES_RING_MAGIC, __ATOMIC_RELEASE);
+    }
+    __atomic_fetch_add(&ring->header->generation, 1, __ATOMIC_RELAXED);
+    return ring;
+}
+
+/**
+ * @fn static void hues_ring_unmap(hues_ring* ring)
+ * @brief Unmaps a ring and closes its file.
+ * @param ring The ring to unmap.
+ */
+static void hues_ring_unmap(hues_ring* ring) {
+    munmap(ring->header, ring->mapping_size);
+    close(ring->fd);
+    free(ring);
+}
+
+/**
+ * @fn static size_t hues_record_location_format(const hues_record* record, char* location)
+ * @brief Formats the code location of a record as stored in binary records.
+ * @param record The record.
+ * @param location A buffer of HUES_RING_LOCATION_SIZE characters receiving the code location.
+ * @return The length of the code location.
+ */
+static size_t hues_record_location_format(const hues_record* record, char* location) {
+    int location_length = snprintf(location, HUES_RING_LOCATION_SIZE, "%s @ %s:%zu", record->location.method_name, record->location.file, record->location.line);
+    if (location_length < 0) {
+        return 0;
+    }
+    return location_length < HUES_RING_LOCATION_SIZE ? location_length : HUES_RING_LOCATION_SIZE - 1;
+}
+
+/**
+ * @fn static size_t hues_record_arguments_size(const hues_record* record, size_t room)
+ * @brief Computes the room taken by the captured values of a record at the end of its payload, dropping them if they do not fit.
+ * @param record The record.
+ * @param room The room left in the payload after the text.
+ * @return The room taken, 0 for none.
+ */
+static size_t hues_record_arguments_size(const hues_record* record, size_t room) {
+    size_t size = record->arguments_length + sizeof(uint16_t);
+    return record->arguments_length > 0 && record->arguments_length <= UINT16_MAX && size <= room ? size : 0;
+}
+
+/**
+ * @fn static void hues_record_arguments_write(char* end, const hues_record* record, size_t size)
+ * @brief Writes the captured values of a record after its text, followed by their length.
+ * @param end A pointer to the end of the text in the payload.
+ * @param record The record.
+ * @param size The room taken, as computed by hues_record_arguments_size.
+ */
+static void hues_record_arguments_write(char* end, const hues_record* record, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    uint16_t length = record->arguments_length;
+    memcpy(end, record->arguments, length);
+    memcpy(end + length, &length, sizeof(length));
+}
+
+size_t hues_record_encode(const hues_record* record, uint64_t sequence, void* buffer, size_t size) {
+    char location[HUES_RING_LOCATION_SIZE];
+    size_t location_length = hues_record_location_format(record, location);
+    size = size & ~(size_t) 7;
+    if (size < HUES_RECORD_SIZE(location_length)) {
+        return 0;
+    }
+    size_t maximum_length = size - sizeof(hues_record_header) - location_length;
+    size_t text_length = record->length < maximum_length ? record->length : maximum_length;
+    size_t arguments_size = hues_record_arguments_size(record, maximum_length - text_length);
+    size_t length = location_length + text_length + arguments_size;
+    hues_record_header* header = buffer;
+    char* payload = (char*) (header + 1);
+    *header = (hues_record_header) {
+        .magic = HUES_RECORD_MAGIC,
+        .length = length,
+        .sequence = sequence,
+        .timestamp = record->timestamp,
+        .level = record->level,
+        .flags = arguments_size > 0 ? HUES_RECORD_FLAG_ARGUMENTS : 0,
+        .location_length = location_length
+    };
+    memcpy(payload, location, location_length);
+    memcpy(payload + location_length, record->text, text_length);
+    hues_record_arguments_write(payload + location_length + text_length, record, arguments_size);
+    memset(payload + length, 0, HUES_RECORD_SIZE(length) - sizeof(hues_record_header) - length);
+    header->checksum = hues_record_checksum(header, payload);
+    return HUES_RECORD_SIZE(length);
+}
+
+/**
+ * @fn static size_t hues_ring_record_location(const hues_record* record, uint64_t capacity, char* location, size_t* text_length, size_t* arguments_size)
+ * @brief Formats the code location of a record and limits its text and captured values to a quarter of a data area.
+ * @param record The record.
+ * @param capacity The size of the data area the record is written to.
+ * @param location A buffer of HUES_RING_LOCATION_SIZE characters receiving the code location.
+ * @param text_length The length of the text to write.
+ * @param arguments_size The room taken by the captured values to write, 0 for none.
+ * @return The length of the code location.
+ */
+static size_t hues_ring_record_location(const hues_record* record, uint64_t capacity, char* location, size_t* text_length, size_t* arguments_size) {
+    size_t location_length = hues_record_location_format(record, location);
+    size_t maximum_length = capacity / 4 - sizeof(hues_record_header) - location_length;
+    *text_length = record->length < maximum_length ? record->length : maximum_length;
+    *arguments_size = hues_record_arguments_size(record, maximum_length - *text_length);
+    return location_length;
+}
+
+/**
+ * @fn static void hues_ring_append(hues_ring* ring, const hues_record* record)
+ * @brief Appends a record to a ring, overwriting the oldest records.
+ * Room is reserved by advancing the shared write position atomically, so any number of threads and processes can append to the same ring.
+ * Records never wrap around the end of the data area: the remaining space is filled with a padding record instead.
+ * The checksum is written after the payload, so a record cut short by the death of the process is detected as torn.
+ * It is zeroed first, so that a reader following the ring never takes the record left there by the previous lap for the new one.
+ * @param ring The ring to append to.
+ * @param record The record to append.
+ */
+static void hues_ring_append(hues_ring* ring, const hues_record* record) {
+    char location[HUES_RING_LOCATION_SIZE];
+    uint64_t capacity = ring->header->capacity;
+    size_t text_length;
+    size_t arguments_size;
+    size_t location_length = hues_ring_record_location(record, capacity, location, &text_length, &arguments_size);
+    size_t length = location_length + text_length + arguments_size;
+    size_t size = HUES_RECORD_SIZE(length);
+    uint64_t position = __atomic_load_n(&ring->header->write_position, __ATOMIC_RELAXED);
+    size_t offset;
+    size_t skip;
+    do {
+        offset = position % capacity;
+        skip = offset + size > capacity ? capacity - offset : 0;
+    } while (!__atomic_compare_exchange_n(&ring->header->write_position, &position, position + skip + size, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    hues_record_header* header = (hues_record_header*) (ring->data + (position + skip) % capacity);
+    // The reserved bytes still hold a complete record of the previous lap: invalidate it before anything else is written
+    if (skip >= sizeof(hues_record_header)) {
+        __atomic_store_n(&((hues_record_header*) (ring->data + offset))->checksum, 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&header->checksum, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (skip >= sizeof(hues_record_header)) {
+        hues_record_header* padding = (hues_record_header*) (ring->data + offset);
+        *padding = (hues_record_header) {
+            .magic = HUES_RECORD_MAGIC,
+            .length = skip - sizeof(hues_record_header),
+            .flags = HUES_RECORD_FLAG_PADDING
+        };
+        __atomic_store_n(&padding->checksum, hues_record_checksum(padding, NULL), __ATOMIC_RELEASE);
+    }
+    char* payload = (char*) (header + 1);
+    *header = (hues_record_header) {
+        .magic = HUES_RECORD_MAGIC,
+        .length = length,
+        .sequence = record->sequence,
+        .timestamp = record->timestamp,
+        .level = record->level,
+        .flags = arguments_size > 0 ? HUES_RECORD_FLAG_ARGUMENTS : 0,
+        .location_length = location_length
+    };
+    memcpy(payload, location, location_length);
+    memcpy(payload + location_length, record->text, text_length);
+    hues_record_arguments_write(payload + location_length + text_length, record, arguments_size);
+    __atomic_store_n(&header->checksum, hues_record_checksum(header, payload), __ATOMIC_RELEASE);
+}
+
+static void hues_flight_recorder_write(hues_sink* sink, const hues_record* record) {
+    hues_ring_append(sink->context, record);
+}
+
+static void hues_flight_recorder_flush(hues_sink* sink) {
+    hues_ring* ring = sink->context;
+    msync(ring->header, ring->mapping_size, MS_ASYNC);
+}
+
+static void hues_flight_recorder_close(hues_sink* sink) {
+    hues_ring_unmap(sink->context);
+    free(sink);
+}
+
+hues_sink* hues_flight_recorder_open(const char* path, size_t capacity) {
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    hues_ring* ring = hues_ring_map(fd, capacity);
+    if (ring == NULL) {
+        close(fd);
+        return NULL;
+    }
+    hues_sink* sink = malloc(sizeof(hues_sink));
+    *sink = (hues_sink) {
+        .minimum_level = HUES_LEVEL_TRACE,
+        .write_function = hues_flight_recorder_write,
+        .flush_function = hues_flight_recorder_flush,
+        .close_function = hues_flight_recorder_close,
+        .context = ring,
+        .binary = 1
+    };
+    hues_configuration_add_sink(sink);
+    return sink;
+}
+
+hues_sink* hues_shm_ring_open(const char* name, size_t capacity) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    hues_ring* ring = hues_ring_map(fd, capacity);
+    if (ring == NULL) {
+        close(fd);
+        return NULL;
+    }
+    hues_sink* sink = malloc(sizeof(hues_sink));
+    *sink = (hues_sink) {
+        .minimum_level = HUES_LEVEL_TRACE,
+        .write_function = hues_flight_recorder_write,
+        .flush_function = NULL,
+        .close_function = hues_flight_recorder_close,
+        .context = ring,
+        .binary = 1
+    };
+    hues_configuration_add_sink(sink);
+    return sink;
+}
+
+/**
+ * @struct hues_bus
+ * @brief Represents a shared memory log bus attached for producing.
+ */
+typedef struct {
+    hues_bus_header* header;  /**< Mapped bus header. */
+    char* data;  /**< Mapped data area. */
+    size_t mapping_size;  /**< Size of the whole mapping. */
+} hues_bus;
+
+/**
+ * @fn static void hues_bus_append(hues_bus* bus, const hues_record* record)
+ * @brief Appends a record to a bus, or drops it if the collector is too far behind.
+ * The length is published first, so that the collector can skip the record if this process dies while writing it,
+ * and the magic number last, so that the collector never reads an incomplete record.
+ * @param bus The bus to append to.
+ * @param record The record to append.
+ */
+static void hues_bus_append(hues_bus* bus, const hues_record* record) {
+    char location[HUES_RING_LOCATION_SIZE];
+    uint64_t capacity = bus->header->capacity;
+    size_t text_length;
+    size_t arguments_size;
+    size_t location_length = hues_ring_record_location(record, capacity, location, &text_length, &arguments_size);
+    size_t length = location_length + text_length + arguments_size;
+    size_t size = HUES_RECORD_SIZE(length);
+    uint64_t position = __atomic_load_n(&bus->header->write_position, __ATOMIC_RELAXED);
+    size_t offset;
+    size_t skip;
+    do {
+        offset = position % capacity;
+        skip = offset + size > capacity ? capacity - offset : 0;
+        if (position + skip + size - __atomic_load_n(&bus->header->read_position, __ATOMIC_ACQUIRE) > capacity) {
+            __atomic_fetch_add(&bus->header->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&bus->header->write_position, &position, position + skip + size, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    if (skip >= sizeof(hues_record_header)) {
+        hues_record_header* padding = (hues_record_header*) (bus->data + offset);
+        hues_record_header local = {
+            .magic = HUES_RECORD_MAGIC,
+            .length = skip - sizeof(hues_record_header),
+            .flags = HUES_RECORD_FLAG_PADDING
+        };
+        local.checksum = hues_record_checksum(&local, NULL);
+        local.magic = 0;
+        *padding = local;
+        __atomic_store_n(&padding->magic, HUES_RECORD_MAGIC, __ATOMIC_RELEASE);
+    }
+    hues_record_header* header = (hues_record_header*) (bus->data + (position + skip) % capacity);
+    char* payload = (char*) (header + 1);
+    __atomic_store_n(&header->length, length, __ATOMIC_RELEASE);
+    memcpy(payload, location, location_length);
+    memcpy(payload + location_length, record->text, text_length);
+    hues_record_arguments_write(payload + location_length + text_length, record, arguments_size);
+    hues_record_header local = {
+        .magic = HUES_RECORD_MAGIC,
+        .length = length,
+        .sequence = record->sequence,
+        .timestamp = record->timestamp,
+        .level = record->level,
+        .flags = arguments_size > 0 ? HUES_RECORD_FLAG_ARGUMENTS : 0,
+        .location_length = location_length
+    };
+    local.checksum = hues_record_checksum(&local, payload);
+    local.magic = 0;
+    *header = local;
+    __atomic_store_n(&header->magic, HUES_RECORD_MAGIC, __ATOMIC_RELEASE);
+}
+
+int hues_bus_record_size(const hues_bus_header* bus, uint64_t position, size_t* size) {
+    const char* data = (const char*) (bus + 1);
+    size_t offset = position % bus->capacity;
+    if (bus->capacity - offset < sizeof(hues_record_header)) {
+        *size = bus->capacity - offset;
+        return 1;
+    }
+    const hues_record_header* header = (const hues_record_header*) (data + offset);
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != HUES_RECORD_MAGIC) {
+        return 0;
+    }
+    if (HUES_RECORD_SIZE(header->length) > bus->capacity - offset) {
+        return -1;
+    }
+    int padding = header->flags & HUES_RECORD_FLAG_PADDING;
+    if (header->checksum != hues_record_checksum(header, padding ? NULL : header + 1)) {
+        return -1;
+    }
+    *size = HUES_RECORD_SIZE(header->length);
+    return 1;
+}
+
+static void hues_bus_write(hues_sink* sink, const hues_record* record) {
+    hues_bus_append(sink->context, record);
+}
+
+static void hues_bus_close(hues_sink* sink) {
+    hues_bus* bus = sink->context;
+    munmap(bus->header, bus->mapping_size);
+    free(bus);
+    free(sink);
+}
+
+hues_sink* hues_bus_open(const char* name) {
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    hues_bus_header existing;
+    struct stat status;
+    int valid = fstat(fd, &status) == 0
+        && (size_t) status.st_size >= sizeof(existing)
+        && pread(fd, &existing, sizeof(existing), 0) == sizeof(existing)
+        && existing.magic == HUES_BUS_MAGIC
+        && existing.version == HUES_RING_VERSION
+        && (size_t) status.st_size >= sizeof(existing) + existing.capacity;
+    void* mapping = valid ? mmap(NULL, sizeof(existing) + existing.capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    hues_bus* bus = malloc(sizeof(hues_bus));
+    bus->header = mapping;
+    bus->data = (char*) mapping + sizeof(hues_bus_header);
+    bus->mapping_size = sizeof(existing) + existing.capacity;
+    hues_sink* sink = malloc(sizeof(hues_sink));
+    *sink = (hues_sink) {
+        .minimum_level = HUES_LEVEL_TRACE,
+        .write_function = hues_bus_write,
+        .flush_function = NULL,
+        .close_function = hues_bus_close,
+        .context = bus,
+        .binary = 1
+    };
+    hues_configuration_add_sink(sink);
+    return sink;
+}
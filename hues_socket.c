@@ -0,0 +1,815 @@
+/**
+ * @file hues_socket.c
+ * @brief Sinks shipping records to other processes over sockets
+ */
+
+#define _GNU_SOURCE  // sendmmsg, program_invocation_short_name
+
+#include "hues.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <syslog.h>
+
+/**
+ * @def HUES_COLLECTOR_LOCATION_BOUND
+ * @brief Upper bound of the size taken by the code location in a binary record.
+ */
+#define HUES_COLLECTOR_LOCATION_BOUND 256
+
+/**
+ * @def HUES_DATAGRAM_BATCH
+ * @brief Maximum number of datagrams sent to syslog or journald in one system call.
+ */
+#define HUES_DATAGRAM_BATCH 64
+
+/**
+ * @def HUES_DATAGRAM_BUFFER_SIZE
+ * @brief Size of the buffer holding the datagrams of a batch.
+ */
+#define HUES_DATAGRAM_BUFFER_SIZE (HUES_DATAGRAM_BATCH * 2048)
+
+/**
+ * @def HUES_DATAGRAM_SIZE
+ * @brief Maximum size of a single datagram sent to syslog or journald.
+ */
+#define HUES_DATAGRAM_SIZE (BUFFER_SIZE + 1024)
+
+/**
+ * @def HUES_NETWORK_BATCH_SIZE
+ * @brief Amount of pending output from which a network sink sends without waiting to be flushed.
+ */
+#define HUES_NETWORK_BATCH_SIZE (64 * 1024)
+
+/**
+ * @def HUES_NETWORK_BACKOFF_MINIMUM
+ * @brief Delay before the first reconnection attempt of a network sink, in milliseconds.
+ */
+#define HUES_NETWORK_BACKOFF_MINIMUM 100
+
+/**
+ * @def HUES_NETWORK_BACKOFF_MAXIMUM
+ * @brief Maximum delay between two reconnection attempts of a network sink, in milliseconds.
+ */
+#define HUES_NETWORK_BACKOFF_MAXIMUM 30000
+
+/**
+ * @def HUES_NETWORK_WRITER_CAPACITY
+ * @brief Capacity of the queue of the background writer when a network sink starts it.
+ */
+#define HUES_NETWORK_WRITER_CAPACITY (1024 * 1024)
+
+/**
+ * @fn static int hues_socket_address(struct sockaddr_un* address, const char* path)
+ * @brief Fills the address of a UNIX socket.
+ * @param address The address to fill.
+ * @param path The path of the socket.
+ * @return 0 on success, -1 if the path is too long.
+ */
+static int hues_socket_address(struct sockaddr_un* address, const char* path) {
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        return -1;
+    }
+    strcpy(address->sun_path, path);
+    return 0;
+}
+
+/**
+ * @struct hues_collector
+ * @brief Represents a connection to hues-collectd.
+ */
+typedef struct {
+    struct sockaddr_un address;  /**< Address of the collector socket. */
+    int fd;  /**< Connected socket, -1 while disconnected. */
+    uint64_t* batch;  /**< Binary records not sent yet, aligned to 8 bytes. */
+    size_t batch_size;  /**< Size of the batch buffer. */
+    size_t used;  /**< Number of bytes in the batch. */
+    uint64_t dropped;  /**< Number of records dropped since the last successful send. */
+    pthread_mutex_t mutex;  /**< Serializes the writers. */
+} hues_collector;
+
+/**
+ * @fn static int hues_collector_reconnect(hues_collector* collector)
+ * @brief Connects to the collector if the connection is not established.
+ * @param collector The connection.
+ * @return 0 if connected, -1 otherwise.
+ */
+static int hues_collector_reconnect(hues_collector* collector) {
+    if (collector->fd >= 0) {
+        return 0;
+    }
+    collector->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (collector->fd < 0) {
+        return -1;
+    }
+    if (connect(collector->fd, (struct sockaddr*) &collector->address, sizeof(collector->address)) != 0) {
+        close(collector->fd);
+        collector->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @fn static void hues_collector_send(hues_collector* collector)
+ * @brief Sends the batch to the collector as a single message, or drops it if the collector is unreachable.
+ * @param collector The connection, locked.
+ */
+static void hues_collector_send(hues_collector* collector) {
+    if (collector->used == 0) {
+        return;
+    }
+    ssize_t sent = -1;
+    if (hues_collector_reconnect(collector) == 0) {
+        do {
+            sent = send(collector->fd, collector->batch, collector->used, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+    }
+    if (sent < 0) {
+        if (collector->fd >= 0) {
+            close(collector->fd);
+            collector->fd = -1;
+        }
+        size_t offset = 0;
+        while (offset < collector->used) {
+            offset += HUES_RECORD_SIZE(((hues_record_header*) ((char*) collector->batch + offset))->length);
+            collector->dropped++;
+        }
+    } else if (collector->dropped > 0) {
+        fprintf(stderr, "hues: %llu records dropped while hues-collectd was unreachable\n", (unsigned long long) collector->dropped);
+        collector->dropped = 0;
+    }
+    collector->used = 0;
+}
+
+static void hues_collector_write(hues_sink* sink, const hues_record* record) {
+    hues_collector* collector = sink->context;
+    pthread_mutex_lock(&collector->mutex);
+    if (collector->used > 0 && collector->used + HUES_RECORD_SIZE(HUES_COLLECTOR_LOCATION_BOUND + record->length + record->arguments_length + sizeof(uint16_t)) > collector->batch_size) {
+        hues_collector_send(collector);  // Start a new batch rather than truncating the record
+    }
+    size_t size = hues_record_encode(record, record->sequence, (char*) collector->batch + collector->used, collector->batch_size - collector->used);
+    collector->used += size;
+    pthread_mutex_unlock(&collector->mutex);
+}
+
+static void hues_collector_flush(hues_sink* sink) {
+    hues_collector* collector = sink->context;
+    pthread_mutex_lock(&collector->mutex);
+    hues_collector_send(collector);
+    pthread_mutex_unlock(&collector->mutex);
+}
+
+static void hues_collector_close(hues_sink* sink) {
+    hues_collector* collector = sink->context;
+    hues_collector_send(collector);
+    if (collector->fd >= 0) {
+        close(collector->fd);
+    }
+    pthread_mutex_destroy(&collector->mutex);
+    free(collector->batch);
+    free(collector);
+    free(sink);
+}
+
+hues_sink* hues_collector_connect(const char* path, size_t batch_size) {
+    hues_collector* collector = malloc(sizeof(hues_collector));
+    collector->fd = -1;
+    if (hues_socket_address(&collector->address, path) != 0 || hues_collector_reconnect(collector) != 0) {
+        free(collector);
+        return NULL;
+    }
+    batch_size &= ~(size_t) 7;
+    if (batch_size == 0 || batch_size > HUES_COLLECTOR_BATCH_SIZE) {
+        batch_size = HUES_COLLECTOR_BATCH_SIZE;
+    }
+    if (batch_size < 2 * HUES_RECORD_SIZE(BUFFER_SIZE)) {
+        batch_size = 2 * HUES_RECORD_SIZE(BUFFER_SIZE);
+    }
+    collector->batch = malloc(batch_size);
+    collector->batch_size = batch_size;
+    collector->used = 0;
+    collector->dropped = 0;
+    pthread_mutex_init(&collector->mutex, NULL);
+    hues_sink* sink = malloc(sizeof(hues_sink));
+    *sink = (hues_sink) {
+        .minimum_level = HUES_LEVEL_TRACE,
+        .write_function = hues_collector_write,
+        .flush_function = hues_collector_flush,
+        .close_function = hues_collector_close,
+        .context = collector,
+        .binary = 1
+    };
+    hues_configuration_add_sink(sink);
+    return sink;
+}
+
+typedef struct hues_datagram hues_datagram;
+
+/**
+ * @typedef size_t (*hues_datagram_format_function)(hues_datagram* datagram, const hues_record* record, char* buffer, size_t size)
+ * @brief Represents a function that formats a record as a datagram of a logging protocol.
+ */
+typedef size_t (*hues_datagram_format_function)(hues_datagram* datagram, const hues_record* record, char* buffer, size_t size);
+
+/**
+ * @struct hues_datagram
+ * @brief Represents a connection to a local logging daemon accepting one record per datagram, such as syslog or journald.
+ */
+struct hues_datagram {
+    struct sockaddr_un address;  /**< Address of the daemon socket. */
+    int fd;  /**< Connected socket, -1 while disconnected. */
+    hues_datagram_format_function format_function;  /**< Function formatting a record as a datagram. */
+    char identifier[64];  /**< Name of the program, as shown by the daemon. */
+    int facility;  /**< Syslog facility, LOG_USER for instance. */
+    pid_t pid;  /**< Process id, refreshed whenever a batch is sent so that forked children report their own. */
+    char* buffer;  /**< Datagrams of the batch, back to back. */
+    size_t used;  /**< Number of bytes in the buffer. */
+    struct iovec vectors[HUES_DATAGRAM_BATCH];  /**< Datagrams of the batch. */
+    struct mmsghdr messages[HUES_DATAGRAM_BATCH];  /**< Headers handed to sendmmsg. */
+    size_t count;  /**< Number of datagrams in the batch. */
+    uint64_t dropped;  /**< Number of datagrams dropped since the last successful send. */
+    pthread_mutex_t mutex;  /**< Serializes the writers. */
+};
+
+/**
+ * @fn static int hues_syslog_severity(hues_level_enum level)
+ * @brief Maps a log level to a syslog severity.
+ * @param level The log level.
+ * @return The syslog severity.
+ */
+static int hues_syslog_severity(hues_level_enum level) {
+    switch (level) {
+        case HUES_LEVEL_TRACE:
+        case HUES_LEVEL_DEBUG:
+            return LOG_DEBUG;
+        case HUES_LEVEL_INFO:
+            return LOG_INFO;
+        case HUES_LEVEL_WARN:
+            return LOG_WARNING;
+        case HUES_LEVEL_SEVERE:
+            return LOG_ERR;
+        case HUES_LEVEL_CRITICAL:
+            return LOG_CRIT;
+        default:
+            return LOG_NOTICE;
+    }
+}
+
+/**
+ * @fn static size_t hues_record_contents(const hues_record* record, const char** contents)
+ * @brief Retrieves the contents of a record without its header and trailing newline, which the daemons replace with their own.
+ * @param record The record.
+ * @param contents The start of the contents.
+ * @return The length of the contents.
+ */
+static size_t hues_record_contents(const hues_record* record, const char** contents) {
+    size_t header_length = record->header_length < record->length ? record->header_length : record->length;
+    size_t length = record->length - header_length;
+    *contents = record->text + header_length;
+    while (length > 0 && (*contents)[length - 1] == '\n') {
+        length--;
+    }
+    return length;
+}
+
+/**
+ * @fn static size_t hues_syslog_format(hues_datagram* datagram, const hues_record* record, char* buffer, size_t size)
+ * @brief Formats a record as an RFC 3164 syslog message.
+ * @param datagram The connection.
+ * @param record The record.
+ * @param buffer The buffer receiving the message.
+ * @param size The size of the buffer.
+ * @return The length of the message.
+ */
+static size_t hues_syslog_format(hues_datagram* datagram, const hues_record* record, char* buffer, size_t size) {
+    time_t seconds = record->timestamp / 1000000000;
+    struct tm local;
+    char date[16];
+    localtime_r(&seconds, &local);
+    strftime(date, sizeof(date), "%b %e %H:%M:%S", &local);
+    const char* contents;
+    size_t length = hues_record_contents(record, &contents);
+    int written = snprintf(buffer, size, "<%d>%s %s[%d]: %.*s", datagram->facility | hues_syslog_severity(record->level), date, datagram->identifier, (int) datagram->pid, (int) length, contents);
+    return written < 0 ? 0 : (size_t) written < size ? (size_t) written : size - 1;
+}
+
+/**
+ * @fn static size_t hues_journald_field(char* buffer, size_t size, const char* name, const char* value, size_t length)
+ * @brief Appends a field of the journald native protocol, in its binary form if the value spans several lines.
+ * @param buffer The buffer receiving the field.
+ * @param size The size of the buffer.
+ * @param name The name of the field.
+ * @param value The value of the field.
+ * @param length The length of the value.
+ * @return The length of the field, 0 if it does not fit.
+ */
+static size_t hues_journald_field(char* buffer, size_t size, const char* name, const char* value, size_t length) {
+    size_t name_length = strlen(name);
+    int multiline = memchr(value, '\n', length) != NULL;
+    size_t field_length = name_length + 1 + (multiline ? 8 : 0) + length + 1;
+    if (field_length > size) {
+        return 0;
+    }
+    memcpy(buffer, name, name_length);
+    char* cursor = buffer + name_length;
+    if (multiline) {
+        *cursor++ = '\n';
+        for (int i = 0; i < 8; i++) {
+            *cursor++ = (uint64_t) length >> (8 * i);  // Little-endian length
+        }
+    } else {
+        *cursor++ = '=';
+    }
+    memcpy(cursor, value, length);
+    cursor[length] = '\n';
+    return field_length;
+}
+
+/**
+ * @fn static size_t hues_journald_format(hues_datagram* datagram, const hues_record* record, char* buffer, size_t size)
+ * @brief Formats a record as an entry of the journald native protocol, with its code location as structured fields.
+ * @param datagram The connection.
+ * @param record The record.
+ * @param buffer The buffer receiving the entry.
+ * @param size The size of the buffer.
+ * @return The length of the entry.
+ */
+static size_t hues_journald_format(hues_datagram* datagram, const hues_record* record, char* buffer, size_t size) {
+    char number[24];
+    const char* contents;
+    size_t length = hues_record_contents(record, &contents);
+    size_t used = 0;
+    snprintf(number, sizeof(number), "%d", hues_syslog_severity(record->level));
+    used += hues_journald_field(buffer + used, size - used, "PRIORITY", number, strlen(number));
+    snprintf(number, sizeof(number), "%d", datagram->facility >> 3);
+    used += hues_journald_field(buffer + used, size - used, "SYSLOG_FACILITY", number, strlen(number));
+    used += hues_journald_field(buffer + used, size - used, "SYSLOG_IDENTIFIER", datagram->identifier, strlen(datagram->identifier));
+    used += hues_journald_field(buffer + used, size - used, "HUES_LEVEL", hues_level_name(record->level), strlen(hues_level_name(record->level)));
+    used += hues_journald_field(buffer + used, size - used, "CODE_FILE", record->location.file, strlen(record->location.file));
+    snprintf(number, sizeof(number), "%zu", record->location.line);
+    used += hues_journald_field(buffer + used, size - used, "CODE_LINE", number, strlen(number));
+    used += hues_journald_field(buffer + used, size - used, "CODE_FUNC", record->location.method_name, strlen(record->location.method_name));
+    if (size - used < length + 16) {
+        length = size - used > 16 ? size - used - 16 : 0;  // Keep the message, truncated, rather than dropping it
+    }
+    used += hues_journald_field(buffer + used, size - used, "MESSAGE", contents, length);
+    return used;
+}
+
+/**
+ * @fn static void hues_datagram_send(hues_datagram* datagram)
+ * @brief Sends the batch to the daemon with as few system calls as possible, or drops it if the daemon is unreachable.
+ * @param datagram The connection, locked.
+ */
+static void hues_datagram_send(hues_datagram* datagram) {
+    size_t sent = 0;
+    if (datagram->fd < 0) {
+        datagram->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (datagram->fd >= 0 && connect(datagram->fd, (struct sockaddr*) &datagram->address, sizeof(datagram->address)) != 0) {
+            close(datagram->fd);
+            datagram->fd = -1;
+        }
+    }
+    while (datagram->fd >= 0 && sent < datagram->count) {
+        for (size_t i = sent; i < datagram->count; i++) {
+            datagram->messages[i] = (struct mmsghdr) { .msg_hdr = { .msg_iov = &datagram->vectors[i], .msg_iovlen = 1 } };
+        }
+        int result = sendmmsg(datagram->fd, datagram->messages + sent, datagram->count - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            close(datagram->fd);
+            datagram->fd = -1;
+            break;
+        }
+        sent += result;
+    }
+    if (sent < datagram->count) {
+        datagram->dropped += datagram->count - sent;
+    } else if (datagram->dropped > 0 && datagram->count > 0) {
+        fprintf(stderr, "hues: %llu records dropped while %s was unreachable\n", (unsigned long long) datagram->dropped, datagram->address.sun_path);
+        datagram->dropped = 0;
+    }
+    datagram->count = 0;
+    datagram->used = 0;
+    datagram->pid = getpid();
+}
+
+static void hues_datagram_write(hues_sink* sink, const hues_record* record) {
+    hues_datagram* datagram = sink->context;
+    pthread_mutex_lock(&datagram->mutex);
+    if (datagram->count == HUES_DATAGRAM_BATCH || HUES_DATAGRAM_BUFFER_SIZE - datagram->used < HUES_DATAGRAM_SIZE) {
+        hues_datagram_send(datagram);
+    }
+    char* buffer = datagram->buffer + datagram->used;
+    size_t length = datagram->format_function(datagram, record, buffer, HUES_DATAGRAM_SIZE);
+    datagram->vectors[datagram->count++] = (struct iovec) { .iov_base = buffer, .iov_len = length };
+    datagram->used += length;
+    pthread_mutex_unlock(&datagram->mutex);
+}
+
+static void hues_datagram_flush(hues_sink* sink) {
+    hues_datagram* datagram = sink->context;
+    pthread_mutex_lock(&datagram->mutex);
+    hues_datagram_send(datagram);
+    pthread_mutex_unlock(&datagram->mutex);
+}
+
+static void hues_datagram_close(hues_sink* sink) {
+    hues_datagram* datagram = sink->context;
+    hues_datagram_send(datagram);
+    if (datagram->fd >= 0) {
+        close(datagram->fd);
+    }
+    pthread_mutex_destroy(&datagram->mutex);
+    free(datagram->buffer);
+    free(datagram);
+    free(sink);
+}
+
+/**
+ * @fn static hues_sink* hues_datagram_open(const char* path, const char* identifier, int facility, hues_datagram_format_function format_function)
+ * @brief Opens a sink sending batches of datagrams to a local logging daemon.
+ * @param path The path of the daemon socket.
+ * @param identifier The name of the program, NULL for the name it was invoked with.
+ * @param facility The syslog facility.
+ * @param format_function The function formatting a record as a datagram.
+ * @return The sink, already added to the configuration, or NULL on error.
+ */
+static hues_sink* hues_datagram_open(const char* path, const char* identifier, int facility, hues_datagram_format_function format_function) {
+    hues_datagram* datagram = malloc(sizeof(hues_datagram));
+    if (hues_socket_address(&datagram->address, path) != 0) {
+        free(datagram);
+        return NULL;
+    }
+    datagram->fd = -1;
+    datagram->format_function = format_function;
+    snprintf(datagram->identifier, sizeof(datagram->identifier), "%s", identifier != NULL ? identifier : program_invocation_short_name);
+    datagram->facility = facility;
+    datagram->pid = getpid();
+    datagram->buffer = malloc(HUES_DATAGRAM_BUFFER_SIZE);
+    datagram->used = 0;
+    datagram->count = 0;
+    datagram->dropped = 0;
+    pthread_mutex_init(&datagram->mutex, NULL);
+    hues_sink* sink = malloc(sizeof(hues_sink));
+    *sink = (hues_sink) {
+        .minimum_level = HUES_LEVEL_TRACE,
+        .write_function = hues_datagram_write,
+        .flush_function = hues_datagram_flush,
+        .close_function = hues_datagram_close,
+        .context = datagram
+    };
+    hues_configuration_add_sink(sink);
+    return sink;
+}
+
+hues_sink* hues_syslog_open(const char* path, const char* identifier, int facility) {
+    return hues_datagram_open(path != NULL ? path : HUES_SYSLOG_PATH, identifier, facility, hues_syslog_format);
+}
+
+hues_sink* hues_journald_open(const char* path, const char* identifier) {
+    return hues_datagram_open(path != NULL ? path : HUES_JOURNALD_PATH, identifier, LOG_USER, hues_journald_format);
+}
+
+/**
+ * @struct hues_network
+ * @brief Represents a connection to a log relay.
+ */
+typedef struct {
+    hues_network_options options;  /**< Options of the sink, with their own copies of the host and port. */
+    int fd;  /**< Non-blocking socket, -1 while disconnected. */
+    int connecting;  /**< Whether a TCP connection is in progress on the socket. */
+    char* buffer;  /**< Records waiting to be sent, aligned to 8 bytes. */
+    size_t head;  /**< Offset of the first byte not sent yet. */
+    size_t used;  /**< Offset of the end of the records. */
+    uint64_t dropped;  /**< Number of records dropped since the buffer was last full. */
+    uint64_t retry_at;  /**< Monotonic time of the next connection attempt, in milliseconds. */
+    uint64_t backoff;  /**< Delay before the next connection attempt after a failure, in milliseconds. */
+    struct addrinfo* addresses;  /**< Addresses of the relay, NULL until resolved. */
+    int resolving;  /**< Whether the resolver thread is running. */
+    int resolver_started;  /**< Whether the resolver thread was started and still has to be joined. */
+    pthread_t resolver;  /**< Thread resolving the host name, so that the writer never waits for DNS. */
+    pthread_mutex_t mutex;  /**< Serializes the writers. */
+} hues_network;
+
+/**
+ * @fn static uint64_t hues_network_now()
+ * @brief Retrieves the monotonic time.
+ * @return The monotonic time in milliseconds.
+ */
+static uint64_t hues_network_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @fn static void hues_network_disconnect(hues_network* network)
+ * @brief Closes the socket of a network sink and schedules the next connection attempt.
+ * @param network The connection, locked.
+ */
+static void hues_network_disconnect(hues_network* network) {
+    if (network->fd >= 0) {
+        close(network->fd);
+        network->fd = -1;
+    }
+    network->connecting = 0;
+    network->retry_at = hues_network_now() + network->backoff;
+    network->backoff = network->backoff * 2 < HUES_NETWORK_BACKOFF_MAXIMUM ? network->backoff * 2 : HUES_NETWORK_BACKOFF_MAXIMUM;
+}
+
+/**
+ * @fn static struct addrinfo* hues_network_lookup(const hues_network* network)
+ * @brief Resolves the host and port of a network sink, blocking until the name servers answer.
+ * @param network The connection, whose options are never changed.
+ * @return The addresses of the relay, or NULL on error.
+ */
+static struct addrinfo* hues_network_lookup(const hues_network* network) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = network->options.type };
+    struct addrinfo* addresses;
+    return getaddrinfo(network->options.host, network->options.port, &hints, &addresses) == 0 ? addresses : NULL;
+}
+
+/**
+ * @fn static void* hues_network_resolve_run(void* argument)
+ * @brief Resolves the relay of a network sink again and replaces its addresses, unless the resolution fails.
+ * @param argument The connection.
+ * @return NULL.
+ */
+static void* hues_network_resolve_run(void* argument) {
+    hues_network* network = argument;
+    struct addrinfo* addresses = hues_network_lookup(network);
+    pthread_mutex_lock(&network->mutex);
+    if (addresses != NULL) {
+        if (network->addresses != NULL) {
+            freeaddrinfo(network->addresses);
+        }
+        network->addresses = addresses;
+    }
+    network->resolving = 0;
+    pthread_mutex_unlock(&network->mutex);
+    return NULL;
+}
+
+/**
+ * @fn static void hues_network_resolve(hues_network* network)
+ * @brief Starts resolving the relay of a network sink again in the background, unless it already is.
+ * @param network The connection, locked.
+ */
+static void hues_network_resolve(hues_network* network) {
+    if (network->resolving) {
+        return;
+    }
+    if (network->resolver_started) {
+        pthread_join(network->resolver, NULL);  // Done: it unlocked the connection before returning
+        network->resolver_started = 0;
+    }
+    if (pthread_create(&network->resolver, NULL, hues_network_resolve_run, network) == 0) {
+        network->resolving = 1;
+        network->resolver_started = 1;
+    }
+}
+
+/**
+ * @fn static int hues_network_connect(hues_network* network)
+ * @brief Starts connecting a network sink if the backoff delay has elapsed, or checks whether a connection in progress is established.
+ * The addresses resolved before are used: when none of them accepts the connection, the relay is resolved again in the background,
+ * for the next attempt.
+ * @param network The connection, locked.
+ * @return 0 if connected, -1 otherwise.
+ */
+static int hues_network_connect(hues_network* network) {
+    if (network->fd >= 0 && !network->connecting) {
+        return 0;
+    }
+    if (network->fd < 0) {
+        if (hues_network_now() < network->retry_at) {
+            return -1;
+        }
+        for (struct addrinfo* address = network->addresses; address != NULL && network->fd < 0; address = address->ai_next) {
+            network->fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+            if (network->fd < 0) {
+                continue;
+            }
+            if (connect(network->fd, address->ai_addr, address->ai_addrlen) == 0) {
+                network->connecting = 0;
+            } else if (errno == EINPROGRESS) {
+                network->connecting = 1;
+            } else {
+                close(network->fd);
+                network->fd = -1;
+            }
+        }
+        if (network->fd < 0) {
+            hues_network_resolve(network);
+            hues_network_disconnect(network);
+            return -1;
+        }
+    }
+    if (network->connecting) {
+        struct pollfd writable = { .fd = network->fd, .events = POLLOUT };
+        if (poll(&writable, 1, 0) == 0) {
+            return -1;
+        }
+        int error = 0;
+        socklen_t error_length = sizeof(error);
+        if (getsockopt(network->fd, SOL_SOCKET, SO_ERROR, &error, &error_length) != 0 || error != 0) {
+            hues_network_disconnect(network);
+            return -1;
+        }
+        network->connecting = 0;
+    }
+    network->backoff = HUES_NETWORK_BACKOFF_MINIMUM;
+    return 0;
+}
+
+/**
+ * @fn static size_t hues_network_datagram_length(const hues_network* network)
+ * @brief Computes the length of the next datagram: as many whole records as fit, or a single truncated one.
+ * @param network The connection, locked.
+ * @return The length of the datagram.
+ */
+static size_t hues_network_datagram_length(const hues_network* network) {
+    const char* start = network->buffer + network->head;
+    size_t available = network->used - network->head;
+    size_t maximum = network->options.datagram_size;
+    if (available <= maximum) {
+        return available;
+    }
+    if (network->options.format == HUES_FILE_FORMAT_TEXT) {
+        const char* newline = memrchr(start, '\n', maximum);
+        return newline != NULL ? (size_t) (newline - start) + 1 : maximum;
+    }
+    size_t length = 0;
+    while (length < available && length + HUES_RECORD_SIZE(((const hues_record_header*) (start + length))->length) <= maximum) {
+        length += HUES_RECORD_SIZE(((const hues_record_header*) (start + length))->length);
+    }
+    return length > 0 ? length : HUES_RECORD_SIZE(((const hues_record_header*) start)->length);
+}
+
+/**
+ * @fn static void hues_network_send(hues_network* network)
+ * @brief Sends as many pending records as the socket accepts without blocking.
+ * @param network The connection, locked.
+ */
+static void hues_network_send(hues_network* network) {
+    while (network->head < network->used) {
+        if (hues_network_connect(network) != 0) {
+            return;
+        }
+        int datagram = network->options.type == SOCK_DGRAM;
+        size_t length = datagram ? hues_network_datagram_length(network) : network->used - network->head;
+        ssize_t sent = send(network->fd, network->buffer + network->head, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (sent < 0 && !(datagram && errno == EMSGSIZE)) {
+            hues_network_disconnect(network);
+            return;
+        }
+        network->head += datagram || sent < 0 ? length : (size_t) sent;  // An oversized datagram is dropped
+    }
+    network->head = 0;
+    network->used = 0;
+}
+
+/**
+ * @fn static int hues_network_reserve(hues_network* network, size_t size)
+ * @brief Makes room for a record in the buffer of a network sink, sending or compacting the pending records if needed.
+ * @param network The connection, locked.
+ * @param size The size of the record.
+ * @return 0 on success, -1 if the buffer is full.
+ */
+static int hues_network_reserve(hues_network* network, size_t size) {
+    if (network->used + size > network->options.buffer_size) {
+        hues_network_send(network);
+    }
+    if (network->used + size > network->options.buffer_size && network->head > 0) {
+        memmove(network->buffer, network->buffer + network->head, network->used - network->head);
+        network->used -= network->head;
+        network->head = 0;
+    }
+    return network->used + size > network->options.buffer_size ? -1 : 0;
+}
+
+static void hues_network_write(hues_sink* sink, const hues_record* record) {
+    hues_network* network = sink->context;
+    pthread_mutex_lock(&network->mutex);
+    int text = network->options.format == HUES_FILE_FORMAT_TEXT;
+    size_t length = record->length < BUFFER_SIZE ? record->length : BUFFER_SIZE;
+    size_t bound = text ? length + 1 : HUES_RECORD_SIZE(HUES_COLLECTOR_LOCATION_BOUND + length + record->arguments_length + sizeof(uint16_t));
+    if (hues_network_reserve(network, bound) != 0) {
+        network->dropped++;
+        pthread_mutex_unlock(&network->mutex);
+        return;
+    }
+    if (network->dropped > 0) {
+        fprintf(stderr, "hues: %llu records dropped while %s:%s was unreachable\n", (unsigned long long) network->dropped, network->options.host, network->options.port);
+        network->dropped = 0;
+    }
+    char* end = network->buffer + network->used;
+    if (text) {
+        memcpy(end, record->text, length);
+        if (length == 0 || end[length - 1] != '\n') {
+            end[length++] = '\n';
+        }
+        network->used += length;
+    } else {
+        network->used += hues_record_encode(record, record->sequence, end, network->options.buffer_size - network->used);
+    }
+    if (network->used - network->head >= HUES_NETWORK_BATCH_SIZE) {
+        hues_network_send(network);
+    }
+    pthread_mutex_unlock(&network->mutex);
+}
+
+static void hues_network_flush(hues_sink* sink) {
+    hues_network* network = sink->context;
+    pthread_mutex_lock(&network->mutex);
+    hues_network_send(network);
+    pthread_mutex_unlock(&network->mutex);
+}
+
+static void hues_network_close(hues_sink* sink) {
+    hues_network* network = sink->context;
+    // Give a connected relay a last chance to take the pending records
+    for (int attempt = 0; attempt < 10 && network->head < network->used && network->fd >= 0; attempt++) {
+        struct pollfd writable = { .fd = network->fd, .events = POLLOUT };
+        poll(&writable, 1, 100);
+        hues_network_send(network);
+    }
+    if (network->fd >= 0) {
+        close(network->fd);
+    }
+    if (network->resolver_started) {
+        pthread_join(network->resolver, NULL);
+    }
+    if (network->addresses != NULL) {
+        freeaddrinfo(network->addresses);
+    }
+    pthread_mutex_destroy(&network->mutex);
+    free(network->buffer);
+    free((char*) network->options.host);
+    free((char*) network->options.port);
+    free(network);
+    free(sink);
+}
+
+hues_sink* hues_network_open(const hues_network_options* options) {
+    if (options->host == NULL || options->port == NULL || (options->type != SOCK_STREAM && options->type != SOCK_DGRAM)) {
+        return NULL;
+    }
+    hues_network* network = malloc(sizeof(hues_network));
+    network->options = *options;
+    network->options.host = strdup(options->host);
+    network->options.port = strdup(options->port);
+    if (network->options.buffer_size == 0) {
+        network->options.buffer_size = 4 * 1024 * 1024;
+    }
+    network->options.buffer_size &= ~(size_t) 7;
+    if (network->options.buffer_size < 2 * HUES_RECORD_SIZE(HUES_COLLECTOR_LOCATION_BOUND + BUFFER_SIZE)) {
+        network->options.buffer_size = 2 * HUES_RECORD_SIZE(HUES_COLLECTOR_LOCATION_BOUND + BUFFER_SIZE);
+    }
+    if (network->options.datagram_size == 0) {
+        network->options.datagram_size = 8 * 1024;
+    }
+    network->fd = -1;
+    network->connecting = 0;
+    network->buffer = malloc(network->options.buffer_size);
+    network->head = 0;
+    network->used = 0;
+    network->dropped = 0;
+    network->retry_at = 0;
+    network->backoff = HUES_NETWORK_BACKOFF_MINIMUM;
+    network->addresses = hues_network_lookup(network);  // On the opening thread: the writer only connects
+    network->resolving = 0;
+    network->resolver_started = 0;
+    pthread_mutex_init(&network->mutex, NULL);
+    pthread_mutex_lock(&network->mutex);
+    hues_network_connect(network);
+    pthread_mutex_unlock(&network->mutex);
+    hues_sink* sink = malloc(sizeof(hues_sink));
+    *sink = (hues_sink) {
+        .minimum_level = HUES_LEVEL_TRACE,
+        .write_function = hues_network_write,
+        .flush_function = hues_network_flush,
+        .close_function = hues_network_close,
+        .context = network,
+        .binary = network->options.format == HUES_FILE_FORMAT_BINARY
+    };
+    hues_writer_start(HUES_NETWORK_WRITER_CAPACITY);
+    hues_configuration_add_sink(sink);
+    return sink;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file test_crc32c.c
+ * @brief Checks the table and SSE4.2 CRC32C computations against known vectors
+ */
+
+#include "hues_ring.c"  // Reaches the table and SSE4.2 computations
+
+/**
+ * @struct test_crc32c_vector
+ * @brief Represents data and its known CRC32C.
+ */
+typedef struct {
+    const char* name;  /**< Name of the vector, printed on failure. */
+    uint8_t data[32];  /**< Data. */
+    size_t length;  /**< Length of the data. */
+    uint32_t crc;  /**< CRC32C of the data. */
+} test_crc32c_vector;
+
+/**
+ * @fn static int test_crc32c_check(const char* name, const char* computation, uint32_t crc, uint32_t expected)
+ * @brief Compares a CRC32C with the one expected.
+ * @param name The name of the data.
+ * @param computation The name of the computation.
+ * @param crc The CRC32C computed.
+ * @param expected The CRC32C expected.
+ * @return 0 if they match, 1 otherwise.
+ */
+static int test_crc32c_check(const char* name, const char* computation, uint32_t crc, uint32_t expected) {
+    if (crc != expected) {
+        fprintf(stderr, "test-crc32c: %s: %s gives %08x instead of %08x\n", name, computation, crc, expected);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    // Vectors from RFC 3720, appendix B.4, and the usual check value
+    test_crc32c_vector vectors[] = {
+        { "check", "123456789", 9, 0xe3069283 },
+        { "32 zeros", { 0 }, 32, 0x8a9136aa },
+        { "32 ones", { 0 }, 32, 0x62a8ab43 },
+        { "32 incrementing", { 0 }, 32, 0x46dd794e },
+        { "32 decrementing", { 0 }, 32, 0x113fdb5c },
+    };
+    for (int i = 0; i < 32; i++) {
+        vectors[2].data[i] = 0xff;
+        vectors[3].data[i] = i;
+        vectors[4].data[i] = 31 - i;
+    }
+    pthread_once(&hues_crc32c_once, hues_crc32c_initialize);
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        test_crc32c_vector* vector = &vectors[i];
+        failed |= test_crc32c_check(vector->name, "table", ~hues_crc32c_software(~0u, vector->data, vector->length), vector->crc);
+        failed |= test_crc32c_check(vector->name, "hues_checksum", hues_checksum(vector->data, vector->length, 0), vector->crc);
+        failed |= test_crc32c_check(vector->name, "hues_checksum in two parts",
+                                    hues_checksum(vector->data + 5, vector->length - 5, hues_checksum(vector->data, 5, 0)), vector->crc);
+    }
+#ifdef __x86_64__
+    if (__builtin_cpu_supports("sse4.2")) {
+        for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+            failed |= test_crc32c_check(vectors[i].name, "SSE4.2", ~hues_crc32c_hardware(~0u, vectors[i].data, vectors[i].length), vectors[i].crc);
+        }
+        // Every length and alignment around the 8-byte steps of the SSE4.2 loop
+        uint8_t data[256 + 8];
+        for (size_t i = 0; i < sizeof(data); i++) {
+            data[i] = (uint8_t) (i * 167 + 13);
+        }
+        for (size_t start = 0; start < 8; start++) {
+            for (size_t length = 0; length <= 256; length++) {
+                if (hues_crc32c_hardware(~0u, data + start, length) != hues_crc32c_software(~0u, data + start, length)) {
+                    fprintf(stderr, "test-crc32c: SSE4.2 and table differ on %zu bytes at offset %zu\n", length, start);
+                    failed = 1;
+                }
+            }
+        }
+    } else {
+        printf("test-crc32c: no SSE4.2, only the table computation checked\n");
+    }
+#endif
+    return failed;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file test_hook.c
+ * @brief Checks that a hooked function calls the original one, with hooks off and on
+ */
+
+#include "hues.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+HUES_HOOK_CAPTURE(twice, int, int)
+
+int main() {
+    char path[] = "/tmp/hues-test-hook.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "test-hook: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    hues_initialize();
+    hues_configuration_set_console(0);
+    hues_configuration_set_minimum_level(HUES_LEVEL_TRACE);
+    hues_file_options options = { .path = path, .format = HUES_FILE_FORMAT_TEXT };
+    hues_sink* file = hues_file_sink_open(&options);
+    int failed = 0;
+    hues_hook_tracing_enable(0);
+    if (twice(21) != 42) {
+        fprintf(stderr, "test-hook: twice(21) with hooks off returned %d\n", twice(21));
+        failed = 1;
+    }
+    hues_hook_tracing_enable(1);
+    int result = twice(4);
+    if (result != 8) {
+        fprintf(stderr, "test-hook: twice(4) with hooks on returned %d\n", result);
+        failed = 1;
+    }
+    hues_sink_close(file);
+    char contents[BUFFER_SIZE] = { 0 };
+    ssize_t size = read(fd, contents, sizeof(contents) - 1);
+    if (size <= 0 || strstr(contents, "'twice' called at") == NULL || strstr(contents, "with (4) returned 8") == NULL
+        || strstr(contents, "(21)") != NULL) {
+        fprintf(stderr, "test-hook: traced \"%.*s\"\n", size > 0 ? (int) size : 0, contents);
+        failed = 1;
+    }
+    close(fd);
+    unlink(path);
+    return failed;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file test_lz4.c
+ * @brief Checks that LZ4 blocks decompress to the data compressed
+ */
+
+#include "hues.h"
+
+/**
+ * @fn static int test_lz4_round_trip(const char* name, const char* data, size_t size)
+ * @brief Compresses data and checks that decompressing it gives it back.
+ * @param name The name of the case, printed on failure.
+ * @param data The data.
+ * @param size The size of the data.
+ * @return 0 on success, 1 on failure.
+ */
+static int test_lz4_round_trip(const char* name, const char* data, size_t size) {
+    char* compressed = malloc(HUES_LZ4_BOUND(size));
+    char* decompressed = malloc(size + 1);
+    size_t compressed_size = hues_lz4_compress(data, size, compressed, HUES_LZ4_BOUND(size));
+    long decompressed_size = compressed_size > 0 ? hues_lz4_decompress(compressed, compressed_size, decompressed, size + 1) : -1;
+    int failed = decompressed_size != (long) size || memcmp(data, decompressed, size) != 0;
+    if (!failed && size > 0 && hues_lz4_decompress(compressed, compressed_size, decompressed, size - 1) != -1) {
+        failed = 1;  // A buffer too small must be refused
+    }
+    if (failed) {
+        fprintf(stderr, "test-lz4: %s: %zu bytes compressed to %zu, decompressed to %ld\n", name, size, compressed_size, decompressed_size);
+    }
+    free(decompressed);
+    free(compressed);
+    return failed;
+}
+
+int main() {
+    int failed = 0;
+    size_t size = 1 << 20;
+    char* data = malloc(size);
+    failed |= test_lz4_round_trip("empty", "", 0);
+    failed |= test_lz4_round_trip("short", "hello", 5);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = 'a';
+    }
+    failed |= test_lz4_round_trip("run", data, size);
+    size_t length = 0;
+    for (unsigned i = 0; length + 128 < size; i++) {
+        length += snprintf(data + length, size - length, "2024-05-01 14:03:%02u.%06u [INFO] request %u served in %u us\n", i % 60, i * 7919 % 1000000, i, i * 31 % 5000);
+    }
+    failed |= test_lz4_round_trip("log lines", data, length);
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = (char) state;
+    }
+    failed |= test_lz4_round_trip("random", data, size);
+    // A block written by the reference implementation: "a", a match of 15 bytes at offset 1, then "bcdef"
+    const char block[] = { 0x1b, 'a', 0x01, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' };
+    long decompressed = hues_lz4_decompress(block, sizeof(block), data, size);
+    if (decompressed != 21 || memcmp(data, "aaaaaaaaaaaaaaaabcdef", 21) != 0) {
+        fprintf(stderr, "test-lz4: reference block decompressed to %ld bytes\n", decompressed);
+        failed = 1;
+    }
+    free(data);
+    return failed;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file test_resync.c
+ * @brief Checks that hues-recover and hues-merge resynchronize past a torn record
+ */
+
+#define _GNU_SOURCE  // memmem
+
+#include "hues.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/**
+ * @def TEST_RESYNC_RECORDS
+ * @brief Number of records written to each file.
+ */
+#define TEST_RESYNC_RECORDS 10
+
+/**
+ * @def TEST_RESYNC_TORN
+ * @brief Index of the record corrupted in each file.
+ */
+#define TEST_RESYNC_TORN 4
+
+/**
+ * @fn static int test_resync_corrupt(const char* path)
+ * @brief Flips a character of the text of a record of a file, so that its checksum no longer matches.
+ * @param path The path of the file.
+ * @return 0 on success, -1 if the record is not found.
+ */
+static int test_resync_corrupt(const char* path) {
+    static char contents[1 << 20];
+    int fd = open(path, O_RDWR);
+    ssize_t size = fd >= 0 ? read(fd, contents, sizeof(contents)) : -1;
+    char needle[32];
+    int length = snprintf(needle, sizeof(needle), "message %d.", TEST_RESYNC_TORN);
+    char* text = size > 0 ? memmem(contents, size, needle, length) : NULL;
+    if (text == NULL || pwrite(fd, "M", 1, text - contents) != 1) {
+        fprintf(stderr, "test-resync: %s: record %d not found\n", path, TEST_RESYNC_TORN);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * @fn static int test_resync_run(const char* command, const char* summary)
+ * @brief Runs a tool on a corrupt file and checks that it reports the corruption and prints every other record.
+ * @param command The command, its standard error redirected to its output.
+ * @param summary The line the tool must report the corruption with.
+ * @return 0 on success, 1 on failure.
+ */
+static int test_resync_run(const char* command, const char* summary) {
+    FILE* output = popen(command, "r");
+    if (output == NULL) {
+        fprintf(stderr, "test-resync: %s: %s\n", command, strerror(errno));
+        return 1;
+    }
+    char line[BUFFER_SIZE];
+    int seen[TEST_RESYNC_RECORDS] = { 0 };
+    int summarized = 0;
+    while (fgets(line, sizeof(line), output) != NULL) {
+        const char* text = strstr(line, "message ");
+        if (text != NULL) {
+            int index = atoi(text + strlen("message "));
+            if (index >= 0 && index < TEST_RESYNC_RECORDS) {
+                seen[index]++;
+            }
+        }
+        summarized |= strstr(line, summary) != NULL;
+    }
+    int status = pclose(output);
+    int failed = 0;
+    if (status == -1 || !WIFEXITED(status) || !summarized) {
+        fprintf(stderr, "test-resync: %s: no \"%s\" reported\n", command, summary);
+        failed = 1;
+    }
+    for (int i = 0; i < TEST_RESYNC_RECORDS; i++) {
+        if (seen[i] != (i != TEST_RESYNC_TORN)) {
+            fprintf(stderr, "test-resync: %s: record %d printed %d times\n", command, i, seen[i]);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+int main() {
+    char directory[] = "/tmp/hues-test-resync.XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        fprintf(stderr, "test-resync: %s: %s\n", directory, strerror(errno));
+        return 1;
+    }
+    char ring_path[BUFFER_SIZE];
+    char file_path[BUFFER_SIZE];
+    snprintf(ring_path, sizeof(ring_path), "%s/ring", directory);
+    snprintf(file_path, sizeof(file_path), "%s/binary.log", directory);
+    hues_initialize();
+    hues_configuration_set_console(0);
+    hues_sink* ring = hues_flight_recorder_open(ring_path, 1 << 16);
+    hues_file_options options = { .path = file_path, .format = HUES_FILE_FORMAT_BINARY };
+    hues_sink* file = hues_file_sink_open(&options);
+    if (ring == NULL || file == NULL) {
+        fprintf(stderr, "test-resync: cannot open the sinks in %s\n", directory);
+        return 1;
+    }
+    for (int i = 0; i < TEST_RESYNC_RECORDS; i++) {
+        info("message %d.\n", i);
+    }
+    hues_sink_close(file);
+    hues_sink_close(ring);
+    int failed = test_resync_corrupt(ring_path) != 0 || test_resync_corrupt(file_path) != 0;
+    char command[3 * BUFFER_SIZE];
+    if (!failed) {
+        snprintf(command, sizeof(command), "tools/hues-recover %s 2>&1", ring_path);
+        failed |= test_resync_run(command, "records, 1 torn");
+        snprintf(command, sizeof(command), "tools/hues-merge %s 2>&1", file_path);
+        failed |= test_resync_run(command, "skipped");
+    }
+    unlink(ring_path);
+    unlink(file_path);
+    rmdir(directory);
+    return failed;
+}
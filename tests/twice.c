@@ -0,0 +1,8 @@
+/**
+ * @file twice.c
+ * @brief A function of a shared library for tests/test-hook to hook
+ */
+
+int twice(int value) {
+    return 2 * value;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file hues_cat.c
+ * @brief Prints the records of log files written by hues, decompressing them as needed
+ */
+
+#include "hues.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @def HUES_CAT_MAXIMUM_BLOCK_SIZE
+ * @brief Maximum decompressed size of a block, larger sizes are considered corrupt.
+ */
+#define HUES_CAT_MAXIMUM_BLOCK_SIZE (64 * 1024 * 1024)
+
+static void hues_cat_usage() {
+    fprintf(stderr, "usage: hues-cat [-s offset] file...\n");
+    fprintf(stderr, "  -s offset  start at the first block or record at or after offset, for binary and compressed files\n");
+}
+
+/**
+ * @fn static size_t hues_cat_records(const char* data, size_t size, int synchronized)
+ * @brief Prints the text of the binary records of a buffer, skipping corrupt data 8 bytes at a time.
+ * @param data The buffer.
+ * @param size The size of the buffer.
+ * @param synchronized Whether the buffer starts on a record, otherwise the bytes before the first record are not corruption.
+ * @return The number of corrupt bytes skipped.
+ */
+static size_t hues_cat_records(const char* data, size_t size, int synchronized) {
+    size_t corrupt = 0;
+    size_t offset = 0;
+    while (offset + sizeof(hues_record_header) <= size) {
+        const hues_record_header* header = (const hues_record_header*) (data + offset);
+        if (header->magic != HUES_RECORD_MAGIC || HUES_RECORD_SIZE(header->length) > size - offset || header->location_length > header->length
+            || header->checksum != hues_record_checksum(header, header + 1)) {
+            corrupt += synchronized ? 8 : 0;
+            offset += 8;
+            continue;
+        }
+        char line[BUFFER_SIZE];
+        size_t length;
+        const char* text = hues_record_line(header, line, sizeof(line), &length);
+        fwrite(text, 1, length, stdout);
+        if (length == 0 || text[length - 1] != '\n') {
+            putchar('\n');
+        }
+        synchronized = 1;
+        offset += HUES_RECORD_SIZE(header->length);
+    }
+    return corrupt;
+}
+
+/**
+ * @fn static int hues_cat_file(const char* path, uint64_t start)
+ * @brief Prints the records of a log file.
+ * @param path The path of the file.
+ * @param start The offset to start at.
+ * @return 0 on success, 1 if the file cannot be read.
+ */
+static int hues_cat_file(const char* path, uint64_t start) {
+    int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(path);
+        return 1;
+    }
+    size_t size = status.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+    const char* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+    madvise((void*) mapping, size, MADV_SEQUENTIAL);
+    const hues_file_header* header = (const hues_file_header*) mapping;
+    if (size < sizeof(hues_file_header) || header->magic != HUES_FILE_MAGIC) {
+        // Plain text file
+        if (start < size) {
+            fwrite(mapping + start, 1, size - start, stdout);
+        }
+        munmap((void*) mapping, size);
+        return 0;
+    }
+    if (header->version != HUES_FILE_VERSION) {
+        fprintf(stderr, "%s: log file version %u, version %d expected\n", path, header->version, HUES_FILE_VERSION);
+        munmap((void*) mapping, size);
+        return 1;
+    }
+    const hues_bloom_footer* footer = hues_bloom_footer_find(mapping, size);
+    if (footer != NULL) {
+        size -= footer->size;  // The bloom filter ending a rotated segment holds no record
+    }
+    uint64_t offset = (start + 7) & ~(uint64_t) 7;
+    if (offset < sizeof(hues_file_header)) {
+        offset = sizeof(hues_file_header);
+    }
+    size_t corrupt = 0;
+    if (header->compression == HUES_FILE_COMPRESSION_NONE) {
+        corrupt = offset < size ? hues_cat_records(mapping + offset, size - offset, offset == sizeof(hues_file_header)) : 0;
+    } else {
+        size_t capacity = 256 * 1024;
+        char* data = malloc(capacity);
+        int synchronized = offset == sizeof(hues_file_header);  // Looking for the first block after the start offset is not corruption
+        while (offset + sizeof(hues_block_header) <= size) {
+            const hues_block_header* block = (const hues_block_header*) (mapping + offset);
+            if (block->magic == HUES_BLOCK_MAGIC && block->size > capacity && block->size <= HUES_CAT_MAXIMUM_BLOCK_SIZE) {
+                capacity = block->size;
+                data = realloc(data, capacity);
+            }
+            long length = block->magic == HUES_BLOCK_MAGIC ? hues_block_decode(block, size - offset, data, capacity) : -1;
+            if (length < 0) {
+                corrupt += synchronized ? 8 : 0;
+                offset += 8;  // Resynchronize on the next block
+                continue;
+            }
+            synchronized = 1;
+            if (header->format == HUES_FILE_FORMAT_TEXT) {
+                fwrite(data, 1, length, stdout);
+            } else {
+                corrupt += hues_cat_records(data, length, 1);
+            }
+            offset += HUES_BLOCK_SIZE(block->stored_size);
+        }
+        free(data);
+    }
+    if (corrupt > 0) {
+        fprintf(stderr, "%s: skipped %zu corrupt bytes\n", path, corrupt);
+    }
+    munmap((void*) mapping, status.st_size);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    uint64_t start = 0;
+    int option;
+    while ((option = getopt(argc, argv, "s:")) != -1) {
+        switch (option) {
+            case 's':
+                start = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                hues_cat_usage();
+                return 2;
+        }
+    }
+    if (optind == argc) {
+        hues_cat_usage();
+        return 2;
+    }
+    static char output[256 * 1024];
+    setvbuf(stdout, output, _IOFBF, sizeof(output));
+    int result = 0;
+    for (int i = optind; i < argc; i++) {
+        result |= hues_cat_file(argv[i], start);
+    }
+    return result;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file hues_collect.c
+ * @brief Collects the records of several processes from a shared memory log bus into one ordered file
+ */
+
+#include "hues.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @def HUES_COLLECT_POLL_INTERVAL
+ * @brief Time to wait for new records, in microseconds.
+ */
+#define HUES_COLLECT_POLL_INTERVAL 1000
+
+/**
+ * @def HUES_COLLECT_STALL_TIMEOUT
+ * @brief Time after which a reserved record that is still not written is considered abandoned, in microseconds.
+ */
+#define HUES_COLLECT_STALL_TIMEOUT 1000000
+
+/**
+ * @def HUES_COLLECT_OUTPUT_SIZE
+ * @brief Size of the output buffer, written with a single write(2) when full or when the bus runs empty.
+ */
+#define HUES_COLLECT_OUTPUT_SIZE (256 * 1024)
+
+static volatile sig_atomic_t hues_collect_stopping = 0;
+
+static void hues_collect_stop(int signal_number) {
+    hues_collect_stopping = 1;
+}
+
+static void hues_collect_usage() {
+    fprintf(stderr, "usage: hues-collect [-c capacity] [-o output] name\n");
+    fprintf(stderr, "  -c capacity  size of the bus in bytes when creating it (default 16 MiB)\n");
+    fprintf(stderr, "  -o output    file the records are appended to (default standard output)\n");
+}
+
+/**
+ * @struct hues_collect_output
+ * @brief Represents the buffered output of the collector.
+ */
+typedef struct {
+    int fd;  /**< Output file descriptor. */
+    char* buffer;  /**< Pending output. */
+    size_t used;  /**< Number of pending bytes. */
+} hues_collect_output;
+
+/**
+ * @fn static size_t hues_collect_abandoned_size(const hues_bus_header* bus, uint64_t position, uint64_t write_position)
+ * @brief Finds the end of a record whose producer died before publishing its length: the next position holding a record
+ * published, or the end of the data area, records never wrapping around it. Its bytes are still zero, as the collector
+ * clears what it reads, so the search never stops inside it.
+ * @param bus The bus.
+ * @param position The position of the abandoned record.
+ * @param write_position The write position of the bus.
+ * @return The number of bytes to skip, or 0 if nothing after the record is published yet.
+ */
+static size_t hues_collect_abandoned_size(const hues_bus_header* bus, uint64_t position, uint64_t write_position) {
+    const char* data = (const char*) (bus + 1);
+    for (uint64_t next = position + 8; next < write_position; next += 8) {
+        size_t offset = next % bus->capacity;
+        if (offset == 0 || bus->capacity - offset < sizeof(hues_record_header)) {
+            return next - position;
+        }
+        const hues_record_header* header = (const hues_record_header*) (data + offset);
+        if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == HUES_RECORD_MAGIC || __atomic_load_n(&header->length, __ATOMIC_ACQUIRE) != 0) {
+            return next - position;
+        }
+    }
+    return 0;
+}
+
+static void hues_collect_output_flush(hues_collect_output* output) {
+    size_t offset = 0;
+    while (offset < output->used) {
+        ssize_t written = write(output->fd, output->buffer + offset, output->used - offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            perror("write");
+            break;
+        }
+        offset += written;
+    }
+    output->used = 0;
+}
+
+static void hues_collect_output_append(hues_collect_output* output, const char* text, size_t length) {
+    if (output->used + length + 1 > HUES_COLLECT_OUTPUT_SIZE) {
+        hues_collect_output_flush(output);
+    }
+    if (length + 1 > HUES_COLLECT_OUTPUT_SIZE) {
+        length = HUES_COLLECT_OUTPUT_SIZE - 1;
+    }
+    memcpy(output->buffer + output->used, text, length);
+    output->used += length;
+    if (length == 0 || text[length - 1] != '\n') {
+        output->buffer[output->used++] = '\n';
+    }
+}
+
+/**
+ * @fn static hues_bus_header* hues_collect_map(const char* name, size_t capacity)
+ * @brief Creates a bus, or maps an existing one to resume collecting it.
+ * @param name The name of the shared memory object.
+ * @param capacity The size of the data area of a new bus.
+ * @return The mapped bus, or NULL on error.
+ */
+static hues_bus_header* hues_collect_map(const char* name, size_t capacity) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(name);
+        return NULL;
+    }
+    hues_bus_header existing;
+    int reuse = (size_t) status.st_size >= sizeof(existing)
+        && pread(fd, &existing, sizeof(existing), 0) == sizeof(existing)
+        && existing.magic == HUES_BUS_MAGIC
+        && existing.version == HUES_RING_VERSION
+        && (size_t) status.st_size >= sizeof(existing) + existing.capacity;
+    if (reuse) {
+        capacity = existing.capacity;
+    } else {
+        capacity = (capacity + 7) & ~(size_t) 7;
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, sizeof(hues_bus_header) + capacity) != 0) {
+            perror(name);
+            return NULL;
+        }
+    }
+    hues_bus_header* bus = mmap(NULL, sizeof(hues_bus_header) + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bus == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    if (!reuse) {
+        bus->version = HUES_RING_VERSION;
+        bus->capacity = capacity;
+        __atomic_store_n(&bus->magic, HUES_BUS_MAGIC, __ATOMIC_RELEASE);
+    }
+    return bus;
+}
+
+int main(int argc, char** argv) {
+    size_t capacity = 16 * 1024 * 1024;
+    const char* output_path = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "c:o:")) != -1) {
+        switch (option) {
+            case 'c':
+                capacity = strtoull(optarg, NULL, 0);
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            default:
+                hues_collect_usage();
+                return 2;
+        }
+    }
+    if (optind != argc - 1 || capacity < 64 * 1024) {
+        hues_collect_usage();
+        return 2;
+    }
+    hues_collect_output output = { STDOUT_FILENO, malloc(HUES_COLLECT_OUTPUT_SIZE), 0 };
+    if (output_path != NULL) {
+        output.fd = open(output_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (output.fd < 0) {
+            perror(output_path);
+            return 1;
+        }
+    }
+    hues_bus_header* bus = hues_collect_map(argv[optind], capacity);
+    if (bus == NULL) {
+        return 1;
+    }
+    signal(SIGINT, hues_collect_stop);
+    signal(SIGTERM, hues_collect_stop);
+    char* data = (char*) (bus + 1);
+    uint64_t position = bus->read_position;
+    uint64_t dropped = __atomic_load_n(&bus->dropped, __ATOMIC_RELAXED);
+    uint64_t stalled = 0;
+    while (1) {
+        uint64_t write_position = __atomic_load_n(&bus->write_position, __ATOMIC_ACQUIRE);
+        if (position == write_position) {
+            hues_collect_output_flush(&output);
+            uint64_t now_dropped = __atomic_load_n(&bus->dropped, __ATOMIC_RELAXED);
+            if (now_dropped != dropped) {
+                fprintf(stderr, "hues-collect: %llu records dropped while the bus was full\n", (unsigned long long) (now_dropped - dropped));
+                dropped = now_dropped;
+            }
+            if (hues_collect_stopping) {
+                break;
+            }
+            usleep(HUES_COLLECT_POLL_INTERVAL);
+            continue;
+        }
+        size_t offset = position % bus->capacity;
+        hues_record_header* header = (hues_record_header*) (data + offset);
+        size_t size = 0;
+        int complete = hues_bus_record_size(bus, position, &size);
+        if (complete == 0) {
+            // Reserved but not written yet; give up on it if its producer seems to be gone
+            if (stalled < HUES_COLLECT_STALL_TIMEOUT && !(hues_collect_stopping && stalled >= HUES_COLLECT_STALL_TIMEOUT / 10)) {
+                hues_collect_output_flush(&output);
+                usleep(HUES_COLLECT_POLL_INTERVAL);
+                stalled += HUES_COLLECT_POLL_INTERVAL;
+                continue;
+            }
+            uint32_t length = __atomic_load_n(&header->length, __ATOMIC_ACQUIRE);
+            if (length != 0 && HUES_RECORD_SIZE(length) <= bus->capacity - offset) {
+                size = HUES_RECORD_SIZE(length);
+            } else {
+                // Its length was never published: skip to the next record published, rather than waiting again every 8 bytes
+                size = hues_collect_abandoned_size(bus, position, write_position);
+                if (size == 0 && hues_collect_stopping) {
+                    break;
+                }
+                if (size == 0) {
+                    hues_collect_output_flush(&output);
+                    usleep(HUES_COLLECT_POLL_INTERVAL);
+                    continue;
+                }
+            }
+            fprintf(stderr, "hues-collect: skipped %zu bytes abandoned by a producer\n", size);
+        } else if (complete < 0) {
+            size = 8;
+            fprintf(stderr, "hues-collect: skipped 8 corrupt bytes\n");
+        } else if (size >= sizeof(hues_record_header) && !(header->flags & HUES_RECORD_FLAG_PADDING)) {
+            char line[BUFFER_SIZE];
+            size_t length;
+            const char* text = hues_record_line(header, line, sizeof(line), &length);
+            hues_collect_output_append(&output, text, length);
+        }
+        stalled = 0;
+        memset(data + offset, 0, size);
+        position += size;
+        __atomic_store_n(&bus->read_position, position, __ATOMIC_RELEASE);
+    }
+    hues_collect_output_flush(&output);
+    return 0;
+}
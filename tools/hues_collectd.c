@@ -0,0 +1,269 @@
+/**
+ * @file hues_collectd.c
+ * @brief Collects the records sent by hues_collector_connect over a UNIX socket, and writes them to rotated log files
+ */
+
+#include "hues.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @def HUES_COLLECTD_FLUSH_INTERVAL
+ * @brief Maximum time records stay in the output buffers while clients keep sending, in milliseconds.
+ */
+#define HUES_COLLECTD_FLUSH_INTERVAL 200
+
+/**
+ * @struct hues_collectd_output
+ * @brief Represents an output of the collector.
+ */
+typedef struct {
+    hues_file* file;  /**< Log file. */
+    hues_level_enum minimum_level;  /**< Minimum level of the records written to the file. */
+} hues_collectd_output;
+
+static volatile sig_atomic_t hues_collectd_stopping = 0;
+static volatile sig_atomic_t hues_collectd_rotating = 0;
+
+static void hues_collectd_signal(int signal_number) {
+    if (signal_number == SIGHUP) {
+        hues_collectd_rotating = 1;
+    } else {
+        hues_collectd_stopping = 1;
+    }
+}
+
+/**
+ * @fn static uint64_t hues_collectd_now()
+ * @brief Retrieves the monotonic time.
+ * @return The monotonic time in milliseconds.
+ */
+static uint64_t hues_collectd_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void hues_collectd_usage() {
+    fprintf(stderr, "usage: hues-collectd [-f format] [-c compression] [-d] [-j threads] [-i interval] [-b size] [-l level] [-s size] [-k count] [-z command] -o output... socket\n");
+    fprintf(stderr, "  -f format       layout of the following outputs: text (default) or binary\n");
+    fprintf(stderr, "  -c compression  compression of the following outputs: none (default) or lz4\n");
+    fprintf(stderr, "  -d              bypass the page cache with O_DIRECT for the following outputs\n");
+    fprintf(stderr, "  -j threads      number of threads compressing the following outputs in parallel (default 1)\n");
+    fprintf(stderr, "  -i interval     write a sidecar index for hues-query along the following binary outputs, an entry every interval bytes\n");
+    fprintf(stderr, "  -b size         end the rotated segments of the following binary or compressed outputs with a bloom filter of\n");
+    fprintf(stderr, "                  their words for hues-query -w, of up to size bytes\n");
+    fprintf(stderr, "  -l level        minimum level of the following outputs (0 = TRACE ... 5 = CRITICAL)\n");
+    fprintf(stderr, "  -s size         rotate the following outputs when they reach size bytes (default never)\n");
+    fprintf(stderr, "  -k count        number of rotated segments kept by the following outputs (default all)\n");
+    fprintf(stderr, "  -z command      command run on every rotated segment of the following outputs, such as gzip\n");
+    fprintf(stderr, "  -o output       adds an output, every record is written to each output accepting its level\n");
+    fprintf(stderr, "SIGHUP rotates every output.\n");
+}
+
+/**
+ * @fn static void hues_collectd_rotated(const char* segment_path, void* context)
+ * @brief Runs the post-rotation command of an output on a rotated segment, in the background.
+ * @param segment_path The path of the rotated segment.
+ * @param context The command, run by the shell with the segment path as its last argument.
+ */
+static void hues_collectd_rotated(const char* segment_path, void* context) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        size_t length = strlen(context) + 8;
+        char* command = malloc(length);
+        snprintf(command, length, "%s \"$1\"", (const char*) context);
+        execl("/bin/sh", "sh", "-c", command, "sh", segment_path, (char*) NULL);
+        _exit(127);
+    }
+}
+
+/**
+ * @fn static ssize_t hues_collectd_receive(int fd, uint64_t* message, hues_collectd_output* outputs, size_t outputs_count)
+ * @brief Receives a batch of records from a client and writes it to the outputs.
+ * @param fd The client socket.
+ * @param message A buffer of HUES_COLLECTOR_BATCH_SIZE bytes.
+ * @param outputs The outputs.
+ * @param outputs_count The number of outputs.
+ * @return The number of bytes received, 0 if the client is gone.
+ */
+static ssize_t hues_collectd_receive(int fd, uint64_t* message, hues_collectd_output* outputs, size_t outputs_count) {
+    ssize_t received;
+    do {
+        received = recv(fd, message, HUES_COLLECTOR_BATCH_SIZE, 0);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+        return 0;
+    }
+    size_t offset = 0;
+    while (offset + sizeof(hues_record_header) <= (size_t) received) {
+        const hues_record_header* header = (const hues_record_header*) ((const char*) message + offset);
+        if (header->magic != HUES_RECORD_MAGIC || HUES_RECORD_SIZE(header->length) > received - offset || header->checksum != hues_record_checksum(header, header + 1)) {
+            fprintf(stderr, "hues-collectd: dropped a corrupt batch of %zu bytes\n", received - offset);
+            break;
+        }
+        for (size_t i = 0; i < outputs_count; i++) {
+            if (header->level >= outputs[i].minimum_level && hues_file_write_encoded(outputs[i].file, header) != 0) {
+                perror("hues-collectd: write");
+            }
+        }
+        offset += HUES_RECORD_SIZE(header->length);
+    }
+    return received;
+}
+
+int main(int argc, char** argv) {
+    hues_file_options options = { .format = HUES_FILE_FORMAT_TEXT };
+    hues_level_enum minimum_level = HUES_LEVEL_TRACE;
+    hues_collectd_output* outputs = malloc(argc * sizeof(hues_collectd_output));
+    size_t outputs_count = 0;
+    int option;
+    while ((option = getopt(argc, argv, "f:c:dj:i:b:l:s:k:z:o:")) != -1) {
+        switch (option) {
+            case 'f':
+                if (strcmp(optarg, "text") != 0 && strcmp(optarg, "binary") != 0) {
+                    hues_collectd_usage();
+                    return 2;
+                }
+                options.format = strcmp(optarg, "binary") == 0 ? HUES_FILE_FORMAT_BINARY : HUES_FILE_FORMAT_TEXT;
+                break;
+            case 'c':
+                if (strcmp(optarg, "none") != 0 && strcmp(optarg, "lz4") != 0) {
+                    hues_collectd_usage();
+                    return 2;
+                }
+                options.compression = strcmp(optarg, "lz4") == 0 ? HUES_FILE_COMPRESSION_LZ4 : HUES_FILE_COMPRESSION_NONE;
+                break;
+            case 'd':
+                options.direct = 1;
+                break;
+            case 'j':
+                options.compression_threads = strtoull(optarg, NULL, 0);
+                break;
+            case 'i':
+                options.index_interval = strtoull(optarg, NULL, 0);
+                break;
+            case 'b':
+                options.bloom_size = strtoull(optarg, NULL, 0);
+                break;
+            case 'l':
+                minimum_level = atoi(optarg);
+                break;
+            case 's':
+                options.max_segment_size = strtoull(optarg, NULL, 0);
+                break;
+            case 'k':
+                options.max_segments = strtoull(optarg, NULL, 0);
+                break;
+            case 'z':
+                options.rotate_function = hues_collectd_rotated;
+                options.rotate_context = optarg;
+                break;
+            case 'o':
+                if (options.index_interval > 0 && options.format == HUES_FILE_FORMAT_TEXT) {
+                    fprintf(stderr, "%s: -i needs -f binary\n", optarg);
+                    return 2;
+                }
+                options.path = optarg;
+                outputs[outputs_count].file = hues_file_open(&options);
+                outputs[outputs_count].minimum_level = minimum_level;
+                if (outputs[outputs_count].file == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                outputs_count++;
+                break;
+            default:
+                hues_collectd_usage();
+                return 2;
+        }
+    }
+    if (optind != argc - 1 || outputs_count == 0) {
+        hues_collectd_usage();
+        return 2;
+    }
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(argv[optind]) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", argv[optind]);
+        return 1;
+    }
+    strcpy(address.sun_path, argv[optind]);
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    unlink(address.sun_path);
+    if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    struct sigaction action = { .sa_handler = hues_collectd_signal };
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGHUP, &action, NULL);
+    signal(SIGCHLD, SIG_IGN);  // Post-rotation commands are not waited for
+    signal(SIGPIPE, SIG_IGN);
+    uint64_t* message = malloc(HUES_COLLECTOR_BATCH_SIZE);
+    size_t clients_capacity = 16;
+    struct pollfd* clients = malloc((clients_capacity + 1) * sizeof(struct pollfd));
+    size_t clients_count = 0;
+    clients[0] = (struct pollfd) { .fd = listener, .events = POLLIN };
+    int pending = 0;
+    uint64_t flushed_at = hues_collectd_now();
+    while (!hues_collectd_stopping) {
+        int ready = poll(clients, clients_count + 1, pending ? HUES_COLLECTD_FLUSH_INTERVAL : -1);
+        if (ready < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (hues_collectd_rotating) {
+            hues_collectd_rotating = 0;
+            for (size_t i = 0; i < outputs_count; i++) {
+                hues_file_rotate(outputs[i].file);
+            }
+        }
+        for (size_t i = clients_count; ready > 0 && i >= 1; i--) {
+            if (clients[i].revents == 0) {
+                continue;
+            }
+            if (hues_collectd_receive(clients[i].fd, message, outputs, outputs_count) > 0) {
+                pending = 1;
+                continue;
+            }
+            close(clients[i].fd);
+            clients[i] = clients[clients_count--];
+        }
+        if (ready > 0 && clients[0].revents & POLLIN) {
+            int client = accept(listener, NULL, NULL);
+            if (client >= 0) {
+                fcntl(client, F_SETFD, FD_CLOEXEC);
+                if (clients_count == clients_capacity) {
+                    clients_capacity *= 2;
+                    clients = realloc(clients, (clients_capacity + 1) * sizeof(struct pollfd));
+                }
+                clients[++clients_count] = (struct pollfd) { .fd = client, .events = POLLIN };
+            }
+        }
+        uint64_t now = hues_collectd_now();
+        if (pending && (ready <= 0 || now - flushed_at >= HUES_COLLECTD_FLUSH_INTERVAL)) {
+            for (size_t i = 0; i < outputs_count; i++) {
+                hues_file_flush(outputs[i].file);
+            }
+            pending = 0;
+            flushed_at = now;
+        }
+    }
+    // Drain what the clients already sent before exiting
+    for (size_t i = 1; i <= clients_count; i++) {
+        while (poll(&clients[i], 1, 0) > 0 && hues_collectd_receive(clients[i].fd, message, outputs, outputs_count) > 0) {
+        }
+        close(clients[i].fd);
+    }
+    for (size_t i = 0; i < outputs_count; i++) {
+        hues_file_close(outputs[i].file);
+    }
+    unlink(address.sun_path);
+    return 0;
+}
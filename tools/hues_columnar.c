@@ -0,0 +1,158 @@
+/**
+ * @file hues_columnar.c
+ * @brief Converts segments of binary log files, compressed or not, into columnar log archives for hues-scan
+ */
+
+#include "hues.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static void hues_columnar_usage() {
+    fprintf(stderr, "usage: hues-columnar [-o archive] segment...\n");
+    fprintf(stderr, "  -o archive  write every segment, in order, to a single archive instead of segment.hcol each\n");
+    fprintf(stderr, "Run it on rotated segments with hues-collectd -f binary -z hues-columnar.\n");
+}
+
+/**
+ * @fn static size_t hues_columnar_records(hues_columnar_writer* writer, const char* data, size_t size)
+ * @brief Appends the binary records of a buffer to an archive, skipping corrupt data 8 bytes at a time.
+ * @param writer The archive.
+ * @param data The buffer, starting on a record.
+ * @param size The size of the buffer.
+ * @return The number of corrupt bytes skipped.
+ */
+static size_t hues_columnar_records(hues_columnar_writer* writer, const char* data, size_t size) {
+    size_t corrupt = 0;
+    size_t offset = 0;
+    while (offset + sizeof(hues_record_header) <= size) {
+        const hues_record_header* header = (const hues_record_header*) (data + offset);
+        if (header->magic != HUES_RECORD_MAGIC || HUES_RECORD_SIZE(header->length) > size - offset || header->location_length > header->length
+            || header->checksum != hues_record_checksum(header, header + 1)) {
+            corrupt += 8;
+            offset += 8;
+            continue;
+        }
+        hues_columnar_writer_append(writer, header);
+        offset += HUES_RECORD_SIZE(header->length);
+    }
+    return corrupt;
+}
+
+/**
+ * @fn static int hues_columnar_segment(hues_columnar_writer* writer, const char* path)
+ * @brief Appends the records of a segment of a binary log file to an archive.
+ * @param writer The archive.
+ * @param path The path of the segment.
+ * @return 0 on success, 1 if the segment cannot be read or is not binary.
+ */
+static int hues_columnar_segment(hues_columnar_writer* writer, const char* path) {
+    int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(path);
+        return 1;
+    }
+    size_t size = status.st_size;
+    const char* mapping = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot be mapped\n", path);
+        return 1;
+    }
+    madvise((void*) mapping, size, MADV_SEQUENTIAL);
+    const hues_file_header* header = (const hues_file_header*) mapping;
+    if (size < sizeof(hues_file_header) || header->magic != HUES_FILE_MAGIC || header->format != HUES_FILE_FORMAT_BINARY) {
+        fprintf(stderr, "%s: not a binary log file\n", path);
+        munmap((void*) mapping, size);
+        return 1;
+    }
+    if (header->version != HUES_FILE_VERSION) {
+        fprintf(stderr, "%s: log file version %u, version %d expected\n", path, header->version, HUES_FILE_VERSION);
+        munmap((void*) mapping, size);
+        return 1;
+    }
+    const hues_bloom_footer* footer = hues_bloom_footer_find(mapping, size);
+    if (footer != NULL) {
+        size -= footer->size;
+    }
+    size_t corrupt = 0;
+    size_t offset = sizeof(hues_file_header);
+    if (header->compression == HUES_FILE_COMPRESSION_NONE) {
+        corrupt = hues_columnar_records(writer, mapping + offset, size - offset);
+    } else {
+        size_t capacity = 256 * 1024;
+        char* data = malloc(capacity);
+        while (offset + sizeof(hues_block_header) <= size) {
+            const hues_block_header* block = (const hues_block_header*) (mapping + offset);
+            if (block->magic == HUES_BLOCK_MAGIC && block->size > capacity && block->size <= 64 * 1024 * 1024) {
+                capacity = block->size;
+                data = realloc(data, capacity);
+            }
+            long length = block->magic == HUES_BLOCK_MAGIC ? hues_block_decode(block, size - offset, data, capacity) : -1;
+            if (length < 0) {
+                corrupt += 8;
+                offset += 8;
+                continue;
+            }
+            corrupt += hues_columnar_records(writer, data, length);
+            offset += HUES_BLOCK_SIZE(block->stored_size);
+        }
+        free(data);
+    }
+    if (corrupt > 0) {
+        fprintf(stderr, "%s: skipped %zu corrupt bytes\n", path, corrupt);
+    }
+    munmap((void*) mapping, status.st_size);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* output = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "o:")) != -1) {
+        switch (option) {
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                hues_columnar_usage();
+                return 2;
+        }
+    }
+    if (optind == argc) {
+        hues_columnar_usage();
+        return 2;
+    }
+    int result = 0;
+    hues_columnar_writer* writer = NULL;
+    for (int i = optind; i < argc; i++) {
+        char* path = NULL;
+        if (writer == NULL) {
+            size_t path_length = strlen(argv[i]) + sizeof(".hcol");
+            path = malloc(path_length);
+            snprintf(path, path_length, "%s.hcol", argv[i]);
+            writer = hues_columnar_writer_open(output != NULL ? output : path);
+            if (writer == NULL) {
+                perror(output != NULL ? output : path);
+                free(path);
+                return 1;
+            }
+        }
+        int failed = hues_columnar_segment(writer, argv[i]);
+        result |= failed;
+        if (output == NULL || i == argc - 1) {
+            if (hues_columnar_writer_close(writer) != 0) {
+                perror(output != NULL ? output : path);
+                result = 1;
+            }
+            writer = NULL;
+        }
+        if (output == NULL && failed) {
+            unlink(path);  // No archive for what is not a binary segment
+        }
+        free(path);
+    }
+    return result;
+}
@@ -0,0 +1,501 @@
+/**
+ * @file hues_grep.c
+ * @brief Searches log files, text, binary or compressed, for a fixed string, with an SSE2 substring search, skipping the chunks and
+ * segments their sidecar indexes and bloom filters rule out, several segments at a time
+ */
+
+#define _GNU_SOURCE  // memmem, memrchr, open_memstream
+
+#include "hues.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @struct hues_grep_task
+ * @brief Represents the search of a segment, its output kept until the segments before it are printed.
+ */
+typedef struct {
+    const char* path;  /**< Path of the segment. */
+    char* output;  /**< Matching records, once searched. */
+    size_t output_size;  /**< Size of the output. */
+    size_t matches;  /**< Number of matching records. */
+    size_t read;  /**< Number of bytes of the segment read. */
+    size_t total;  /**< Size of the segment. */
+    int skipped;  /**< Whether the bloom filter of the segment ruled it out. */
+    int result;  /**< 0 on success, 1 if the segment cannot be read. */
+    int done;  /**< Whether the segment was searched. */
+} hues_grep_task;
+
+/**
+ * @struct hues_grep
+ * @brief Represents a search: its criteria and the segments to search, shared by the worker threads.
+ */
+typedef struct {
+    const char* pattern;  /**< String the records must hold. */
+    size_t pattern_length;  /**< Length of the string. */
+    int word;  /**< Whether the string must be delimited by characters other than letters, digits, '_' and '-'. */
+    const char* tokens;  /**< Part of the string made of whole tokens, checked against bloom filters. */
+    size_t tokens_length;  /**< Length of that part. */
+    uint64_t from;  /**< Start of the time range, in nanoseconds since the epoch. */
+    uint64_t to;  /**< End of the time range, included. */
+    hues_level_enum minimum_level;  /**< Minimum level. */
+    int count;  /**< Whether to print the number of matching records instead of the records. */
+    hues_grep_task* tasks;  /**< Segments to search, in output order. */
+    size_t tasks_count;  /**< Number of segments. */
+    size_t next;  /**< Index of the next segment to search. */
+    size_t printed;  /**< Number of segments printed. */
+    size_t window;  /**< Number of segments searched ahead of the printed ones at most, bounding the output kept in memory. */
+    pthread_mutex_t mutex;  /**< Protects next, printed and the done flags. */
+    pthread_cond_t searched;  /**< Signaled when a segment is searched. */
+    pthread_cond_t printed_condition;  /**< Signaled when a segment is printed. */
+} hues_grep;
+
+static void hues_grep_usage() {
+    fprintf(stderr, "usage: hues-grep [-f time] [-t time] [-l level] [-w] [-c] [-j threads] [-v] string file...\n");
+    fprintf(stderr, "  -f time     earliest record, as YYYY-MM-DD HH:MM[:SS], HH:MM[:SS] today, or @seconds since the epoch\n");
+    fprintf(stderr, "  -t time     latest record, in the same forms\n");
+    fprintf(stderr, "  -l level    minimum level (0 = TRACE ... 5 = CRITICAL)\n");
+    fprintf(stderr, "  -w          string delimited by characters other than letters, digits, '_' and '-'\n");
+    fprintf(stderr, "  -c          print the number of matching records instead\n");
+    fprintf(stderr, "  -j threads  number of segments searched at once (default one per CPU)\n");
+    fprintf(stderr, "  -v          print how much of the files was read\n");
+    fprintf(stderr, "Binary files are filtered record by record. Text files hold no level nor time per line: they are searched line by line\n");
+    fprintf(stderr, "and -f, -t and -l are rejected on them.\n");
+}
+
+/**
+ * @fn static const char* hues_grep_find(const char* text, size_t length, const char* pattern, size_t pattern_length)
+ * @brief Finds the first occurrence of a string in a text.
+ * Sixteen positions are tested at a time by comparing the first and the last character of the string with SSE2,
+ * the rest of the string being compared only at the positions where both match.
+ * @param text The text.
+ * @param length The length of the text.
+ * @param pattern The string, not empty.
+ * @param pattern_length The length of the string.
+ * @return The occurrence, or NULL if there is none.
+ */
+static const char* hues_grep_find(const char* text, size_t length, const char* pattern, size_t pattern_length) {
+    if (length < pattern_length) {
+        return NULL;
+    }
+    if (pattern_length == 1) {
+        return memchr(text, pattern[0], length);
+    }
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[pattern_length - 1]);
+    for (; i + pattern_length + 15 <= length; i += 16) {
+        __m128i first_block = _mm_loadu_si128((const __m128i*) (text + i));
+        __m128i last_block = _mm_loadu_si128((const __m128i*) (text + i + pattern_length - 1));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first_block, first), _mm_cmpeq_epi8(last_block, last)));
+        while (mask != 0) {
+            size_t position = i + __builtin_ctz(mask);
+            if (memcmp(text + position + 1, pattern + 1, pattern_length - 2) == 0) {
+                return text + position;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+    return memmem(text + i, length - i, pattern, pattern_length);
+}
+
+/**
+ * @fn static const char* hues_grep_match(const hues_grep* grep, const char* text, size_t length)
+ * @brief Finds the first occurrence of the string of a search in a text, delimited as a token if the search asks for it.
+ * @param grep The search.
+ * @param text The text.
+ * @param length The length of the text.
+ * @return The occurrence, or NULL if there is none.
+ */
+static const char* hues_grep_match(const hues_grep* grep, const char* text, size_t length) {
+    const char* end = text + length;
+    const char* match = text;
+    while ((match = hues_grep_find(match, end - match, grep->pattern, grep->pattern_length)) != NULL) {
+        const char* after = match + grep->pattern_length;
+        if (!grep->word || ((match == text || !hues_token_character(match[-1])) && (after == end || !hues_token_character(*after)))) {
+            return match;
+        }
+        match++;
+    }
+    return NULL;
+}
+
+/**
+ * @fn static void hues_grep_text(const hues_grep* grep, hues_grep_task* task, FILE* output, const char* data, size_t size)
+ * @brief Prints the lines of a chunk of text holding the string of a search, searching the chunk rather than each line.
+ * @param grep The search.
+ * @param task The search of the segment of the chunk.
+ * @param output The output of the segment.
+ * @param data The chunk.
+ * @param size The size of the chunk.
+ */
+static void hues_grep_text(const hues_grep* grep, hues_grep_task* task, FILE* output, const char* data, size_t size) {
+    const char* end = data + size;
+    const char* position = data;
+    const char* match;
+    while (position < end && (match = hues_grep_match(grep, position, end - position)) != NULL) {
+        const char* line = memrchr(data, '\n', match - data);
+        line = line != NULL ? line + 1 : data;
+        const char* newline = memchr(match, '\n', end - match);
+        position = newline != NULL ? newline + 1 : end;
+        task->matches++;
+        if (!grep->count) {
+            fwrite(line, 1, position - line, output);
+        }
+    }
+}
+
+/**
+ * @fn static void hues_grep_records(const hues_grep* grep, hues_grep_task* task, FILE* output, const char* data, size_t size)
+ * @brief Prints the text of the binary records of a buffer matching a search, skipping corrupt data 8 bytes at a time.
+ * The buffer is searched as a whole and only the records holding an occurrence are checked, so that records far from any occurrence
+ * cost a header read. Captured arguments are searched as stored, so that strings match but numbers do not.
+ * @param grep The search.
+ * @param task The search of the segment of the buffer.
+ * @param output The output of the segment.
+ * @param data The buffer, starting on a record.
+ * @param size The size of the buffer.
+ */
+static void hues_grep_records(const hues_grep* grep, hues_grep_task* task, FILE* output, const char* data, size_t size) {
+    const char* end = data + size;
+    const char* occurrence = hues_grep_find(data, size, grep->pattern, grep->pattern_length);
+    size_t offset = 0;
+    while (occurrence != NULL && offset + sizeof(hues_record_header) <= size) {
+        const hues_record_header* header = (const hues_record_header*) (data + offset);
+        if (header->magic != HUES_RECORD_MAGIC || HUES_RECORD_SIZE(header->length) > size - offset || header->location_length > header->length) {
+            offset += 8;
+            continue;
+        }
+        const char* stored = (const char*) (header + 1) + header->location_length;
+        size_t stored_length = header->length - header->location_length;
+        if (occurrence < stored) {
+            occurrence = hues_grep_find(stored, end - stored, grep->pattern, grep->pattern_length);
+        }
+        if (occurrence == NULL || occurrence + grep->pattern_length > stored + stored_length || header->level < grep->minimum_level
+            || header->timestamp < grep->from || header->timestamp > grep->to) {
+            offset += HUES_RECORD_SIZE(header->length);
+            continue;
+        }
+        if (header->checksum != hues_record_checksum(header, header + 1)) {
+            offset += 8;
+            continue;
+        }
+        char line[BUFFER_SIZE];
+        size_t length;
+        const char* text = hues_record_line(header, line, sizeof(line), &length);
+        if (grep->word && hues_grep_match(grep, text, length) == NULL) {
+            offset += HUES_RECORD_SIZE(header->length);
+            continue;
+        }
+        offset += HUES_RECORD_SIZE(header->length);
+        task->matches++;
+        if (!grep->count) {
+            fwrite(text, 1, length, output);
+            if (length == 0 || text[length - 1] != '\n') {
+                fputc('\n', output);
+            }
+        }
+    }
+}
+
+/**
+ * @fn static void hues_grep_chunk(const hues_grep* grep, hues_grep_task* task, FILE* output, const char* mapping, uint64_t offset, uint64_t end, const hues_file_header* header, char** data, size_t* capacity)
+ * @brief Prints the records of a chunk of a segment matching a search.
+ * @param grep The search.
+ * @param task The search of the segment.
+ * @param output The output of the segment.
+ * @param mapping The segment.
+ * @param offset The offset of the chunk, on a record or block boundary.
+ * @param end The end of the chunk.
+ * @param header The header of the segment, NULL for a text segment.
+ * @param data The decompression buffer of the thread, grown as needed.
+ * @param capacity The size of the decompression buffer.
+ */
+static void hues_grep_chunk(const hues_grep* grep, hues_grep_task* task, FILE* output, const char* mapping, uint64_t offset, uint64_t end,
+                            const hues_file_header* header, char** data, size_t* capacity) {
+    if (header == NULL) {
+        hues_grep_text(grep, task, output, mapping + offset, end - offset);
+        return;
+    }
+    if (header->compression == HUES_FILE_COMPRESSION_NONE) {
+        hues_grep_records(grep, task, output, mapping + offset, end - offset);
+        return;
+    }
+    while (offset + sizeof(hues_block_header) <= end) {
+        const hues_block_header* block = (const hues_block_header*) (mapping + offset);
+        if (block->magic != HUES_BLOCK_MAGIC) {
+            offset += 8;
+            continue;
+        }
+        if (block->size > *capacity) {
+            *capacity = block->size;
+            *data = realloc(*data, *capacity);
+        }
+        long length = hues_block_decode(block, end - offset, *data, *capacity);
+        if (length < 0) {
+            offset += 8;
+            continue;
+        }
+        if (header->format == HUES_FILE_FORMAT_TEXT) {
+            hues_grep_text(grep, task, output, *data, length);
+        } else {
+            hues_grep_records(grep, task, output, *data, length);
+        }
+        offset += HUES_BLOCK_SIZE(block->stored_size);
+    }
+}
+
+/**
+ * @fn static void hues_grep_segment(const hues_grep* grep, hues_grep_task* task, char** data, size_t* capacity)
+ * @brief Searches a log file segment, scanning the parts its index does not cover, unless its bloom filter rules out the string.
+ * @param grep The search.
+ * @param task The search of the segment, receiving its output.
+ * @param data The decompression buffer of the thread, grown as needed.
+ * @param capacity The size of the decompression buffer.
+ */
+static void hues_grep_segment(const hues_grep* grep, hues_grep_task* task, char** data, size_t* capacity) {
+    FILE* output = open_memstream(&task->output, &task->output_size);
+    int fd = open(task->path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        fprintf(output, "%s: %s\n", task->path, strerror(errno));  // Printed on stderr, in order
+        task->result = 1;
+        fclose(output);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    size_t size = status.st_size;
+    const char* mapping = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(output, "%s: %s\n", task->path, strerror(errno));
+        task->result = 1;
+        fclose(output);
+        return;
+    }
+    task->total = size;
+    if (size == 0) {
+        fclose(output);
+        return;
+    }
+    madvise((void*) mapping, size, MADV_SEQUENTIAL);
+    const hues_file_header* header = (const hues_file_header*) mapping;
+    if (size < sizeof(hues_file_header) || header->magic != HUES_FILE_MAGIC) {
+        header = NULL;  // Plain text file
+    }
+    if (header != NULL && header->version != HUES_FILE_VERSION) {
+        fprintf(output, "%s: log file version %u, version %d expected\n", task->path, header->version, HUES_FILE_VERSION);
+        task->result = 1;
+        munmap((void*) mapping, size);
+        fclose(output);
+        return;
+    }
+    if ((header == NULL || header->format == HUES_FILE_FORMAT_TEXT)
+        && (grep->minimum_level != HUES_LEVEL_TRACE || grep->from != 0 || grep->to != UINT64_MAX)) {
+        // Filtering lines by level or time would need to parse the level format, as in hues-query
+        fprintf(output, "%s: text segment, -f, -t and -l need binary records\n", task->path);
+        task->result = 1;
+        munmap((void*) mapping, size);
+        fclose(output);
+        return;
+    }
+    const hues_bloom_footer* footer = header != NULL ? hues_bloom_footer_find(mapping, size) : NULL;
+    if (footer != NULL) {
+        const uint64_t* filter = (const uint64_t*) ((const char*) footer - footer->bits / 8);
+        task->read += footer->size;
+        if (!hues_bloom_may_contain(filter, footer->bits, grep->tokens, grep->tokens_length)) {
+            task->skipped = 1;
+            munmap((void*) mapping, size);
+            fclose(output);
+            return;
+        }
+        size -= footer->size;
+    }
+    size_t count = 0;
+    hues_index_entry* entries = hues_index_load(task->path, &count);
+    uint64_t covered = header != NULL ? sizeof(hues_file_header) : 0;
+    for (size_t i = 0; i <= count; i++) {
+        uint64_t offset = i < count ? entries[i].offset : size;
+        offset = offset < size ? offset : size;
+        if (offset > covered) {
+            hues_grep_chunk(grep, task, output, mapping, covered, offset, header, data, capacity);
+            task->read += offset - covered;
+        }
+        if (i == count) {
+            break;
+        }
+        uint64_t end = entries[i].offset + entries[i].size;
+        end = end < size ? end : size;
+        if (end > offset && hues_index_entry_matches(&entries[i], grep->from, grep->to, grep->minimum_level)) {
+            hues_grep_chunk(grep, task, output, mapping, offset, end, header, data, capacity);
+            task->read += end - offset;
+        }
+        covered = end > covered ? end : covered;
+    }
+    free(entries);
+    munmap((void*) mapping, status.st_size);
+    fclose(output);
+}
+
+/**
+ * @fn static void* hues_grep_worker(void* argument)
+ * @brief Searches segments in order until none is left, staying within the window of the printed segments.
+ * @param argument The search.
+ * @return NULL.
+ */
+static void* hues_grep_worker(void* argument) {
+    hues_grep* grep = argument;
+    char* data = NULL;
+    size_t capacity = 0;
+    pthread_mutex_lock(&grep->mutex);
+    for (;;) {
+        while (grep->next < grep->tasks_count && grep->next >= grep->printed + grep->window) {
+            pthread_cond_wait(&grep->printed_condition, &grep->mutex);
+        }
+        if (grep->next == grep->tasks_count) {
+            break;
+        }
+        hues_grep_task* task = &grep->tasks[grep->next++];
+        pthread_mutex_unlock(&grep->mutex);
+        hues_grep_segment(grep, task, &data, &capacity);
+        pthread_mutex_lock(&grep->mutex);
+        task->done = 1;
+        pthread_cond_broadcast(&grep->searched);
+    }
+    pthread_mutex_unlock(&grep->mutex);
+    free(data);
+    return NULL;
+}
+
+/**
+ * @fn static void hues_grep_tokens(hues_grep* grep)
+ * @brief Finds the part of the string of a search made of whole tokens, the ones a bloom filter must hold for a segment to match:
+ * the string itself when delimited as a token, otherwise the string without its first and last token, which may be parts of longer ones.
+ * @param grep The search.
+ */
+static void hues_grep_tokens(hues_grep* grep) {
+    const char* start = grep->pattern;
+    const char* end = grep->pattern + grep->pattern_length;
+    if (!grep->word) {
+        while (start < end && hues_token_character(*start)) {
+            start++;
+        }
+        while (end > start && hues_token_character(end[-1])) {
+            end--;
+        }
+    }
+    grep->tokens = start;
+    grep->tokens_length = end - start;
+}
+
+int main(int argc, char** argv) {
+    hues_grep grep = { .from = 0, .to = UINT64_MAX, .minimum_level = HUES_LEVEL_TRACE };
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int verbose = 0;
+    int option;
+    while ((option = getopt(argc, argv, "f:t:l:wcj:v")) != -1) {
+        switch (option) {
+            case 'f':
+            case 't':
+                if (hues_time_parse(optarg, option == 'f' ? &grep.from : &grep.to) != 0) {
+                    fprintf(stderr, "hues-grep: invalid time: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'l':
+                grep.minimum_level = atoi(optarg);
+                break;
+            case 'w':
+                grep.word = 1;
+                break;
+            case 'c':
+                grep.count = 1;
+                break;
+            case 'j':
+                threads = atol(optarg);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                hues_grep_usage();
+                return 2;
+        }
+    }
+    if (argc - optind < 2 || argv[optind][0] == '\0' || threads < 1) {
+        hues_grep_usage();
+        return 2;
+    }
+    grep.pattern = argv[optind];
+    grep.pattern_length = strlen(grep.pattern);
+    hues_grep_tokens(&grep);
+    grep.tasks_count = argc - optind - 1;
+    grep.tasks = calloc(grep.tasks_count, sizeof(hues_grep_task));
+    for (size_t i = 0; i < grep.tasks_count; i++) {
+        grep.tasks[i].path = argv[optind + 1 + i];
+    }
+    threads = (size_t) threads < grep.tasks_count ? threads : (long) grep.tasks_count;
+    grep.window = 2 * threads;
+    pthread_mutex_init(&grep.mutex, NULL);
+    pthread_cond_init(&grep.searched, NULL);
+    pthread_cond_init(&grep.printed_condition, NULL);
+    pthread_t* workers = malloc(threads * sizeof(pthread_t));
+    for (long i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, hues_grep_worker, &grep);
+    }
+    static char output[256 * 1024];
+    setvbuf(stdout, output, _IOFBF, sizeof(output));
+    int result = 0;
+    size_t matches = 0;
+    size_t read = 0;
+    size_t total = 0;
+    size_t skipped = 0;
+    for (size_t i = 0; i < grep.tasks_count; i++) {
+        hues_grep_task* task = &grep.tasks[i];
+        pthread_mutex_lock(&grep.mutex);
+        while (!task->done) {
+            pthread_cond_wait(&grep.searched, &grep.mutex);
+        }
+        pthread_mutex_unlock(&grep.mutex);
+        if (task->result != 0) {
+            fflush(stdout);
+            fwrite(task->output, 1, task->output_size, stderr);
+        } else {
+            fwrite(task->output, 1, task->output_size, stdout);
+        }
+        free(task->output);
+        result |= task->result;
+        matches += task->matches;
+        read += task->read;
+        total += task->total;
+        skipped += task->skipped;
+        pthread_mutex_lock(&grep.mutex);
+        grep.printed++;
+        pthread_cond_broadcast(&grep.printed_condition);
+        pthread_mutex_unlock(&grep.mutex);
+    }
+    for (long i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    free(grep.tasks);
+    if (grep.count) {
+        printf("%zu\n", matches);
+    }
+    if (verbose) {
+        fflush(stdout);
+        fprintf(stderr, "hues-grep: read %zu of %zu bytes, skipped %zu of %zu segments, %ld threads\n", read, total, skipped, grep.tasks_count, threads);
+    }
+    return result != 0 ? 2 : matches > 0 ? 0 : 1;
+}
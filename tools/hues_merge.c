@@ -0,0 +1,437 @@
+/**
+ * @file hues_merge.c
+ * @brief Merges binary log files, compressed or not, written by separate threads or processes, into one timeline ordered by timestamp
+ * and sequence number
+ */
+
+#include "hues.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @def HUES_MERGE_MAXIMUM_BLOCK_SIZE
+ * @brief Maximum decompressed size of a block, larger sizes are considered corrupt.
+ */
+#define HUES_MERGE_MAXIMUM_BLOCK_SIZE (64 * 1024 * 1024)
+
+/**
+ * @def HUES_MERGE_RELEASE_SIZE
+ * @brief Number of bytes of an input read between releases of its pages, bounding the memory mapped inputs take.
+ */
+#define HUES_MERGE_RELEASE_SIZE (4 * 1024 * 1024)
+
+/**
+ * @def HUES_MERGE_GAP_WINDOW
+ * @brief Number of batches of sequence numbers checked for gaps at once, records of older batches coming too late to be checked.
+ */
+#define HUES_MERGE_GAP_WINDOW 65536
+
+/**
+ * @struct hues_merge_gaps
+ * @brief Represents the sequence numbers seen by a merge, to find the records missing from its inputs.
+ */
+typedef struct {
+    uint64_t* seen;  /**< Numbers seen of the batches of the window, a bit per number, by batch modulo the window size. */
+    uint64_t lowest;  /**< Lowest batch seen. */
+    uint64_t highest;  /**< Highest batch seen. */
+    int started;  /**< Whether a record was seen. */
+    size_t missing;  /**< Number of missing records found, a missing batch counting for one. */
+    size_t gaps;  /**< Number of runs of missing records found. */
+    size_t late;  /**< Number of records too late to be checked. */
+} hues_merge_gaps;
+
+/**
+ * @struct hues_merge_input
+ * @brief Represents an input of a merge, read record by record.
+ */
+typedef struct {
+    const char* path;  /**< Path of the input. */
+    size_t index;  /**< Position of the input on the command line, ordering records with the same timestamp and sequence number. */
+    const char* mapping;  /**< Mapped input. */
+    size_t mapping_size;  /**< Size of the mapping. */
+    size_t size;  /**< Size of the input, without any bloom filter footer. */
+    size_t offset;  /**< Offset of the next record or block of the input. */
+    size_t released;  /**< Offset up to which the pages of the input were released. */
+    int compressed;  /**< Whether the input is made of compressed blocks. */
+    char* data;  /**< Decompressed block. */
+    size_t capacity;  /**< Size of the decompression buffer. */
+    size_t data_size;  /**< Size of the decompressed block. */
+    size_t data_offset;  /**< Offset of the next record in the decompressed block. */
+    const hues_record_header* record;  /**< Current record, NULL once the input is exhausted. */
+    size_t corrupt;  /**< Number of corrupt bytes skipped. */
+} hues_merge_input;
+
+static void hues_merge_usage() {
+    fprintf(stderr, "usage: hues-merge [-o output] [-g] [-v] file...\n");
+    fprintf(stderr, "  -o output  write the records to a binary log file instead of printing their text\n");
+    fprintf(stderr, "  -g         report the records missing from the files, which must come from the same process\n");
+    fprintf(stderr, "  -v         print how many records were merged\n");
+    fprintf(stderr, "Records are ordered by timestamp, then sequence number, then position of their file on the command line.\n");
+    fprintf(stderr, "Records dropped, discarded by tail sampling or below the level of every file are missing alike.\n");
+}
+
+/**
+ * @fn static const hues_record_header* hues_merge_record(const char* data, size_t size, size_t* offset, size_t* corrupt)
+ * @brief Finds the next valid binary record of a buffer, skipping corrupt data 8 bytes at a time.
+ * @param data The buffer.
+ * @param size The size of the buffer.
+ * @param offset The offset to search from, advanced past the record.
+ * @param corrupt Incremented by the number of corrupt bytes skipped.
+ * @return The record, or NULL if there is none left.
+ */
+static const hues_record_header* hues_merge_record(const char* data, size_t size, size_t* offset, size_t* corrupt) {
+    while (*offset + sizeof(hues_record_header) <= size) {
+        const hues_record_header* header = (const hues_record_header*) (data + *offset);
+        if (header->magic != HUES_RECORD_MAGIC || HUES_RECORD_SIZE(header->length) > size - *offset || header->location_length > header->length
+            || header->checksum != hues_record_checksum(header, header + 1)) {
+            *corrupt += 8;
+            *offset += 8;
+            continue;
+        }
+        *offset += HUES_RECORD_SIZE(header->length);
+        return header;
+    }
+    *offset = size;
+    return NULL;
+}
+
+/**
+ * @fn static void hues_merge_release(hues_merge_input* input)
+ * @brief Releases the pages of an input read since the last release, once there are enough of them.
+ * @param input The input.
+ */
+static void hues_merge_release(hues_merge_input* input) {
+    // The current record of an uncompressed input is still read from the mapping
+    size_t used = !input->compressed && input->record != NULL ? (size_t) ((const char*) input->record - input->mapping) : input->offset;
+    if (used - input->released < HUES_MERGE_RELEASE_SIZE) {
+        return;
+    }
+    size_t end = used & ~(size_t) (sysconf(_SC_PAGESIZE) - 1);
+    madvise((void*) (input->mapping + input->released), end - input->released, MADV_DONTNEED);
+    input->released = end;
+}
+
+/**
+ * @fn static void hues_merge_advance(hues_merge_input* input)
+ * @brief Moves an input to its next record, decompressing its next block if needed.
+ * @param input The input.
+ */
+static void hues_merge_advance(hues_merge_input* input) {
+    if (!input->compressed) {
+        input->record = hues_merge_record(input->mapping, input->size, &input->offset, &input->corrupt);
+        hues_merge_release(input);
+        return;
+    }
+    while ((input->record = hues_merge_record(input->data, input->data_size, &input->data_offset, &input->corrupt)) == NULL) {
+        input->data_size = 0;
+        input->data_offset = 0;
+        while (input->offset + sizeof(hues_block_header) <= input->size) {
+            const hues_block_header* block = (const hues_block_header*) (input->mapping + input->offset);
+            if (block->magic == HUES_BLOCK_MAGIC && block->size > input->capacity && block->size <= HUES_MERGE_MAXIMUM_BLOCK_SIZE) {
+                input->capacity = block->size;
+                input->data = realloc(input->data, input->capacity);
+            }
+            long length = block->magic == HUES_BLOCK_MAGIC ? hues_block_decode(block, input->size - input->offset, input->data, input->capacity) : -1;
+            if (length < 0) {
+                input->corrupt += 8;
+                input->offset += 8;  // Resynchronize on the next block
+                continue;
+            }
+            input->offset += HUES_BLOCK_SIZE(block->stored_size);
+            input->data_size = length;
+            break;
+        }
+        hues_merge_release(input);
+        if (input->data_size == 0) {
+            return;
+        }
+    }
+}
+
+/**
+ * @fn static int hues_merge_open(hues_merge_input* input)
+ * @brief Maps an input and moves it to its first record.
+ * @param input The input, its path and index set.
+ * @return 0 on success, 1 if the input cannot be read or is not a binary log file.
+ */
+static int hues_merge_open(hues_merge_input* input) {
+    int fd = open(input->path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(input->path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+    input->mapping_size = status.st_size;
+    input->mapping = input->mapping_size > 0 ? mmap(NULL, input->mapping_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    const hues_file_header* header = (const hues_file_header*) input->mapping;
+    if (input->mapping == MAP_FAILED || input->mapping_size < sizeof(hues_file_header) || header->magic != HUES_FILE_MAGIC
+        || header->format != HUES_FILE_FORMAT_BINARY) {
+        fprintf(stderr, "%s: not a binary log file\n", input->path);
+        if (input->mapping != MAP_FAILED) {
+            munmap((void*) input->mapping, input->mapping_size);
+        }
+        input->mapping = NULL;
+        return 1;
+    }
+    if (header->version != HUES_FILE_VERSION) {
+        fprintf(stderr, "%s: log file version %u, version %d expected\n", input->path, header->version, HUES_FILE_VERSION);
+        munmap((void*) input->mapping, input->mapping_size);
+        input->mapping = NULL;
+        return 1;
+    }
+    madvise((void*) input->mapping, input->mapping_size, MADV_SEQUENTIAL);
+    const hues_bloom_footer* footer = hues_bloom_footer_find(input->mapping, input->mapping_size);
+    input->size = input->mapping_size - (footer != NULL ? footer->size : 0);
+    input->offset = sizeof(hues_file_header);
+    input->compressed = header->compression != HUES_FILE_COMPRESSION_NONE;
+    hues_merge_advance(input);
+    return 0;
+}
+
+/**
+ * @fn static int hues_merge_before(const hues_merge_input* first, const hues_merge_input* second)
+ * @brief Compares the current records of two inputs.
+ * @param first The first input.
+ * @param second The second input.
+ * @return Whether the record of the first input comes before the record of the second one.
+ */
+static int hues_merge_before(const hues_merge_input* first, const hues_merge_input* second) {
+    if (first->record->timestamp != second->record->timestamp) {
+        return first->record->timestamp < second->record->timestamp;
+    }
+    if (first->record->sequence != second->record->sequence) {
+        return first->record->sequence < second->record->sequence;
+    }
+    return first->index < second->index;
+}
+
+/**
+ * @fn static void hues_merge_sift_down(hues_merge_input** heap, size_t count, size_t position)
+ * @brief Restores the order of a binary min-heap of inputs whose entry at a position may come after its children.
+ * @param heap The heap.
+ * @param count The number of inputs of the heap.
+ * @param position The position of the entry.
+ */
+static void hues_merge_sift_down(hues_merge_input** heap, size_t count, size_t position) {
+    hues_merge_input* input = heap[position];
+    for (;;) {
+        size_t child = 2 * position + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && hues_merge_before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!hues_merge_before(heap[child], input)) {
+            break;
+        }
+        heap[position] = heap[child];
+        position = child;
+    }
+    heap[position] = input;
+}
+
+/**
+ * @fn static void hues_merge_write(FILE* output, const hues_record_header* record, int binary)
+ * @brief Writes a record to the output of a merge.
+ * @param output The output.
+ * @param record The record.
+ * @param binary Whether the output is a binary log file, otherwise the text of the record is written.
+ */
+static void hues_merge_write(FILE* output, const hues_record_header* record, int binary) {
+    if (binary) {
+        fwrite(record, 1, HUES_RECORD_SIZE(record->length), output);
+        return;
+    }
+    char line[BUFFER_SIZE];
+    size_t length;
+    const char* text = hues_record_line(record, line, sizeof(line), &length);
+    fwrite(text, 1, length, output);
+    if (length == 0 || text[length - 1] != '\n') {
+        fputc('\n', output);
+    }
+}
+
+/**
+ * @fn static void hues_merge_gaps_finish(hues_merge_gaps* gaps, uint64_t batch)
+ * @brief Reports the records missing from a batch of sequence numbers leaving the window: the numbers not seen before the last
+ * one seen, or the whole batch if none was seen.
+ * @param gaps The sequence numbers seen.
+ * @param batch The batch.
+ */
+static void hues_merge_gaps_finish(hues_merge_gaps* gaps, uint64_t batch) {
+    uint64_t seen = gaps->seen[batch % HUES_MERGE_GAP_WINDOW];
+    gaps->seen[batch % HUES_MERGE_GAP_WINDOW] = 0;
+    uint64_t start = batch * HUES_SEQUENCE_BATCH;
+    if (seen == 0) {
+        if (batch > gaps->lowest) {
+            fprintf(stderr, "hues-merge: missing records %llu to %llu, at least the first one\n", (unsigned long long) start,
+                    (unsigned long long) (start + HUES_SEQUENCE_BATCH - 1));
+            gaps->missing++;
+            gaps->gaps++;
+        }
+        return;
+    }
+    int last = 63 - __builtin_clzll(seen);
+    for (int i = 0; i < last;) {
+        if (seen & (1ull << i)) {
+            i++;
+            continue;
+        }
+        int end = i;
+        while ((seen & (1ull << end)) == 0) {
+            end++;
+        }
+        fprintf(stderr, "hues-merge: missing records %llu to %llu\n", (unsigned long long) (start + i), (unsigned long long) (start + end - 1));
+        gaps->missing += end - i;
+        gaps->gaps++;
+        i = end;
+    }
+}
+
+/**
+ * @fn static void hues_merge_gaps_add(hues_merge_gaps* gaps, uint64_t sequence)
+ * @brief Notes a sequence number seen, reporting the gaps of the batches it pushes out of the window.
+ * @param gaps The sequence numbers seen.
+ * @param sequence The sequence number.
+ */
+static void hues_merge_gaps_add(hues_merge_gaps* gaps, uint64_t sequence) {
+    uint64_t batch = sequence / HUES_SEQUENCE_BATCH;
+    if (!gaps->started) {
+        gaps->lowest = batch;
+        gaps->highest = batch;
+        gaps->started = 1;
+    }
+    if (batch + HUES_MERGE_GAP_WINDOW <= gaps->highest) {
+        gaps->late++;
+        return;
+    }
+    if (batch >= gaps->highest + HUES_MERGE_GAP_WINDOW) {
+        // Every batch of the window leaves it, and the ones in between were never seen
+        uint64_t first = gaps->highest >= gaps->lowest + HUES_MERGE_GAP_WINDOW ? gaps->highest - HUES_MERGE_GAP_WINDOW + 1 : gaps->lowest;
+        for (uint64_t i = first; i <= gaps->highest; i++) {
+            hues_merge_gaps_finish(gaps, i);
+        }
+        fprintf(stderr, "hues-merge: missing records %llu to %llu, at least the first of every %d\n",
+                (unsigned long long) ((gaps->highest + 1) * HUES_SEQUENCE_BATCH), (unsigned long long) (batch * HUES_SEQUENCE_BATCH - 1), HUES_SEQUENCE_BATCH);
+        gaps->missing += batch - gaps->highest - 1;
+        gaps->gaps++;
+        gaps->lowest = batch;
+        gaps->highest = batch;
+    }
+    while (gaps->highest < batch) {
+        gaps->highest++;
+        if (gaps->highest >= gaps->lowest + HUES_MERGE_GAP_WINDOW) {
+            hues_merge_gaps_finish(gaps, gaps->highest - HUES_MERGE_GAP_WINDOW);
+        }
+    }
+    gaps->lowest = batch < gaps->lowest ? batch : gaps->lowest;
+    gaps->seen[batch % HUES_MERGE_GAP_WINDOW] |= 1ull << (sequence % HUES_SEQUENCE_BATCH);
+}
+
+int main(int argc, char** argv) {
+    const char* output_path = NULL;
+    hues_merge_gaps gaps = { 0 };
+    int verbose = 0;
+    int option;
+    while ((option = getopt(argc, argv, "o:gv")) != -1) {
+        switch (option) {
+            case 'o':
+                output_path = optarg;
+                break;
+            case 'g':
+                gaps.seen = calloc(HUES_MERGE_GAP_WINDOW, sizeof(uint64_t));
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                hues_merge_usage();
+                return 2;
+        }
+    }
+    if (optind == argc) {
+        hues_merge_usage();
+        return 2;
+    }
+    FILE* output = stdout;
+    if (output_path != NULL) {
+        output = fopen(output_path, "w");
+        if (output == NULL) {
+            perror(output_path);
+            return 1;
+        }
+        hues_file_header header = { .magic = HUES_FILE_MAGIC, .version = HUES_FILE_VERSION, .format = HUES_FILE_FORMAT_BINARY,
+                                    .compression = HUES_FILE_COMPRESSION_NONE };
+        fwrite(&header, 1, sizeof(header), output);
+    }
+    static char buffer[1024 * 1024];
+    setvbuf(output, buffer, _IOFBF, sizeof(buffer));
+    size_t inputs_count = argc - optind;
+    hues_merge_input* inputs = calloc(inputs_count, sizeof(hues_merge_input));
+    hues_merge_input** heap = malloc(inputs_count * sizeof(hues_merge_input*));
+    size_t count = 0;
+    int result = 0;
+    for (size_t i = 0; i < inputs_count; i++) {
+        inputs[i].path = argv[optind + i];
+        inputs[i].index = i;
+        result |= hues_merge_open(&inputs[i]);
+        if (inputs[i].record != NULL) {
+            heap[count++] = &inputs[i];
+        }
+    }
+    for (size_t i = count / 2; i-- > 0;) {
+        hues_merge_sift_down(heap, count, i);
+    }
+    size_t records = 0;
+    while (count > 0) {
+        hues_merge_input* input = heap[0];
+        hues_merge_write(output, input->record, output_path != NULL);
+        if (gaps.seen != NULL) {
+            hues_merge_gaps_add(&gaps, input->record->sequence);
+        }
+        records++;
+        hues_merge_advance(input);
+        if (input->record == NULL) {
+            heap[0] = heap[--count];
+        }
+        if (count > 0) {
+            hues_merge_sift_down(heap, count, 0);
+        }
+    }
+    for (size_t i = 0; i < inputs_count; i++) {
+        if (inputs[i].corrupt > 0) {
+            fprintf(stderr, "%s: skipped %zu corrupt bytes\n", inputs[i].path, inputs[i].corrupt);
+        }
+        if (inputs[i].mapping != NULL) {
+            munmap((void*) inputs[i].mapping, inputs[i].mapping_size);
+        }
+        free(inputs[i].data);
+    }
+    if (gaps.seen != NULL && gaps.started) {
+        fflush(output);
+        uint64_t first = gaps.highest >= gaps.lowest + HUES_MERGE_GAP_WINDOW ? gaps.highest - HUES_MERGE_GAP_WINDOW + 1 : gaps.lowest;
+        for (uint64_t i = first; i <= gaps.highest; i++) {
+            hues_merge_gaps_finish(&gaps, i);
+        }
+        fprintf(stderr, "hues-merge: %zu records missing in %zu gaps, %zu records too late to check\n", gaps.missing, gaps.gaps, gaps.late);
+        result |= gaps.missing > 0;
+    }
+    free(gaps.seen);
+    free(heap);
+    free(inputs);
+    if (fflush(output) != 0 || (output != stdout && fclose(output) != 0)) {
+        perror(output_path != NULL ? output_path : "stdout");
+        result = 1;
+    }
+    if (verbose) {
+        fprintf(stderr, "hues-merge: merged %zu records from %zu files\n", records, inputs_count);
+    }
+    return result;
+}
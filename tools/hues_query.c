@@ -0,0 +1,288 @@
+/**
+ * @file hues_query.c
+ * @brief Prints the records of log files in a time range, at or above a level and holding a word, reading only the chunks their sidecar indexes
+ * point to, in the segments whose bloom filter may hold the word
+ */
+
+#define _GNU_SOURCE  // memmem
+
+#include "hues.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @struct hues_query
+ * @brief Represents the criteria of a query.
+ */
+typedef struct {
+    uint64_t from;  /**< Start of the time range, in nanoseconds since the epoch. */
+    uint64_t to;  /**< End of the time range, included. */
+    hues_level_enum minimum_level;  /**< Minimum level. */
+    const char* word;  /**< Word the records must hold, NULL for any record. */
+    size_t word_length;  /**< Length of the word. */
+    size_t read;  /**< Number of bytes of the segments read so far. */
+    size_t total;  /**< Total size of the segments queried so far. */
+    size_t skipped;  /**< Number of segments skipped thanks to their bloom filter. */
+    size_t segments;  /**< Number of segments queried so far. */
+} hues_query;
+
+static void hues_query_usage() {
+    fprintf(stderr, "usage: hues-query [-f time] [-t time] [-l level] [-w word] [-v] file...\n");
+    fprintf(stderr, "  -f time   earliest record, as YYYY-MM-DD HH:MM[:SS], HH:MM[:SS] today, or @seconds since the epoch\n");
+    fprintf(stderr, "  -t time   latest record, in the same forms\n");
+    fprintf(stderr, "  -l level  minimum level (0 = TRACE ... 5 = CRITICAL)\n");
+    fprintf(stderr, "  -w word   records holding word, or several words, delimited by characters other than letters, digits, '_' and '-'\n");
+    fprintf(stderr, "  -v        print how much of the files was read\n");
+    fprintf(stderr, "Binary files are filtered record by record. Text files hold no level nor time per line: only -w applies to them.\n");
+}
+
+/**
+ * @fn static int hues_query_word_matches(const hues_query* query, const char* text, size_t length)
+ * @brief Checks whether a text holds the word of a query, delimited as a token.
+ * @param query The query.
+ * @param text The text.
+ * @param length The length of the text.
+ * @return 1 if the text holds the word or the query has none, 0 otherwise.
+ */
+static int hues_query_word_matches(const hues_query* query, const char* text, size_t length) {
+    if (query->word == NULL) {
+        return 1;
+    }
+    const char* end = text + length;
+    const char* match = text;
+    while ((match = memmem(match, end - match, query->word, query->word_length)) != NULL) {
+        const char* after = match + query->word_length;
+        if ((match == text || !hues_token_character(match[-1])) && (after == end || !hues_token_character(*after))) {
+            return 1;
+        }
+        match++;
+    }
+    return 0;
+}
+
+/**
+ * @fn static void hues_query_text(const char* data, size_t size, const hues_query* query)
+ * @brief Prints the lines of a chunk of text holding the word of a query, or the whole chunk if the query has none.
+ * @param data The chunk.
+ * @param size The size of the chunk.
+ * @param query The query.
+ */
+static void hues_query_text(const char* data, size_t size, const hues_query* query) {
+    if (query->word == NULL) {
+        fwrite(data, 1, size, stdout);
+        return;
+    }
+    const char* end = data + size;
+    while (data < end) {
+        const char* newline = memchr(data, '\n', end - data);
+        const char* line_end = newline != NULL ? newline + 1 : end;
+        if (hues_query_word_matches(query, data, line_end - data)) {
+            fwrite(data, 1, line_end - data, stdout);
+        }
+        data = line_end;
+    }
+}
+
+/**
+ * @fn static void hues_query_records(const char* data, size_t size, const hues_query* query)
+ * @brief Prints the text of the binary records of a buffer matching a query, skipping corrupt data 8 bytes at a time.
+ * @param data The buffer, starting on a record.
+ * @param size The size of the buffer.
+ * @param query The query.
+ */
+static void hues_query_records(const char* data, size_t size, const hues_query* query) {
+    size_t offset = 0;
+    while (offset + sizeof(hues_record_header) <= size) {
+        const hues_record_header* header = (const hues_record_header*) (data + offset);
+        if (header->magic != HUES_RECORD_MAGIC || HUES_RECORD_SIZE(header->length) > size - offset || header->location_length > header->length
+            || header->checksum != hues_record_checksum(header, header + 1)) {
+            offset += 8;
+            continue;
+        }
+        offset += HUES_RECORD_SIZE(header->length);
+        char line[BUFFER_SIZE];
+        size_t length;
+        const char* text = hues_record_line(header, line, sizeof(line), &length);
+        if (header->level < query->minimum_level || header->timestamp < query->from || header->timestamp > query->to
+            || !hues_query_word_matches(query, text, length)) {
+            continue;
+        }
+        fwrite(text, 1, length, stdout);
+        if (length == 0 || text[length - 1] != '\n') {
+            putchar('\n');
+        }
+    }
+}
+
+/**
+ * @fn static void hues_query_chunk(const char* mapping, uint64_t offset, uint64_t end, const hues_file_header* header, const hues_query* query)
+ * @brief Prints the records of a chunk of a segment matching a query.
+ * @param mapping The segment.
+ * @param offset The offset of the chunk, on a record or block boundary.
+ * @param end The end of the chunk.
+ * @param header The header of the segment, NULL for a text segment.
+ * @param query The query.
+ */
+static void hues_query_chunk(const char* mapping, uint64_t offset, uint64_t end, const hues_file_header* header, const hues_query* query) {
+    if (header == NULL) {
+        hues_query_text(mapping + offset, end - offset, query);
+        return;
+    }
+    if (header->compression == HUES_FILE_COMPRESSION_NONE) {
+        hues_query_records(mapping + offset, end - offset, query);
+        return;
+    }
+    static char* data = NULL;
+    static size_t capacity = 0;
+    while (offset + sizeof(hues_block_header) <= end) {
+        const hues_block_header* block = (const hues_block_header*) (mapping + offset);
+        if (block->magic != HUES_BLOCK_MAGIC) {
+            offset += 8;
+            continue;
+        }
+        if (block->size > capacity) {
+            capacity = block->size;
+            data = realloc(data, capacity);
+        }
+        long length = hues_block_decode(block, end - offset, data, capacity);
+        if (length < 0) {
+            offset += 8;
+            continue;
+        }
+        if (header->format == HUES_FILE_FORMAT_TEXT) {
+            hues_query_text(data, length, query);
+        } else {
+            hues_query_records(data, length, query);
+        }
+        offset += HUES_BLOCK_SIZE(block->stored_size);
+    }
+}
+
+/**
+ * @fn static int hues_query_file(const char* path, hues_query* query)
+ * @brief Prints the records of a log file segment matching a query, scanning the parts its index does not cover,
+ * unless the bloom filter ending the segment rules out the word of the query.
+ * @param path The path of the segment.
+ * @param query The query.
+ * @return 0 on success, 1 if the file cannot be read.
+ */
+static int hues_query_file(const char* path, hues_query* query) {
+    int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(path);
+        return 1;
+    }
+    size_t size = status.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+    const char* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+    const hues_file_header* header = (const hues_file_header*) mapping;
+    if (size < sizeof(hues_file_header) || header->magic != HUES_FILE_MAGIC) {
+        header = NULL;  // Plain text file
+    }
+    if (header != NULL && header->version != HUES_FILE_VERSION) {
+        fprintf(stderr, "hues-query: %s: log file version %u, version %d expected\n", path, header->version, HUES_FILE_VERSION);
+        munmap((void*) mapping, size);
+        return 1;
+    }
+    if ((header == NULL || header->format == HUES_FILE_FORMAT_TEXT)
+        && (query->minimum_level != HUES_LEVEL_TRACE || query->from != 0 || query->to != UINT64_MAX)) {
+        // Text files have no index, and filtering lines by level or time would need to parse the level format
+        fprintf(stderr, "hues-query: %s: text segment, only -w applies to it\n", path);
+        munmap((void*) mapping, size);
+        return 1;
+    }
+    query->segments++;
+    query->total += size;
+    const hues_bloom_footer* footer = header != NULL ? hues_bloom_footer_find(mapping, size) : NULL;
+    if (footer != NULL) {
+        const uint64_t* filter = (const uint64_t*) ((const char*) footer - footer->bits / 8);
+        query->read += footer->size;
+        if (query->word != NULL && !hues_bloom_may_contain(filter, footer->bits, query->word, query->word_length)) {
+            query->skipped++;
+            munmap((void*) mapping, size);
+            return 0;
+        }
+        size -= footer->size;
+    }
+    size_t count = 0;
+    hues_index_entry* entries = hues_index_load(path, &count);
+    uint64_t covered = header != NULL ? sizeof(hues_file_header) : 0;
+    for (size_t i = 0; i <= count; i++) {
+        // Entries ending past the segment only happen when the segment is being written or was truncated
+        uint64_t offset = i < count ? entries[i].offset : size;
+        offset = offset < size ? offset : size;
+        if (offset > covered) {
+            hues_query_chunk(mapping, covered, offset, header, query);
+            query->read += offset - covered;
+        }
+        if (i == count) {
+            break;
+        }
+        uint64_t end = entries[i].offset + entries[i].size;
+        end = end < size ? end : size;
+        if (end > offset && hues_index_entry_matches(&entries[i], query->from, query->to, query->minimum_level)) {
+            hues_query_chunk(mapping, offset, end, header, query);
+            query->read += end - offset;
+        }
+        covered = end > covered ? end : covered;
+    }
+    free(entries);
+    munmap((void*) mapping, status.st_size);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    hues_query query = { .from = 0, .to = UINT64_MAX, .minimum_level = HUES_LEVEL_TRACE };
+    int verbose = 0;
+    int option;
+    while ((option = getopt(argc, argv, "f:t:l:w:v")) != -1) {
+        switch (option) {
+            case 'f':
+            case 't':
+                if (hues_time_parse(optarg, option == 'f' ? &query.from : &query.to) != 0) {
+                    fprintf(stderr, "hues-query: invalid time: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'l':
+                query.minimum_level = atoi(optarg);
+                break;
+            case 'w':
+                query.word = optarg;
+                query.word_length = strlen(optarg);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                hues_query_usage();
+                return 2;
+        }
+    }
+    if (optind == argc) {
+        hues_query_usage();
+        return 2;
+    }
+    static char output[256 * 1024];
+    setvbuf(stdout, output, _IOFBF, sizeof(output));
+    int result = 0;
+    for (int i = optind; i < argc; i++) {
+        result |= hues_query_file(argv[i], &query);
+    }
+    if (verbose) {
+        fflush(stdout);
+        fprintf(stderr, "hues-query: read %zu of %zu bytes, skipped %zu of %zu segments\n", query.read, query.total, query.skipped, query.segments);
+    }
+    return result;
+}
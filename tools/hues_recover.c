@@ -0,0 +1,129 @@
+/**
+ * @file hues_recover.c
+ * @brief Reads back the last records of a flight recorder ring after its process is gone
+ */
+
+#include "hues.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @struct hues_recovered_record
+ * @brief Represents a record found in the ring.
+ */
+typedef struct {
+    const hues_record_header* header;  /**< Record header, inside the mapping. */
+    uint64_t age;  /**< Distance of the record from the oldest byte of the ring, ordering the records as they were reserved. */
+    int torn;  /**< Whether the checksum of the record does not match. */
+} hues_recovered_record;
+
+static int hues_recovered_record_compare(const void* left, const void* right) {
+    uint64_t left_age = ((const hues_recovered_record*) left)->age;
+    uint64_t right_age = ((const hues_recovered_record*) right)->age;
+    return (left_age > right_age) - (left_age < right_age);
+}
+
+static void hues_recover_usage() {
+    fprintf(stderr, "usage: hues-recover [-n count] [-t] ring-file\n");
+    fprintf(stderr, "  -n count  print only the last count records\n");
+    fprintf(stderr, "  -t        also print torn records\n");
+}
+
+int main(int argc, char** argv) {
+    size_t count = 0;
+    int show_torn = 0;
+    int option;
+    while ((option = getopt(argc, argv, "n:t")) != -1) {
+        switch (option) {
+            case 'n':
+                count = strtoull(optarg, NULL, 10);
+                break;
+            case 't':
+                show_torn = 1;
+                break;
+            default:
+                hues_recover_usage();
+                return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        hues_recover_usage();
+        return 2;
+    }
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if ((size_t) status.st_size < sizeof(hues_ring_header)) {
+        fprintf(stderr, "%s: not a hues ring\n", argv[optind]);
+        return 1;
+    }
+    const char* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    const hues_ring_header* ring = (const hues_ring_header*) mapping;
+    if (ring->magic != HUES_RING_MAGIC || ring->version != HUES_RING_VERSION || ring->capacity == 0
+        || sizeof(hues_ring_header) + ring->capacity > (size_t) status.st_size) {
+        fprintf(stderr, "%s: not a hues ring\n", argv[optind]);
+        return 1;
+    }
+    const char* data = mapping + sizeof(hues_ring_header);
+    // Records are reserved by advancing the write position, across processes and restarts: the oldest byte is the one it points to.
+    // A record reserved may not have been written before its process died, so scan the whole data area and resynchronize on every
+    // 8-byte boundary holding the record magic.
+    uint64_t oldest = ring->write_position % ring->capacity;
+    size_t records_count = 0;
+    size_t records_capacity = 256;
+    hues_recovered_record* records = malloc(records_capacity * sizeof(hues_recovered_record));
+    size_t torn_count = 0;
+    uint64_t offset = 0;
+    while (offset + sizeof(hues_record_header) <= ring->capacity) {
+        const hues_record_header* header = (const hues_record_header*) (data + offset);
+        if (header->magic != HUES_RECORD_MAGIC || HUES_RECORD_SIZE(header->length) > ring->capacity - offset) {
+            offset += 8;
+            continue;
+        }
+        if (header->flags & HUES_RECORD_FLAG_PADDING) {
+            offset += HUES_RECORD_SIZE(header->length);
+            continue;
+        }
+        int torn = header->checksum != hues_record_checksum(header, header + 1) || header->location_length > header->length;
+        if (torn) {
+            torn_count++;
+            if (!show_torn) {
+                offset += 8;
+                continue;
+            }
+        }
+        if (records_count == records_capacity) {
+            records_capacity *= 2;
+            records = realloc(records, records_capacity * sizeof(hues_recovered_record));
+        }
+        records[records_count++] = (hues_recovered_record) { header, (offset + ring->capacity - oldest) % ring->capacity, torn };
+        offset += torn ? 8 : HUES_RECORD_SIZE(header->length);
+    }
+    qsort(records, records_count, sizeof(hues_recovered_record), hues_recovered_record_compare);
+    fprintf(stderr, "%s: generation %llu, %zu records, %zu torn\n", argv[optind], (unsigned long long) ring->generation, records_count - (show_torn ? torn_count : 0), torn_count);
+    size_t first = count != 0 && count < records_count ? records_count - count : 0;
+    for (size_t i = first; i < records_count; i++) {
+        const hues_record_header* header = records[i].header;
+        const char* payload = (const char*) (header + 1);
+        size_t location_length = header->location_length <= header->length ? header->location_length : header->length;
+        char line[BUFFER_SIZE];
+        size_t length;
+        const char* text = hues_record_line(header, line, sizeof(line), &length);
+        int text_length = length;
+        if (text_length > 0 && text[text_length - 1] == '\n') {
+            text_length--;
+        }
+        printf("%s#%llu %s [%.*s] %.*s\n", records[i].torn ? "TORN " : "", (unsigned long long) header->sequence, hues_level_name(header->level), (int) location_length, payload, text_length, text);
+    }
+    free(records);
+    return 0;
+}
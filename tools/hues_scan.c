@@ -0,0 +1,346 @@
+/**
+ * @file hues_scan.c
+ * @brief Filters and aggregates the records of columnar log archives by time, level and callsite
+ */
+
+#define _GNU_SOURCE  // memmem
+
+#include "hues.h"
+
+/**
+ * @def HUES_SCAN_KEY_TIME
+ * @brief Groups the records by time bucket.
+ */
+#define HUES_SCAN_KEY_TIME 0x01
+
+/**
+ * @def HUES_SCAN_KEY_LEVEL
+ * @brief Groups the records by level.
+ */
+#define HUES_SCAN_KEY_LEVEL 0x02
+
+/**
+ * @def HUES_SCAN_KEY_CALLSITE
+ * @brief Groups the records by callsite.
+ */
+#define HUES_SCAN_KEY_CALLSITE 0x04
+
+/**
+ * @struct hues_scan_count
+ * @brief Represents the number of records of a group.
+ */
+typedef struct {
+    uint64_t bucket;  /**< Start of the time bucket, in nanoseconds since the epoch, 0 if not grouped by time. */
+    uint32_t level;  /**< Level, 0 if not grouped by level. */
+    uint32_t callsite;  /**< Callsite identifier plus one across archives, 0 if not grouped by callsite. */
+    uint64_t count;  /**< Number of records. */
+} hues_scan_count;
+
+/**
+ * @struct hues_scan
+ * @brief Represents a scan: its predicates, its grouping and its results so far.
+ */
+typedef struct {
+    uint64_t from;  /**< Start of the time range, in nanoseconds since the epoch. */
+    uint64_t to;  /**< End of the time range, included. */
+    uint8_t minimum_level;  /**< Minimum level. */
+    const char* callsite;  /**< Text the callsites must contain, NULL for any callsite. */
+    int keys;  /**< HUES_SCAN_KEY_* grouping the records, 0 to print them. */
+    uint64_t bucket_width;  /**< Width of the time buckets, in nanoseconds. */
+    char** callsites;  /**< Callsites seen across archives, by identifier. */
+    size_t callsites_count;  /**< Number of callsites seen. */
+    hues_scan_count* counts;  /**< Open addressing table of the groups, empty slots have a zero count. */
+    size_t counts_capacity;  /**< Number of slots of the table, a power of two. */
+    size_t counts_used;  /**< Number of groups. */
+    size_t groups;  /**< Number of row groups of the archives. */
+    size_t groups_scanned;  /**< Number of row groups decoded, the others being ruled out by their header. */
+    size_t records;  /**< Number of records selected. */
+} hues_scan;
+
+static void hues_scan_usage() {
+    fprintf(stderr, "usage: hues-scan [-f time] [-t time] [-l level] [-c callsite] [-g keys] [-b seconds] [-v] archive...\n");
+    fprintf(stderr, "  -f time      earliest record, as YYYY-MM-DD HH:MM[:SS], HH:MM[:SS] today, or @seconds since the epoch\n");
+    fprintf(stderr, "  -t time      latest record, in the same forms\n");
+    fprintf(stderr, "  -l level     minimum level (0 = TRACE ... 5 = CRITICAL)\n");
+    fprintf(stderr, "  -c callsite  records whose callsite (\"function @ file:line\") contains callsite\n");
+    fprintf(stderr, "  -g keys      count the records per group instead of printing them, keys among time, level and callsite, comma separated\n");
+    fprintf(stderr, "  -b seconds   width of the time groups (default 60)\n");
+    fprintf(stderr, "  -v           print how many row groups were decoded\n");
+}
+
+/**
+ * @fn static uint32_t hues_scan_callsite(hues_scan* scan, const char* name, size_t length)
+ * @brief Finds the identifier of a callsite across archives, adding it if it is new.
+ * Dictionaries are small: a linear search per dictionary entry is enough.
+ * @param scan The scan.
+ * @param name The callsite.
+ * @param length The length of the callsite.
+ * @return The identifier of the callsite.
+ */
+static uint32_t hues_scan_callsite(hues_scan* scan, const char* name, size_t length) {
+    for (size_t i = 0; i < scan->callsites_count; i++) {
+        if (strlen(scan->callsites[i]) == length && memcmp(scan->callsites[i], name, length) == 0) {
+            return i;
+        }
+    }
+    scan->callsites = realloc(scan->callsites, (scan->callsites_count + 1) * sizeof(char*));
+    scan->callsites[scan->callsites_count] = strndup(name, length);
+    return scan->callsites_count++;
+}
+
+/**
+ * @fn static hues_scan_count* hues_scan_slot(hues_scan_count* counts, size_t capacity, uint64_t bucket, uint32_t level, uint32_t callsite)
+ * @brief Looks for the slot of a group in a table of groups.
+ * @param counts The table.
+ * @param capacity The number of slots of the table, a power of two.
+ * @param bucket The time bucket of the group.
+ * @param level The level of the group.
+ * @param callsite The callsite identifier of the group plus one.
+ * @return The slot of the group, or the empty slot where it belongs.
+ */
+static hues_scan_count* hues_scan_slot(hues_scan_count* counts, size_t capacity, uint64_t bucket, uint32_t level, uint32_t callsite) {
+    uint64_t hash = bucket * 0x9e3779b97f4a7c15ull ^ ((uint64_t) level << 32 | callsite) * 0xc2b2ae3d27d4eb4full;
+    size_t slot = (hash ^ (hash >> 29)) & (capacity - 1);
+    while (counts[slot].count > 0 && (counts[slot].bucket != bucket || counts[slot].level != level || counts[slot].callsite != callsite)) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    return &counts[slot];
+}
+
+/**
+ * @fn static void hues_scan_count_add(hues_scan* scan, uint64_t bucket, uint32_t level, uint32_t callsite)
+ * @brief Counts a record in its group.
+ * @param scan The scan.
+ * @param bucket The time bucket of the record.
+ * @param level The level of the record.
+ * @param callsite The callsite identifier of the record plus one.
+ */
+static void hues_scan_count_add(hues_scan* scan, uint64_t bucket, uint32_t level, uint32_t callsite) {
+    if (2 * (scan->counts_used + 1) > scan->counts_capacity) {
+        // Keep the table at most half full
+        size_t capacity = scan->counts_capacity > 0 ? 2 * scan->counts_capacity : 1024;
+        hues_scan_count* counts = calloc(capacity, sizeof(hues_scan_count));
+        for (size_t i = 0; i < scan->counts_capacity; i++) {
+            if (scan->counts[i].count > 0) {
+                *hues_scan_slot(counts, capacity, scan->counts[i].bucket, scan->counts[i].level, scan->counts[i].callsite) = scan->counts[i];
+            }
+        }
+        free(scan->counts);
+        scan->counts = counts;
+        scan->counts_capacity = capacity;
+    }
+    hues_scan_count* count = hues_scan_slot(scan->counts, scan->counts_capacity, bucket, level, callsite);
+    if (count->count == 0) {
+        *count = (hues_scan_count) { .bucket = bucket, .level = level, .callsite = callsite };
+        scan->counts_used++;
+    }
+    count->count++;
+}
+
+/**
+ * @fn static int hues_scan_archive(hues_scan* scan, const char* path)
+ * @brief Scans the records of a columnar log archive, printing or counting those matching the predicates of a scan.
+ * Row groups are ruled out from their header, then the predicates are evaluated column by column into a selection mask,
+ * in branchless loops the compiler vectorizes; the callsite predicate is evaluated once per dictionary entry.
+ * @param scan The scan.
+ * @param path The path of the archive.
+ * @return 0 on success, 1 if the archive cannot be read.
+ */
+static int hues_scan_archive(hues_scan* scan, const char* path) {
+    hues_columnar_archive* archive = hues_columnar_archive_open(path);
+    if (archive == NULL) {
+        fprintf(stderr, "%s: not a complete columnar log archive\n", path);
+        return 1;
+    }
+    uint32_t dictionary_count = archive->footer->dictionary_count;
+    uint8_t* callsite_matches = malloc(dictionary_count + 1);
+    uint32_t* callsite_identifiers = malloc((dictionary_count + 1) * sizeof(uint32_t));
+    for (uint32_t code = 0; code < dictionary_count; code++) {
+        const char* name = archive->callsites[code];
+        size_t length = archive->callsite_lengths[code];
+        callsite_matches[code] = scan->callsite == NULL || memmem(name, length, scan->callsite, strlen(scan->callsite)) != NULL;
+        callsite_identifiers[code] = scan->keys & HUES_SCAN_KEY_CALLSITE ? hues_scan_callsite(scan, name, length) + 1 : 0;
+    }
+    uint8_t* mask = malloc(HUES_COLUMNAR_GROUP_ROWS);
+    hues_columnar_rows rows = { 0 };
+    int result = 0;
+    const hues_columnar_group* group = NULL;
+    while ((group = hues_columnar_archive_next(archive, group)) != NULL) {
+        scan->groups++;
+        if (group->maximum_timestamp < scan->from || group->minimum_timestamp > scan->to || (group->levels >> scan->minimum_level) == 0) {
+            continue;
+        }
+        scan->groups_scanned++;
+        if (hues_columnar_decode(archive, group, &rows) != 0) {
+            fprintf(stderr, "%s: skipped a corrupt row group\n", path);
+            result = 1;
+            continue;
+        }
+        size_t count = rows.rows;
+        const uint64_t* timestamps = rows.timestamps;
+        const uint8_t* levels = rows.levels;
+        const uint32_t* callsites = rows.callsites;
+        uint64_t from = scan->from;
+        uint64_t to = scan->to;
+        uint8_t minimum_level = scan->minimum_level;
+        for (size_t i = 0; i < count; i++) {
+            mask[i] = (levels[i] >= minimum_level) & (timestamps[i] >= from) & (timestamps[i] <= to);
+        }
+        if (scan->callsite != NULL) {
+            for (size_t i = 0; i < count; i++) {
+                mask[i] &= callsite_matches[callsites[i]];
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (!mask[i]) {
+                continue;
+            }
+            scan->records++;
+            if (scan->keys == 0) {
+                size_t length = rows.text_offsets[i + 1] - rows.text_offsets[i];
+                const char* text = rows.text + rows.text_offsets[i];
+                char line[BUFFER_SIZE];
+                if (rows.value_offsets[i + 1] > rows.value_offsets[i]) {
+                    uint8_t arguments[HUES_ARGUMENTS_SIZE];
+                    size_t arguments_length = hues_columnar_arguments(&rows, i, arguments, sizeof(arguments));
+                    length = hues_arguments_line(text, length, arguments, arguments_length, line, sizeof(line));
+                    text = line;
+                }
+                fwrite(text, 1, length, stdout);
+                if (length == 0 || text[length - 1] != '\n') {
+                    putchar('\n');
+                }
+                continue;
+            }
+            uint64_t bucket = scan->keys & HUES_SCAN_KEY_TIME ? timestamps[i] - timestamps[i] % scan->bucket_width : 0;
+            uint32_t level = scan->keys & HUES_SCAN_KEY_LEVEL ? levels[i] : 0;
+            hues_scan_count_add(scan, bucket, level, callsite_identifiers[callsites[i]]);
+        }
+    }
+    free(rows.values);
+    free(rows.value_offsets);
+    free(rows.text_offsets);
+    free(rows.sequences);
+    free(rows.timestamps);
+    free(mask);
+    free(callsite_identifiers);
+    free(callsite_matches);
+    hues_columnar_archive_close(archive);
+    return result;
+}
+
+static const hues_scan* hues_scan_sorted;
+
+static int hues_scan_compare(const void* first, const void* second) {
+    const hues_scan_count* a = first;
+    const hues_scan_count* b = second;
+    if (a->bucket != b->bucket) {
+        return a->bucket < b->bucket ? -1 : 1;
+    }
+    if (a->callsite != b->callsite) {
+        return a->callsite == 0 ? -1 : b->callsite == 0 ? 1 : strcmp(hues_scan_sorted->callsites[a->callsite - 1], hues_scan_sorted->callsites[b->callsite - 1]);
+    }
+    return (int) a->level - (int) b->level;
+}
+
+/**
+ * @fn static void hues_scan_print_counts(hues_scan* scan)
+ * @brief Prints the groups of a scan and their number of records, by time, callsite and level.
+ * @param scan The scan.
+ */
+static void hues_scan_print_counts(hues_scan* scan) {
+    hues_scan_count* counts = malloc((scan->counts_used + 1) * sizeof(hues_scan_count));
+    size_t used = 0;
+    for (size_t i = 0; i < scan->counts_capacity; i++) {
+        if (scan->counts[i].count > 0) {
+            counts[used++] = scan->counts[i];
+        }
+    }
+    hues_scan_sorted = scan;
+    qsort(counts, used, sizeof(hues_scan_count), hues_scan_compare);
+    for (size_t i = 0; i < used; i++) {
+        if (scan->keys & HUES_SCAN_KEY_TIME) {
+            time_t seconds = counts[i].bucket / 1000000000;
+            struct tm fields;
+            char date[32];
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime_r(&seconds, &fields));
+            printf("%s\t", date);
+        }
+        if (scan->keys & HUES_SCAN_KEY_LEVEL) {
+            printf("%s\t", hues_level_name(counts[i].level));
+        }
+        if (scan->keys & HUES_SCAN_KEY_CALLSITE) {
+            printf("%s\t", scan->callsites[counts[i].callsite - 1]);
+        }
+        printf("%llu\n", (unsigned long long) counts[i].count);
+    }
+    free(counts);
+}
+
+int main(int argc, char** argv) {
+    hues_scan scan = { .from = 0, .to = UINT64_MAX, .minimum_level = HUES_LEVEL_TRACE, .bucket_width = 60000000000ull };
+    int verbose = 0;
+    int option;
+    while ((option = getopt(argc, argv, "f:t:l:c:g:b:v")) != -1) {
+        switch (option) {
+            case 'f':
+            case 't':
+                if (hues_time_parse(optarg, option == 'f' ? &scan.from : &scan.to) != 0) {
+                    fprintf(stderr, "hues-scan: invalid time: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'l':
+                scan.minimum_level = atoi(optarg);
+                break;
+            case 'c':
+                scan.callsite = optarg;
+                break;
+            case 'g':
+                for (char* key = strtok(optarg, ","); key != NULL; key = strtok(NULL, ",")) {
+                    if (strcmp(key, "time") == 0) {
+                        scan.keys |= HUES_SCAN_KEY_TIME;
+                    } else if (strcmp(key, "level") == 0) {
+                        scan.keys |= HUES_SCAN_KEY_LEVEL;
+                    } else if (strcmp(key, "callsite") == 0) {
+                        scan.keys |= HUES_SCAN_KEY_CALLSITE;
+                    } else {
+                        hues_scan_usage();
+                        return 2;
+                    }
+                }
+                break;
+            case 'b':
+                scan.bucket_width = strtoull(optarg, NULL, 0) * 1000000000ull;
+                if (scan.bucket_width == 0) {
+                    hues_scan_usage();
+                    return 2;
+                }
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                hues_scan_usage();
+                return 2;
+        }
+    }
+    if (optind == argc) {
+        hues_scan_usage();
+        return 2;
+    }
+    static char output[256 * 1024];
+    setvbuf(stdout, output, _IOFBF, sizeof(output));
+    int result = 0;
+    for (int i = optind; i < argc; i++) {
+        result |= hues_scan_archive(&scan, argv[i]);
+    }
+    if (scan.keys != 0) {
+        hues_scan_print_counts(&scan);
+    }
+    if (verbose) {
+        fflush(stdout);
+        fprintf(stderr, "hues-scan: decoded %zu of %zu row groups, selected %zu records\n", scan.groups_scanned, scan.groups, scan.records);
+    }
+    return result;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file hues_tail.c
+ * @brief Follows a shared memory ring of a live process
+ */
+
+#include "hues.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @def HUES_TAIL_POLL_INTERVAL
+ * @brief Time to wait for new records, in microseconds.
+ */
+#define HUES_TAIL_POLL_INTERVAL 10000
+
+/**
+ * @def HUES_TAIL_IN_FLIGHT_POLLS
+ * @brief Number of polls after which a reserved but incomplete record is considered torn.
+ */
+#define HUES_TAIL_IN_FLIGHT_POLLS 100
+
+static volatile sig_atomic_t hues_tail_stopping = 0;
+
+static void hues_tail_stop(int signal_number) {
+    hues_tail_stopping = 1;
+}
+
+static void hues_tail_usage() {
+    fprintf(stderr, "usage: hues-tail [-a] [-l level] name\n");
+    fprintf(stderr, "  -a        start from the oldest record still in the ring\n");
+    fprintf(stderr, "  -l level  only print records at or above level (0 = TRACE ... 5 = CRITICAL)\n");
+}
+
+int main(int argc, char** argv) {
+    int from_oldest = 0;
+    int minimum_level = HUES_LEVEL_TRACE;
+    int option;
+    while ((option = getopt(argc, argv, "al:")) != -1) {
+        switch (option) {
+            case 'a':
+                from_oldest = 1;
+                break;
+            case 'l':
+                minimum_level = atoi(optarg);
+                break;
+            default:
+                hues_tail_usage();
+                return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        hues_tail_usage();
+        return 2;
+    }
+    int fd = shm_open(argv[optind], O_RDONLY, 0);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if ((size_t) status.st_size < sizeof(hues_ring_header)) {
+        fprintf(stderr, "%s: not a hues ring\n", argv[optind]);
+        return 1;
+    }
+    const char* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    const hues_ring_header* ring = (const hues_ring_header*) mapping;
+    uint64_t capacity = ring->capacity;
+    if (ring->magic != HUES_RING_MAGIC || ring->version != HUES_RING_VERSION || sizeof(hues_ring_header) + capacity > (size_t) status.st_size) {
+        fprintf(stderr, "%s: not a hues ring\n", argv[optind]);
+        return 1;
+    }
+    signal(SIGINT, hues_tail_stop);
+    signal(SIGTERM, hues_tail_stop);
+    const char* data = mapping + sizeof(hues_ring_header);
+    hues_record_header* record = malloc(sizeof(hues_record_header) + capacity);  // The header and payload of the record copied
+    char* payload = (char*) (record + 1);
+    uint64_t position = __atomic_load_n(&ring->write_position, __ATOMIC_ACQUIRE);
+    int resynchronizing = 0;
+    if (from_oldest && position > capacity) {
+        position = (position - capacity + 7) & ~(uint64_t) 7;
+        resynchronizing = 1;
+    } else if (from_oldest) {
+        position = 0;
+    }
+    size_t in_flight_polls = 0;
+    uint64_t lost = 0;
+    while (!hues_tail_stopping) {
+        uint64_t write_position = __atomic_load_n(&ring->write_position, __ATOMIC_ACQUIRE);
+        if (write_position - position > capacity) {
+            // Lapped by the producers: skip to the oldest data still in the ring
+            uint64_t oldest = (write_position - capacity + 7) & ~(uint64_t) 7;
+            lost += oldest - position;
+            position = oldest;
+            resynchronizing = 1;
+        }
+        if (position == write_position) {
+            fflush(stdout);
+            usleep(HUES_TAIL_POLL_INTERVAL);
+            continue;
+        }
+        size_t offset = position % capacity;
+        if (capacity - offset < sizeof(hues_record_header)) {
+            position += capacity - offset;
+            continue;
+        }
+        hues_record_header header;
+        memcpy(&header, data + offset, sizeof(header));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        int valid = header.magic == HUES_RECORD_MAGIC && HUES_RECORD_SIZE(header.length) <= capacity - offset;
+        if (valid && !(header.flags & HUES_RECORD_FLAG_PADDING)) {
+            memcpy(payload, data + offset + sizeof(header), header.length);
+        }
+        valid = valid && header.checksum == hues_record_checksum(&header, header.flags & HUES_RECORD_FLAG_PADDING ? NULL : payload);
+        if (__atomic_load_n(&ring->write_position, __ATOMIC_ACQUIRE) - position > capacity) {
+            continue;  // Overwritten while copied
+        }
+        if (!valid) {
+            if (!resynchronizing && in_flight_polls++ < HUES_TAIL_IN_FLIGHT_POLLS) {
+                usleep(HUES_TAIL_POLL_INTERVAL / 10);  // Reserved by a producer that has not written it yet
+                continue;
+            }
+            in_flight_polls = 0;
+            lost += 8;
+            position += 8;
+            resynchronizing = 1;
+            continue;
+        }
+        in_flight_polls = 0;
+        resynchronizing = 0;
+        position += HUES_RECORD_SIZE(header.length);
+        if (header.flags & HUES_RECORD_FLAG_PADDING || header.level < minimum_level) {
+            continue;
+        }
+        if (lost > 0) {
+            fprintf(stderr, "hues-tail: lost %llu bytes of records\n", (unsigned long long) lost);
+            lost = 0;
+        }
+        memcpy(record, &header, sizeof(header));
+        size_t location_length = header.location_length <= header.length ? header.location_length : header.length;
+        char line[BUFFER_SIZE];
+        size_t length;
+        const char* text = hues_record_line(record, line, sizeof(line), &length);
+        int text_length = length;
+        if (text_length > 0 && text[text_length - 1] == '\n') {
+            text_length--;
+        }
+        printf("%s [%.*s] %.*s\n", hues_level_name(header.level), (int) location_length, payload, text_length, text);
+    }
+    free(record);
+    return 0;
+}